@@ -67,6 +67,12 @@ if(${UNIX})
 endif()
 
 
+# X11 support flag
+if(${UNIX} AND NOT "${NO_XCB}")
+	add_definitions(-DHAS_XCB)
+endif()
+
+
 # Generate the configuration files
 set(config_h_files "")
 foreach(file_in ${config_in_files})
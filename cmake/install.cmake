@@ -76,6 +76,11 @@ if(${UNIX})
 	install(DIRECTORY os-integration/unix/
 		DESTINATION share
 	)
+
+	# Public header describing the shared-memory clock state export.
+	install(FILES src/ipc/clockstate.h
+		DESTINATION include/${APP_NAME}
+	)
 endif()
 
 
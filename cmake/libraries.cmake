@@ -31,23 +31,33 @@ set(Boost_USE_STATIC_LIBS ON)
 find_package(Boost REQUIRED COMPONENTS system filesystem regex)
 
 
+# Threads
+find_package(Threads REQUIRED)
+
+
 # Qt
 set(CMAKE_AUTOMOC ON)
 find_package(Qt5Widgets REQUIRED)
 set(Qt5Modules Widgets)
-if(${UNIX})
+if(${UNIX} AND NOT "${NO_XCB}")
 	find_package(Qt5X11Extras REQUIRED)
 	set(Qt5Modules ${Qt5Modules} X11Extras)
 endif()
 
 
-# XCB
-if(${UNIX})
+# XCB (not needed by the kiosk builds, which run on the linuxfb platform only: see the NO_XCB flag)
+if(${UNIX} AND NOT "${NO_XCB}")
 	find_package(PkgConfig REQUIRED)
 	pkg_check_modules(Xcb REQUIRED xcb)
 endif()
 
 
+# POSIX real-time library (shared memory)
+if(${UNIX} AND NOT ${APPLE})
+	find_library(Rt_LIBRARIES rt)
+endif()
+
+
 # All libraries together
 set(all_INCLUDE_DIRS
 	${Boost_INCLUDE_DIRS} ${Xcb_INCLUDE_DIRS}
@@ -56,5 +66,5 @@ set(all_LIBRARY_DIRS
 	${Boost_LIBRARY_DIRS} ${Xcb_LIBRARY_DIRS}
 )
 set(all_LIBRARIES
-	${Boost_LIBRARIES} ${Xcb_LIBRARIES}
+	${Boost_LIBRARIES} ${Xcb_LIBRARIES} ${Rt_LIBRARIES} ${CMAKE_THREAD_LIBS_INIT}
 )
@@ -21,7 +21,30 @@
 
 
 #include "bitimer.h"
+#include "metrics.h"
 #include <algorithm>
+#include <vector>
+
+
+// Kinds of transitions counted in the metrics.
+enum class Transition { START, SWITCH, PAUSE, RESET, SWAP, FLAG_FALL };
+
+
+// Count a transition of the timer pair.
+static void count_transition(Transition transition)
+{
+	static const std::vector<Metrics::Counter> counters = []() {
+		std::vector<Metrics::Counter> retval;
+		Metrics &metrics(Metrics::instance());
+		for(const char *kind : { "start", "switch", "pause", "reset", "swap" }) {
+			retval.push_back(metrics.counter("vcc_bitimer_transitions_total", "Transitions of the timer pair, per kind.",
+				std::string("kind=\"") + kind + "\""));
+		}
+		retval.push_back(metrics.counter("vcc_flag_falls_total", "Timers stopped after having run out of time."));
+		return retval;
+	}();
+	counters[static_cast<std::size_t>(transition)].increment();
+}
 
 
 // Change the current time control, and resets the timers if necessary.
@@ -35,10 +58,10 @@ void BiTimer::set_time_control(const TimeControl &time_control)
 }
 
 
-// Current time of the timer on side `side`, with additional information.
-BiTimer::TimeInfo BiTimer::detailed_time(Side side) const
+// Time of the timer on side `side` at the given instant, with additional information.
+BiTimer::TimeInfo BiTimer::detailed_time(Side side, const TimePoint &at) const
 {
-	TimeDuration      tt   = _timer[side].time();
+	TimeDuration      tt   = _timer[side].time(at);
 	TimeControl::Mode mode = _time_control.mode();
 
 	// Negative remaining time -> never add any additional information
@@ -74,28 +97,29 @@ BiTimer::TimeInfo BiTimer::detailed_time(Side side) const
 
 
 // Start a timer.
-void BiTimer::start_timer(Side side)
+void BiTimer::start_timer(Side side, const TimePoint &at)
 {
 	// Deal with the situation where one of the timers is already running
 	if(_active_side) {
 		if(*_active_side!=side) {
-			change_timer();
+			change_timer(at);
 		}
 		return;
 	}
 
 	// Regular situation
-	if(_time_control.mode()==TimeControl::Mode::HOURGLASS && _timer[flip(side)].time()>=TIME_DURATION_ZERO) {
-		_timer[flip(side)].set_mode(Timer::Mode::INCREMENT);
+	if(_time_control.mode()==TimeControl::Mode::HOURGLASS && _timer[flip(side)].time(at)>=TIME_DURATION_ZERO) {
+		_timer[flip(side)].set_mode(Timer::Mode::INCREMENT, at);
 	}
-	_timer[side].set_mode(Timer::Mode::DECREMENT);
+	_timer[side].set_mode(Timer::Mode::DECREMENT, at);
 	_active_side = side;
+	count_transition(Transition::START);
 	_signal_state_changed();
 }
 
 
 // Change the active side
-void BiTimer::change_timer()
+void BiTimer::change_timer(const TimePoint &at)
 {
 	// Nothing to do if no timer is running
 	if(!_active_side) {
@@ -105,16 +129,19 @@ void BiTimer::change_timer()
 	// Regular situation
 	TimeControl::Mode current_mode = _time_control.mode();
 	Side              active_side  = *_active_side;
-	TimeDuration      current_time = _timer[active_side].time();
+	TimeDuration      current_time = _timer[active_side].time(at);
+	if(current_time<TIME_DURATION_ZERO) {
+		count_transition(Transition::FLAG_FALL);
+	}
 
 	// With hour-glass mode, the future "inactive" timer is incrementing
 	if(current_mode==TimeControl::Mode::HOURGLASS && current_time>=TIME_DURATION_ZERO) {
-		_timer[active_side].set_mode(Timer::Mode::INCREMENT);
+		_timer[active_side].set_mode(Timer::Mode::INCREMENT, at);
 	}
 
 	// Otherwise, it must be stopped
 	else {
-		_timer[active_side].set_mode(Timer::Mode::PAUSED);
+		_timer[active_side].set_mode(Timer::Mode::PAUSED, at);
 
 		// If the current player still has time, his/her timer may be incremented,
 		// depending on the time control mode.
@@ -155,8 +182,9 @@ void BiTimer::change_timer()
 
 	// The new active timer is now decrementing
 	active_side = flip(active_side);
-	_timer[active_side].set_mode(Timer::Mode::DECREMENT);
+	_timer[active_side].set_mode(Timer::Mode::DECREMENT, at);
 	_active_side = active_side;
+	count_transition(Transition::SWITCH);
 	_signal_state_changed();
 }
 
@@ -167,9 +195,13 @@ void BiTimer::stop_timer()
 	if(!_active_side) {
 		return;
 	}
+	if(_timer[*_active_side].time()<TIME_DURATION_ZERO) {
+		count_transition(Transition::FLAG_FALL);
+	}
 	_timer[Side::LEFT ].set_mode(Timer::Mode::PAUSED);
 	_timer[Side::RIGHT].set_mode(Timer::Mode::PAUSED);
 	_active_side = boost::none;
+	count_transition(Transition::PAUSE);
 	_signal_state_changed();
 }
 
@@ -191,6 +223,7 @@ void BiTimer::reset_timers()
 
 	// Update the state flag and fire the signal
 	_active_side = boost::none;
+	count_transition(Transition::RESET);
 	_signal_state_changed();
 }
 
@@ -224,5 +257,35 @@ void BiTimer::swap_sides()
 	}
 
 	// Fire the state-changed signal.
+	count_transition(Transition::SWAP);
+	_signal_state_changed();
+}
+
+
+// Snapshot of the current state.
+BiTimer::State BiTimer::state() const
+{
+	State retval;
+	retval.time_control    = _time_control;
+	retval.active_side     = _active_side;
+	retval.reference       = current_time();
+	retval.bronstein_limit = _bronstein_limit;
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		retval.mode[*s] = _timer[*s].mode();
+		retval.time[*s] = _timer[*s].time(retval.reference);
+	}
+	return retval;
+}
+
+
+// Replace the current state.
+void BiTimer::restore(const State &state)
+{
+	_time_control    = state.time_control;
+	_active_side     = state.active_side;
+	_bronstein_limit = state.bronstein_limit;
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		_timer[*s].restore(state.mode[*s], state.time[*s], state.reference);
+	}
 	_signal_state_changed();
 }
@@ -79,6 +79,19 @@ public:
 	};
 
 
+	/**
+	 * Complete state of the timer pair, as returned by `state()`.
+	 */
+	struct State
+	{
+		TimeControl                     time_control   ; //!< Current time control.
+		boost::optional<Side>           active_side    ; //!< Active side, if any.
+		TimePoint                       reference      ; //!< Instant at which `time` is evaluated.
+		Enum::array<Side, Timer::Mode>  mode           ; //!< Mode of each timer.
+		Enum::array<Side, TimeDuration> time           ; //!< Time of each timer at the instant `reference`.
+		Enum::array<Side, TimeDuration> bronstein_limit; //!< Bronstein threshold of each side.
+	};
+
 	/**
 	 * Constructor.
 	 */
@@ -126,10 +139,26 @@ public:
 	 */
 	TimeDuration time(Side side) const { return _timer[side].time(); }
 
+	/**
+	 * Time of the timer on side `side` at the given instant (assuming the state does not change in the meantime).
+	 */
+	TimeDuration time(Side side, const TimePoint &at) const { return _timer[side].time(at); }
+
 	/**
 	 * Current time of the timer on side `side`, with additional information.
 	 */
-	TimeInfo detailed_time(Side side) const;
+	TimeInfo detailed_time(Side side) const { return detailed_time(side, current_time()); }
+
+	/**
+	 * Time of the timer on side `side` at the given instant, with additional information
+	 * (assuming the state does not change in the meantime).
+	 */
+	TimeInfo detailed_time(Side side, const TimePoint &at) const;
+
+	/**
+	 * Whether the timer on side `side` is incrementing, decrementing or paused.
+	 */
+	Timer::Mode timer_mode(Side side) const { return _timer[side].mode(); }
 
 	/**
 	 * Start the timer corresponding to side `side`.
@@ -137,12 +166,24 @@ public:
 	 * If `side` is already active, nothing happens. If the opposite timer is active,
 	 * the method `change_timer()` is called.
 	 */
-	void start_timer(Side side);
+	void start_timer(Side side) { start_timer(side, current_time()); }
+
+	/**
+	 * Start the timer corresponding to side `side`, as if it had been done at the instant `at`
+	 * (typically, the instant at which the triggering event has been received).
+	 */
+	void start_timer(Side side, const TimePoint &at);
 
 	/**
 	 * Change the active side. Nothing happens if both timers are paused.
 	 */
-	void change_timer();
+	void change_timer() { change_timer(current_time()); }
+
+	/**
+	 * Change the active side, as if it had been done at the instant `at` (typically, the instant at which
+	 * the triggering event has been received, so that the time spent processing it is not charged to the player).
+	 */
+	void change_timer(const TimePoint &at);
 
 	/**
 	 * Stop the active timer. Nothing happens if both timers are paused.
@@ -159,6 +200,16 @@ public:
 	 */
 	void swap_sides();
 
+	/**
+	 * Snapshot of the current state.
+	 */
+	State state() const;
+
+	/**
+	 * Replace the current state by the given one (typically captured by `state()` in another process).
+	 */
+	void restore(const State &state);
+
 private:
 
 	// Private functions
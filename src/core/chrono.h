@@ -24,6 +24,8 @@
 #define CHRONO_H_
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include <cstdint>
 #include <cstdlib>
 
 
@@ -79,6 +81,46 @@ inline long to_seconds(const TimeDuration &td)
 }
 
 
+/**
+ * Number of microseconds elapsed between the Unix epoch and the given time point.
+ */
+inline std::int64_t to_epoch_microseconds(const TimePoint &tp)
+{
+	return (tp - TimePoint(boost::gregorian::date(1970, 1, 1))).total_microseconds();
+}
+
+
+/**
+ * Time point located the given number of microseconds after the Unix epoch.
+ */
+inline TimePoint from_epoch_microseconds(std::int64_t us)
+{
+	return TimePoint(boost::gregorian::date(1970, 1, 1)) + boost::posix_time::microseconds(us);
+}
+
+
+/**
+ * Number of microseconds elapsed between the Unix epoch and the given time point, counted in UTC. The time point
+ * is on the time base of `current_time()` (local time): the result does not depend on the time zone, and can
+ * be exchanged between machines.
+ */
+inline std::int64_t to_utc_epoch_microseconds(const TimePoint &tp)
+{
+	TimeDuration utc_offset = boost::date_time::c_local_adjustor<TimePoint>::utc_to_local(tp) - tp;
+	return to_epoch_microseconds(tp - utc_offset);
+}
+
+
+/**
+ * Time point (on the time base of `current_time()`) located the given number of microseconds after the Unix epoch,
+ * counted in UTC. Inverse of `to_utc_epoch_microseconds()`.
+ */
+inline TimePoint from_utc_epoch_microseconds(std::int64_t us)
+{
+	return boost::date_time::c_local_adjustor<TimePoint>::utc_to_local(from_epoch_microseconds(us));
+}
+
+
 /**
  * Division operator between two TimeDuration objects.
  */
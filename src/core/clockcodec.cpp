@@ -0,0 +1,328 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "clockcodec.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+
+// Offsets of the fields within the records.
+static const std::size_t TC_MODE      =  8;
+static const std::size_t TC_SIDE      = 16;
+static const std::size_t TC_SIDE_SIZE = 24;
+static const std::size_t BT_ACTIVE    =  8;
+static const std::size_t BT_MODE      =  9;
+static const std::size_t BT_REFERENCE = 16;
+static const std::size_t BT_SIDE      = 24;
+static const std::size_t BT_SIDE_SIZE = 16;
+static const std::size_t BT_TC        = 64;
+
+
+// Little-endian store/load of an unsigned integer of the given size (compiled into a single move on little-endian targets).
+static void store(unsigned char *out, std::uint64_t value, int bytes)
+{
+	for(int k=0; k<bytes; ++k) {
+		out[k] = static_cast<unsigned char>((value >> (8*k)) & 0xff);
+	}
+}
+
+static std::uint64_t load(const unsigned char *in, int bytes)
+{
+	std::uint64_t retval = 0;
+	for(int k=0; k<bytes; ++k) {
+		retval |= static_cast<std::uint64_t>(in[k]) << (8*k);
+	}
+	return retval;
+}
+
+
+// Write the common header of the records.
+static void store_header(unsigned char *out, std::uint32_t magic, std::size_t size)
+{
+	std::memset(out, 0, size);
+	store(out  , magic              , 4);
+	store(out+4, CLOCK_CODEC_VERSION, 2);
+	store(out+6, size               , 2);
+}
+
+
+// Check the common header of the records.
+static bool check_header(const unsigned char *in, std::size_t available, std::uint32_t magic, std::size_t size)
+{
+	return available>=size && load(in, 4)==magic && load(in+4, 2)==CLOCK_CODEC_VERSION && load(in+6, 2)==size;
+}
+
+
+// Write the record corresponding to the given time control.
+void encode_time_control(const TimeControl &time_control, char *out)
+{
+	unsigned char *data = reinterpret_cast<unsigned char *>(out);
+	store_header(data, TIME_CONTROL_RECORD_MAGIC, TIME_CONTROL_RECORD_SIZE);
+	data[TC_MODE] = Enum::to_value(time_control.mode());
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		unsigned char *side = data + TC_SIDE + TC_SIDE_SIZE*Enum::to_value(*s);
+		store(side   , time_control.main_time  (*s).total_microseconds(), 8);
+		store(side+ 8, time_control.increment  (*s).total_microseconds(), 8);
+		store(side+16, time_control.byo_periods(*s)                     , 4);
+	}
+}
+
+
+// Return the record corresponding to the given time control.
+std::string encode_time_control(const TimeControl &time_control)
+{
+	char buffer[TIME_CONTROL_RECORD_SIZE];
+	encode_time_control(time_control, buffer);
+	return std::string(buffer, TIME_CONTROL_RECORD_SIZE);
+}
+
+
+// Write the record corresponding to the given timer state.
+void encode_bi_timer_state(const BiTimer::State &state, char *out)
+{
+	unsigned char *data = reinterpret_cast<unsigned char *>(out);
+	store_header(data, BI_TIMER_RECORD_MAGIC, BI_TIMER_RECORD_SIZE);
+	data[BT_ACTIVE] = static_cast<unsigned char>(state.active_side ? Enum::to_value(*state.active_side) : -1);
+	store(data+BT_REFERENCE, to_utc_epoch_microseconds(state.reference), 8);
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		unsigned char *side = data + BT_SIDE + BT_SIDE_SIZE*Enum::to_value(*s);
+		data[BT_MODE + Enum::to_value(*s)] = static_cast<unsigned char>(state.mode[*s]);
+		store(side  , state.time           [*s].total_microseconds(), 8);
+		store(side+8, state.bronstein_limit[*s].total_microseconds(), 8);
+	}
+	encode_time_control(state.time_control, out + BT_TC);
+}
+
+
+// Return the record corresponding to the given timer state.
+std::string encode_bi_timer_state(const BiTimer::State &state)
+{
+	char buffer[BI_TIMER_RECORD_SIZE];
+	encode_bi_timer_state(state, buffer);
+	return std::string(buffer, BI_TIMER_RECORD_SIZE);
+}
+
+
+// Hash of a time control.
+std::uint64_t time_control_hash(const TimeControl &time_control)
+{
+	unsigned char buffer[TIME_CONTROL_RECORD_SIZE];
+	encode_time_control(time_control, reinterpret_cast<char *>(buffer));
+	std::uint64_t retval = 0xcbf29ce484222325ull;
+	for(unsigned char byte : buffer) {
+		retval = (retval ^ byte) * 0x100000001b3ull;
+	}
+	return retval;
+}
+
+
+// Check whether the buffer holds a readable time control record.
+bool TimeControlView::valid() const
+{
+	return check_header(_data, _size, TIME_CONTROL_RECORD_MAGIC, TIME_CONTROL_RECORD_SIZE);
+}
+
+
+// Fields of the time control record.
+std::int64_t TimeControlView::main_time_us(Side side) const { return static_cast<std::int64_t>(load(_data + TC_SIDE + TC_SIDE_SIZE*Enum::to_value(side)     , 8)); }
+std::int64_t TimeControlView::increment_us(Side side) const { return static_cast<std::int64_t>(load(_data + TC_SIDE + TC_SIDE_SIZE*Enum::to_value(side) +  8, 8)); }
+std::int32_t TimeControlView::byo_periods (Side side) const { return static_cast<std::int32_t>(load(_data + TC_SIDE + TC_SIDE_SIZE*Enum::to_value(side) + 16, 4)); }
+
+
+// Build the corresponding time control object.
+TimeControl TimeControlView::decode() const
+{
+	if(!valid() || mode()>=Enum::traits<TimeControl::Mode>::count) {
+		throw std::invalid_argument("Invalid time control record.");
+	}
+	TimeControl retval;
+	retval.set_mode(Enum::from_value<TimeControl::Mode>(mode()));
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		retval.set_main_time  (*s, boost::posix_time::microseconds(main_time_us(*s)));
+		retval.set_increment  (*s, boost::posix_time::microseconds(increment_us(*s)));
+		retval.set_byo_periods(*s, byo_periods(*s));
+	}
+	return retval;
+}
+
+
+// Check whether the buffer holds a readable timer state record.
+bool BiTimerStateView::valid() const
+{
+	return check_header(_data, _size, BI_TIMER_RECORD_MAGIC, BI_TIMER_RECORD_SIZE) && time_control().valid();
+}
+
+
+// Fields of the timer state record.
+std::int64_t    BiTimerStateView::reference_us      ()          const { return static_cast<std::int64_t>(load(_data + BT_REFERENCE, 8)); }
+std::int64_t    BiTimerStateView::time_us           (Side side) const { return static_cast<std::int64_t>(load(_data + BT_SIDE + BT_SIDE_SIZE*Enum::to_value(side)    , 8)); }
+std::int64_t    BiTimerStateView::bronstein_limit_us(Side side) const { return static_cast<std::int64_t>(load(_data + BT_SIDE + BT_SIDE_SIZE*Enum::to_value(side) + 8, 8)); }
+TimeControlView BiTimerStateView::time_control      ()          const { return TimeControlView(reinterpret_cast<const char *>(_data + BT_TC), TIME_CONTROL_RECORD_SIZE); }
+
+
+// Build the corresponding timer state.
+BiTimer::State BiTimerStateView::decode() const
+{
+	if(!valid() || active_side()<-1 || active_side()>=static_cast<int>(Enum::traits<Side>::count)) {
+		throw std::invalid_argument("Invalid timer state record.");
+	}
+	BiTimer::State retval;
+	retval.time_control = time_control().decode();
+	retval.reference    = from_utc_epoch_microseconds(reference_us());
+	if(active_side()>=0) {
+		retval.active_side = Enum::from_value<Side>(active_side());
+	}
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		if(timer_mode(*s)>static_cast<std::uint8_t>(Timer::Mode::PAUSED)) {
+			throw std::invalid_argument("Invalid timer state record.");
+		}
+		retval.mode           [*s] = static_cast<Timer::Mode>(timer_mode(*s));
+		retval.time           [*s] = boost::posix_time::microseconds(time_us(*s));
+		retval.bronstein_limit[*s] = boost::posix_time::microseconds(bronstein_limit_us(*s));
+	}
+	return retval;
+}
+
+
+
+// *****************************************************************************
+// Checks
+// *****************************************************************************
+
+
+// Reference instant of the known timer state record: 2014-06-01 12:00:00.25 UTC.
+static const std::int64_t KNOWN_REFERENCE_US = 1401624000250000ll;
+
+// Known timer state record (byo-yomi, right timer running), written from the layout described in the header.
+static const char KNOWN_BI_TIMER_RECORD[] =
+	"\x56\x43\x42\x54\x01\x00\x80\x00\x01\x02\x01\x00\x00\x00\x00\x00" // header, active side, timer modes
+	"\x90\xc0\xa4\x04\xc5\xfa\x04\x00\x15\xcd\x5b\x07\x00\x00\x00\x00" // reference instant, left time
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x40\xc9\xa2\x03\x00\x00\x00\x00" // left Bronstein limit, right time
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00" // right Bronstein limit
+	"\x56\x43\x54\x43\x01\x00\x40\x00\x04\x00\x00\x00\x00\x00\x00\x00" // time control: header, mode
+	"\x00\xa3\xe1\x11\x00\x00\x00\x00\x80\xc3\xc9\x01\x00\x00\x00\x00" // left main time, left increment
+	"\x05\x00\x00\x00\x00\x00\x00\x00\x00\x95\xba\x0a\x00\x00\x00\x00" // left byo-periods, right main time
+	"\x80\x96\x98\x00\x00\x00\x00\x00\x03\x00\x00\x00\x00\x00\x00\x00";// right increment, right byo-periods
+
+// Time zones in which the checks are run.
+static const char *const CHECKED_TIME_ZONES[] = { "UTC0", "CET-1CEST,M3.5.0,M10.5.0/3", "EST5EDT,M3.2.0,M11.1.0", "NPT-5:45", "LINT-14" };
+
+
+// Timer state corresponding to the known record (the reference instant being on the time base of `current_time()`).
+static BiTimer::State known_bi_timer_state()
+{
+	BiTimer::State retval;
+	retval.time_control.set_mode(TimeControl::Mode::BYO_YOMI);
+	retval.time_control.set_main_time  (Side::LEFT , boost::posix_time::seconds(300));
+	retval.time_control.set_increment  (Side::LEFT , boost::posix_time::seconds( 30));
+	retval.time_control.set_byo_periods(Side::LEFT , 5);
+	retval.time_control.set_main_time  (Side::RIGHT, boost::posix_time::seconds(180));
+	retval.time_control.set_increment  (Side::RIGHT, boost::posix_time::seconds( 10));
+	retval.time_control.set_byo_periods(Side::RIGHT, 3);
+	retval.active_side               = Side::RIGHT;
+	retval.reference                 = from_utc_epoch_microseconds(KNOWN_REFERENCE_US);
+	retval.mode           [Side::LEFT ] = Timer::Mode::PAUSED;
+	retval.mode           [Side::RIGHT] = Timer::Mode::DECREMENT;
+	retval.time           [Side::LEFT ] = boost::posix_time::microseconds(123456789);
+	retval.time           [Side::RIGHT] = boost::posix_time::seconds(61);
+	retval.bronstein_limit[Side::LEFT ] = TIME_DURATION_ZERO;
+	retval.bronstein_limit[Side::RIGHT] = TIME_DURATION_ZERO;
+	return retval;
+}
+
+
+// Whether two timer states are equal.
+static bool equal_states(const BiTimer::State &lhs, const BiTimer::State &rhs)
+{
+	if(lhs.time_control!=rhs.time_control || lhs.active_side!=rhs.active_side || lhs.reference!=rhs.reference) {
+		return false;
+	}
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		if(lhs.mode[*s]!=rhs.mode[*s] || lhs.time[*s]!=rhs.time[*s] || lhs.bronstein_limit[*s]!=rhs.bronstein_limit[*s]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Checks of the encoding in the current time zone.
+static void check_clock_codec_in_time_zone(const std::string &zone, std::vector<std::string> &failures)
+{
+	// Known bytes: the record does not depend on the time zone.
+	BiTimer::State known = known_bi_timer_state();
+	std::string record = encode_bi_timer_state(known);
+	if(record!=std::string(KNOWN_BI_TIMER_RECORD, BI_TIMER_RECORD_SIZE)) {
+		failures.push_back(zone + ": the timer state record differs from the known one");
+	}
+	if(record.substr(BT_TC)!=encode_time_control(known.time_control)) {
+		failures.push_back(zone + ": the embedded time control record differs from the standalone one");
+	}
+
+	// Round trip, for the known state and for the current instant.
+	BiTimer::State now = known;
+	now.reference = current_time();
+	for(const BiTimer::State &state : {known, now}) {
+		std::string encoded = encode_bi_timer_state(state);
+		BiTimerStateView view(encoded.data(), encoded.size());
+		if(!view.valid() || !equal_states(view.decode(), state)) {
+			failures.push_back(zone + ": the timer state does not survive the round trip");
+		}
+		if(view.valid() && view.reference_us()!=to_utc_epoch_microseconds(state.reference)) {
+			failures.push_back(zone + ": the reference instant is not encoded in UTC");
+		}
+	}
+	if(TimeControlView(record.data()+BT_TC, TIME_CONTROL_RECORD_SIZE).decode()!=known.time_control) {
+		failures.push_back(zone + ": the time control does not survive the round trip");
+	}
+}
+
+
+// Check the encoding.
+std::vector<std::string> check_clock_codec()
+{
+	const char *previous = std::getenv("TZ");
+	std::string saved = previous==nullptr ? std::string() : previous;
+
+	std::vector<std::string> retval;
+	for(const char *zone : CHECKED_TIME_ZONES) {
+		setenv("TZ", zone, 1);
+		tzset();
+		try {
+			check_clock_codec_in_time_zone(zone, retval);
+		}
+		catch(std::exception &err) {
+			retval.push_back(std::string(zone) + ": " + err.what());
+		}
+	}
+
+	if(previous==nullptr) {
+		unsetenv("TZ");
+	}
+	else {
+		setenv("TZ", saved.c_str(), 1);
+	}
+	tzset();
+	return retval;
+}
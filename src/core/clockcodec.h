@@ -0,0 +1,209 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef CLOCKCODEC_H_
+#define CLOCKCODEC_H_
+
+#include "bitimer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Canonical binary encoding of `TimeControl` and `BiTimer::State` objects.
+ *
+ * Both records have a fixed size and a fixed layout, all the integers being little-endian and all the durations
+ * being expressed in microseconds. They start with the same 8-byte header:
+ *
+ *     u32 magic           TIME_CONTROL_RECORD_MAGIC or BI_TIMER_RECORD_MAGIC
+ *     u16 version         CLOCK_CODEC_VERSION
+ *     u16 size            size of the record (in bytes)
+ *
+ * Time control record (TIME_CONTROL_RECORD_SIZE bytes):
+ *
+ *      8  u8  mode                (see `TimeControl::Mode`)
+ *      9  7 bytes reserved (zero)
+ *     16  for each side (24 bytes): i64 main time, i64 increment, i32 byo-periods, u32 reserved (zero)
+ *
+ * Timer state record (BI_TIMER_RECORD_SIZE bytes):
+ *
+ *      8  i8  active side         (-1: none, 0: left, 1: right)
+ *      9  u8  timer mode of each side (see `Timer::Mode`)
+ *     11  5 bytes reserved (zero)
+ *     16  i64 reference instant   (microseconds since the Unix epoch, UTC, whatever the time zone of the machine)
+ *     24  for each side (16 bytes): i64 time at the reference instant, i64 Bronstein limit
+ *     56  8 bytes reserved (zero)
+ *     64  time control record
+ *
+ * As the reserved bytes are always zero, two equal objects always have the same encoding: the records
+ * can be compared or hashed directly. They can also be read in place (without copy nor allocation) through
+ * `TimeControlView` and `BiTimerStateView`, whatever the alignment of the buffer.
+ */
+const std::uint16_t CLOCK_CODEC_VERSION = 1;
+
+/**
+ * Magic number of the time control records ("VCTC").
+ */
+const std::uint32_t TIME_CONTROL_RECORD_MAGIC = 0x43544356;
+
+/**
+ * Magic number of the timer state records ("VCBT").
+ */
+const std::uint32_t BI_TIMER_RECORD_MAGIC = 0x54424356;
+
+/**
+ * Size of a time control record (in bytes).
+ */
+const std::size_t TIME_CONTROL_RECORD_SIZE = 64;
+
+/**
+ * Size of a timer state record (in bytes).
+ */
+const std::size_t BI_TIMER_RECORD_SIZE = 128;
+
+
+/**
+ * Write the record corresponding to the given time control into `out` (`TIME_CONTROL_RECORD_SIZE` bytes).
+ */
+void encode_time_control(const TimeControl &time_control, char *out);
+
+/**
+ * Return the record corresponding to the given time control.
+ */
+std::string encode_time_control(const TimeControl &time_control);
+
+/**
+ * Write the record corresponding to the given timer state into `out` (`BI_TIMER_RECORD_SIZE` bytes).
+ */
+void encode_bi_timer_state(const BiTimer::State &state, char *out);
+
+/**
+ * Return the record corresponding to the given timer state.
+ */
+std::string encode_bi_timer_state(const BiTimer::State &state);
+
+/**
+ * 64-bit hash of a time control (FNV-1a of its record), stable across platforms and versions of the program
+ * as long as `CLOCK_CODEC_VERSION` does not change.
+ */
+std::uint64_t time_control_hash(const TimeControl &time_control);
+
+
+/**
+ * Check the encoding against known records (the layout above), and the round trip of the timer states, in several
+ * time zones (the `TZ` environment variable is restored afterward).
+ * @returns The description of the failed checks (empty if all of them pass).
+ */
+std::vector<std::string> check_clock_codec();
+
+
+/**
+ * Read-only view on a time control record.
+ *
+ * The accessors read the underlying buffer directly: they must only be called if `valid()` returns true.
+ */
+class TimeControlView
+{
+public:
+
+	/**
+	 * Constructor. The buffer must outlive the view.
+	 */
+	TimeControlView(const char *data, std::size_t size) : _data(reinterpret_cast<const unsigned char *>(data)), _size(size) {}
+
+	/**
+	 * Check whether the buffer holds a record that can be read by this version of the program.
+	 */
+	bool valid() const;
+
+	/**
+	 * @name Fields of the record.
+	 * @{
+	 */
+	std::uint8_t mode        ()          const { return _data[8]; }
+	std::int64_t main_time_us(Side side) const;
+	std::int64_t increment_us(Side side) const;
+	std::int32_t byo_periods (Side side) const;
+	/**@} */
+
+	/**
+	 * Build the corresponding time control object.
+	 * @throw std::invalid_argument If the record is not valid, or if some of its fields are out of range.
+	 */
+	TimeControl decode() const;
+
+private:
+
+	// Private members
+	const unsigned char *_data;
+	std::size_t          _size;
+};
+
+
+/**
+ * Read-only view on a timer state record.
+ *
+ * The accessors read the underlying buffer directly: they must only be called if `valid()` returns true.
+ */
+class BiTimerStateView
+{
+public:
+
+	/**
+	 * Constructor. The buffer must outlive the view.
+	 */
+	BiTimerStateView(const char *data, std::size_t size) : _data(reinterpret_cast<const unsigned char *>(data)), _size(size) {}
+
+	/**
+	 * Check whether the buffer holds a record that can be read by this version of the program
+	 * (including the embedded time control record).
+	 */
+	bool valid() const;
+
+	/**
+	 * @name Fields of the record.
+	 * @{
+	 */
+	std::int8_t     active_side       ()          const { return static_cast<std::int8_t>(_data[8]); }
+	std::uint8_t    timer_mode        (Side side) const { return _data[9 + Enum::to_value(side)]; }
+	std::int64_t    reference_us      ()          const;
+	std::int64_t    time_us           (Side side) const;
+	std::int64_t    bronstein_limit_us(Side side) const;
+	TimeControlView time_control      ()          const;
+	/**@} */
+
+	/**
+	 * Build the corresponding timer state.
+	 * @throw std::invalid_argument If the record is not valid, or if some of its fields are out of range.
+	 */
+	BiTimer::State decode() const;
+
+private:
+
+	// Private members
+	const unsigned char *_data;
+	std::size_t          _size;
+};
+
+#endif /* CLOCKCODEC_H_ */
@@ -0,0 +1,101 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "filewatcher.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+
+// Constructor.
+FileWatcher::FileWatcher(const std::vector<std::string> &directories) : _notify_fd(-1)
+{
+	_notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(_notify_fd<0) {
+		throw std::runtime_error("Unable to create the inotify instance.");
+	}
+	for(const auto &directory : directories) {
+		int wd = inotify_add_watch(_notify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+		if(wd>=0) {
+			_directories[wd] = directory;
+		}
+	}
+	if(_directories.empty()) {
+		close(_notify_fd);
+		throw std::runtime_error("None of the directories can be watched.");
+	}
+}
+
+
+// Destructor.
+FileWatcher::~FileWatcher()
+{
+	close(_notify_fd);
+}
+
+
+// Retrieve the pending changes.
+std::vector<std::string> FileWatcher::changed_files()
+{
+	std::vector<std::string> retval;
+	alignas(inotify_event) char buffer[4096];
+	while(true) {
+		ssize_t received = read(_notify_fd, buffer, sizeof(buffer));
+		if(received<0 && errno==EINTR) {
+			continue;
+		}
+		if(received<=0) {
+			break;
+		}
+		for(ssize_t offset=0; offset<received; ) {
+			const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			auto it = _directories.find(event->wd);
+			if(it==_directories.end() || event->len==0 || (event->mask & IN_ISDIR)!=0) {
+				continue;
+			}
+			std::string path = it->second + "/" + event->name;
+			if(std::find(retval.begin(), retval.end(), path)==retval.end()) {
+				retval.push_back(path);
+			}
+		}
+	}
+	return retval;
+}
+
+#else
+
+// inotify is not available: the directories cannot be watched.
+FileWatcher::FileWatcher(const std::vector<std::string> &) : _notify_fd(-1)
+{
+	throw std::runtime_error("Watching the files is not supported on this platform.");
+}
+
+FileWatcher::~FileWatcher() {}
+std::vector<std::string> FileWatcher::changed_files() { return std::vector<std::string>(); }
+
+#endif /* OS_IS_UNIX */
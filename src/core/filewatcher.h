@@ -0,0 +1,83 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef FILEWATCHER_H_
+#define FILEWATCHER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+/**
+ * Watch some directories for the files that are written or moved into them (through inotify).
+ *
+ * The changes are reported through a descriptor, `notify_fd()`, that becomes readable when some events are pending:
+ * the owner (typically with a `QSocketNotifier`) then calls `changed_files()` to retrieve the paths of the files
+ * concerned. Only completed changes are reported: a file is reported when it is closed after being written, or when
+ * it is renamed into a watched directory (as done by the tools that replace a file atomically), not while
+ * it is being written. Sub-directories are not watched recursively.
+ *
+ * Only available on Unix platforms (Linux).
+ */
+class FileWatcher
+{
+public:
+
+	/**
+	 * Constructor. Start watching the given directories (the ones that do not exist are ignored).
+	 * @throw std::runtime_error If none of the directories can be watched.
+	 */
+	explicit FileWatcher(const std::vector<std::string> &directories);
+
+	/**
+	 * Destructor.
+	 */
+	~FileWatcher();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	FileWatcher(const FileWatcher &op) = delete;
+	FileWatcher &operator=(const FileWatcher &op) = delete;
+	/**@} */
+
+	/**
+	 * Descriptor that becomes readable when some changes are waiting to be retrieved.
+	 */
+	int notify_fd() const { return _notify_fd; }
+
+	/**
+	 * Retrieve the pending changes.
+	 * @returns Paths of the files that have changed since the previous call (each path being listed once).
+	 */
+	std::vector<std::string> changed_files();
+
+private:
+
+	// Private members
+	int                        _notify_fd  ;
+	std::map<int, std::string> _directories; // Watched directories, per watch descriptor.
+};
+
+#endif /* FILEWATCHER_H_ */
@@ -0,0 +1,398 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef FUTURE_H_
+#define FUTURE_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+
+
+/**
+ * Object able to run tasks, for instance a thread pool or the main event loop.
+ */
+class Executor
+{
+public:
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~Executor() {}
+
+	/**
+	 * Schedule the given task. The method returns immediately, and never runs the task synchronously.
+	 */
+	virtual void post(std::function<void()> task)=0;
+};
+
+
+template<typename T> class Future;
+template<typename T> class Promise;
+
+
+namespace detail
+{
+	/**
+	 * Synchronization part of the state shared between a promise and its futures.
+	 */
+	class FutureStateBase
+	{
+	public:
+
+		FutureStateBase() : _ready(false) {}
+
+		FutureStateBase(const FutureStateBase &op) = delete;
+		FutureStateBase &operator=(const FutureStateBase &op) = delete;
+
+		bool is_ready() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _ready;
+		}
+
+		void wait() const
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this]() { return _ready; });
+		}
+
+		void set_exception(std::exception_ptr error)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_error = error;
+			mark_ready(lock);
+		}
+
+		// The continuation is executed immediately (in the calling thread) if the state is already ready,
+		// or by the thread that makes the state ready otherwise.
+		void add_continuation(std::function<void()> continuation)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if(!_ready) {
+				_continuations.push_back(std::move(continuation));
+				return;
+			}
+			lock.unlock();
+			continuation();
+		}
+
+	protected:
+
+		void rethrow_if_failed() const
+		{
+			if(_error) {
+				std::rethrow_exception(_error);
+			}
+		}
+
+		// Must be called with `_mutex` locked through `lock`, which is released by the function.
+		void mark_ready(std::unique_lock<std::mutex> &lock)
+		{
+			std::vector<std::function<void()>> continuations;
+			_ready = true;
+			continuations.swap(_continuations);
+			lock.unlock();
+			_condition.notify_all();
+			for(auto &it : continuations) {
+				it();
+			}
+		}
+
+		mutable std::mutex                 _mutex        ;
+		mutable std::condition_variable    _condition    ;
+		bool                               _ready        ;
+		std::exception_ptr                 _error        ;
+		std::vector<std::function<void()>> _continuations;
+	};
+
+
+	/**
+	 * State shared between a promise and its futures.
+	 */
+	template<typename T>
+	class FutureState : public FutureStateBase
+	{
+	public:
+
+		void set_value(T value)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_value = std::move(value);
+			mark_ready(lock);
+		}
+
+		const T &value() const
+		{
+			wait();
+			rethrow_if_failed();
+			return *_value;
+		}
+
+	private:
+		boost::optional<T> _value;
+	};
+
+
+	/**
+	 * State shared between a promise and its futures (specialization for `void`).
+	 */
+	template<>
+	class FutureState<void> : public FutureStateBase
+	{
+	public:
+
+		void set_value()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			mark_ready(lock);
+		}
+
+		void value() const
+		{
+			wait();
+			rethrow_if_failed();
+		}
+	};
+
+
+	/**
+	 * Invoke a callable object, and store either its result or the exception it throws in a shared state.
+	 */
+	template<typename R>
+	struct Fulfill
+	{
+		template<typename F, typename... Args>
+		static void run(FutureState<R> &state, F &f, Args &&... args)
+		{
+			try {
+				state.set_value(f(std::forward<Args>(args)...));
+			}
+			catch(...) {
+				state.set_exception(std::current_exception());
+			}
+		}
+	};
+
+	template<>
+	struct Fulfill<void>
+	{
+		template<typename F, typename... Args>
+		static void run(FutureState<void> &state, F &f, Args &&... args)
+		{
+			try {
+				f(std::forward<Args>(args)...);
+			}
+			catch(...) {
+				state.set_exception(std::current_exception());
+				return;
+			}
+			state.set_value();
+		}
+	};
+
+
+	/**
+	 * Type returned by `Future<T>::get()`.
+	 */
+	template<typename T> struct GetType       { typedef const T &type; };
+	template<>           struct GetType<void> { typedef void     type; };
+
+
+	/**
+	 * Result type and invocation of a value-based continuation.
+	 */
+	template<typename T, typename F>
+	struct Then
+	{
+		typedef typename std::result_of<F(const T &)>::type type;
+		template<typename Fut> static type call(F &f, const Fut &previous) { return f(previous.get()); }
+	};
+
+	template<typename F>
+	struct Then<void, F>
+	{
+		typedef typename std::result_of<F()>::type type;
+		template<typename Fut> static type call(F &f, const Fut &previous) { previous.get(); return f(); }
+	};
+
+} // namespace detail
+
+
+
+/**
+ * Result of an asynchronous operation.
+ *
+ * Futures are cheap to copy: all the copies refer to the same shared state.
+ */
+template<typename T>
+class Future
+{
+	friend class Promise<T>;
+
+public:
+
+	/**
+	 * Type returned by `get()`.
+	 */
+	typedef typename detail::GetType<T>::type get_type;
+
+	/**
+	 * Default constructor (invalid future).
+	 */
+	Future() {}
+
+	/**
+	 * Whether the future refers to a shared state.
+	 */
+	bool valid() const { return static_cast<bool>(_state); }
+
+	/**
+	 * Whether the result (or the error) is available.
+	 */
+	bool is_ready() const { return _state->is_ready(); }
+
+	/**
+	 * Block until the result (or the error) is available.
+	 */
+	void wait() const { _state->wait(); }
+
+	/**
+	 * Block until the result is available, and return it.
+	 * @throw Rethrow the exception raised by the asynchronous operation, if any.
+	 */
+	get_type get() const { return _state->value(); }
+
+	/**
+	 * Schedule `f` on `executor` when the current future becomes ready (whether it succeeds or not).
+	 * `f` receives the current (ready) future.
+	 */
+	template<typename F>
+	Future<typename std::result_of<F(const Future &)>::type> continue_with(Executor &executor, F f) const
+	{
+		typedef typename std::result_of<F(const Future &)>::type R;
+		Promise<R> promise;
+		Future     self(*this);
+		Executor  *target = &executor;
+		_state->add_continuation([=]() {
+			target->post([=]() mutable { promise.fulfill(f, self); });
+		});
+		return promise.get_future();
+	}
+
+	/**
+	 * Schedule `f` on `executor` when the current future succeeds. `f` receives the result of the current future
+	 * (or nothing if `T` is `void`). If the current future fails, the returned future fails with the same error,
+	 * and `f` is not called.
+	 */
+	template<typename F>
+	Future<typename detail::Then<T, F>::type> then(Executor &executor, F f) const
+	{
+		return continue_with(executor, [f](const Future &previous) mutable {
+			return detail::Then<T, F>::call(f, previous);
+		});
+	}
+
+private:
+
+	// Private constructor
+	explicit Future(std::shared_ptr<detail::FutureState<T>> state) : _state(std::move(state)) {}
+
+	// Private members
+	std::shared_ptr<detail::FutureState<T>> _state;
+};
+
+
+
+/**
+ * Writable end of a future.
+ */
+template<typename T>
+class Promise
+{
+public:
+
+	/**
+	 * Constructor.
+	 */
+	Promise() : _state(std::make_shared<detail::FutureState<T>>()) {}
+
+	/**
+	 * Future associated to the promise.
+	 */
+	Future<T> get_future() const { return Future<T>(_state); }
+
+	/**
+	 * Make the associated future ready with the given value.
+	 */
+	template<typename... Args>
+	void set_value(Args &&... args) const { _state->set_value(std::forward<Args>(args)...); }
+
+	/**
+	 * Make the associated future ready with the given error.
+	 */
+	void set_exception(std::exception_ptr error) const { _state->set_exception(error); }
+
+	/**
+	 * Invoke `f`, and make the associated future ready with either its result or the exception it throws.
+	 */
+	template<typename F, typename... Args>
+	void fulfill(F &f, Args &&... args) const { detail::Fulfill<T>::run(*_state, f, std::forward<Args>(args)...); }
+
+private:
+
+	// Private members
+	std::shared_ptr<detail::FutureState<T>> _state;
+};
+
+
+/**
+ * Return a future that is already ready with the given value.
+ */
+template<typename T>
+Future<typename std::decay<T>::type> make_ready_future(T &&value)
+{
+	Promise<typename std::decay<T>::type> promise;
+	promise.set_value(std::forward<T>(value));
+	return promise.get_future();
+}
+
+
+/**
+ * Return a `void` future that is already ready.
+ */
+inline Future<void> make_ready_future()
+{
+	Promise<void> promise;
+	promise.set_value();
+	return promise.get_future();
+}
+
+
+#endif /* FUTURE_H_ */
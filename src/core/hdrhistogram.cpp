@@ -0,0 +1,165 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "hdrhistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+
+// Constructor.
+HdrHistogram::HdrHistogram()
+{
+	reset();
+}
+
+
+// Forget all the recorded values.
+void HdrHistogram::reset()
+{
+	for(auto &it : _buckets) {
+		it.store(0, std::memory_order_relaxed);
+	}
+	_count.store(0, std::memory_order_relaxed);
+	_sum  .store(0, std::memory_order_relaxed);
+	_max  .store(0, std::memory_order_relaxed);
+}
+
+
+// Bucket in which a value is counted.
+std::size_t HdrHistogram::bucket_of(std::int64_t value)
+{
+	std::uint64_t v = static_cast<std::uint64_t>(value<0 ? 0 : value>MAX_VALUE ? MAX_VALUE : value);
+	if(v<SUB_BUCKET_COUNT) {
+		return v;
+	}
+	int magnitude = 63 - __builtin_clzll(v);
+	int shift     = magnitude - 6; // <- Keeps the 7 most significant bits of the value.
+	return shift * (SUB_BUCKET_COUNT / 2) + (v >> shift);
+}
+
+
+// Largest value counted in a bucket.
+std::int64_t HdrHistogram::highest_in(std::size_t bucket)
+{
+	if(bucket<SUB_BUCKET_COUNT) {
+		return bucket;
+	}
+	std::size_t shift = bucket / (SUB_BUCKET_COUNT / 2) - 1;
+	std::size_t sub   = bucket - shift * (SUB_BUCKET_COUNT / 2);
+	return (static_cast<std::int64_t>(sub + 1) << shift) - 1;
+}
+
+
+// Record a duration.
+void HdrHistogram::record(std::int64_t value)
+{
+	value = std::max<std::int64_t>(value, 0);
+	_buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum  .fetch_add(value, std::memory_order_relaxed);
+	std::int64_t current = _max.load(std::memory_order_relaxed);
+	while(value>current && !_max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+
+// Mean of the recorded values.
+double HdrHistogram::mean() const
+{
+	std::uint64_t count = _count.load(std::memory_order_relaxed);
+	return count==0 ? 0.0 : static_cast<double>(_sum.load(std::memory_order_relaxed)) / count;
+}
+
+
+// Value below which the given fraction of the recorded values lie.
+std::int64_t HdrHistogram::quantile(double fraction) const
+{
+	// The total is recomputed from the buckets, as values may be recorded while they are read.
+	std::uint64_t snapshot[BUCKET_COUNT];
+	std::uint64_t total = 0;
+	for(std::size_t k=0; k<BUCKET_COUNT; ++k) {
+		snapshot[k] = _buckets[k].load(std::memory_order_relaxed);
+		total += snapshot[k];
+	}
+	if(total==0) {
+		return 0;
+	}
+	fraction = std::min(std::max(fraction, 0.0), 1.0);
+	std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(fraction * total)));
+	std::uint64_t seen = 0;
+	for(std::size_t k=0; k<BUCKET_COUNT; ++k) {
+		seen += snapshot[k];
+		if(seen>=rank) {
+			return std::min(highest_in(k), max());
+		}
+	}
+	return max();
+}
+
+
+// Distribution of the recorded values, in the percentile-distribution text format of the HdrHistogram tools.
+std::string HdrHistogram::percentile_distribution() const
+{
+	static const int TICKS_PER_HALF_DISTANCE = 5;
+
+	std::uint64_t snapshot[BUCKET_COUNT];
+	std::uint64_t total = 0;
+	for(std::size_t k=0; k<BUCKET_COUNT; ++k) {
+		snapshot[k] = _buckets[k].load(std::memory_order_relaxed);
+		total += snapshot[k];
+	}
+	std::int64_t largest = max();
+
+	std::ostringstream retval;
+	char line[128];
+	std::snprintf(line, sizeof(line), "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+	retval << line;
+
+	// Percentiles visited with a step halved each time the remaining distance to 100% is halved.
+	double        percentile = 0.0;
+	std::size_t   bucket     = 0;
+	std::uint64_t seen       = total==0 ? 0 : snapshot[0];
+	while(total>0) {
+		std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(percentile / 100.0 * total)));
+		while(seen<rank) {
+			seen += snapshot[++bucket];
+		}
+		double value = std::min(highest_in(bucket), largest) / 1e3;
+		if(seen>=total) {
+			std::snprintf(line, sizeof(line), "%12.3f %14.12f %10llu\n", value, 1.0, static_cast<unsigned long long>(seen));
+			retval << line;
+			break;
+		}
+		std::snprintf(line, sizeof(line), "%12.3f %14.12f %10llu %14.2f\n", value, percentile / 100.0,
+			static_cast<unsigned long long>(seen), 100.0 / (100.0 - percentile));
+		retval << line;
+		double halvings = std::floor(std::log2(100.0 / (100.0 - percentile))) + 1.0;
+		percentile += 100.0 / (TICKS_PER_HALF_DISTANCE * std::pow(2.0, halvings));
+	}
+
+	std::snprintf(line, sizeof(line), "#[Mean    = %12.3f, Max            = %12.3f]\n", mean() / 1e3, largest / 1e3);
+	retval << line;
+	std::snprintf(line, sizeof(line), "#[Buckets = %12zu, Total count    = %12llu]\n", BUCKET_COUNT, static_cast<unsigned long long>(total));
+	retval << line;
+	return retval.str();
+}
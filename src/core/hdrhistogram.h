@@ -0,0 +1,133 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef HDRHISTOGRAM_H_
+#define HDRHISTOGRAM_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Distribution of durations with a bounded relative error, in the spirit of the HdrHistogram of Gil Tene.
+ *
+ * The durations are recorded in nanoseconds, in log-linear buckets: each power of two is split into
+ * `SUB_BUCKET_COUNT / 2` linear sub-buckets, so that any duration up to `MAX_VALUE` (about 68 seconds) is known
+ * with a relative error below 1/64 (1.6%), whatever its magnitude. Longer durations are counted in the last bucket.
+ *
+ * Recording a value costs a few relaxed atomic operations, and never blocks: the histogram may be recorded
+ * from any number of threads while it is read from another one (the reader then sees a consistent enough
+ * snapshot, each bucket being read atomically).
+ */
+class HdrHistogram
+{
+public:
+
+	/**
+	 * Number of linear sub-buckets of the first power of two (the smaller values are recorded exactly).
+	 */
+	static const std::size_t SUB_BUCKET_COUNT = 128;
+
+	/**
+	 * Largest value that can be told apart from the longer ones (in nanoseconds).
+	 */
+	static const std::int64_t MAX_VALUE = (std::int64_t(1) << 36) - 1;
+
+	/**
+	 * Constructor.
+	 */
+	HdrHistogram();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	HdrHistogram(const HdrHistogram &op) = delete;
+	HdrHistogram &operator=(const HdrHistogram &op) = delete;
+	/**@} */
+
+	/**
+	 * Record a duration (in nanoseconds, the negative values being recorded as 0).
+	 */
+	void record(std::int64_t value);
+
+	/**
+	 * Record a duration.
+	 */
+	template<typename Rep, typename Period>
+	void record(const std::chrono::duration<Rep, Period> &value)
+	{
+		record(static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(value).count()));
+	}
+
+	/**
+	 * Forget all the recorded values.
+	 */
+	void reset();
+
+	/**
+	 * Number of recorded values.
+	 */
+	std::uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+
+	/**
+	 * Largest recorded value (in nanoseconds).
+	 */
+	std::int64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+	/**
+	 * Mean of the recorded values (in nanoseconds).
+	 */
+	double mean() const;
+
+	/**
+	 * Value below which the given fraction (between 0 and 1) of the recorded values lie (in nanoseconds,
+	 * 0 if nothing has been recorded).
+	 */
+	std::int64_t quantile(double fraction) const;
+
+	/**
+	 * Distribution of the recorded values, in the percentile-distribution text format of the HdrHistogram
+	 * tools (the values being expressed in microseconds), that can be plotted with their plotter.
+	 */
+	std::string percentile_distribution() const;
+
+private:
+
+	// Number of buckets: the exact ones, then one series of sub-buckets per power of two from 2^7 to 2^35.
+	static const std::size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (36 - 7) * (SUB_BUCKET_COUNT / 2);
+
+	// Private functions
+	static std::size_t  bucket_of   (std::int64_t value);
+	static std::int64_t highest_in  (std::size_t bucket);
+
+	// Private members
+	std::atomic<std::uint64_t> _buckets[BUCKET_COUNT];
+	std::atomic<std::uint64_t> _count               ;
+	std::atomic<std::uint64_t> _sum                 ; // Sum of the recorded values (in nanoseconds).
+	std::atomic<std::int64_t>  _max                 ;
+};
+
+#endif /* HDRHISTOGRAM_H_ */
@@ -30,6 +30,7 @@
 
 // Constructor of the KeyDescriptor class.
 KeyboardMap::KeyDescriptor::KeyDescriptor() :
+	_id               (NO_KEY_ID),
 	_scan_code_unix   (0),
 	_scan_code_windows(0),
 	_in_numeric_keypad(false),
@@ -42,7 +43,7 @@ KeyboardMap::KeyDescriptor::KeyDescriptor() :
 KeyboardMap::KeyDescriptor &KeyboardMap::KeyDescriptor::load(const boost::property_tree::ptree &data)
 {
 	// ID
-	_id = data.get<std::string>("id");
+	_id = intern_key_id(data.get<std::string>("id"));
 
 	// Label
 	std::string rawLabel = data.get<std::string>("label");
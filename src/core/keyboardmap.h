@@ -30,6 +30,7 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/regex.hpp>
 #include "keys.h"
+#include "keyid.h"
 
 
 /**
@@ -69,9 +70,9 @@ public:
 		KeyDescriptor &load(const boost::property_tree::ptree &data);
 
 		/**
-		 * ID of the key.
+		 * ID of the key (interned when the keyboard map is loaded).
 		 */
-		const std::string &id() const { return _id; }
+		KeyId id() const { return _id; }
 
 		/**
 		 * Label of the key.
@@ -139,7 +140,7 @@ public:
 		static std::string translateSpecialLabel(const std::string &code);
 
 		// Private members
-		std::string              _id               ;
+		KeyId                    _id               ;
 		std::vector<std::string> _label            ;
 		ScanCode                 _scan_code_unix   ;
 		ScanCode                 _scan_code_windows;
@@ -0,0 +1,87 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "keyid.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+
+// Table of the interned IDs. The strings are stored in a deque, so that the references returned
+// by `key_id_name()` remain valid when new IDs are interned.
+struct KeyIdTable
+{
+	std::mutex                             mutex  ;
+	std::deque<std::string>                names  ;
+	std::unordered_map<std::string, KeyId> handles;
+
+	KeyIdTable()
+	{
+		names.push_back(std::string());
+		handles[std::string()] = NO_KEY_ID;
+	}
+};
+
+
+// Process-wide table (never released, as keyboard maps may be loaded by worker threads).
+static KeyIdTable &key_id_table()
+{
+	static KeyIdTable *retval = new KeyIdTable;
+	return *retval;
+}
+
+
+// Handle associated to the given string ID.
+KeyId intern_key_id(const std::string &id)
+{
+	KeyIdTable &table(key_id_table());
+	std::lock_guard<std::mutex> lock(table.mutex);
+	auto it = table.handles.find(id);
+	if(it!=table.handles.end()) {
+		return it->second;
+	}
+	KeyId retval = static_cast<KeyId>(table.names.size());
+	table.names.push_back(id);
+	table.handles[id] = retval;
+	return retval;
+}
+
+
+// String ID associated to the given handle.
+const std::string &key_id_name(KeyId key)
+{
+	KeyIdTable &table(key_id_table());
+	std::lock_guard<std::mutex> lock(table.mutex);
+	return key<table.names.size() ? table.names[key] : table.names[NO_KEY_ID];
+}
+
+
+// Handle of the modifier key on the given side.
+KeyId modifier_key_id(ModifierKeys modifier_keys, Side side)
+{
+	static const KeyId ids[3][2] = {
+		{ intern_key_id("ctrl-left" ), intern_key_id("ctrl-right" ) },
+		{ intern_key_id("shift-left"), intern_key_id("shift-right") },
+		{ intern_key_id("alt-left"  ), intern_key_id("alt-right"  ) }
+	};
+	return ids[Enum::to_value(modifier_keys)][Enum::to_value(side)];
+}
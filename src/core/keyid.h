@@ -0,0 +1,66 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef KEYID_H_
+#define KEYID_H_
+
+#include "keys.h"
+#include "side.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Interned identifier of a key. The string IDs of the keys (such as "ctrl-left"), which appear in the keyboard map
+ * and shortcut map files, are mapped to dense integer handles when these files are loaded, so that the rest of
+ * the application compares keys and indexes arrays with integers.
+ *
+ * The handles are allocated in the order in which the IDs are first seen, are never released, and are shared
+ * by all the keyboard maps and shortcut maps of the process. Handle 0 stands for the empty ID (no key).
+ */
+typedef std::uint32_t KeyId;
+
+
+/**
+ * Handle of the empty ID.
+ */
+const KeyId NO_KEY_ID = 0;
+
+
+/**
+ * Handle associated to the given string ID (allocated on the first call). Thread-safe.
+ */
+KeyId intern_key_id(const std::string &id);
+
+/**
+ * String ID associated to the given handle (the empty string if the handle has not been allocated). Thread-safe.
+ */
+const std::string &key_id_name(KeyId key);
+
+/**
+ * Handle of the modifier key on the given side, for the given pair of modifier keys.
+ */
+KeyId modifier_key_id(ModifierKeys modifier_keys, Side side);
+
+
+#endif /* KEYID_H_ */
@@ -0,0 +1,135 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "keystate.h"
+#include <algorithm>
+
+
+// Index of the lowest bit set in a non-zero word.
+static unsigned int lowest_bit(std::uint64_t word)
+{
+	#ifdef __GNUC__
+		return static_cast<unsigned int>(__builtin_ctzll(word));
+	#else
+		unsigned int retval = 0;
+		while((word & 1)==0) {
+			word >>= 1;
+			++retval;
+		}
+		return retval;
+	#endif
+}
+
+
+// Constructor.
+KeyState::KeyState() : _count(0), _sequence(0)
+{
+	_bits.fill(0);
+	_press_order.fill(0);
+}
+
+
+// Mark the given key as down.
+bool KeyState::press(ScanCode scan_code, const TimePoint &at)
+{
+	if(scan_code>=KEY_COUNT || is_down(scan_code)) {
+		return false;
+	}
+	_bits[scan_code/64] |= std::uint64_t(1) << (scan_code%64);
+	_pressed_at [scan_code] = at;
+	_press_order[scan_code] = ++_sequence;
+	++_count;
+	return true;
+}
+
+
+// Mark the given key as up.
+bool KeyState::release(ScanCode scan_code)
+{
+	if(!is_down(scan_code)) {
+		return false;
+	}
+	_bits[scan_code/64] &= ~(std::uint64_t(1) << (scan_code%64));
+	--_count;
+	return true;
+}
+
+
+// Mark all the keys as up.
+void KeyState::clear()
+{
+	_bits.fill(0);
+	_count = 0;
+}
+
+
+// Lowest scan-code among the keys that are down.
+ScanCode KeyState::first() const
+{
+	for(std::size_t k=0; k<WORD_COUNT; ++k) {
+		if(_bits[k]!=0) {
+			return static_cast<ScanCode>(k*64 + lowest_bit(_bits[k]));
+		}
+	}
+	return KEY_COUNT;
+}
+
+
+// Empty chord constructor.
+KeyChord::KeyChord() : _valid(false)
+{
+	_mask.fill(0);
+}
+
+
+// Constructor.
+KeyChord::KeyChord(std::initializer_list<ScanCode> scan_codes) : _valid(scan_codes.size()>0)
+{
+	_mask.fill(0);
+	for(ScanCode scan_code : scan_codes) {
+		if(scan_code>=KeyState::KEY_COUNT) {
+			_valid = false;
+		}
+		else {
+			_mask[scan_code/64] |= std::uint64_t(1) << (scan_code%64);
+		}
+	}
+}
+
+
+// Check whether the keys of the chord are down, and have been pressed within the given time window.
+bool KeyChord::matches_within(const KeyState &state, const TimeDuration &window) const
+{
+	if(!matches(state)) {
+		return false;
+	}
+	TimePoint earliest(boost::posix_time::pos_infin);
+	TimePoint latest  (boost::posix_time::neg_infin);
+	for(std::size_t k=0; k<KeyState::WORD_COUNT; ++k) {
+		for(std::uint64_t word=_mask[k]; word!=0; word &= word-1) {
+			const TimePoint &at = state.pressed_at(static_cast<ScanCode>(k*64 + lowest_bit(word)));
+			earliest = std::min(earliest, at);
+			latest   = std::max(latest  , at);
+		}
+	}
+	return latest - earliest <= window;
+}
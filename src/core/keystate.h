@@ -0,0 +1,188 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef KEYSTATE_H_
+#define KEYSTATE_H_
+
+#include "keys.h"
+#include "chrono.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+
+/**
+ * Set of the keys that are down, with the instant and the order in which they have been pressed.
+ *
+ * The state is a fixed-size bitset (one bit per scan-code, plus one timestamp and one sequence number per key):
+ * pressing, releasing or testing a key is a constant-time operation that never allocates. The scan-codes
+ * greater than or equal to `KEY_COUNT` are not tracked (they are never reported as down).
+ */
+class KeyState
+{
+public:
+
+	/**
+	 * Number of scan-codes that can be tracked.
+	 */
+	static const std::size_t KEY_COUNT = 512;
+
+	/**
+	 * Number of 64-bit words of the bitset.
+	 */
+	static const std::size_t WORD_COUNT = KEY_COUNT/64;
+
+	/**
+	 * Bitset type.
+	 */
+	typedef std::array<std::uint64_t, WORD_COUNT> Bits;
+
+	/**
+	 * Constructor. No key is down.
+	 */
+	KeyState();
+
+	/**
+	 * Mark the given key as down.
+	 * @returns `false` if the key was already down (auto-repeat), or if its scan-code cannot be tracked.
+	 */
+	bool press(ScanCode scan_code, const TimePoint &at=current_time());
+
+	/**
+	 * Mark the given key as up.
+	 * @returns `false` if the key was not down.
+	 */
+	bool release(ScanCode scan_code);
+
+	/**
+	 * Mark all the keys as up.
+	 */
+	void clear();
+
+	/**
+	 * Check whether the given key is down.
+	 */
+	bool is_down(ScanCode scan_code) const
+	{
+		return scan_code<KEY_COUNT && (_bits[scan_code/64] >> (scan_code%64) & 1)!=0;
+	}
+
+	/**
+	 * Check whether no key is down.
+	 */
+	bool empty() const { return _count==0; }
+
+	/**
+	 * Number of keys down.
+	 */
+	std::size_t count() const { return _count; }
+
+	/**
+	 * Lowest scan-code among the keys that are down (`KEY_COUNT` if no key is down).
+	 */
+	ScanCode first() const;
+
+	/**
+	 * Instant at which the given key has been pressed (meaningless if the key is not down).
+	 */
+	const TimePoint &pressed_at(ScanCode scan_code) const { return _pressed_at[scan_code<KEY_COUNT ? scan_code : 0]; }
+
+	/**
+	 * Sequence number of the press of the given key: the larger, the more recent (meaningless if the key is not down).
+	 */
+	std::uint32_t press_order(ScanCode scan_code) const { return _press_order[scan_code<KEY_COUNT ? scan_code : 0]; }
+
+	/**
+	 * Underlying bitset.
+	 */
+	const Bits &bits() const { return _bits; }
+
+private:
+
+	// Private members
+	Bits                                 _bits       ;
+	std::size_t                          _count      ;
+	std::uint32_t                        _sequence   ;
+	std::array<TimePoint    , KEY_COUNT> _pressed_at ;
+	std::array<std::uint32_t, KEY_COUNT> _press_order;
+};
+
+
+/**
+ * Combination of keys that must be held down together (e.g. the two modifier keys of `ModifierKeys::DOUBLE_SHIFT`).
+ *
+ * A chord is evaluated against a `KeyState` with a few word-wide bit operations. A chord that refers to a scan-code
+ * that cannot be tracked, or that has no key at all, never matches.
+ */
+class KeyChord
+{
+public:
+
+	/**
+	 * Constructor. Empty chord (never matches).
+	 */
+	KeyChord();
+
+	/**
+	 * Constructor.
+	 */
+	KeyChord(std::initializer_list<ScanCode> scan_codes);
+
+	/**
+	 * Check whether all the keys of the chord are down.
+	 */
+	bool matches(const KeyState &state) const
+	{
+		std::uint64_t missing = _valid ? 0 : 1;
+		for(std::size_t k=0; k<KeyState::WORD_COUNT; ++k) {
+			missing |= _mask[k] & ~state.bits()[k];
+		}
+		return missing==0;
+	}
+
+	/**
+	 * Check whether all the keys of the chord are down, and no other key.
+	 */
+	bool matches_exactly(const KeyState &state) const
+	{
+		std::uint64_t difference = _valid ? 0 : 1;
+		for(std::size_t k=0; k<KeyState::WORD_COUNT; ++k) {
+			difference |= _mask[k] ^ state.bits()[k];
+		}
+		return difference==0;
+	}
+
+	/**
+	 * Check whether all the keys of the chord are down, and have been pressed within the given time window
+	 * (e.g. to tell a deliberate chord from keys that happen to be held at the same time).
+	 */
+	bool matches_within(const KeyState &state, const TimeDuration &window) const;
+
+private:
+
+	// Private members
+	KeyState::Bits _mask ;
+	bool           _valid;
+};
+
+#endif /* KEYSTATE_H_ */
@@ -0,0 +1,120 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "latencytrace.h"
+#include <sstream>
+
+
+// Delay after which an unfinished trace is dropped.
+const std::chrono::milliseconds LatencyTrace::TIMEOUT(2000);
+
+
+// Bit associated to a stage in the `_marked` field.
+static unsigned int bit(TraceStage stage)
+{
+	return 1u << Enum::to_value(stage);
+}
+
+
+// Stage that must have been recorded for the given one to be recorded.
+static TraceStage prerequisite(TraceStage stage)
+{
+	switch(stage)
+	{
+		case TraceStage::UPDATE     : return TraceStage::SWITCH     ;
+		case TraceStage::PAINT_BEGIN: return TraceStage::UPDATE     ;
+		case TraceStage::PAINT_END  : return TraceStage::PAINT_BEGIN;
+		case TraceStage::FLUSH      : return TraceStage::PAINT_END  ;
+		default                     : return TraceStage::DELIVERY   ;
+	}
+}
+
+
+// Constructor.
+LatencyTrace::LatencyTrace() : _active(false), _marked(0) {}
+
+
+// Start tracing a key press.
+void LatencyTrace::begin(const std::chrono::steady_clock::time_point &stamp)
+{
+	_origin = stamp;
+	_active = true;
+	_marked = bit(TraceStage::DELIVERY);
+	_histograms[TraceStage::DELIVERY].record(std::chrono::steady_clock::now() - stamp);
+}
+
+
+// Mark the current stage of the trace in progress.
+void LatencyTrace::mark(TraceStage stage)
+{
+	if(!_active || (_marked & bit(stage))!=0 || (_marked & bit(prerequisite(stage)))==0) {
+		return;
+	}
+	auto latency = std::chrono::steady_clock::now() - _origin;
+	if(latency>TIMEOUT) {
+		_active = false;
+		return;
+	}
+	_histograms[stage].record(latency);
+	_marked |= bit(stage);
+	if(stage==TraceStage::FLUSH) {
+		_active = false;
+	}
+}
+
+
+// Forget all the recorded latencies.
+void LatencyTrace::reset()
+{
+	for(auto s = Enum::cursor<TraceStage>::first(); s.valid(); ++s) {
+		_histograms[*s].reset();
+	}
+}
+
+
+// Identifier of a stage.
+const char *LatencyTrace::stage_name(TraceStage stage)
+{
+	switch(stage)
+	{
+		case TraceStage::DELIVERY   : return "delivery"   ;
+		case TraceStage::SHORTCUT   : return "shortcut"   ;
+		case TraceStage::SWITCH     : return "switch"     ;
+		case TraceStage::UPDATE     : return "update"     ;
+		case TraceStage::PAINT_BEGIN: return "paint-begin";
+		case TraceStage::PAINT_END  : return "paint-end"  ;
+		case TraceStage::FLUSH      : return "flush"      ;
+		default                     : return "unknown"    ;
+	}
+}
+
+
+// Distribution of the latencies of all the stages.
+std::string LatencyTrace::export_text() const
+{
+	std::ostringstream retval;
+	for(auto s = Enum::cursor<TraceStage>::first(); s.valid(); ++s) {
+		retval << "# Stage: " << stage_name(*s) << " (latency from the key event, in microseconds)\n"
+			<< _histograms[*s].percentile_distribution() << "\n";
+	}
+	return retval.str();
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef LATENCYTRACE_H_
+#define LATENCYTRACE_H_
+
+#include "singleton.h"
+#include "enumutil.h"
+#include "hdrhistogram.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Stages of the path between a key press and the display of its effect, in the order in which they are crossed.
+ */
+enum class TraceStage : std::uint8_t
+{
+	DELIVERY   , //!< Key event received by the application (from the timestamp set by the display server or the kernel).
+	SHORTCUT   , //!< Shortcut associated to the key looked up.
+	SWITCH     , //!< State of the timers changed.
+	UPDATE     , //!< Repaint of the timer widget requested.
+	PAINT_BEGIN, //!< Repaint of the timer widget started.
+	PAINT_END  , //!< Repaint of the timer widget finished.
+	FLUSH        //!< Back-buffer of the window flushed to the screen.
+};
+
+namespace Enum { template<> struct traits<TraceStage> : trait_indexing<7> {}; }
+
+
+/**
+ * End-to-end latency of the key presses, from the instant at which the key event has been stamped
+ * (by the display server or by the kernel) up to the flush of the repainted window.
+ *
+ * A trace is started by `begin()` for each key press, and each stage is then marked as it is crossed: the delay
+ * between the key event and the stage is recorded in the histogram of the stage. A stage is only recorded
+ * once per trace, and only after the stage it depends on (the repaint stages need a switch of the timers,
+ * which needs nothing but a key press), so that the periodic repaints of the timers do not pollute the
+ * histograms. A trace is dropped if it is not completed within `TIMEOUT`, or when the next press begins.
+ *
+ * `begin()` and `mark()` must be called from the main thread; the histograms can be read from any thread.
+ */
+class LatencyTrace : public Singleton<LatencyTrace>
+{
+	friend class Singleton<LatencyTrace>;
+
+public:
+
+	/**
+	 * Delay after which an unfinished trace is dropped.
+	 */
+	static const std::chrono::milliseconds TIMEOUT;
+
+	/**
+	 * Start tracing a key press (dropping the trace in progress, if any).
+	 * @param stamp Instant at which the key event has been stamped by the system.
+	 */
+	void begin(const std::chrono::steady_clock::time_point &stamp);
+
+	/**
+	 * Mark the current stage of the trace in progress, if any.
+	 */
+	void mark(TraceStage stage);
+
+	/**
+	 * Latencies recorded for a stage (in nanoseconds, from the key event).
+	 */
+	const HdrHistogram &histogram(TraceStage stage) const { return _histograms[stage]; }
+
+	/**
+	 * Forget all the recorded latencies.
+	 */
+	void reset();
+
+	/**
+	 * Identifier of a stage, as used in the exports.
+	 */
+	static const char *stage_name(TraceStage stage);
+
+	/**
+	 * Distribution of the latencies of all the stages, one after the other, in the percentile-distribution
+	 * text format of the HdrHistogram tools (in microseconds).
+	 */
+	std::string export_text() const;
+
+private:
+
+	// Constructor
+	LatencyTrace();
+
+	// Private members
+	Enum::array<TraceStage, HdrHistogram> _histograms;
+	std::chrono::steady_clock::time_point _origin    ; // Instant of the key event of the current trace.
+	bool                                  _active    ;
+	unsigned int                          _marked    ; // Stages already recorded for the current trace (bit field).
+};
+
+#endif /* LATENCYTRACE_H_ */
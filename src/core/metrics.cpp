@@ -0,0 +1,281 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+
+// Slabs of all the threads that have updated a metric. Neither the slabs nor the list are ever released: a thread
+// may exit after the registry is destroyed, and the values of the exited threads must remain in the sums.
+Metrics::SlabList &Metrics::slabs()
+{
+	static SlabList *retval = new SlabList;
+	return *retval;
+}
+
+
+// Value written by the default-constructed gauges, which never belongs to a metric.
+std::atomic<double> &Metrics::discarded_gauge()
+{
+	static std::atomic<double> retval(0.0);
+	return retval;
+}
+
+
+// Slab of the calling thread.
+Metrics::Slab &Metrics::local_slab()
+{
+	static thread_local Slab *t_slab = nullptr;
+	if(t_slab==nullptr) {
+		t_slab = new Slab;
+		for(auto &it : t_slab->values) {
+			it.store(0, std::memory_order_relaxed);
+		}
+		SlabList &list(slabs());
+		std::lock_guard<std::mutex> lock(list.mutex);
+		list.slabs.push_back(t_slab);
+	}
+	return *t_slab;
+}
+
+
+// Record a duration in a histogram.
+void Metrics::Histogram::observe(double seconds) const
+{
+	if(_bounds==nullptr) {
+		return;
+	}
+	std::size_t bucket = std::lower_bound(_bounds->begin(), _bounds->end(), seconds) - _bounds->begin();
+	Metrics::add(_slot + bucket, 1);
+	Metrics::add(_slot + _bounds->size() + 1, static_cast<std::uint64_t>(std::max(0.0, seconds) * 1e9));
+}
+
+
+// Default bucket bounds for the durations.
+const std::vector<double> &Metrics::default_duration_bounds()
+{
+	static const std::vector<double> retval{1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2, 1e-1, 5e-1, 1.0};
+	return retval;
+}
+
+
+// Counter with the given name and labels.
+Metrics::Counter Metrics::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Series *series = find(name, labels, Kind::COUNTER);
+	return Counter(series!=nullptr ? series->slot : create(name, help, labels, Kind::COUNTER, 1).slot);
+}
+
+
+// Gauge with the given name and labels.
+Metrics::Gauge Metrics::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Series *series = find(name, labels, Kind::GAUGE);
+	if(series==nullptr) {
+		series = &create(name, help, labels, Kind::GAUGE, 0);
+		series->gauge.reset(new std::atomic<double>(0.0));
+	}
+	return Gauge(series->gauge.get());
+}
+
+
+// Histogram with the given name, labels and bucket bounds.
+Metrics::Histogram Metrics::histogram(const std::string &name, const std::string &help, const std::string &labels,
+	const std::vector<double> &bounds)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Series *series = find(name, labels, Kind::HISTOGRAM);
+	if(series==nullptr) {
+		series = &create(name, help, labels, Kind::HISTOGRAM, bounds.size()+2);
+		series->bounds.reset(new std::vector<double>(bounds));
+	}
+	return Histogram(series->bounds.get(), series->slot);
+}
+
+
+// Current value of all the metrics.
+std::string Metrics::scrape() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// Group the series by name, keeping the registration order.
+	std::vector<std::string> names;
+	std::map<std::string, std::vector<const Series *>> families;
+	for(const auto &it : _series) {
+		auto &family(families[it->name]);
+		if(family.empty()) {
+			names.push_back(it->name);
+		}
+		family.push_back(it.get());
+	}
+
+	std::ostringstream retval;
+	retval.precision(9);
+	for(const auto &name : names) {
+		const auto &family(families[name]);
+		const char *type = family.front()->kind==Kind::COUNTER ? "counter" : family.front()->kind==Kind::GAUGE ? "gauge" : "histogram";
+		retval << "# HELP " << name << " " << family.front()->help << "\n";
+		retval << "# TYPE " << name << " " << type << "\n";
+		for(const Series *series : family) {
+			std::string labels = series->labels.empty() ? "" : "{" + series->labels + "}";
+			switch(series->kind)
+			{
+				case Kind::COUNTER:
+					retval << name << labels << " " << sum(series->slot) << "\n";
+					break;
+
+				case Kind::GAUGE:
+					retval << name << labels << " " << series->gauge->load(std::memory_order_relaxed) << "\n";
+					break;
+
+				case Kind::HISTOGRAM:
+				{
+					std::string prefix = series->labels.empty() ? "" : series->labels + ",";
+					std::uint64_t count = 0;
+					for(std::size_t k=0; k<=series->bounds->size(); ++k) {
+						count += sum(series->slot + k);
+						retval << name << "_bucket{" << prefix << "le=\"";
+						if(k<series->bounds->size()) {
+							retval << (*series->bounds)[k];
+						}
+						else {
+							retval << "+Inf";
+						}
+						retval << "\"} " << count << "\n";
+					}
+					retval << name << "_sum"   << labels << " " << sum(series->slot + series->bounds->size() + 1) * 1e-9 << "\n";
+					retval << name << "_count" << labels << " " << count << "\n";
+					break;
+				}
+			}
+		}
+	}
+	return retval.str();
+}
+
+
+// Number of observations of a histogram.
+std::uint64_t Metrics::observations(const std::string &name, const std::string &labels) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const std::vector<double> *bounds = nullptr;
+	std::vector<std::uint64_t> counts = cumulative_counts(name, labels, bounds);
+	return counts.empty() ? 0 : counts.back();
+}
+
+
+// Estimate of some quantiles of a histogram.
+std::vector<double> Metrics::quantiles(const std::string &name, const std::vector<double> &qs, const std::string &labels) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const std::vector<double> *bounds = nullptr;
+	std::vector<std::uint64_t> counts = cumulative_counts(name, labels, bounds);
+	std::vector<double> retval;
+	if(counts.empty() || counts.back()==0) {
+		return retval;
+	}
+	for(double q : qs) {
+		double rank = std::min(std::max(q, 0.0), 1.0) * counts.back();
+		std::size_t k = std::lower_bound(counts.begin(), counts.end(), static_cast<std::uint64_t>(std::ceil(rank))) - counts.begin();
+		if(k>=bounds->size()) {
+			retval.push_back(bounds->empty() ? 0.0 : bounds->back());
+			continue;
+		}
+		double        lower = k==0 ? 0.0 : (*bounds)[k-1];
+		std::uint64_t below = k==0 ? 0   : counts[k-1];
+		std::uint64_t in    = counts[k] - below;
+		retval.push_back(lower + ((*bounds)[k] - lower) * (in==0 ? 1.0 : (rank - below) / in));
+	}
+	return retval;
+}
+
+
+// Cumulative counts of the buckets of a histogram (+Inf included; empty if not registered). Requires `_mutex`.
+std::vector<std::uint64_t> Metrics::cumulative_counts(const std::string &name, const std::string &labels,
+	const std::vector<double> *&bounds) const
+{
+	std::vector<std::uint64_t> retval;
+	for(const auto &it : _series) {
+		if(it->name==name && it->labels==labels && it->kind==Kind::HISTOGRAM) {
+			bounds = it->bounds.get();
+			std::uint64_t count = 0;
+			for(std::size_t k=0; k<=bounds->size(); ++k) {
+				count += sum(it->slot + k);
+				retval.push_back(count);
+			}
+			break;
+		}
+	}
+	return retval;
+}
+
+
+// Find the series with the given name and labels, if any.
+Metrics::Series *Metrics::find(const std::string &name, const std::string &labels, Kind kind)
+{
+	for(const auto &it : _series) {
+		if(it->name==name && it->labels==labels) {
+			if(it->kind!=kind) {
+				throw std::invalid_argument("Metric " + name + " is already registered with another type.");
+			}
+			return it.get();
+		}
+	}
+	return nullptr;
+}
+
+
+// Register a new series.
+Metrics::Series &Metrics::create(const std::string &name, const std::string &help, const std::string &labels, Kind kind, std::size_t slots)
+{
+	if(_next_slot+slots>MAX_SLOTS) {
+		throw std::runtime_error("Too many metrics.");
+	}
+	std::unique_ptr<Series> series(new Series);
+	series->name   = name;
+	series->help   = help;
+	series->labels = labels;
+	series->kind   = kind;
+	series->slot   = _next_slot;
+	_next_slot += slots;
+	_series.push_back(std::move(series));
+	return *_series.back();
+}
+
+
+// Sum of the values of a slot over all the threads.
+std::uint64_t Metrics::sum(std::size_t slot) const
+{
+	SlabList &list(slabs());
+	std::lock_guard<std::mutex> lock(list.mutex);
+	std::uint64_t retval = 0;
+	for(const Slab *slab : list.slabs) {
+		retval += slab->values[slot].load(std::memory_order_relaxed);
+	}
+	return retval;
+}
@@ -0,0 +1,209 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "singleton.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+ * Registry of the metrics exported by the application, in the Prometheus text exposition format.
+ *
+ * Updating a counter or a histogram costs a couple of relaxed atomic operations on a slot owned by the calling
+ * thread: each thread writes in its own array of slots, and the arrays are only summed when the metrics are
+ * scraped. Gauges hold a single value shared by all threads.
+ *
+ * The handles (`Counter`, `Gauge`, `Histogram`) are cheap to copy, and are typically obtained once and kept in
+ * function-level static variables. Asking twice for the same name and labels returns the same metric.
+ * The first call to `instance()` must be done from the main thread.
+ */
+class Metrics : public Singleton<Metrics>
+{
+	friend class Singleton<Metrics>;
+
+public:
+
+	/**
+	 * Monotonically increasing counter.
+	 */
+	class Counter
+	{
+		friend class Metrics;
+	public:
+		Counter() : _slot(DISCARD_SLOT) {} // <- Not bound to any metric: the increments are discarded.
+		void increment(std::uint64_t value=1) const { Metrics::add(_slot, value); }
+	private:
+		explicit Counter(std::size_t slot) : _slot(slot) {}
+		std::size_t _slot;
+	};
+
+	/**
+	 * Value that can go up and down.
+	 */
+	class Gauge
+	{
+		friend class Metrics;
+	public:
+		Gauge() : _value(&discarded_gauge()) {} // <- Not bound to any metric: the values are discarded.
+		void set(double value) const { _value->store(value, std::memory_order_relaxed); }
+	private:
+		explicit Gauge(std::atomic<double> *value) : _value(value) {}
+		std::atomic<double> *_value;
+	};
+
+	/**
+	 * Distribution of durations (in seconds), with cumulative buckets.
+	 */
+	class Histogram
+	{
+		friend class Metrics;
+	public:
+		Histogram() : _bounds(nullptr), _slot(DISCARD_SLOT) {} // <- Not bound to any metric: the observations are discarded.
+		void observe(double seconds) const;
+	private:
+		Histogram(const std::vector<double> *bounds, std::size_t slot) : _bounds(bounds), _slot(slot) {}
+		const std::vector<double> *_bounds; // Upper bounds of the buckets (the +Inf bucket is implicit).
+		std::size_t                _slot  ; // First slot: one per bucket (+Inf included), then the sum (in nanoseconds).
+	};
+
+	/**
+	 * Record the lifetime of the object in a histogram.
+	 */
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(const Histogram &histogram) : _histogram(histogram), _started_at(std::chrono::steady_clock::now()) {}
+		~ScopedTimer() { _histogram.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - _started_at).count()); }
+		ScopedTimer(const ScopedTimer &op) = delete;
+		ScopedTimer &operator=(const ScopedTimer &op) = delete;
+	private:
+		Histogram                             _histogram ;
+		std::chrono::steady_clock::time_point _started_at;
+	};
+
+	/**
+	 * Default bucket bounds for the durations, from 10 microseconds to 1 second.
+	 */
+	static const std::vector<double> &default_duration_bounds();
+
+	/**
+	 * Counter with the given name and labels (for instance `action="swap"`).
+	 */
+	Counter counter(const std::string &name, const std::string &help, const std::string &labels="");
+
+	/**
+	 * Gauge with the given name and labels.
+	 */
+	Gauge gauge(const std::string &name, const std::string &help, const std::string &labels="");
+
+	/**
+	 * Histogram with the given name, labels and bucket bounds (in seconds, increasing).
+	 */
+	Histogram histogram(const std::string &name, const std::string &help, const std::string &labels="",
+		const std::vector<double> &bounds=default_duration_bounds());
+
+	/**
+	 * Current value of all the metrics, in the Prometheus text exposition format (version 0.0.4).
+	 */
+	std::string scrape() const;
+
+	/**
+	 * Number of observations recorded so far in the histogram with the given name and labels (0 if not registered).
+	 */
+	std::uint64_t observations(const std::string &name, const std::string &labels="") const;
+
+	/**
+	 * Estimate of the given quantiles (between 0 and 1) of the histogram with the given name and labels, interpolated
+	 * linearly within the buckets as `histogram_quantile()` does in Prometheus. The quantiles that fall in the +Inf
+	 * bucket are reported as the last finite bound. Empty if the histogram is not registered or has no observations.
+	 */
+	std::vector<double> quantiles(const std::string &name, const std::vector<double> &qs, const std::string &labels="") const;
+
+private:
+
+	// Maximal number of slots (counters count for one slot, histograms for their number of buckets plus two).
+	static const std::size_t MAX_SLOTS = 1024;
+
+	// Slot written by the default-constructed handles, which never belongs to a metric.
+	static const std::size_t DISCARD_SLOT = 0;
+
+	// Slots written by one thread.
+	struct Slab
+	{
+		std::atomic<std::uint64_t> values[MAX_SLOTS];
+	};
+
+	// Slabs of all the threads.
+	struct SlabList
+	{
+		std::mutex          mutex;
+		std::vector<Slab *> slabs;
+	};
+
+	// Kind of metric.
+	enum class Kind { COUNTER, GAUGE, HISTOGRAM };
+
+	// Metric (one per name and labels).
+	struct Series
+	{
+		std::string                          name  ;
+		std::string                          help  ;
+		std::string                          labels;
+		Kind                                 kind  ;
+		std::size_t                          slot  ;
+		std::unique_ptr<std::atomic<double>> gauge ;
+		std::unique_ptr<std::vector<double>> bounds;
+	};
+
+	// Constructor
+	Metrics() : _next_slot(DISCARD_SLOT+1) {}
+
+	// Private functions
+	Series *find(const std::string &name, const std::string &labels, Kind kind);
+	Series &create(const std::string &name, const std::string &help, const std::string &labels, Kind kind, std::size_t slots);
+	std::vector<std::uint64_t> cumulative_counts(const std::string &name, const std::string &labels, const std::vector<double> *&bounds) const;
+	std::uint64_t sum(std::size_t slot) const;
+	static Slab &local_slab();
+	static SlabList &slabs();
+	static std::atomic<double> &discarded_gauge();
+	static void add(std::size_t slot, std::uint64_t value)
+	{
+		std::atomic<std::uint64_t> &target(local_slab().values[slot]);
+		target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); // <- Single writer.
+	}
+
+	// Private members
+	mutable std::mutex                   _mutex    ;
+	std::vector<std::unique_ptr<Series>> _series   ;
+	std::size_t                          _next_slot;
+};
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,110 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef MPSCQUEUE_H_
+#define MPSCQUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+
+/**
+ * Unbounded multiple-producer single-consumer FIFO queue.
+ *
+ * `push()` may be called from any thread, and is wait-free (a single atomic exchange). `pop()` must always be
+ * called from the same (consumer) thread, and is lock-free. This is the intrusive queue of D. Vyukov: a producer
+ * that has exchanged the tail but not yet linked its node makes the consumer see the queue as temporarily empty,
+ * so `pop()` may return `false` while a push is in progress (the producer is expected to wake up the consumer
+ * after pushing, so the element is not lost).
+ */
+template<typename T>
+class MPSCQueue
+{
+public:
+
+	/**
+	 * Constructor.
+	 */
+	MPSCQueue() : _head(new Node), _tail(_head.load()) {}
+
+	/**
+	 * Destructor. The remaining elements are destroyed.
+	 */
+	~MPSCQueue()
+	{
+		T buffer;
+		while(pop(buffer)) {}
+		delete _tail;
+	}
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	MPSCQueue(const MPSCQueue &op) = delete;
+	MPSCQueue &operator=(const MPSCQueue &op) = delete;
+	/**@} */
+
+	/**
+	 * Append an element at the end of the queue. Thread-safe.
+	 */
+	void push(T value)
+	{
+		Node *node = new Node(std::move(value));
+		Node *previous = _head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	/**
+	 * Remove the first element of the queue, if any. Consumer thread only.
+	 * @returns `false` if the queue is empty.
+	 */
+	bool pop(T &value)
+	{
+		Node *tail = _tail;
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if(next==nullptr) {
+			return false;
+		}
+		value = std::move(next->value);
+		_tail = next;
+		delete tail;
+		return true;
+	}
+
+private:
+
+	// Queue node (the node pointed by `_tail` is a sentinel, whose value has already been consumed).
+	struct Node
+	{
+		Node() : next(nullptr) {}
+		explicit Node(T v) : value(std::move(v)), next(nullptr) {}
+		T                  value;
+		std::atomic<Node*> next ;
+	};
+
+	// Private members
+	std::atomic<Node*> _head; // Last pushed node (producers).
+	Node              *_tail; // Sentinel node (consumer).
+};
+
+#endif /* MPSCQUEUE_H_ */
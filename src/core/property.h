@@ -247,6 +247,15 @@ public:
 		_data=value; _loaded=true; _saved=false; _signal_changed(_data);
 	}
 
+	/**
+	 * Replace the underlying value with one that has been read again from the storage (e.g. because the underlying
+	 * file has been modified by another program). Contrary to the write operator, the property is considered as saved.
+	 */
+	void reload(typename traits::lightweight_type_t value)
+	{
+		_data=value; _loaded=true; _saved=true; _signal_changed(_data);
+	}
+
 	/**
 	 * Signal triggered when the value of the property changes.
 	 */
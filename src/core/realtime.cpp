@@ -0,0 +1,161 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "realtime.h"
+#include "metrics.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+	#include <malloc.h>
+#endif
+
+
+// Size of the stack pre-faulted by `lock_memory()` (in bytes).
+static const std::size_t STACK_RESERVE = 256 << 10;
+
+
+// Export the outcome of a step of the real-time mode.
+static void report(const char *feature, bool active)
+{
+	Metrics::instance().gauge("vcc_realtime_active", "Whether a step of the real-time mode is active (1) or has been skipped (0).",
+		std::string("feature=\"") + feature + "\"").set(active ? 1.0 : 0.0);
+}
+
+
+// Constructor.
+RealtimeMode::RealtimeMode(int cpu, int priority, std::size_t heap_reserve) :
+	_cpu(cpu), _priority(priority), _heap_reserve(heap_reserve)
+{
+	if(cpu<-1 || cpu>=CPU_SETSIZE) {
+		throw std::invalid_argument("Invalid CPU index for the real-time mode.");
+	}
+	if(priority<0 || priority>sched_get_priority_max(SCHED_FIFO)) {
+		throw std::invalid_argument("Invalid real-time priority.");
+	}
+}
+
+
+// Pre-fault and lock the memory of the process.
+void RealtimeMode::lock_memory()
+{
+	// Keep the freed memory in the heap (instead of giving it back to the system), so that it remains pre-faulted and locked.
+	#ifdef __GLIBC__
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+	#endif
+
+	// Pre-fault the heap reserve and the stack.
+	std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	if(_heap_reserve>0) {
+		volatile char *reserve = static_cast<char *>(std::malloc(_heap_reserve));
+		if(reserve!=nullptr) {
+			for(std::size_t k=0; k<_heap_reserve; k+=page) {
+				reserve[k] = 0;
+			}
+			std::free(const_cast<char *>(reserve));
+		}
+	}
+	prefault_stack();
+
+	// Locking the future mappings makes them fail beyond the locked-memory limit: only do it if there is no such limit.
+	rlimit limit;
+	bool unlimited = geteuid()==0 || (getrlimit(RLIMIT_MEMLOCK, &limit)==0 && limit.rlim_cur==RLIM_INFINITY);
+	if(mlockall(unlimited ? MCL_CURRENT | MCL_FUTURE : MCL_CURRENT)!=0) {
+		_warnings.push_back(std::string("memory not locked: ") + std::strerror(errno)
+			+ " (raise the locked-memory limit with `ulimit -l`, or grant CAP_IPC_LOCK)");
+		report("memory_lock", false);
+		return;
+	}
+	if(!unlimited) {
+		_warnings.push_back("only the memory allocated so far is locked (the locked-memory limit is not unlimited)");
+	}
+	report("memory_lock", true);
+}
+
+
+// Touch the pages of the stack that the calling thread may use.
+void RealtimeMode::prefault_stack()
+{
+	char buffer[STACK_RESERVE];
+	volatile char *stack = buffer; // <- Keep the compiler from optimizing the writes away.
+	std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	for(std::size_t k=0; k<STACK_RESERVE; k+=page) {
+		stack[k] = 0;
+	}
+}
+
+
+// Pin a thread to the CPU, and switch it to SCHED_FIFO.
+void RealtimeMode::promote_thread(std::thread::native_handle_type thread, const std::string &name)
+{
+	if(_cpu>=0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(_cpu, &cpus);
+		int error = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+		if(error!=0) {
+			_warnings.push_back(name + " not pinned to CPU " + std::to_string(_cpu) + ": " + std::strerror(error));
+		}
+		report("cpu_affinity", error==0);
+	}
+	if(_priority>0) {
+		sched_param parameters;
+		parameters.sched_priority = _priority;
+		int error = pthread_setschedparam(thread, SCHED_FIFO, &parameters);
+		if(error!=0) {
+			_warnings.push_back(name + " not switched to SCHED_FIFO: " + std::strerror(error)
+				+ (error==EPERM ? " (grant CAP_SYS_NICE, or raise the real-time priority limit with `ulimit -r`)" : ""));
+		}
+		report("fifo_scheduling", error==0);
+	}
+}
+
+
+// Pin the calling thread to the CPU, and switch it to SCHED_FIFO.
+void RealtimeMode::promote_current_thread(const std::string &name)
+{
+	promote_thread(pthread_self(), name);
+}
+
+#else
+
+// Memory locking and real-time scheduling are not supported on this platform.
+RealtimeMode::RealtimeMode(int cpu, int priority, std::size_t heap_reserve) : _cpu(cpu), _priority(priority), _heap_reserve(heap_reserve)
+{
+	throw std::runtime_error("The real-time mode is not supported on this platform.");
+}
+
+void RealtimeMode::lock_memory() {}
+void RealtimeMode::promote_thread(std::thread::native_handle_type, const std::string &) {}
+void RealtimeMode::promote_current_thread(const std::string &) {}
+void RealtimeMode::prefault_stack() {}
+
+#endif /* OS_IS_UNIX */
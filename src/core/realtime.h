@@ -0,0 +1,114 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef REALTIME_H_
+#define REALTIME_H_
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Opt-in real-time operating mode for the input and clock-engine path (`vcc --engine --realtime[=<cpu>]`),
+ * against the page faults and the scheduler noise that show up as key-to-switch jitter on busy machines.
+ *
+ * Each step is applied independently, and a step that is not permitted is skipped with a warning explaining why
+ * (the clock still works, just without that guarantee):
+ * - `lock_memory()` pre-faults a heap reserve and the stack of the calling thread, prevents the allocator from
+ *   giving memory back to the system, and locks the pages with `mlockall` (the future mappings are only locked
+ *   when the locked-memory limit allows it, as they would otherwise fail to be allocated);
+ * - `promote_thread()` pins a thread to the chosen CPU, and switches it to `SCHED_FIFO`.
+ *
+ * The outcome of each step is exported as the `vcc_realtime_active` gauge, so that the latency histograms
+ * (`vcc_evdev_delivery_seconds` in particular) can be compared with and without the real-time mode.
+ *
+ * Only available on Unix platforms (Linux).
+ */
+class RealtimeMode
+{
+public:
+
+	/**
+	 * Default `SCHED_FIFO` priority (the one of the threaded interrupt handlers, in the middle of the range).
+	 */
+	static const int DEFAULT_PRIORITY = 50;
+
+	/**
+	 * Default size of the heap reserve pre-faulted by `lock_memory()` (in bytes).
+	 */
+	static const std::size_t DEFAULT_HEAP_RESERVE = 4 << 20;
+
+	/**
+	 * Constructor.
+	 * @param cpu CPU to pin the promoted threads to (-1 to let them run anywhere).
+	 * @param priority `SCHED_FIFO` priority of the promoted threads (0 to keep the normal scheduling).
+	 * @param heap_reserve Size of the heap reserve to pre-fault (in bytes).
+	 * @throw std::invalid_argument If the CPU or the priority is out of range.
+	 * @throw std::runtime_error If the real-time mode is not supported on this platform.
+	 */
+	explicit RealtimeMode(int cpu=-1, int priority=DEFAULT_PRIORITY, std::size_t heap_reserve=DEFAULT_HEAP_RESERVE);
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	RealtimeMode(const RealtimeMode &op) = delete;
+	RealtimeMode &operator=(const RealtimeMode &op) = delete;
+	/**@} */
+
+	/**
+	 * Pre-fault and lock the memory of the process. To be called once everything has been allocated
+	 * (i.e. right before entering the event loop).
+	 */
+	void lock_memory();
+
+	/**
+	 * Pin the given thread to the CPU, and switch it to `SCHED_FIFO`.
+	 * @param name Name of the thread, for the warnings.
+	 */
+	void promote_thread(std::thread::native_handle_type thread, const std::string &name);
+
+	/**
+	 * Pin the calling thread to the CPU, and switch it to `SCHED_FIFO`.
+	 */
+	void promote_current_thread(const std::string &name);
+
+	/**
+	 * Steps that have been skipped, with the reason why (empty if the real-time mode is fully active).
+	 */
+	const std::vector<std::string> &warnings() const { return _warnings; }
+
+private:
+
+	// Private functions
+	void prefault_stack();
+
+	// Private members
+	int                      _cpu         ;
+	int                      _priority    ;
+	std::size_t              _heap_reserve;
+	std::vector<std::string> _warnings    ;
+};
+
+#endif /* REALTIME_H_ */
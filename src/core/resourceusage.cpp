@@ -0,0 +1,64 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "resourceusage.h"
+
+#ifdef OS_IS_UNIX
+
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+
+
+// Measure the resources consumed so far by the current process.
+ResourceUsage resource_usage()
+{
+	ResourceUsage retval = { 0.0, 0, 0, 0 };
+	rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage)==0) {
+		retval.cpu_seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+		retval.peak_resident_bytes = static_cast<std::int64_t>(usage.ru_maxrss) * 1024; // <- In kilobytes on Linux.
+		retval.wakeups = usage.ru_nvcsw;
+	}
+
+	// The current resident set size is the second field of /proc/self/statm (in pages).
+	std::FILE *statm = std::fopen("/proc/self/statm", "r");
+	if(statm!=nullptr) {
+		long long size = 0, resident = 0;
+		if(std::fscanf(statm, "%lld %lld", &size, &resident)==2) {
+			retval.resident_bytes = resident * sysconf(_SC_PAGESIZE);
+		}
+		std::fclose(statm);
+	}
+	return retval;
+}
+
+#else
+
+// The resources are not measured on this platform.
+ResourceUsage resource_usage()
+{
+	ResourceUsage retval = { 0.0, 0, 0, 0 };
+	return retval;
+}
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,48 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef RESOURCEUSAGE_H_
+#define RESOURCEUSAGE_H_
+
+#include <cstdint>
+
+
+/**
+ * Resources consumed so far by the current process, to measure the footprint of the clock (typically on the
+ * low-end boards running the kiosk mode). The fields that cannot be measured on the current platform are 0.
+ */
+struct ResourceUsage
+{
+	double       cpu_seconds        ; //!< CPU time consumed by all the threads (user and system, in seconds).
+	std::int64_t resident_bytes     ; //!< Current resident set size (in bytes).
+	std::int64_t peak_resident_bytes; //!< Largest resident set size reached so far (in bytes).
+	std::int64_t wakeups            ; //!< Voluntary context switches, i.e. number of times a thread went to sleep.
+};
+
+
+/**
+ * Measure the resources consumed so far by the current process.
+ */
+ResourceUsage resource_usage();
+
+
+#endif /* RESOURCEUSAGE_H_ */
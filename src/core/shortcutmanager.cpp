@@ -21,10 +21,33 @@
 
 
 #include "shortcutmanager.h"
+#include "metrics.h"
+#include <algorithm>
 
 
 // Constructor.
-ShortcutManager::ShortcutManager() : _modifier_key({0, 0}) {}
+ShortcutManager::ShortcutManager() : _modifier_key({0, 0})
+{
+	_slots.fill(0);
+}
+
+
+// Count the key presses per resolved action (index 0 stands for the keys without shortcut).
+void ShortcutManager::count_key_press(int shortcut)
+{
+	static const char *const ACTIONS[] = { "none", "start_right", "start_left", "pause", "reset", "swap" };
+	static const std::vector<Metrics::Counter> counters = []() {
+		std::vector<Metrics::Counter> retval;
+		for(const char *action : ACTIONS) {
+			retval.push_back(Metrics::instance().counter("vcc_key_presses_total", "Key presses, per resolved action.",
+				std::string("action=\"") + action + "\""));
+		}
+		return retval;
+	}();
+	if(shortcut>=0 && static_cast<std::size_t>(shortcut)<counters.size()) {
+		counters[shortcut].increment();
+	}
+}
 
 
 // Return to the default state.
@@ -32,8 +55,8 @@ void ShortcutManager::reset()
 {
 	_modifier_key[Side::LEFT ] = 0;
 	_modifier_key[Side::RIGHT] = 0;
-	_shortcut_low .clear();
-	_shortcut_high.clear();
+	_slots.fill(0);
+	update_modifier_chord();
 }
 
 
@@ -46,41 +69,92 @@ void ShortcutManager::reset(ModifierKeys modifier_keys, const KeyboardMap &keybo
 	for(std::size_t k=0; k<keyboard_map.key_count(); ++k)
 	{
 		ScanCode scan_code = keyboard_map.key(k).scan_code();
-		const std::string &id = keyboard_map.key(k).id();
+		KeyId    id        = keyboard_map.key(k).id();
 
 		// Update the modifier key scan-codes.
 		bool is_modifier_key = false;
-		switch(modifier_keys) {
-			case ModifierKeys::DOUBLE_CTRL : is_modifier_key=update_modifier_key_scan_code(scan_code, id, "ctrl-left" , "ctrl-right" ); break;
-			case ModifierKeys::DOUBLE_SHIFT: is_modifier_key=update_modifier_key_scan_code(scan_code, id, "shift-left", "shift-right"); break;
-			case ModifierKeys::DOUBLE_ALT  : is_modifier_key=update_modifier_key_scan_code(scan_code, id, "alt-left"  , "alt-right"  ); break;
-			default: break;
+		for(auto s=Enum::cursor<Side>::first(); s.valid(); ++s) {
+			if(id==modifier_key_id(modifier_keys, *s)) {
+				_modifier_key[*s] = scan_code;
+				is_modifier_key = true;
+			}
 		}
 
 		// Retrieve the shortcuts associated to the key in the shortcut map. However, if the current key
 		// is a modifier key, no shortcut is associated to it, whatever it is specified in the shortcup map.
 		if(!is_modifier_key) {
-			_shortcut_low [scan_code] = shortcut_map.shortcut_low (id);
-			_shortcut_high[scan_code] = shortcut_map.shortcut_high(id);
+			set_shortcuts(scan_code, shortcut_map.shortcut_low(id), shortcut_map.shortcut_high(id));
 		}
 	}
+	update_modifier_chord();
 }
 
 
-// Auxiliary function: if `id` is equal to either `expected_id_for_left` or `expected_id_for_right`,
-// the corresponding flag in `_modifier_key` is updated with the given scan-code.
-bool ShortcutManager::update_modifier_key_scan_code(ScanCode scan_code, const std::string &id,
-	const char *expected_id_for_left, const char *expected_id_for_right)
+// Configuration from a raw shortcut table.
+void ShortcutManager::reset(const Enum::array<Side, ScanCode> &modifier_key, const std::vector<Entry> &table)
 {
-	if(id==expected_id_for_left) {
-		_modifier_key[Side::LEFT] = scan_code;
-		return true;
+	reset();
+	_modifier_key = modifier_key;
+	for(const auto &it : table) {
+		set_shortcuts(it.scan_code, it.shortcut_low, it.shortcut_high);
 	}
-	else if(id==expected_id_for_right) {
-		_modifier_key[Side::RIGHT] = scan_code;
-		return true;
+	update_modifier_chord();
+}
+
+
+// Partial update from "top-level" objects.
+void ShortcutManager::update(const KeyboardMap &keyboard_map, const ShortcutMap &shortcut_map, const std::vector<KeyId> &keys)
+{
+	for(std::size_t k=0; k<keyboard_map.key_count(); ++k)
+	{
+		ScanCode scan_code = keyboard_map.key(k).scan_code();
+		KeyId    id        = keyboard_map.key(k).id();
+		if(!is_modifier_key(scan_code) && std::binary_search(keys.begin(), keys.end(), id)) {
+			set_shortcuts(scan_code, shortcut_map.shortcut_low(id), shortcut_map.shortcut_high(id));
+		}
 	}
-	else {
-		return false;
+}
+
+
+// Register the shortcuts of a key in the lookup table (the keys that cannot be tracked being ignored).
+void ShortcutManager::set_shortcuts(ScanCode scan_code, int shortcut_low, int shortcut_high)
+{
+	if(scan_code>=KEY_COUNT) {
+		return;
+	}
+	Slot &slot(_slots[scan_code]);
+	slot = (slot & MODIFIER_FLAG) | REGISTERED_FLAG;
+	if(shortcut_low>0 && shortcut_low<=MAX_SHORTCUT) {
+		slot |= static_cast<Slot>(shortcut_low);
+	}
+	if(shortcut_high>0 && shortcut_high<=MAX_SHORTCUT) {
+		slot |= static_cast<Slot>(shortcut_high << HIGH_SHIFT);
+	}
+}
+
+
+// Rebuild the chord of the modifier keys (0 being the scan-code of the undefined modifier keys),
+// and flag them in the lookup table.
+void ShortcutManager::update_modifier_chord()
+{
+	bool defined = _modifier_key[Side::LEFT]!=0 && _modifier_key[Side::RIGHT]!=0;
+	_modifier_chord = defined ? KeyChord{_modifier_key[Side::LEFT], _modifier_key[Side::RIGHT]} : KeyChord();
+	for(auto s=Enum::cursor<Side>::first(); s.valid(); ++s) {
+		if(_modifier_key[*s]!=0 && _modifier_key[*s]<KEY_COUNT) {
+			_slots[_modifier_key[*s]] |= MODIFIER_FLAG;
+		}
+	}
+}
+
+
+// Shortcuts associated to each registered key.
+std::vector<ShortcutManager::Entry> ShortcutManager::table() const
+{
+	std::vector<Entry> retval;
+	for(ScanCode scan_code=0; scan_code<KEY_COUNT; ++scan_code) {
+		if((_slots[scan_code] & REGISTERED_FLAG)!=0) {
+			retval.push_back(Entry{scan_code, shortcut_low(scan_code), shortcut_high(scan_code)});
+		}
 	}
+	return retval;
 }
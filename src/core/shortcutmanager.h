@@ -27,17 +27,45 @@
 #include "side.h"
 #include "keyboardmap.h"
 #include "shortcutmap.h"
-#include <map>
+#include "keystate.h"
+#include <array>
+#include <cstdint>
+#include <vector>
 
 
 /**
  * For each key (identified by its low-level scan-code), this object associate
  * the index of the shortcuts that are triggered when it is pressed.
+ *
+ * The configuration is compiled into a flat table indexed by the scan-codes, with one 16-bit slot per key packing
+ * both shortcuts and the modifier-key flag: resolving a key press is a single load, without any search. Only
+ * the scan-codes that can be tracked by `KeyState` (below `KEY_COUNT`) may be associated to shortcuts,
+ * and the shortcut indices must not exceed `MAX_SHORTCUT` (the larger ones are ignored).
  */
 class ShortcutManager
 {
 public:
 
+	/**
+	 * Shortcuts associated to a given key (see `table()`).
+	 */
+	struct Entry
+	{
+		ScanCode scan_code    ; //!< Scan-code of the key.
+		int      shortcut_low ; //!< Index of the low-position shortcut (0 if none).
+		int      shortcut_high; //!< Index of the high-position shortcut (0 if none).
+	};
+
+	/**
+	 * Number of scan-codes that can be associated to shortcuts.
+	 */
+	static const std::size_t KEY_COUNT = KeyState::KEY_COUNT;
+
+	/**
+	 * Largest shortcut index.
+	 */
+	static const int MAX_SHORTCUT = 63;
+
 	/**
 	 * Constructor.
 	 */
@@ -48,27 +76,34 @@ public:
 	 */
 	ScanCode modifier_key(Side side) const { return _modifier_key[side]; }
 
+	/**
+	 * Chord made of the two modifier keys (never matches if the modifier keys are not defined).
+	 */
+	const KeyChord &modifier_chord() const { return _modifier_chord; }
+
+	/**
+	 * Check whether both modifier keys are down (i.e. whether the high-position shortcuts must be used).
+	 */
+	bool modifier_keys_activated(const KeyState &keys_down) const { return _modifier_chord.matches(keys_down); }
+
+	/**
+	 * Check whether the given scan-code corresponds to one of the modifier keys.
+	 */
+	bool is_modifier_key(ScanCode scan_code) const { return (slot(scan_code) & MODIFIER_FLAG)!=0; }
+
 	/**
 	 * Return the index of the low-position shortcut associated to the key corresponding
 	 * to the given scan-code. If the scan-code does not refer to a key, or if no
 	 * shortcut is associated to it, 0 is returned.
 	 */
-	int shortcut_low(ScanCode scan_code) const
-	{
-		auto it = _shortcut_low.find(scan_code);
-		return it==_shortcut_low.end() ? 0 : it->second;
-	}
+	int shortcut_low(ScanCode scan_code) const { return slot(scan_code) & SHORTCUT_MASK; }
 
 	/**
 	 * Return the index of the high-position shortcut associated to the key corresponding
 	 * to the given scan-code. If the scan-code does not refer to a key, or if no
 	 * shortcut is associated to it, 0 is returned.
 	 */
-	int shortcut_high(ScanCode scan_code) const
-	{
-		auto it = _shortcut_high.find(scan_code);
-		return it==_shortcut_high.end() ? 0 : it->second;
-	}
+	int shortcut_high(ScanCode scan_code) const { return (slot(scan_code) >> HIGH_SHIFT) & SHORTCUT_MASK; }
 
 	/**
 	 * Return the index of the (either low- or high-position depending on the flag `high_position`)
@@ -76,9 +111,15 @@ public:
 	 */
 	int shortcut(ScanCode scan_code, bool high_position) const
 	{
-		return high_position ? shortcut_high(scan_code) : shortcut_low(scan_code);
+		return (slot(scan_code) >> (high_position ? HIGH_SHIFT : 0)) & SHORTCUT_MASK;
 	}
 
+	/**
+	 * Count a key press in the `vcc_key_presses_total` metric, per resolved shortcut (0 for the keys without shortcut).
+	 * To be called where the shortcut is executed, so that the lookups alone do not change the metrics.
+	 */
+	static void count_key_press(int shortcut);
+
 	/**
 	 * Reset the shortcut manager to its default state: no shortcut is associated to
 	 * the keys, and an invalide scan-code is associated to the modifier keys.
@@ -91,16 +132,43 @@ public:
 	 */
 	void reset(ModifierKeys modifier_keys, const KeyboardMap &keyboard_map, const ShortcutMap &shortcut_map);
 
+	/**
+	 * Configure the shortcut manager with the given modifier key scan-codes and shortcut table.
+	 * This is typically used to transfer the state of the object to another process.
+	 */
+	void reset(const Enum::array<Side, ScanCode> &modifier_key, const std::vector<Entry> &table);
+
+	/**
+	 * Update the shortcuts of the given keys only (handles sorted in increasing order, as returned
+	 * by `ShortcutMap::diff()`), the other keys being left untouched. The object must have been configured
+	 * with the same modifier keys and keyboard map (the modifier keys are left unchanged).
+	 */
+	void update(const KeyboardMap &keyboard_map, const ShortcutMap &shortcut_map, const std::vector<KeyId> &keys);
+
+	/**
+	 * Shortcuts associated to each registered key.
+	 */
+	std::vector<Entry> table() const;
+
 private:
 
+	// Slot of the lookup table: low-position shortcut (bits 0-5), high-position shortcut (bits 6-11),
+	// and flags telling whether the key is registered (i.e. listed in `table()`) and whether it is a modifier key.
+	typedef std::uint16_t Slot;
+	static const int  HIGH_SHIFT      = 6;
+	static const Slot SHORTCUT_MASK   = 0x003f;
+	static const Slot REGISTERED_FLAG = 0x1000;
+	static const Slot MODIFIER_FLAG   = 0x2000;
+
 	// Private functions
-	bool update_modifier_key_scan_code(ScanCode scan_code, const std::string &id,
-		const char *expected_id_for_left, const char *expected_id_for_right);
+	Slot slot(ScanCode scan_code) const { return scan_code<KEY_COUNT ? _slots[scan_code] : 0; }
+	void set_shortcuts(ScanCode scan_code, int shortcut_low, int shortcut_high);
+	void update_modifier_chord();
 
 	// Private members
-	Enum::array<Side, ScanCode> _modifier_key ;
-	std::map<ScanCode, int>     _shortcut_low ;
-	std::map<ScanCode, int>     _shortcut_high;
+	std::array<Slot, KEY_COUNT> _slots         ;
+	Enum::array<Side, ScanCode> _modifier_key  ;
+	KeyChord                    _modifier_chord;
 };
 
 #endif /* SHORTCUTMANAGER_H_ */
@@ -21,47 +21,82 @@
 
 
 #include "shortcutmap.h"
+#include <algorithm>
+#include <map>
 #include <boost/property_tree/xml_parser.hpp>
 
 
+// Constructor.
+ShortcutMap::ShortcutMap() : _version(std::make_shared<const Version>()) {}
+
+
 // Copy constructor.
-ShortcutMap::ShortcutMap(const ShortcutMap &rhs) :
-	_shortcut_low (rhs._shortcut_low ),
-	_shortcut_high(rhs._shortcut_high)
-{}
+ShortcutMap::ShortcutMap(const ShortcutMap &rhs) : _version(rhs._version) {}
 
 
 // Copy operator.
 ShortcutMap &ShortcutMap::operator=(const ShortcutMap &rhs)
 {
-	if(this!=&rhs) {
-		_shortcut_low  = rhs._shortcut_low ;
-		_shortcut_high = rhs._shortcut_high;
+	if(_version!=rhs._version) {
+		_version = rhs._version;
 		_signal_changed();
 	}
 	return *this;
 }
 
 
-// Set the index of the low-position shortcut associated to the key having the ID `id`.
-void ShortcutMap::set_shortcut_low(const std::string &id, int value)
+// Set the index of the (either low- or high-position) shortcut associated to the key having the ID `id`.
+void ShortcutMap::set_shortcut(KeyId id, bool high_position, int value)
 {
-	int old_value = shortcut_low(id);
-	if(old_value!=value) {
-		_shortcut_low[id] = value;
+	if(shortcut(id, high_position)!=value) {
+		set(id, high_position, value);
 		_signal_changed();
 	}
 }
 
 
-// Set the index of the high-position shortcut associated to the key having the ID `id`.
-void ShortcutMap::set_shortcut_high(const std::string &id, int value)
+// Produce a new version in which the given shortcut is modified: only the affected chunk
+// and the table of chunks are copied, the other chunks remaining shared with the previous versions.
+void ShortcutMap::set(KeyId id, bool high_position, int value)
 {
-	int old_value = shortcut_high(id);
-	if(old_value!=value) {
-		_shortcut_high[id] = value;
-		_signal_changed();
+	std::shared_ptr<Version> version = std::make_shared<Version>(*_version);
+	std::size_t index = id / CHUNK_SIZE;
+	if(index>=version->size()) {
+		version->resize(index+1);
+	}
+	std::shared_ptr<Chunk> chunk = (*version)[index] ? std::make_shared<Chunk>(*(*version)[index]) : std::make_shared<Chunk>();
+	Binding &binding((*chunk)[id % CHUNK_SIZE]);
+	(high_position ? binding.high : binding.low) = value;
+	(*version)[index] = chunk;
+	_version = version;
+}
+
+
+// Keys whose shortcuts differ between this map and `other`.
+std::vector<KeyId> ShortcutMap::diff(const ShortcutMap &other) const
+{
+	static const Chunk EMPTY_CHUNK = Chunk();
+
+	std::vector<KeyId> retval;
+	if(_version==other._version) {
+		return retval;
 	}
+	std::size_t chunk_count = std::max(_version->size(), other._version->size());
+	for(std::size_t index=0; index<chunk_count; ++index) {
+		const Chunk *lhs = index<_version      ->size() ? (*_version      )[index].get() : nullptr;
+		const Chunk *rhs = index<other._version->size() ? (*other._version)[index].get() : nullptr;
+		if(lhs==rhs) {
+			continue;
+		}
+		lhs = lhs==nullptr ? &EMPTY_CHUNK : lhs;
+		rhs = rhs==nullptr ? &EMPTY_CHUNK : rhs;
+		for(std::size_t k=0; k<CHUNK_SIZE; ++k) {
+			if((*lhs)[k].low!=(*rhs)[k].low || (*lhs)[k].high!=(*rhs)[k].high) {
+				retval.push_back(static_cast<KeyId>(index * CHUNK_SIZE + k));
+			}
+		}
+	}
+	return retval;
 }
 
 
@@ -77,8 +112,8 @@ ShortcutMap &ShortcutMap::load(const std::string &path)
 // Load the shortcut map from a property tree.
 ShortcutMap &ShortcutMap::load(const boost::property_tree::ptree &data)
 {
-	_shortcut_low .clear();
-	_shortcut_high.clear();
+	// The chunks are built in place, as the new version is not shared yet.
+	std::vector<std::shared_ptr<Chunk>> chunks;
 
 	// Visit each node <key></key>
 	for(const auto &it : data) {
@@ -87,12 +122,21 @@ ShortcutMap &ShortcutMap::load(const boost::property_tree::ptree &data)
 		}
 
 		// Read the ID of the key.
-		std::string id = it.second.get<std::string>("id");
+		KeyId id = intern_key_id(it.second.get<std::string>("id"));
+		std::size_t index = id / CHUNK_SIZE;
+		if(index>=chunks.size()) {
+			chunks.resize(index+1);
+		}
+		if(!chunks[index]) {
+			chunks[index] = std::make_shared<Chunk>();
+		}
 
 		// Read the shortcut indexes.
-		_shortcut_low [id] = it.second.get("low" , 0);
-		_shortcut_high[id] = it.second.get("high", 0);
+		Binding &binding((*chunks[index])[id % CHUNK_SIZE]);
+		binding.low  = it.second.get("low" , 0);
+		binding.high = it.second.get("high", 0);
 	}
+	_version = std::make_shared<const Version>(chunks.begin(), chunks.end());
 
 	// Notify the modifications and return the object.
 	_signal_changed();
@@ -116,22 +160,27 @@ const ShortcutMap &ShortcutMap::save(const std::string &path) const
 // Save the shortcut map to a property tree.
 const ShortcutMap &ShortcutMap::save(boost::property_tree::ptree &data) const
 {
-	// For each key that is binded to a "low-position" shortcut, create a property tree node.
+	// For each key that is binded to a shortcut, create a property tree node (the nodes being sorted by ID,
+	// as the handles depend on the order in which the files have been loaded).
 	std::map<std::string, boost::property_tree::ptree> nodes;
-	for(const auto &it : _shortcut_low) {
-		if(it.second==0) {
+	for(std::size_t index=0; index<_version->size(); ++index) {
+		const std::shared_ptr<const Chunk> &chunk((*_version)[index]);
+		if(!chunk) {
 			continue;
 		}
-		nodes[it.first].put("low", it.second);
-	}
-
-	// For each key that is binded to a "high-position" shortcut, update the corresponding
-	// node, or create new one.
-	for(const auto &it : _shortcut_high) {
-		if(it.second==0) {
-			continue;
+		for(std::size_t k=0; k<CHUNK_SIZE; ++k) {
+			const Binding &binding((*chunk)[k]);
+			if(binding.low==0 && binding.high==0) {
+				continue;
+			}
+			boost::property_tree::ptree &node(nodes[key_id_name(static_cast<KeyId>(index * CHUNK_SIZE + k))]);
+			if(binding.low!=0) {
+				node.put("low", binding.low);
+			}
+			if(binding.high!=0) {
+				node.put("high", binding.high);
+			}
 		}
-		nodes[it.first].put("high", it.second);
 	}
 
 	// Insert each node created in the previous steps as a <key></key> node in the property tree.
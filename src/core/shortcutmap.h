@@ -23,19 +23,31 @@
 #ifndef SHORTCUTMAP_H_
 #define SHORTCUTMAP_H_
 
-#include <map>
+#include "keyid.h"
+#include <array>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 #include <boost/property_tree/ptree.hpp>
 #include <wrappers/signals.h>
 
 
 /**
- * Associate the keys of the keyboard (identified by a string ID) to an abstract
+ * Associate the keys of the keyboard (identified by their interned ID) to an abstract
  * shortcut or function (identified by an integer).
  *
  * Two shortcuts may be associated to each key: one is said to be the "low-shortcut",
  * one is said to be the "high-shortcut". The shortcut or the action that is triggered
  * when the key is pressed depend on the state of modifier keys.
+ *
+ * The shortcuts are stored in arrays indexed by the key handles: the string IDs only appear
+ * in the files, and are interned when the map is loaded.
+ *
+ * The map is a persistent data structure: its content is split into fixed-size chunks of keys, which are
+ * shared (and never modified) by all the copies of the map. Copying a map is O(1), and each edit produces
+ * a new version by copying the affected chunk and the table of chunks only, so that keeping the previous
+ * versions (e.g. for an undo history) is cheap, and `diff()` only visits the chunks that differ.
  */
 class ShortcutMap
 {
@@ -44,15 +56,15 @@ public:
 	/**
 	 * Constructor.
 	 */
-	ShortcutMap() {}
+	ShortcutMap();
 
 	/**
-	 * Copy constructor.
+	 * Copy constructor (O(1): the content is shared).
 	 */
 	ShortcutMap(const ShortcutMap &rhs);
 
 	/**
-	 * Copy operator.
+	 * Copy operator (O(1): the content is shared). The change signal is sent unless both maps were already sharing the same version.
 	 */
 	ShortcutMap &operator=(const ShortcutMap &rhs);
 
@@ -69,28 +81,20 @@ public:
 	 * If this ID does not refer to a key, or if no shortcut is associated to it,
 	 * 0 is returned.
 	 */
-	int shortcut_low(const std::string &id) const
-	{
-		auto it = _shortcut_low.find(id);
-		return it==_shortcut_low.end() ? 0 : it->second;
-	}
+	int shortcut_low(KeyId id) const { const Binding *b = binding(id); return b==nullptr ? 0 : b->low; }
 
 	/**
 	 * Return the index of the high-position shortcut associated to the key having the ID `id`.
 	 * If this ID does not refer to a key, or if no shortcut is associated to it,
 	 * 0 is returned.
 	 */
-	int shortcut_high(const std::string &id) const
-	{
-		auto it = _shortcut_high.find(id);
-		return it==_shortcut_high.end() ? 0 : it->second;
-	}
+	int shortcut_high(KeyId id) const { const Binding *b = binding(id); return b==nullptr ? 0 : b->high; }
 
 	/**
 	 * Return the index of the (either low- or high-position depending on the flag `high_position`)
 	 * shortcut associated to the key having the ID `id`.
 	 */
-	int shortcut(const std::string &id, bool high_position) const
+	int shortcut(KeyId id, bool high_position) const
 	{
 		return high_position ? shortcut_high(id) : shortcut_low(id);
 	}
@@ -98,21 +102,25 @@ public:
 	/**
 	 * Set the index of the low-position shortcut associated to the key having the ID `id`.
 	 */
-	void set_shortcut_low(const std::string &id, int value);
+	void set_shortcut_low(KeyId id, int value) { set_shortcut(id, false, value); }
 
 	/**
 	 * Set the index of the high-position shortcut associated to the key having the ID `id`.
 	 */
-	void set_shortcut_high(const std::string &id, int value);
+	void set_shortcut_high(KeyId id, int value) { set_shortcut(id, true, value); }
 
 	/**
 	 * Set the index of the (either low- or high-position depending on the flag `high_position`)
 	 * shortcut associated to the key having the ID `id`.
 	 */
-	void set_shortcut(const std::string &id, bool high_position, int value)
-	{
-		high_position ? set_shortcut_high(id, value) : set_shortcut_low(id, value);
-	}
+	void set_shortcut(KeyId id, bool high_position, int value);
+
+	/**
+	 * Keys whose shortcuts differ between this map and `other` (in increasing handle order).
+	 * The chunks shared by both maps are skipped, so that comparing a map with a previous version
+	 * of itself costs O(number of edited chunks).
+	 */
+	std::vector<KeyId> diff(const ShortcutMap &other) const;
 
 	/**
 	 * Load the shortcut map from a file.
@@ -140,10 +148,35 @@ public:
 
 private:
 
+	// Shortcuts associated to a key.
+	struct Binding
+	{
+		int low ;
+		int high;
+	};
+
+	// Number of consecutive key handles per chunk.
+	static const std::size_t CHUNK_SIZE = 32;
+
+	// Chunk of keys (never modified once it belongs to a version).
+	typedef std::array<Binding, CHUNK_SIZE> Chunk;
+
+	// Version of the map: chunks indexed by `handle / CHUNK_SIZE` (nullptr for the chunks without any shortcut).
+	typedef std::vector<std::shared_ptr<const Chunk>> Version;
+
+	// Shortcuts of the given key (nullptr if none).
+	const Binding *binding(KeyId id) const
+	{
+		std::size_t chunk = id / CHUNK_SIZE;
+		return chunk<_version->size() && (*_version)[chunk] ? &(*(*_version)[chunk])[id % CHUNK_SIZE] : nullptr;
+	}
+
+	// Private functions
+	void set(KeyId id, bool high_position, int value);
+
 	// Private members
-	mutable sig::signal<void()> _signal_changed;
-	std::map<std::string, int>  _shortcut_low  ;
-	std::map<std::string, int>  _shortcut_high ;
+	mutable sig::signal<void()>    _signal_changed;
+	std::shared_ptr<const Version> _version       ;
 };
 
 #endif /* SHORTCUTMAP_H_ */
@@ -0,0 +1,106 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+/**
+ * Bounded single-producer single-consumer FIFO queue.
+ *
+ * `push()` must always be called from the same (producer) thread, and `pop()` from the same (consumer) thread.
+ * Both are wait-free, and never allocate: the elements are stored in a ring buffer of `N` slots (`N` must be
+ * a power of 2). The producer and consumer indexes are kept on different cache lines (and away from the neighbouring objects), so that the two threads
+ * do not invalidate each other's cache line at each operation.
+ */
+template<typename T, std::size_t N>
+class SPSCQueue
+{
+	static_assert(N>=2 && (N & (N-1))==0, "The capacity of a SPSCQueue must be a power of 2.");
+
+public:
+
+	/**
+	 * Constructor.
+	 */
+	SPSCQueue() : _head(0), _tail(0) {}
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	SPSCQueue(const SPSCQueue &op) = delete;
+	SPSCQueue &operator=(const SPSCQueue &op) = delete;
+	/**@} */
+
+	/**
+	 * Append an element at the end of the queue. Producer thread only.
+	 * @param reserved Number of slots that must remain free after the insertion (e.g. for elements that must
+	 *        never be dropped).
+	 * @returns `false` if the queue is full (the element is not inserted in this case).
+	 */
+	bool push(T value, std::size_t reserved=0)
+	{
+		std::size_t head = _head.load(std::memory_order_relaxed);
+		if(head - _tail.load(std::memory_order_acquire) + reserved >= N) {
+			return false;
+		}
+		_slots[head & (N-1)] = std::move(value);
+		_head.store(head+1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove the first element of the queue, if any. Consumer thread only.
+	 * @returns `false` if the queue is empty.
+	 */
+	bool pop(T &value)
+	{
+		std::size_t tail = _tail.load(std::memory_order_relaxed);
+		if(tail==_head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = std::move(_slots[tail & (N-1)]);
+		_tail.store(tail+1, std::memory_order_release);
+		return true;
+	}
+
+private:
+
+	// Size of a cache line. The members are separated by padding rather than over-aligned, as C++11 does not
+	// guarantee the alignment of over-aligned objects allocated with `new`.
+	static const std::size_t CACHE_LINE_SIZE = 64;
+
+	// Private members
+	char                     _padding0[CACHE_LINE_SIZE];
+	std::atomic<std::size_t> _head                     ; // Number of pushed elements (written by the producer).
+	char                     _padding1[CACHE_LINE_SIZE];
+	std::atomic<std::size_t> _tail                     ; // Number of popped elements (written by the consumer).
+	char                     _padding2[CACHE_LINE_SIZE];
+	T                        _slots[N]                 ;
+};
+
+#endif /* SPSCQUEUE_H_ */
@@ -0,0 +1,79 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "switcharbiter.h"
+#include "metrics.h"
+
+
+// Constructor.
+SwitchArbiter::SwitchArbiter(BiTimer &bi_timer, const TimeDuration &window) :
+	_bi_timer(bi_timer), _window(window), _generation(0), _last_generation(0), _has_last(false), _last_player(Side::LEFT),
+	_suppressed(0)
+{
+	_connection = _bi_timer.connect_state_changed(std::bind(&SwitchArbiter::on_state_changed, this));
+}
+
+
+// Process a press on the button of the given player.
+bool SwitchArbiter::press(Side player, const TimePoint &at)
+{
+	static const Metrics::Counter suppressed = Metrics::instance().counter("vcc_input_suppressed_total",
+		"Key events suppressed by the input filters.", "reason=\"arbitration\"");
+
+	// Conflict: the other player has pressed within the window, and nothing else has happened since (never with
+	// a zero window, even for presses with equal timestamps).
+	bool conflict = _window>TIME_DURATION_ZERO && _has_last && player!=_last_player && _generation==_last_generation &&
+		(at<_last_at ? _last_at - at : at - _last_at) <= _window;
+	if(conflict) {
+		if(at>=_last_at) {
+			++_suppressed;
+			suppressed.increment();
+			return false;
+		}
+		if(_last_before.active_side && *_last_before.active_side==flip(player)) {
+			return false; // <- The earlier press would not have switched the clock anyway.
+		}
+		++_suppressed;
+		suppressed.increment();
+		_bi_timer.restore(_last_before); // <- The press that has been applied was actually the latest one.
+	}
+
+	// Presses that do not switch the clock (the timer of the opponent is already running) are not arbitrated.
+	else if(_bi_timer.active_side() && *_bi_timer.active_side()==flip(player)) {
+		return true;
+	}
+
+	_has_last    = true;
+	_last_player = player;
+	_last_at     = at;
+	_last_before = _bi_timer.state();
+	_bi_timer.start_timer(flip(player), at);
+	_last_generation = _generation;
+	return true;
+}
+
+
+// Count the changes of the timers.
+void SwitchArbiter::on_state_changed()
+{
+	++_generation;
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef SWITCHARBITER_H_
+#define SWITCHARBITER_H_
+
+#include "bitimer.h"
+#include <cstdint>
+
+
+/**
+ * Arbitration between the clock buttons of both players, for the nearly simultaneous presses.
+ *
+ * When both players press their button within the arbitration window, only the earliest press (according to
+ * the timestamps of the events, not to their order of arrival) switches the clock: the other one is suppressed.
+ * The first press is always applied immediately; if a press from the other player then arrives with an earlier
+ * timestamp (which may happen when the buttons are different devices), the switch already applied is rolled back
+ * and replaced by the one of the earlier press. A roll-back only happens if the timers have not been changed
+ * by something else in the meantime.
+ *
+ * With a zero window, the presses are applied as they come.
+ */
+class SwitchArbiter
+{
+public:
+
+	/**
+	 * Constructor.
+	 */
+	explicit SwitchArbiter(BiTimer &bi_timer, const TimeDuration &window=TIME_DURATION_ZERO);
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	SwitchArbiter(const SwitchArbiter &op) = delete;
+	SwitchArbiter &operator=(const SwitchArbiter &op) = delete;
+	/**@} */
+
+	/**
+	 * Arbitration window.
+	 */
+	const TimeDuration &window() const { return _window; }
+
+	/**
+	 * Set the arbitration window.
+	 */
+	void set_window(const TimeDuration &window) { _window = window; }
+
+	/**
+	 * Process a press on the button of the given player (i.e. a request to start the timer of the opponent),
+	 * stamped with the given instant.
+	 * @returns `false` if the press has been suppressed.
+	 */
+	bool press(Side player, const TimePoint &at);
+
+	/**
+	 * Number of presses suppressed (or rolled back) by the arbitration.
+	 */
+	std::uint64_t suppressed() const { return _suppressed; }
+
+private:
+
+	// Private functions
+	void on_state_changed();
+
+	// Private members
+	BiTimer                   &_bi_timer       ;
+	TimeDuration               _window         ;
+	sig::scoped_connection     _connection     ;
+	std::uint64_t              _generation     ; // Incremented each time the timers change.
+	std::uint64_t              _last_generation; // Value of `_generation` right after the last applied switch.
+	bool                       _has_last       ;
+	Side                       _last_player    ;
+	TimePoint                  _last_at        ;
+	BiTimer::State             _last_before    ; // State of the timers before the last applied switch.
+	std::uint64_t              _suppressed     ;
+};
+
+#endif /* SWITCHARBITER_H_ */
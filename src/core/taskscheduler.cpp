@@ -0,0 +1,274 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "taskscheduler.h"
+#include <algorithm>
+
+
+// Index (plus one) of the worker running in the current thread, 0 if the current thread is not a worker.
+static thread_local std::size_t t_worker_index = 0;
+
+
+// Constructor.
+TaskScheduler::TaskScheduler() :
+	_next_queue(0), _pending(0), _posted(0), _stopping(false),
+	_tasks_submitted(0), _tasks_completed(0), _tasks_stolen(0), _queue_depth(0), _max_queue_depth(0),
+	_total_wait_time(0), _max_wait_time(0), _total_run_time(0), _max_run_time(0)
+{
+	// Loading and saving operations are short and mostly I/O bound: a few workers are enough.
+	std::size_t count = std::max(2u, std::min(4u, std::thread::hardware_concurrency()));
+	for(std::size_t k=0; k<count; ++k) {
+		_workers.emplace_back(new Worker);
+	}
+	for(std::size_t k=0; k<count; ++k) {
+		_workers[k]->thread = std::thread(&TaskScheduler::run_worker, this, k);
+	}
+}
+
+
+// Destructor.
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(_idle_mutex);
+		_stopping = true;
+	}
+	_idle_condition.notify_all();
+	for(auto &it : _workers) {
+		it->thread.join();
+	}
+}
+
+
+// Schedule a task on one of the worker threads.
+void TaskScheduler::post(std::function<void()> task)
+{
+	// Select the queue: the current one if called from a worker, otherwise the next one (round-robin).
+	std::size_t queue = t_worker_index>0 ? t_worker_index-1 : _next_queue.fetch_add(1) % _workers.size();
+	Worker &worker(*_workers[queue]);
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(Task{std::move(task), std::chrono::steady_clock::now(), queue});
+	}
+
+	// Statistics
+	++_tasks_submitted;
+	std::int64_t depth = ++_queue_depth;
+	update_max(_max_queue_depth, static_cast<std::uint64_t>(std::max<std::int64_t>(depth, 0)));
+
+	// Wake up an idle worker.
+	{
+		std::lock_guard<std::mutex> lock(_idle_mutex);
+		++_pending;
+		++_posted;
+	}
+	_idle_condition.notify_one();
+}
+
+
+// Block until all the tasks are executed.
+void TaskScheduler::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(_idle_mutex);
+	_done_condition.wait(lock, [this]() { return _pending==0; });
+}
+
+
+// Whether the calling thread is one of the worker threads.
+bool TaskScheduler::in_worker_thread() const
+{
+	return t_worker_index>0;
+}
+
+
+// Snapshot of the statistics.
+TaskScheduler::Statistics TaskScheduler::statistics() const
+{
+	Statistics retval;
+	retval.tasks_submitted = _tasks_submitted;
+	retval.tasks_completed = _tasks_completed;
+	retval.tasks_stolen    = _tasks_stolen   ;
+	retval.queue_depth     = _queue_depth    ;
+	retval.max_queue_depth = _max_queue_depth;
+	retval.total_wait_time = _total_wait_time;
+	retval.max_wait_time   = _max_wait_time  ;
+	retval.total_run_time  = _total_run_time ;
+	retval.max_run_time    = _max_run_time   ;
+	return retval;
+}
+
+
+// Main loop of the worker threads.
+void TaskScheduler::run_worker(std::size_t index)
+{
+	t_worker_index = index+1;
+	while(true) {
+
+		// The posting counter is read before looking into the queues: a task posted after that cannot be missed,
+		// as the counter is bumped after the task is queued.
+		std::uint64_t posted = 0;
+		{
+			std::lock_guard<std::mutex> lock(_idle_mutex);
+			posted = _posted;
+		}
+		Task task;
+		if(pop_task(index, task)) {
+			execute(index, task);
+			continue;
+		}
+
+		// Nothing to do: sleep until a new task is posted, or until the scheduler is stopped and all the tasks
+		// are executed (the tasks being executed by the other workers must not wake up this one).
+		std::unique_lock<std::mutex> lock(_idle_mutex);
+		_idle_condition.wait(lock, [this, posted]() { return _posted!=posted || (_stopping && _pending==0); });
+		if(_stopping && _pending==0) {
+			return;
+		}
+	}
+}
+
+
+// Pop the most recent task from the worker's own queue, or steal the oldest task of another queue.
+bool TaskScheduler::pop_task(std::size_t index, Task &task)
+{
+	{
+		Worker &worker(*_workers[index]);
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if(!worker.tasks.empty()) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+			return true;
+		}
+	}
+	for(std::size_t k=1; k<_workers.size(); ++k) {
+		Worker &victim(*_workers[(index+k) % _workers.size()]);
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if(!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Execute a task and update the statistics.
+void TaskScheduler::execute(std::size_t index, Task &task)
+{
+	--_queue_depth;
+	if(task.queue!=index) {
+		++_tasks_stolen;
+	}
+	auto started_at = std::chrono::steady_clock::now();
+	auto wait_time  = std::chrono::duration_cast<std::chrono::microseconds>(started_at - task.posted_at).count();
+	_total_wait_time += wait_time;
+	update_max(_max_wait_time, wait_time);
+
+	// The tasks posted through `submit()` never throw (the exceptions are forwarded to the futures).
+	// Any other exception is swallowed, to keep the worker alive.
+	try {
+		task.function();
+	}
+	catch(...) {}
+	task.function = nullptr;
+
+	auto run_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started_at).count();
+	_total_run_time += run_time;
+	update_max(_max_run_time, run_time);
+	++_tasks_completed;
+
+	// Notify the threads waiting for the scheduler to become idle.
+	bool idle = false;
+	{
+		std::lock_guard<std::mutex> lock(_idle_mutex);
+		idle = --_pending==0;
+	}
+	if(idle) {
+		_done_condition.notify_all();
+		_idle_condition.notify_all();
+	}
+}
+
+
+// Lock-free update of a maximum value.
+void TaskScheduler::update_max(std::atomic<std::uint64_t> &target, std::uint64_t value)
+{
+	std::uint64_t current = target.load();
+	while(value>current && !target.compare_exchange_weak(current, value)) {}
+}
+
+
+
+// *****************************************************************************
+// Main thread executor
+// *****************************************************************************
+
+
+// Queue a task to be executed in the main thread.
+void MainThreadExecutor::post(std::function<void()> task)
+{
+	std::function<void()> wakeup;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back(std::move(task));
+		if(!_wakeup_pending) {
+			_wakeup_pending = true;
+			wakeup = _wakeup;
+		}
+	}
+	if(wakeup) {
+		wakeup();
+	}
+}
+
+
+// Set the wake-up function.
+void MainThreadExecutor::set_wakeup(std::function<void()> wakeup)
+{
+	bool need_wakeup = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wakeup = std::move(wakeup);
+		need_wakeup = _wakeup && !_tasks.empty();
+		_wakeup_pending = need_wakeup;
+	}
+	if(need_wakeup) {
+		_wakeup();
+	}
+}
+
+
+// Execute all the queued tasks.
+std::size_t MainThreadExecutor::drain()
+{
+	std::vector<std::function<void()>> tasks;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		tasks.swap(_tasks);
+		_wakeup_pending = false;
+	}
+	for(auto &it : tasks) {
+		it();
+	}
+	return tasks.size();
+}
@@ -0,0 +1,209 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef TASKSCHEDULER_H_
+#define TASKSCHEDULER_H_
+
+#include "future.h"
+#include "singleton.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Small work-stealing thread pool, used to run the I/O and parsing operations
+ * (loading and saving of the configuration files, etc...) outside the GUI thread.
+ *
+ * Each worker owns a task queue: tasks posted from a worker go to its own queue,
+ * tasks posted from another thread are spread over the queues. An idle worker first
+ * pops the most recent task of its own queue, and then steals the oldest task from the
+ * queues of the other workers.
+ *
+ * The first call to `instance()` must be done from the main thread.
+ */
+class TaskScheduler : public Executor, public Singleton<TaskScheduler>
+{
+	friend class Singleton<TaskScheduler>;
+
+public:
+
+	/**
+	 * Statistics about the activity of the scheduler.
+	 */
+	struct Statistics
+	{
+		std::uint64_t tasks_submitted ; //!< Number of tasks posted to the scheduler.
+		std::uint64_t tasks_completed ; //!< Number of tasks that have been executed.
+		std::uint64_t tasks_stolen    ; //!< Number of tasks executed by another worker than the one they were queued on.
+		std::int64_t  queue_depth     ; //!< Number of tasks currently waiting to be executed.
+		std::int64_t  max_queue_depth ; //!< Highest value reached by `queue_depth`.
+		std::uint64_t total_wait_time ; //!< Cumulated time spent by the tasks in the queues (in microseconds).
+		std::uint64_t max_wait_time   ; //!< Highest time spent by a task in the queues (in microseconds).
+		std::uint64_t total_run_time  ; //!< Cumulated execution time of the tasks (in microseconds).
+		std::uint64_t max_run_time    ; //!< Highest execution time of a task (in microseconds).
+	};
+
+	/**
+	 * Destructor. The tasks that are still queued are executed before the workers are stopped.
+	 */
+	~TaskScheduler();
+
+	/**
+	 * Number of worker threads.
+	 */
+	std::size_t worker_count() const { return _workers.size(); }
+
+	/**
+	 * Schedule a task on one of the worker threads.
+	 */
+	void post(std::function<void()> task) override;
+
+	/**
+	 * Schedule `f` on one of the worker threads, and return a future holding its result.
+	 */
+	template<typename F>
+	Future<typename std::result_of<F()>::type> submit(F f)
+	{
+		typedef typename std::result_of<F()>::type R;
+		Promise<R> promise;
+		post([promise, f]() mutable { promise.fulfill(f); });
+		return promise.get_future();
+	}
+
+	/**
+	 * Block until all the tasks posted so far (and the tasks they post) are executed.
+	 * Must not be called from a worker thread.
+	 */
+	void wait_idle();
+
+	/**
+	 * Whether the calling thread is one of the worker threads.
+	 */
+	bool in_worker_thread() const;
+
+	/**
+	 * Snapshot of the statistics.
+	 */
+	Statistics statistics() const;
+
+private:
+
+	// Task and its submission time.
+	struct Task
+	{
+		std::function<void()>                 function ;
+		std::chrono::steady_clock::time_point posted_at;
+		std::size_t                           queue    ;
+	};
+
+	// Worker thread and its task queue.
+	struct Worker
+	{
+		std::mutex       mutex ;
+		std::deque<Task> tasks ;
+		std::thread      thread;
+	};
+
+	// Constructor
+	TaskScheduler();
+
+	// Private functions
+	void run_worker(std::size_t index);
+	bool pop_task(std::size_t index, Task &task);
+	void execute(std::size_t index, Task &task);
+	static void update_max(std::atomic<std::uint64_t> &target, std::uint64_t value);
+
+	// Private members
+	std::vector<std::unique_ptr<Worker>> _workers          ;
+	std::atomic<std::size_t>             _next_queue       ;
+	std::mutex                           _idle_mutex       ;
+	std::condition_variable              _idle_condition   ;
+	std::condition_variable              _done_condition   ;
+	std::int64_t                         _pending          ; // Queued + running tasks (protected by `_idle_mutex`).
+	std::uint64_t                        _posted           ; // Number of posted tasks (protected by `_idle_mutex`).
+	bool                                 _stopping         ;
+
+	// Statistics
+	std::atomic<std::uint64_t> _tasks_submitted;
+	std::atomic<std::uint64_t> _tasks_completed;
+	std::atomic<std::uint64_t> _tasks_stolen   ;
+	std::atomic<std::int64_t > _queue_depth    ;
+	std::atomic<std::uint64_t> _max_queue_depth;
+	std::atomic<std::uint64_t> _total_wait_time;
+	std::atomic<std::uint64_t> _max_wait_time  ;
+	std::atomic<std::uint64_t> _total_run_time ;
+	std::atomic<std::uint64_t> _max_run_time   ;
+};
+
+
+
+/**
+ * Executor running the tasks in the main thread.
+ *
+ * The tasks are queued until `drain()` is called from the main thread. The owner of the main event loop
+ * is expected to register a wake-up function (through `set_wakeup()`) that makes the event loop call `drain()`
+ * as soon as possible. The first call to `instance()` must be done from the main thread.
+ */
+class MainThreadExecutor : public Executor, public Singleton<MainThreadExecutor>
+{
+	friend class Singleton<MainThreadExecutor>;
+
+public:
+
+	/**
+	 * Queue a task to be executed in the main thread.
+	 */
+	void post(std::function<void()> task) override;
+
+	/**
+	 * Set the function called (from any thread) when a task is queued while no drain request is pending.
+	 */
+	void set_wakeup(std::function<void()> wakeup);
+
+	/**
+	 * Execute all the queued tasks. Must be called from the main thread.
+	 * @returns Number of executed tasks.
+	 */
+	std::size_t drain();
+
+private:
+
+	// Constructor
+	MainThreadExecutor() : _wakeup_pending(false) {}
+
+	// Private members
+	std::mutex                         _mutex         ;
+	std::vector<std::function<void()>> _tasks         ;
+	std::function<void()>              _wakeup        ;
+	bool                               _wakeup_pending;
+};
+
+#endif /* TASKSCHEDULER_H_ */
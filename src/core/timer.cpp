@@ -25,30 +25,29 @@
 
 
 // Change the behavior of the timer.
-void Timer::set_mode(Mode mode)
+void Timer::set_mode(Mode mode, const TimePoint &at)
 {
 	if(_mode==mode) {
 		return;
 	}
 	if(_mode!=Mode::PAUSED) {
-		_time = time();
+		_time = time(at);
 	}
 	if(mode!=Mode::PAUSED) {
-		_start_at = current_time();
+		_start_at = at;
 	}
 	_mode = mode;
 }
 
 
-// Current time.
-TimeDuration Timer::time() const
+// Time at the given instant.
+TimeDuration Timer::time(const TimePoint &at) const
 {
 	if(_mode==Mode::PAUSED) {
 		return _time;
 	}
 	else {
-		TimePoint    now  = current_time();
-		TimeDuration diff = now - _start_at;
+		TimeDuration diff = at - _start_at;
 		if(_mode==Mode::INCREMENT)
 			return _time + diff;
 		else // _mode==Mode::DECREMENT
@@ -63,3 +62,12 @@ void Timer::set_time(TimeDuration time)
 	_mode = Mode::PAUSED;
 	_time = std::move(time);
 }
+
+
+// Set both the mode and the time of the timer.
+void Timer::restore(Mode mode, TimeDuration time, const TimePoint &reference)
+{
+	_mode     = mode;
+	_time     = std::move(time);
+	_start_at = reference;
+}
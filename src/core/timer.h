@@ -57,12 +57,23 @@ public:
 	/**
 	 * Change the behavior of the timer.
 	 */
-	void set_mode(Mode mode);
+	void set_mode(Mode mode) { set_mode(mode, current_time()); }
+
+	/**
+	 * Change the behavior of the timer, the change being effective from the instant `at`
+	 * (which must not be earlier than the last change).
+	 */
+	void set_mode(Mode mode, const TimePoint &at);
 
 	/**
 	 * Current time.
 	 */
-	TimeDuration time() const;
+	TimeDuration time() const { return time(current_time()); }
+
+	/**
+	 * Time at the given instant (assuming the timer mode does not change in the meantime).
+	 */
+	TimeDuration time(const TimePoint &at) const;
 
 	/**
 	 * Change the current time. A call to this function stops the timer
@@ -70,6 +81,12 @@ public:
 	 */
 	void set_time(TimeDuration time);
 
+	/**
+	 * Set both the mode and the time of the timer, `time` being the time at the instant `reference`.
+	 * This is typically used to restore the state of a timer captured in another process.
+	 */
+	void restore(Mode mode, TimeDuration time, const TimePoint &reference);
+
 private:
 
 	// Private members
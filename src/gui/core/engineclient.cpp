@@ -0,0 +1,232 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "engineclient.h"
+#include <ipc/engineprotocol.h>
+#include <ipc/sharedclockstate.h>
+#include <models/modelmain.h>
+#include <QCoreApplication>
+#include <QProcess>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+	#include <cstring>
+	#include <fcntl.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+
+// Minimal delay between two attempts to spawn the engine (in milliseconds).
+static const qint64 SPAWN_RETRY_DELAY = 2000;
+
+
+// Constructor.
+EngineClient::EngineClient(QObject *parent) : QObject(parent), _fd(-1), _notifier(nullptr)
+{
+	_reconnectTimer = new QTimer(this);
+	_reconnectTimer->setInterval(100);
+	connect(_reconnectTimer, &QTimer::timeout, this, &EngineClient::onReconnectTimerElapsed);
+	if(!tryConnect()) {
+		_reconnectTimer->start();
+	}
+}
+
+
+// Destructor.
+EngineClient::~EngineClient()
+{
+	closeConnection();
+}
+
+
+// Read the clock state last published by the engine.
+bool EngineClient::readState(BiTimer::State &state) const
+{
+	return _sharedState && _sharedState->read(state);
+}
+
+
+// Commands forwarded to the engine.
+void EngineClient::sendKeyPressed (ScanCode scanCode) { send(EngineMessage(EngineMessageType::KEY_PRESSED , scanCode)); }
+void EngineClient::sendKeyReleased(ScanCode scanCode) { send(EngineMessage(EngineMessageType::KEY_RELEASED, scanCode)); }
+void EngineClient::startTimer(Side side) { send(EngineMessage(EngineMessageType::START_TIMER, Enum::to_value(side))); }
+void EngineClient::stopTimer  () { send(EngineMessage(EngineMessageType::STOP_TIMER  )); }
+void EngineClient::resetTimers() { send(EngineMessage(EngineMessageType::RESET_TIMERS)); }
+void EngineClient::swapSides  () { send(EngineMessage(EngineMessageType::SWAP_SIDES  )); }
+void EngineClient::setTimeControl(const TimeControl &timeControl) { send(make_time_control_message(timeControl)); }
+void EngineClient::setShortcuts(const ShortcutManager &shortcutManager) { send(make_shortcuts_message(shortcutManager)); }
+
+
+// Change the name of a player.
+void EngineClient::setPlayerName(Side side, const QString &name)
+{
+	EngineMessage message(EngineMessageType::SET_PLAYER_NAME, Enum::to_value(side));
+	message.text = name.toStdString();
+	send(message);
+}
+
+
+// Try to (re-)connect to the engine, and spawn it if it does not answer.
+void EngineClient::onReconnectTimerElapsed()
+{
+	if(tryConnect()) {
+		_reconnectTimer->stop();
+		return;
+	}
+	if(!_lastSpawn.isValid() || _lastSpawn.elapsed()>SPAWN_RETRY_DELAY) {
+		QStringList arguments;
+		arguments << "--engine";
+		ModelMain &model(ModelMain::instance());
+		if(model.broadcast_enabled()) {
+			arguments << QString("--broadcast=%1:%2").arg(QString::fromStdString(model.broadcast_address())).arg(model.broadcast_port());
+			if(!model.time_sync_server().empty()) {
+				arguments << QString("--time-sync=%1").arg(QString::fromStdString(model.time_sync_server()));
+			}
+		}
+		if(model.metrics_enabled()) {
+			arguments << QString("--metrics=%1").arg(model.metrics_port()+1);
+		}
+		if(!model.input_debounce().empty()) {
+			arguments << QString("--debounce=%1").arg(QString::fromStdString(model.input_debounce()));
+		}
+		if(model.input_arbitration()>0) {
+			arguments << QString("--arbitration=%1").arg(model.input_arbitration());
+		}
+		if(model.evdev_enabled()) {
+			arguments << "--evdev";
+			if(!model.input_routes().empty()) {
+				arguments << QString("--input-routes=%1").arg(QString::fromStdString(model.input_routes()));
+			}
+		}
+		if(model.realtime_enabled()) {
+			arguments << (model.realtime_cpu()>=0 ? QString("--realtime=%1").arg(model.realtime_cpu()) : QString("--realtime"));
+		}
+		QProcess::startDetached(QCoreApplication::applicationFilePath(), arguments);
+		_lastSpawn.start();
+	}
+}
+
+
+// Process the messages sent by the engine.
+void EngineClient::onSocketActivated()
+{
+	#ifdef OS_IS_UNIX
+		EngineMessage message;
+		if(!receive_engine_message(_fd, message)) {
+			closeConnection();
+			emit disconnected();
+			_reconnectTimer->start();
+			return;
+		}
+		switch(message.type)
+		{
+			case EngineMessageType::STATE_CHANGED: emit stateChanged(); break;
+			case EngineMessageType::SIDES_SWAPPED: emit sidesSwapped(); break;
+			case EngineMessageType::TIME_CONTROL_CHANGED:
+				try {
+					_timeControl = parse_time_control_message(message);
+					emit timeControlChanged();
+				}
+				catch(std::invalid_argument &) {}
+				break;
+			default: break;
+		}
+	#endif
+}
+
+
+// Try to connect to the engine.
+bool EngineClient::tryConnect()
+{
+	#ifdef OS_IS_UNIX
+		sockaddr_un address;
+		std::string path = engine_socket_path();
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if(path.size()>=sizeof(address.sun_path)) {
+			return false;
+		}
+		std::strcpy(address.sun_path, path.c_str());
+
+		int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+		if(fd<0) {
+			return false;
+		}
+		if(::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))!=0) {
+			::close(fd);
+			return false;
+		}
+
+		// The engine creates the shared-memory segment before it starts listening.
+		try {
+			_sharedState = SharedClockState::open(SharedClockState::default_name());
+		}
+		catch(std::runtime_error &) {
+			::close(fd);
+			return false;
+		}
+
+		// From now on, the UI must never block on the engine.
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		_fd = fd;
+		_notifier = new QSocketNotifier(_fd, QSocketNotifier::Read, this);
+		connect(_notifier, &QSocketNotifier::activated, this, &EngineClient::onSocketActivated);
+		send(EngineMessage(EngineMessageType::HELLO, ENGINE_PROTOCOL_VERSION));
+		emit connected();
+		return true;
+	#else
+		return false;
+	#endif
+}
+
+
+// Close the connection with the engine.
+void EngineClient::closeConnection()
+{
+	if(_fd<0) {
+		return;
+	}
+	delete _notifier;
+	_notifier = nullptr;
+	_sharedState.reset();
+	#ifdef OS_IS_UNIX
+		::close(_fd);
+	#endif
+	_fd = -1;
+}
+
+
+// Send a message to the engine.
+void EngineClient::send(const EngineMessage &message)
+{
+	#ifdef OS_IS_UNIX
+		if(_fd>=0) {
+			send_engine_message(_fd, message);
+		}
+	#else
+		(void)message;
+	#endif
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef ENGINECLIENT_H_
+#define ENGINECLIENT_H_
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <memory>
+#include <core/keys.h>
+#include <core/side.h>
+#include <core/bitimer.h>
+#include <core/shortcutmanager.h>
+
+class QSocketNotifier;
+class QTimer;
+class SharedClockState;
+struct EngineMessage;
+
+
+/**
+ * Connection to the headless clock engine (see `ClockEngine`), used when the UI runs in client mode.
+ *
+ * The engine is spawned if it is not running yet, and the connection is re-established automatically
+ * if it is lost. Only available on Unix platforms: elsewhere, the client never gets connected.
+ */
+class EngineClient : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * Constructor.
+	 */
+	EngineClient(QObject *parent=0);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~EngineClient();
+
+	/**
+	 * Whether the client is currently connected to the engine.
+	 */
+	bool isConnected() const { return _fd>=0; }
+
+	/**
+	 * Read the clock state last published by the engine.
+	 * @returns `false` if the client is not connected or if nothing has been published yet.
+	 */
+	bool readState(BiTimer::State &state) const;
+
+	/**
+	 * Time control last announced by the engine (see the `timeControlChanged()` signal).
+	 */
+	const TimeControl &timeControl() const { return _timeControl; }
+
+	/**
+	 * @name Commands forwarded to the engine (ignored if the client is not connected).
+	 * @{
+	 */
+	void sendKeyPressed (ScanCode scanCode);
+	void sendKeyReleased(ScanCode scanCode);
+	void startTimer(Side side);
+	void stopTimer();
+	void resetTimers();
+	void swapSides();
+	void setTimeControl(const TimeControl &timeControl);
+	void setShortcuts(const ShortcutManager &shortcutManager);
+	void setPlayerName(Side side, const QString &name);
+	/**@} */
+
+signals:
+
+	/**
+	 * Emitted when the connection with the engine is established.
+	 */
+	void connected();
+
+	/**
+	 * Emitted when the connection with the engine is lost.
+	 */
+	void disconnected();
+
+	/**
+	 * Emitted when the engine has published a new clock state.
+	 */
+	void stateChanged();
+
+	/**
+	 * Emitted when the engine has swapped the sides.
+	 */
+	void sidesSwapped();
+
+	/**
+	 * Emitted when the engine announces its time control: right after the connection, and whenever it changes
+	 * (whoever changed it: this client, another one, or the command socket).
+	 */
+	void timeControlChanged();
+
+private:
+
+	// Private functions
+	void onReconnectTimerElapsed();
+	void onSocketActivated();
+	bool tryConnect();
+	void closeConnection();
+	void send(const EngineMessage &message);
+
+	// Private members
+	int                               _fd            ;
+	QSocketNotifier                  *_notifier      ;
+	QTimer                           *_reconnectTimer;
+	QElapsedTimer                     _lastSpawn     ;
+	std::unique_ptr<SharedClockState> _sharedState   ;
+	TimeControl                       _timeControl   ;
+};
+
+#endif /* ENGINECLIENT_H_ */
@@ -0,0 +1,117 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "eventloopmonitor.h"
+#include <core/metrics.h>
+#include <core/resourceusage.h>
+#include <QEvent>
+#include <QTimer>
+#include <QWindow>
+#include <algorithm>
+
+
+// Expected delay between two measurements (in milliseconds).
+static const int MEASUREMENT_INTERVAL = 100;
+
+// Number of measurements between two exports of the resource usage.
+static const int RESOURCE_USAGE_PERIOD = 10;
+
+
+// Constructor.
+EventLoopMonitor::EventLoopMonitor(QWindow *window, QObject *parent) : QObject(parent), _window(window), _ticks(0)
+{
+	_timer = new QTimer(this);
+	_timer->setTimerType(Qt::PreciseTimer);
+	_timer->setInterval(MEASUREMENT_INTERVAL);
+	connect(_timer, &QTimer::timeout, this, &EventLoopMonitor::onTimerElapsed);
+	_window->installEventFilter(this);
+	refreshActivity();
+}
+
+
+// Event filter.
+bool EventLoopMonitor::eventFilter(QObject *object, QEvent *event)
+{
+	if(object==_window && event->type()==QEvent::Expose) {
+		refreshActivity();
+	}
+	return QObject::eventFilter(object, event);
+}
+
+
+// Start or stop the measurements, depending on whether the window is exposed.
+void EventLoopMonitor::refreshActivity()
+{
+	bool active = _window->isExposed();
+	if(active==_timer->isActive()) {
+		return;
+	}
+	if(active) {
+		_ticks = 0;
+		_elapsed.start(); // <- The time spent while suspended is not a lag.
+		_timer->start();
+	}
+	else {
+		_timer->stop();
+		exportResourceUsage(); // <- The gauges are left up to date while the measurements are suspended.
+	}
+}
+
+
+// Timer handler.
+void EventLoopMonitor::onTimerElapsed()
+{
+	static const Metrics::Histogram lagHistogram = Metrics::instance().histogram("vcc_event_loop_lag_seconds",
+		"Delay with which the events of the GUI event loop are processed.");
+	static const Metrics::Gauge lagGauge = Metrics::instance().gauge("vcc_event_loop_last_lag_seconds",
+		"Last measured delay of the GUI event loop.");
+
+	double lag = std::max<qint64>(0, _elapsed.nsecsElapsed() - MEASUREMENT_INTERVAL*1000000LL) * 1e-9;
+	_elapsed.restart();
+	lagHistogram.observe(lag);
+	lagGauge.set(lag);
+
+	if(++_ticks>=RESOURCE_USAGE_PERIOD) {
+		_ticks = 0;
+		exportResourceUsage();
+	}
+}
+
+
+// Export the resources consumed by the process.
+void EventLoopMonitor::exportResourceUsage()
+{
+	static const Metrics::Gauge cpuGauge = Metrics::instance().gauge("vcc_process_cpu_seconds",
+		"CPU time consumed by the process (user and system).");
+	static const Metrics::Gauge residentGauge = Metrics::instance().gauge("vcc_process_resident_memory_bytes",
+		"Resident set size of the process.");
+	static const Metrics::Gauge peakResidentGauge = Metrics::instance().gauge("vcc_process_peak_resident_memory_bytes",
+		"Largest resident set size of the process.");
+	static const Metrics::Gauge wakeupGauge = Metrics::instance().gauge("vcc_process_wakeups",
+		"Voluntary context switches of the process (i.e. number of times a thread went to sleep).");
+
+	ResourceUsage usage = resource_usage();
+	cpuGauge         .set(usage.cpu_seconds        );
+	residentGauge    .set(usage.resident_bytes     );
+	peakResidentGauge.set(usage.peak_resident_bytes);
+	wakeupGauge      .set(usage.wakeups            );
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef EVENTLOOPMONITOR_H_
+#define EVENTLOOPMONITOR_H_
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QTimer;
+class QWindow;
+
+
+/**
+ * Measure the lag of the Qt event loop, and export it in the metrics (see `Metrics`).
+ *
+ * A timer is scheduled at a fixed interval; the lag is the difference between the actual
+ * and the expected delay between two of its expirations. The resources consumed by the process
+ * (see `ResourceUsage`) are exported as well, once per second.
+ *
+ * The measurements are suspended while the given window is not exposed (hidden, minimized or occluded),
+ * so that the monitor does not wake up the process when nothing is displayed.
+ */
+class EventLoopMonitor : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param window Window whose exposure is followed (it must outlive the monitor).
+	 */
+	EventLoopMonitor(QWindow *window, QObject *parent=0);
+
+protected:
+
+	/**
+	 * Event filter (exposure of the window).
+	 */
+	bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+
+	// Private functions
+	void refreshActivity();
+	void onTimerElapsed();
+	void exportResourceUsage();
+
+	// Private members
+	QWindow       *_window ;
+	QTimer        *_timer  ;
+	QElapsedTimer  _elapsed;
+	int            _ticks  ; // Measurements since the last export of the resource usage.
+};
+
+#endif /* EVENTLOOPMONITOR_H_ */
@@ -0,0 +1,327 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "inputhub.h"
+#include "keyboardhandler.h"
+#include <QApplication>
+#include <algorithm>
+#include <cstdint>
+
+#ifndef Q_OS_WIN
+	#include <QAbstractEventDispatcher>
+#endif
+
+#ifdef HAS_XCB
+	#include <xcb/xcb.h>
+	#include <time.h>
+#endif
+
+
+#if defined(Q_OS_WIN) || defined(HAS_XCB)
+
+// Largest plausible delay between the stamping of a key event by the system and its reception (in milliseconds):
+// beyond, the time base of the stamp is assumed to differ from the local one (e.g. remote display).
+static const std::uint32_t MAX_EVENT_AGE = 10000;
+
+
+// Delay elapsed since a key event has been stamped by the system, from the stamp (in milliseconds, on a 32-bit
+// wrapping clock) and the current value of the same clock (hence a resolution of one millisecond).
+static std::chrono::microseconds eventAge(std::uint32_t stamp, std::uint32_t now)
+{
+	std::uint32_t age = now - stamp;
+	return std::chrono::microseconds(age<=MAX_EVENT_AGE ? age * 1000 : 0);
+}
+
+#endif
+
+
+// Singleton.
+InputHub &InputHub::instance()
+{
+	static InputHub hub;
+	return hub;
+}
+
+
+// Constructor.
+InputHub::InputHub() : _dispatching(0), _listening(false), _consuming(false),
+	#ifdef Q_OS_WIN
+		_hModule(GetModuleHandle(NULL)), _hHook(NULL)
+	#else
+		_eventFilter(this), _grabber(nullptr)
+	#endif
+{
+	#ifndef Q_OS_WIN
+		QAbstractEventDispatcher::instance()->installNativeEventFilter(&_eventFilter);
+	#endif
+
+	// Follow the activation of the windows of the application (queued, so that the active window is up to date).
+	QObject::connect(qApp, &QGuiApplication::focusWindowChanged     , qApp, [this]() { refreshGrab(); }, Qt::QueuedConnection);
+	QObject::connect(qApp, &QGuiApplication::applicationStateChanged, qApp, [this]() { refreshGrab(); }, Qt::QueuedConnection);
+}
+
+
+// Register a handler.
+void InputHub::subscribe(KeyboardHandler *handler, unsigned int interest)
+{
+	_subscribers.push_back(Subscriber{handler, interest});
+}
+
+
+// Unregister a handler.
+void InputHub::unsubscribe(KeyboardHandler *handler)
+{
+	releaseFocus(handler);
+	for(auto &it : _subscribers) {
+		if(it.handler==handler) {
+			it.handler = nullptr;
+		}
+	}
+	if(_dispatching==0) { // <- Otherwise, the list is compacted at the end of the dispatch.
+		_subscribers.erase(std::remove_if(_subscribers.begin(), _subscribers.end(),
+			[](const Subscriber &it) { return it.handler==nullptr; }), _subscribers.end());
+	}
+}
+
+
+// Give the focus to the given handler.
+void InputHub::acquireFocus(KeyboardHandler *handler, QWidget *grabber)
+{
+	if(focusOwner()==handler) {
+		return;
+	}
+	clearKeysDown();
+	_focusStack.erase(std::remove_if(_focusStack.begin(), _focusStack.end(),
+		[handler](const FocusEntry &it) { return it.handler==handler; }), _focusStack.end());
+	_focusStack.push_back(FocusEntry{handler, grabber});
+	refreshGrab();
+}
+
+
+// Remove the given handler from the focus stack.
+void InputHub::releaseFocus(KeyboardHandler *handler)
+{
+	if(focusOwner()!=handler) {
+		_focusStack.erase(std::remove_if(_focusStack.begin(), _focusStack.end(),
+			[handler](const FocusEntry &it) { return it.handler==handler; }), _focusStack.end());
+		return;
+	}
+	clearKeysDown();
+	_focusStack.pop_back();
+	refreshGrab();
+}
+
+
+// Listen to the keyboard while the application is active and some handler owns the focus, and grab it
+// on behalf of the focus owner while its window is the active one.
+void InputHub::refreshGrab()
+{
+	QWidget *grabber   = _focusStack.empty() ? nullptr : _focusStack.back().grabber;
+	bool     listening = grabber!=nullptr && QApplication::activeWindow()!=nullptr;
+	if(_listening && !listening) {
+		clearKeysDown(); // <- The key releases will not be received anymore.
+	}
+	_listening = listening;
+	_consuming = listening && grabber->isActiveWindow();
+
+	// Grab the keyboard to avoid unexpected key sequences being intercepted by the OS
+	// (for instance, it avoids the main menu begin rolled down in the Cinnamon desktop).
+	#ifdef Q_OS_WIN
+		if(_listening && _hHook==NULL) {
+			_hHook = SetWindowsHookEx(WH_KEYBOARD_LL, InputHub::lowLevelKeyboardProc, _hModule, 0);
+		}
+		else if(!_listening && _hHook!=NULL) {
+			UnhookWindowsHookEx(_hHook);
+			_hHook = NULL;
+		}
+	#else
+		QWidget *target = _consuming ? grabber : nullptr;
+		if(target==_grabber) {
+			return;
+		}
+		if(_grabber!=nullptr) {
+			_grabber->releaseKeyboard();
+		}
+		_grabber = target;
+		if(_grabber!=nullptr) {
+			_grabber->grabKeyboard();
+		}
+	#endif
+}
+
+
+// Register a key press (ignoring the auto-repeat events).
+void InputHub::notifyKeyPressed(ScanCode scanCode, std::chrono::microseconds age)
+{
+	if(_keysDown.press(scanCode)) {
+		_pressStamp = std::chrono::steady_clock::now() - age;
+		dispatch(scanCode, KEY_PRESS);
+	}
+}
+
+
+// Register a key release (if the key is actually down).
+void InputHub::notifyKeyReleased(ScanCode scanCode, std::chrono::microseconds age)
+{
+	if(_keysDown.release(scanCode)) {
+		_releaseStamp = std::chrono::steady_clock::now() - age;
+		dispatch(scanCode, KEY_RELEASE);
+	}
+}
+
+
+// Convert an instant of the steady clock to the time base of `current_time()`.
+TimePoint InputHub::toTimePoint(std::chrono::steady_clock::time_point stamp)
+{
+	auto age = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stamp);
+	return current_time() - boost::posix_time::microseconds(age.count());
+}
+
+
+// Release all the keys currently down.
+void InputHub::clearKeysDown()
+{
+	while(!_keysDown.empty()) {
+		notifyKeyReleased(_keysDown.first());
+	}
+}
+
+
+// Deliver an event to the focus owner and to the background subscribers interested in it.
+void InputHub::dispatch(ScanCode scanCode, unsigned int kind)
+{
+	KeyboardHandler *owner = focusOwner();
+	++_dispatching;
+	for(std::size_t k=0; k<_subscribers.size(); ++k) { // <- Indexes, as the handlers may subscribe new handlers.
+		KeyboardHandler *handler = _subscribers[k].handler;
+		unsigned int     interest = _subscribers[k].interest;
+		if(handler==nullptr || (interest & kind)==0 || (handler!=owner && (interest & BACKGROUND)==0)) {
+			continue;
+		}
+		if(kind==KEY_PRESS) {
+			emit handler->keyPressed(scanCode);
+		}
+		else {
+			emit handler->keyReleased(scanCode);
+		}
+	}
+	if(--_dispatching==0) {
+		_subscribers.erase(std::remove_if(_subscribers.begin(), _subscribers.end(),
+			[](const Subscriber &it) { return it.handler==nullptr; }), _subscribers.end());
+	}
+}
+
+
+#ifdef Q_OS_WIN
+
+// Low-level callback method to handle keyboard events.
+LRESULT CALLBACK InputHub::lowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
+{
+	// nCode<0 has a special meaning, as specified by the MSDN.
+	// However, this case seems to never (or rarely) happens.
+	if(nCode<0) {
+		return CallNextHookEx(0, nCode, wParam, lParam);
+	}
+
+	// Extract the scan-code.
+	KBDLLHOOKSTRUCT *info = reinterpret_cast<KBDLLHOOKSTRUCT *>(lParam);
+	ScanCode scanCode = info->scanCode;
+	if(info->flags & 0x01) {
+		scanCode += 256;
+	}
+
+	// Notify the hub.
+	switch(wParam)
+	{
+		case WM_KEYDOWN:
+		case WM_SYSKEYDOWN:
+			instance().notifyKeyPressed(scanCode, eventAge(info->time, GetTickCount()));
+			break;
+
+		case WM_KEYUP:
+		case WM_SYSKEYUP:
+			instance().notifyKeyReleased(scanCode, eventAge(info->time, GetTickCount()));
+			break;
+	}
+
+	// Pass the event on to the active window if it is not the one of the focus owner.
+	return instance()._consuming ? 1 : CallNextHookEx(0, nCode, wParam, lParam);
+}
+
+
+#elif defined(HAS_XCB)
+
+
+// Delay elapsed since a key event has been stamped by the X server (with its CLOCK_MONOTONIC time, in milliseconds).
+static std::chrono::microseconds xcbEventAge(xcb_timestamp_t stamp)
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return eventAge(stamp, static_cast<std::uint32_t>(static_cast<std::uint64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000));
+}
+
+
+// Implementation of the event filter method.
+bool InputHub::EventFilter::nativeEventFilter(const QByteArray &eventType, void *message, long *)
+{
+	// Do not intercept anything if no handler owns the focus, nor on the platforms other than X11
+	// (e.g. linuxfb or offscreen, used by the kiosk mode).
+	if(!_owner->_listening || eventType!="xcb_generic_event_t") {
+		return false;
+	}
+
+	// Redirect key-press and key-release events to the notification methods (passing them on to the regular
+	// event dispatcher as well if another window than the one of the focus owner is active),
+	// and forward everything else to the regular event dispatcher.
+	xcb_generic_event_t *event = static_cast<xcb_generic_event_t *>(message);
+	switch(event->response_type)
+	{
+		case XCB_KEY_PRESS:
+		{
+			xcb_key_press_event_t *keyEvent = reinterpret_cast<xcb_key_press_event_t *>(event);
+			_owner->notifyKeyPressed(keyEvent->detail, xcbEventAge(keyEvent->time));
+			return _owner->_consuming;
+		}
+
+		case XCB_KEY_RELEASE:
+		{
+			xcb_key_release_event_t *keyEvent = reinterpret_cast<xcb_key_release_event_t *>(event);
+			_owner->notifyKeyReleased(keyEvent->detail, xcbEventAge(keyEvent->time));
+			return _owner->_consuming;
+		}
+
+		default:
+			return false;
+	}
+}
+
+#else
+
+
+// Built without X11 support: the key events are not intercepted (in kiosk mode, the keyboards
+// are read directly, see `EvdevReader`).
+bool InputHub::EventFilter::nativeEventFilter(const QByteArray &, void *, long *)
+{
+	return false;
+}
+
+#endif /* Q_OS_WIN */
@@ -0,0 +1,207 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef INPUTHUB_H_
+#define INPUTHUB_H_
+
+#include <QWidget>
+#include <chrono>
+#include <vector>
+#include <core/chrono.h>
+#include <core/keys.h>
+#include <core/keystate.h>
+
+#ifdef Q_OS_WIN
+	#include <windows.h>
+#else
+	#include <QAbstractNativeEventFilter>
+#endif
+
+class KeyboardHandler;
+
+
+/**
+ * Process-wide source of the low-level key events, shared by all the `KeyboardHandler` objects.
+ *
+ * The hub owns the only native event filter (or, on Windows, the only low-level keyboard hook) of the process:
+ * each native event is decoded once, the auto-repeat events are discarded once, and the set of the keys that are
+ * down is maintained once, whatever the number of handlers.
+ *
+ * The handlers that are enabled form a focus stack: the last enabled one owns the focus, and the keyboard is
+ * grabbed on its widget. When the focus owner is disabled, the focus and the grab go back to the previous one.
+ * The key events are delivered to the focus owner, and to the handlers subscribed with the `BACKGROUND` interest,
+ * each handler only receiving the kinds of events it has subscribed to. When the focus changes hands, the keys
+ * that are down are reported as released to the previous owner, so that each owner sees consistent press/release
+ * sequences.
+ *
+ * The events are delivered as long as one of the windows of the application is active, not only the one of
+ * the focus owner: while another window is active (a dialog, typically), the keyboard is not grabbed, and the
+ * events are both delivered to the handlers and passed on to that window. When the application is deactivated,
+ * the keys that are down are reported as released.
+ */
+class InputHub
+{
+public:
+
+	/**
+	 * Kinds of events a handler may subscribe to (bit mask).
+	 */
+	enum Interest : unsigned int
+	{
+		KEY_PRESS   = 0x1, //!< Key-press events.
+		KEY_RELEASE = 0x2, //!< Key-release events.
+		KEY_EVENTS  = 0x3, //!< Both key-press and key-release events.
+		BACKGROUND  = 0x4  //!< Receive the events even without the focus (as long as some handler owns it).
+	};
+
+	/**
+	 * Return the singleton (created on the first call, which must happen after the creation of the application object).
+	 */
+	static InputHub &instance();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	InputHub(const InputHub &op) = delete;
+	InputHub &operator=(const InputHub &op) = delete;
+	/**@} */
+
+	/**
+	 * Register a handler (called by its constructor).
+	 */
+	void subscribe(KeyboardHandler *handler, unsigned int interest);
+
+	/**
+	 * Unregister a handler (called by its destructor).
+	 */
+	void unsubscribe(KeyboardHandler *handler);
+
+	/**
+	 * Give the focus to the given handler, and grab the keyboard on the given widget.
+	 */
+	void acquireFocus(KeyboardHandler *handler, QWidget *grabber);
+
+	/**
+	 * Remove the given handler from the focus stack (the focus going back to the previous handler, if it owned it).
+	 */
+	void releaseFocus(KeyboardHandler *handler);
+
+	/**
+	 * Handler that owns the focus, if any.
+	 */
+	KeyboardHandler *focusOwner() const { return _focusStack.empty() ? nullptr : _focusStack.back().handler; }
+
+	/**
+	 * Inject a key event, as if it had been received from the display server (to replay a recorded input stream,
+	 * see `InputReplay`). The auto-repeat events are discarded as usual.
+	 */
+	void inject(ScanCode scanCode, bool pressed) { if(pressed) { notifyKeyPressed(scanCode); } else { notifyKeyReleased(scanCode); } }
+
+	/**
+	 * Set of the keys currently down (as seen by the focus owner).
+	 */
+	const KeyState &keysDown() const { return _keysDown; }
+
+	/**
+	 * Instant at which the last key press has been stamped by the system (the instant of its reception if unknown),
+	 * on the steady clock. Valid in the key-press handlers, to trace the latency of the press (see `LatencyTrace`).
+	 */
+	std::chrono::steady_clock::time_point pressStamp() const { return _pressStamp; }
+
+	/**
+	 * Instant of the last key press (see `pressStamp()`) on the time base of `current_time()`, at which the debounce,
+	 * the arbitration and the switches are evaluated.
+	 */
+	TimePoint pressTime() const { return toTimePoint(_pressStamp); }
+
+	/**
+	 * Instant at which the last key release has been stamped by the system (the instant of its reception if unknown),
+	 * on the time base of `current_time()`. Valid in the key-release handlers.
+	 */
+	TimePoint releaseTime() const { return toTimePoint(_releaseStamp); }
+
+private:
+
+	// Handler of the focus stack, with the widget on which the keyboard is grabbed.
+	struct FocusEntry
+	{
+		KeyboardHandler *handler;
+		QWidget         *grabber;
+	};
+
+	// Registered handler.
+	struct Subscriber
+	{
+		KeyboardHandler *handler ; // nullptr if unsubscribed during a dispatch.
+		unsigned int     interest;
+	};
+
+	#ifdef Q_OS_WIN
+
+		// Low-level callback method to handle keyboard events.
+		static LRESULT CALLBACK lowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
+
+	#else
+
+		// Event filter used to alter the behavior of the regular Qt event dispatcher.
+		class EventFilter : public QAbstractNativeEventFilter
+		{
+		public:
+			EventFilter(InputHub *owner) : _owner(owner) {}
+			bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
+		private:
+			InputHub *_owner;
+		};
+
+	#endif
+
+	// Private functions
+	InputHub();
+	void notifyKeyPressed (ScanCode scanCode, std::chrono::microseconds age=std::chrono::microseconds::zero());
+	void notifyKeyReleased(ScanCode scanCode, std::chrono::microseconds age=std::chrono::microseconds::zero());
+	void clearKeysDown();
+	void dispatch(ScanCode scanCode, unsigned int kind);
+	void refreshGrab();
+	static TimePoint toTimePoint(std::chrono::steady_clock::time_point stamp);
+
+	// Private members
+	std::vector<Subscriber>               _subscribers ;
+	std::vector<FocusEntry>               _focusStack  ;
+	KeyState                              _keysDown    ;
+	std::chrono::steady_clock::time_point _pressStamp  ;
+	std::chrono::steady_clock::time_point _releaseStamp;
+	int                                   _dispatching ;
+	bool                                  _listening   ; // Whether some handler owns the focus and the application is active.
+	bool                                  _consuming   ; // Whether the window of the focus owner is active (events not passed on).
+
+	// OS-dependent implementation
+	#ifdef Q_OS_WIN
+		HMODULE _hModule;
+		HHOOK   _hHook  ;
+	#else
+		EventFilter  _eventFilter;
+		QWidget     *_grabber    ; // Widget on which the keyboard is currently grabbed, if any.
+	#endif
+};
+
+#endif /* INPUTHUB_H_ */
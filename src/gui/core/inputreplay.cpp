@@ -0,0 +1,281 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "inputreplay.h"
+#include "inputhub.h"
+#include "keyboardhandler.h"
+#include <gui/widgets/bitimerwidget.h>
+#include <core/metrics.h>
+#include <core/resourceusage.h>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+
+// Delay granted to the event loop to repaint the timers after the last injected event (in milliseconds).
+static const int DRAIN_DELAY = 200;
+
+
+// Value of the given quantile of a set of durations (in microseconds).
+static double quantile(std::vector<qint64> values, double q)
+{
+	if(values.empty()) {
+		return 0.0;
+	}
+	std::size_t index = std::min(values.size()-1, static_cast<std::size_t>(q * values.size()));
+	std::nth_element(values.begin(), values.begin()+index, values.end());
+	return values[index] * 1e-3;
+}
+
+
+// Load a recording.
+std::vector<InputReplay::Event> InputReplay::load(const std::string &path)
+{
+	std::ifstream stream(path);
+	if(!stream) {
+		throw std::runtime_error("Unable to read the recording " + path);
+	}
+	std::vector<Event> retval;
+	std::string line;
+	for(int lineNumber=1; std::getline(stream, line); ++lineNumber) {
+		if(line.empty() || line[0]=='#') {
+			continue;
+		}
+		std::istringstream fields(line);
+		std::int64_t at;
+		unsigned int scanCode;
+		std::string  kind;
+		if(!(fields >> at >> scanCode >> kind) || (kind!="p" && kind!="r") || at<0 || (!retval.empty() && at<retval.back().at)) {
+			throw std::invalid_argument("Invalid event at line " + std::to_string(lineNumber) + " of the recording " + path);
+		}
+		retval.push_back(Event{at, static_cast<ScanCode>(scanCode), kind=="p"});
+	}
+	return retval;
+}
+
+
+// Synthetic stream.
+std::vector<InputReplay::Event> InputReplay::synthetic(ScanCode left, ScanCode right, double rate, std::size_t count)
+{
+	std::vector<Event> retval;
+	retval.reserve(2*count);
+	double period = 1e6 / rate;
+	for(std::size_t k=0; k<count; ++k) {
+		ScanCode     scanCode = k%2==0 ? left : right;
+		std::int64_t at       = static_cast<std::int64_t>(k * period);
+		retval.push_back(Event{at                                      , scanCode, true });
+		retval.push_back(Event{at + static_cast<std::int64_t>(period/2), scanCode, false});
+	}
+	return retval;
+}
+
+
+// Microbenchmark of the resolution of the key presses.
+std::string InputReplay::lookupBenchmark(const ShortcutManager &shortcutManager, std::size_t count)
+{
+	std::map<ScanCode, int> low, high;
+	for(const auto &entry : shortcutManager.table()) {
+		low [entry.scan_code] = entry.shortcut_low ;
+		high[entry.scan_code] = entry.shortcut_high;
+	}
+	std::mt19937 random(0);
+	std::uniform_int_distribution<ScanCode> distribution(0, ShortcutManager::KEY_COUNT-1);
+	std::vector<ScanCode> presses(count);
+	for(auto &it : presses) {
+		it = distribution(random);
+	}
+	KeyState keysDown;
+
+	// Former implementation: one map per position.
+	std::uint64_t mapSum = 0;
+	auto mapStart = std::chrono::steady_clock::now();
+	for(ScanCode scanCode : presses) {
+		const std::map<ScanCode, int> &shortcuts(shortcutManager.modifier_keys_activated(keysDown) ? high : low);
+		auto it = shortcuts.find(scanCode);
+		int shortcut = it==shortcuts.end() ? 0 : it->second;
+		ShortcutManager::count_key_press(shortcut);
+		mapSum += shortcut;
+	}
+	double mapTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - mapStart).count();
+
+	// Flat table.
+	std::uint64_t tableSum = 0;
+	auto tableStart = std::chrono::steady_clock::now();
+	for(ScanCode scanCode : presses) {
+		int shortcut = shortcutManager.shortcut(scanCode, shortcutManager.modifier_keys_activated(keysDown));
+		ShortcutManager::count_key_press(shortcut);
+		tableSum += shortcut;
+	}
+	double tableTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tableStart).count();
+
+	std::ostringstream retval;
+	double divisor = count>0 ? static_cast<double>(count) : 1.0;
+	retval << std::fixed << std::setprecision(1)
+		<< "Resolved " << count << " random presses (" << low.size() << " keys with shortcuts)\n"
+		<< "maps:       " << mapTime  /divisor << " ns/press\n"
+		<< "flat table: " << tableTime/divisor << " ns/press\n"
+		<< (mapSum==tableSum ? "same shortcuts" : "DIFFERENT SHORTCUTS") << "\n";
+	return retval.str();
+}
+
+
+// Constructor.
+InputReplay::InputReplay(const std::vector<Event> &events, const BiTimerWidget *widget, QObject *parent) : QObject(parent),
+	_events(events), _next(0), _injecting(false), _injectedAt(0), _duration(0), _presses(0), _paints(0)
+{
+	_timer = new QTimer(this);
+	_timer->setTimerType(Qt::PreciseTimer);
+	_timer->setSingleShot(true);
+	connect(_timer, &QTimer::timeout, this, &InputReplay::onTimerElapsed);
+	connect(widget, &BiTimerWidget::painted, this, &InputReplay::onPainted);
+	_connection = widget->biTimer().connect_state_changed(std::bind(&InputReplay::onStateChanged, this));
+}
+
+
+// Start the injection.
+void InputReplay::start()
+{
+	_clock.start();
+	_timer->start(0);
+}
+
+
+// Inject the events that are due.
+void InputReplay::onTimerElapsed()
+{
+	InputHub &hub(InputHub::instance());
+	qint64 now = _clock.nsecsElapsed();
+	while(_next<_events.size() && _events[_next].at*1000<=now) {
+		const Event &event(_events[_next++]);
+		_injectedAt = _clock.nsecsElapsed();
+		_injecting  = true;
+		hub.inject(event.scan_code, event.pressed);
+		_injecting  = false;
+		if(event.pressed) {
+			_scheduleLag.push_back(_injectedAt - event.at*1000);
+			_handlerTime.push_back(_clock.nsecsElapsed() - _injectedAt);
+			++_presses;
+		}
+		now = _clock.nsecsElapsed();
+	}
+
+	// Wait for the next event, or for the last repaint.
+	if(_next<_events.size()) {
+		_timer->start(static_cast<int>((_events[_next].at*1000 - now) / 1000000));
+	}
+	else {
+		_duration = now;
+		QTimer::singleShot(DRAIN_DELAY, this, &InputReplay::finished);
+	}
+}
+
+
+// Change of the state of the timers.
+void InputReplay::onStateChanged()
+{
+	qint64 now = _clock.nsecsElapsed();
+	if(_injecting) {
+		_switchLatency.push_back(now - _injectedAt);
+	}
+	_unpainted.push_back(now);
+}
+
+
+// Repaint of the timers.
+void InputReplay::onPainted()
+{
+	qint64 now = _clock.nsecsElapsed();
+	for(qint64 it : _unpainted) {
+		_paintLatency.push_back(now - it);
+	}
+	_unpainted.clear();
+	++_paints;
+}
+
+
+// Throughput and latency report.
+std::string InputReplay::report() const
+{
+	std::ostringstream retval;
+	double seconds = _duration * 1e-9;
+	retval << std::fixed << std::setprecision(3)
+		<< "Replayed " << _presses << " presses in " << seconds << " s (" << std::setprecision(1)
+		<< (seconds>0.0 ? _presses / seconds : 0.0) << " presses/s): "
+		<< _switchLatency.size() << " switches, " << _paints << " repaints\n"
+		<< "stage (us)            p50        p99      p99.9        max\n";
+	auto stage = [&retval](const char *name, const std::vector<qint64> &values) {
+		retval << std::left << std::setw(16) << name << std::right;
+		for(double q : { 0.5, 0.99, 0.999, 1.0 }) {
+			retval << std::setw(11) << quantile(values, q);
+		}
+		retval << "\n";
+	};
+	stage("schedule lag"  , _scheduleLag  );
+	stage("press->switch" , _switchLatency);
+	stage("handler"       , _handlerTime  );
+	stage("switch->paint" , _paintLatency );
+
+	// Delay of the key events read from the input devices, if any (bucket estimates, see `Metrics::quantiles()`).
+	std::vector<double> delivery = Metrics::instance().quantiles("vcc_evdev_delivery_seconds", { 0.5, 0.99, 0.999, 1.0 });
+	if(!delivery.empty()) {
+		retval << std::left << std::setw(16) << "evdev delivery" << std::right;
+		for(double value : delivery) {
+			retval << std::setw(11) << value * 1e6;
+		}
+		retval << "\n";
+	}
+
+	// Footprint of the whole process (including its start-up).
+	ResourceUsage usage = resource_usage();
+	retval << std::setprecision(3) << "process: " << usage.cpu_seconds << " s of CPU, " << std::setprecision(1)
+		<< usage.resident_bytes / 1048576.0 << " MiB resident (peak " << usage.peak_resident_bytes / 1048576.0 << " MiB), "
+		<< usage.wakeups << " wakeups\n";
+	return retval.str();
+}
+
+
+// Constructor.
+InputRecorder::InputRecorder(const std::string &path, QWidget *parent) : QObject(parent), _stream(path)
+{
+	if(!_stream) {
+		throw std::runtime_error("Unable to create the recording " + path);
+	}
+	_stream << "# <instant in us> <scan-code> <p|r>" << std::endl;
+	_handler = new KeyboardHandler(parent, InputHub::KEY_EVENTS | InputHub::BACKGROUND);
+	connect(_handler, &KeyboardHandler::keyPressed , this, std::bind(&InputRecorder::record, this, std::placeholders::_1, true ));
+	connect(_handler, &KeyboardHandler::keyReleased, this, std::bind(&InputRecorder::record, this, std::placeholders::_1, false));
+}
+
+
+// Write an event.
+void InputRecorder::record(ScanCode scanCode, bool pressed)
+{
+	if(!_clock.isValid()) {
+		_clock.start();
+	}
+	_stream << _clock.nsecsElapsed()/1000 << ' ' << scanCode << ' ' << (pressed ? 'p' : 'r') << std::endl;
+}
@@ -0,0 +1,172 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef INPUTREPLAY_H_
+#define INPUTREPLAY_H_
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <core/keys.h>
+#include <core/shortcutmanager.h>
+#include <wrappers/signals.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class QTimer;
+class QWidget;
+class BiTimerWidget;
+class KeyboardHandler;
+
+
+/**
+ * Driver injecting a recorded or synthetic stream of key events into the `InputHub`, to load-test the whole
+ * press path (hub, main window, `ShortcutManager`, `BiTimer`, repaint of the `BiTimerWidget`) at controlled rates
+ * (`vcc --replay=<file>` or `vcc --replay=synthetic[:<rate>[:<count>]]`, on the offscreen platform by default).
+ *
+ * The events are injected from the event loop, at the instants of the stream (several events may be injected
+ * in a row if the loop is late). For each key press, the driver measures:
+ * - the schedule lag: delay between the instant of the event in the stream and its injection;
+ * - the switch latency: delay between the injection and the resulting change of the state of the timers;
+ * - the handler duration: time spent in the synchronous part of the press path;
+ * - the paint latency: delay between the change of the state of the timers and the next repaint of the widget.
+ *
+ * The recordings are text files, with one event per line: `<instant in us> <scan-code> <p|r>` (p: press,
+ * r: release), the lines starting with `#` being ignored. They can be produced by `InputRecorder`.
+ */
+class InputReplay : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * Key event of a stream.
+	 */
+	struct Event
+	{
+		std::int64_t at       ; //!< Instant of the event, relative to the beginning of the stream (us).
+		ScanCode     scan_code;
+		bool         pressed  ;
+	};
+
+	/**
+	 * Load a recording.
+	 * @throw std::runtime_error If the file cannot be read.
+	 * @throw std::invalid_argument If the file is malformed.
+	 */
+	static std::vector<Event> load(const std::string &path);
+
+	/**
+	 * Synthetic stream: `count` presses alternating between the given keys at `rate` presses per second,
+	 * each key being released half-way to the next press.
+	 */
+	static std::vector<Event> synthetic(ScanCode left, ScanCode right, double rate, std::size_t count);
+
+	/**
+	 * Microbenchmark of the resolution of the key presses (`vcc --replay=lookup[:<count>]`): `count` presses of random
+	 * scan-codes are resolved with the modifier chord check and counted in the metrics, first through two maps
+	 * built from `shortcutManager` (as `ShortcutManager` used to do), then through its flat table.
+	 * @returns Report giving the time per press of each of them.
+	 */
+	static std::string lookupBenchmark(const ShortcutManager &shortcutManager, std::size_t count);
+
+	/**
+	 * Constructor.
+	 * @param widget Widget displaying the timers driven by the injected events.
+	 */
+	InputReplay(const std::vector<Event> &events, const BiTimerWidget *widget, QObject *parent=0);
+
+	/**
+	 * Start the injection. `finished()` is emitted once the stream has been injected and the last repaint done.
+	 */
+	void start();
+
+	/**
+	 * Throughput and latency report (to be called after `finished()`). The delay of the key events read from the
+	 * input devices (`vcc_evdev_delivery_seconds`) is included when some have been read, e.g. in kiosk mode.
+	 */
+	std::string report() const;
+
+signals:
+
+	/**
+	 * Signal emitted when the replay is over.
+	 */
+	void finished();
+
+private:
+
+	// Private functions
+	void onTimerElapsed();
+	void onStateChanged();
+	void onPainted();
+
+	// Private members
+	std::vector<Event>       _events       ;
+	std::size_t              _next         ;
+	QTimer                  *_timer        ;
+	QElapsedTimer            _clock        ;
+	sig::scoped_connection   _connection   ;
+	bool                     _injecting    ;
+	qint64                   _injectedAt   ; // Instant of the current injection (ns on `_clock`).
+	qint64                   _duration     ; // Time taken to inject the stream (ns).
+	std::size_t              _presses      ;
+	std::size_t              _paints       ;
+	std::vector<qint64>      _unpainted    ; // Instants of the state changes not yet repainted.
+	std::vector<qint64>      _scheduleLag  ;
+	std::vector<qint64>      _switchLatency;
+	std::vector<qint64>      _handlerTime  ;
+	std::vector<qint64>      _paintLatency ;
+};
+
+
+/**
+ * Record the key events received by the `InputHub` into a file, in the format read by `InputReplay::load()`
+ * (`vcc --record=<file>`). The instants are relative to the first recorded event.
+ */
+class InputRecorder : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param parent Widget to which the underlying (background) keyboard handler is attached.
+	 * @throw std::runtime_error If the file cannot be created.
+	 */
+	InputRecorder(const std::string &path, QWidget *parent);
+
+private:
+
+	// Private functions
+	void record(ScanCode scanCode, bool pressed);
+
+	// Private members
+	std::ofstream    _stream ;
+	QElapsedTimer    _clock  ;
+	KeyboardHandler *_handler;
+};
+
+#endif /* INPUTREPLAY_H_ */
@@ -25,14 +25,9 @@
 
 #include <QObject>
 #include <QWidget>
-#include <set>
 #include <core/keys.h>
-
-#ifdef Q_OS_WIN
-	#include <windows.h>
-#else
-	#include <QAbstractNativeEventFilter>
-#endif
+#include <core/keystate.h>
+#include "inputhub.h"
 
 
 /**
@@ -42,6 +37,10 @@
  * (such as the circumflex key ^ in the French keyboard) or with keys that triggers an action
  * at the OS level (for instance, pressing the window key on Windows popups the start menu
  * and makes the application lost the focus).
+ *
+ * The events are decoded by the process-wide `InputHub`: a handler is only a subscription to it. Enabling
+ * a handler gives it the focus (and grabs the keyboard on its parent widget); disabling it gives the focus back
+ * to the handler that owned it before, if that one is still enabled.
  */
 class KeyboardHandler : public QObject
 {
@@ -51,8 +50,9 @@ public:
 
 	/**
 	 * Constructor.
+	 * @param interest Kinds of events to receive (see `InputHub::Interest`).
 	 */
-	KeyboardHandler(QWidget *parent);
+	KeyboardHandler(QWidget *parent, unsigned int interest=InputHub::KEY_EVENTS);
 
 	/**
 	 * Destructor.
@@ -61,8 +61,9 @@ public:
 
 	/**
 	 * Whether the keyboard handler is actually enabled or not. If not enabled,
-	 * no signal will be emitted by the keyboard handler, and no key is reported
-	 * as "down". By default, the keyboard handler is not enabled.
+	 * no signal will be emitted by the keyboard handler (unless it has subscribed to
+	 * the background events), and no key is reported as "down". By default,
+	 * the keyboard handler is not enabled.
 	 */
 	bool isEnabled() const { return _enabled; }
 
@@ -72,14 +73,19 @@ public:
 	void setEnabled(bool enabled);
 
 	/**
-	 * Return a set containing the scan-codes of all keys currently down.
+	 * Whether the keyboard handler currently owns the focus of the input hub.
+	 */
+	bool hasFocus() const { return InputHub::instance().focusOwner()==this; }
+
+	/**
+	 * Return the state of all the keys currently down.
 	 */
-	const std::set<ScanCode> &keysDown() const { return _keysDown; }
+	const KeyState &keysDown() const { return isTracking() ? InputHub::instance().keysDown() : _noKeys; }
 
 	/**
 	 * Check whether a given key is or not currently down.
 	 */
-	bool isDown(ScanCode scanCode) const { return _keysDown.count(scanCode)>0; }
+	bool isDown(ScanCode scanCode) const { return isTracking() && InputHub::instance().keysDown().is_down(scanCode); }
 
 signals:
 
@@ -95,62 +101,16 @@ signals:
 
 private:
 
-	#ifdef Q_OS_WIN
-
-		/**
-		 * Pointer to the lastly activated keyboard handler.
-		 */
-		static KeyboardHandler *_activeHandler;
-
-		/**
-		 * Low-level callback method to handle keyboard events.
-		 */
-		static LRESULT CALLBACK lowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
-
-	#else
-
-		/**
-		 * Event filter used to alter the behavior of the regular Qt event dispatcher.
-		 */
-		class EventFilter : public QAbstractNativeEventFilter
-		{
-		public:
-
-			/**
-			 * Constructor.
-			 */
-			EventFilter(KeyboardHandler *owner);
-
-			/**
-			 * Implementation of the event filter method.
-			 */
-			bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
-
-		private:
-
-			// Private members
-			KeyboardHandler *_owner;
-		};
-
-	#endif
-
 	// Private functions
-	void notifyKeyPressed (ScanCode scanCode);
-	void notifyKeyReleased(ScanCode scanCode);
-	void clearKeysDown();
+	bool isTracking() const { return (_interest & InputHub::BACKGROUND)!=0 ? InputHub::instance().focusOwner()!=nullptr : hasFocus(); }
 
 	// Private members
-	bool               _enabled ;
-	std::set<ScanCode> _keysDown;
-
-	// OS-dependent implementation
-	#ifdef Q_OS_WIN
-		HMODULE _hModule;
-		HHOOK   _hHook  ;
-	#else
-		EventFilter _eventFilter;
-		QWidget    *_parent     ;
-	#endif
+	bool          _enabled ;
+	unsigned int  _interest;
+	QWidget      *_parent  ;
+
+	// Empty set of keys, reported when the handler does not track the keyboard.
+	static const KeyState _noKeys;
 };
 
 #endif /* KEYBOARDHANDLER_H_ */
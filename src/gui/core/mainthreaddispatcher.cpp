@@ -0,0 +1,57 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "mainthreaddispatcher.h"
+#include <core/taskscheduler.h>
+#include <QCoreApplication>
+
+
+// Type of the events used to request the execution of the queued tasks.
+const QEvent::Type MainThreadDispatcher::_drainEventType = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+
+// Constructor.
+MainThreadDispatcher::MainThreadDispatcher(QObject *parent) : QObject(parent)
+{
+	// `QCoreApplication::postEvent()` is thread-safe: the wake-up function can be called from any worker thread.
+	MainThreadExecutor::instance().set_wakeup([this]() {
+		QCoreApplication::postEvent(this, new QEvent(_drainEventType));
+	});
+}
+
+
+// Destructor.
+MainThreadDispatcher::~MainThreadDispatcher()
+{
+	MainThreadExecutor::instance().set_wakeup(nullptr);
+}
+
+
+// Event handler.
+bool MainThreadDispatcher::event(QEvent *event)
+{
+	if(event->type()==_drainEventType) {
+		MainThreadExecutor::instance().drain();
+		return true;
+	}
+	return QObject::event(event);
+}
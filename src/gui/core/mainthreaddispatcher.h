@@ -0,0 +1,65 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef MAINTHREADDISPATCHER_H_
+#define MAINTHREADDISPATCHER_H_
+
+#include <QObject>
+#include <QEvent>
+
+
+/**
+ * Bridge between the main-thread executor (see `MainThreadExecutor`) and the Qt event loop:
+ * the tasks posted to the main thread from the worker threads are executed by the Qt event loop.
+ *
+ * Exactly one dispatcher should be alive at a time, created in the main thread.
+ */
+class MainThreadDispatcher : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	/**
+	 * Constructor.
+	 */
+	MainThreadDispatcher(QObject *parent=0);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~MainThreadDispatcher();
+
+protected:
+
+	/**
+	 * Event handler.
+	 */
+	bool event(QEvent *event) override;
+
+private:
+
+	// Type of the events used to request the execution of the queued tasks.
+	static const QEvent::Type _drainEventType;
+};
+
+#endif /* MAINTHREADDISPATCHER_H_ */
@@ -23,10 +23,26 @@
 #include "debugdialog.h"
 #include <wrappers/translation.h>
 #include <gui/core/keyboardhandler.h>
+#include <core/latencytrace.h>
 #include <QLabel>
 #include <QTextEdit>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QHBoxLayout>
 #include <QVBoxLayout>
+#include <QTimer>
 #include <QEvent>
+#include <fstream>
+
+
+// Refresh period of the latency table (in milliseconds).
+static const int LATENCY_REFRESH_PERIOD = 500;
+
+// Quantiles displayed in the latency table.
+static const double LATENCY_QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
 
 
 // Constructor.
@@ -46,13 +62,41 @@ DebugDialog::DebugDialog(QWidget *parent) : QDialog(parent)
 	_info->setReadOnly(true);
 	layout->addWidget(new QLabel(_("Press some key..."), this));
 	layout->addWidget(_info, 1);
+
+	// Latency table: one row per stage, the count and the quantiles (in milliseconds from the key event).
+	_latencies = new QTableWidget(Enum::traits<TraceStage>::count, 6, this);
+	_latencies->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	_latencies->setHorizontalHeaderLabels(QStringList() << _("Count") << _("Median") << "90%" << "99%" << "99.9%" << _("Max"));
+	_latencies->setVerticalHeaderLabels(QStringList() << _("Key event received") << _("Shortcut looked up") << _("Timers switched")
+		<< _("Repaint requested") << _("Repaint started") << _("Repaint finished") << _("Window flushed"));
+	_latencies->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+	layout->addWidget(new QLabel(_("Latency of the key presses (ms):"), this));
+	layout->addWidget(_latencies);
+
+	// Buttons
+	QHBoxLayout *buttonLayout = new QHBoxLayout;
+	layout->addLayout(buttonLayout);
+	QPushButton *resetButton  = new QPushButton(_("Reset"    ), this);
+	QPushButton *exportButton = new QPushButton(_("Export..."), this);
+	connect(resetButton , &QPushButton::clicked, this, &DebugDialog::onResetLatenciesClicked );
+	connect(exportButton, &QPushButton::clicked, this, &DebugDialog::onExportLatenciesClicked);
+	buttonLayout->addStretch(1);
+	buttonLayout->addWidget(resetButton );
+	buttonLayout->addWidget(exportButton);
+
+	// Refresh timer
+	QTimer *refreshTimer = new QTimer(this);
+	refreshTimer->setInterval(LATENCY_REFRESH_PERIOD);
+	connect(refreshTimer, &QTimer::timeout, this, &DebugDialog::onRefreshLatencies);
+	refreshTimer->start();
+	onRefreshLatencies();
 }
 
 
 // Default size.
 QSize DebugDialog::sizeHint() const
 {
-	return QSize(400, 400);
+	return QSize(600, 600);
 }
 
 
@@ -85,3 +129,55 @@ void DebugDialog::onKeyReleased(ScanCode scanCode)
 {
 	_info->append(QString("<b style=\"color: #008000;\">Key released</b>, code=%1").arg(scanCode));
 }
+
+
+// Refresh the latency table.
+void DebugDialog::onRefreshLatencies()
+{
+	if(!isVisible()) {
+		return;
+	}
+	const LatencyTrace &trace(LatencyTrace::instance());
+	for(auto s=Enum::cursor<TraceStage>::first(); s.valid(); ++s) {
+		const HdrHistogram &histogram(trace.histogram(*s));
+		QStringList cells;
+		cells << QString::number(histogram.count());
+		for(double quantile : LATENCY_QUANTILES) {
+			cells << QString::number(histogram.quantile(quantile) / 1e6, 'f', 2);
+		}
+		cells << QString::number(histogram.max() / 1e6, 'f', 2);
+		for(int column=0; column<cells.size(); ++column) {
+			QTableWidgetItem *item = _latencies->item(Enum::to_value(*s), column);
+			if(item==nullptr) {
+				item = new QTableWidgetItem;
+				item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+				_latencies->setItem(Enum::to_value(*s), column, item);
+			}
+			item->setText(cells[column]);
+		}
+	}
+}
+
+
+// Forget the latencies recorded so far.
+void DebugDialog::onResetLatenciesClicked()
+{
+	LatencyTrace::instance().reset();
+	onRefreshLatencies();
+}
+
+
+// Save the distribution of the latencies, in the percentile-distribution format of the HdrHistogram tools.
+void DebugDialog::onExportLatenciesClicked()
+{
+	QString path = QFileDialog::getSaveFileName(this, _("Export the latencies"), "latencies.hgrm",
+		_("Percentile distributions (*.hgrm);;All files (*)"));
+	if(path.isEmpty()) {
+		return;
+	}
+	std::ofstream file(path.toLocal8Bit().constData());
+	file << LatencyTrace::instance().export_text();
+	if(!file) {
+		QMessageBox::warning(this, _("Export the latencies"), QString(_("Unable to write the file %1.")).arg(path));
+	}
+}
@@ -27,6 +27,7 @@
 #include <core/keys.h>
 
 QT_BEGIN_NAMESPACE
+	class QTableWidget;
 	class QTextEdit;
 QT_END_NAMESPACE
 
@@ -34,7 +35,8 @@ class KeyboardHandler;
 
 
 /**
- * Dialog providing extra-information for debugging purposes.
+ * Dialog providing extra-information for debugging purposes, including the distribution of the latencies
+ * between the key presses and the display of their effect (see `LatencyTrace`).
  */
 class DebugDialog : public QDialog
 {
@@ -69,10 +71,14 @@ private:
 	// Private functions
 	void onKeyPressed (ScanCode scanCode);
 	void onKeyReleased(ScanCode scanCode);
+	void onRefreshLatencies();
+	void onResetLatenciesClicked();
+	void onExportLatenciesClicked();
 
 	// Private members
 	KeyboardHandler *_keyboardHandler;
 	QTextEdit       *_info;
+	QTableWidget    *_latencies;
 };
 
 #endif /* DEBUGDIALOG_H_ */
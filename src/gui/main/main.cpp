@@ -23,13 +23,531 @@
 #include <QApplication>
 #include <QTranslator>
 #include <QLibraryInfo>
+#include <QTimer>
 #include "mainwindow.h"
+#include <gui/core/mainthreaddispatcher.h>
+#include <gui/core/engineclient.h>
+#include <gui/core/eventloopmonitor.h>
+#include <gui/core/inputreplay.h>
+#include <ipc/clockengine.h>
+#include <ipc/enginematch.h>
+#include <net/clockaggregator.h>
+#include <net/metricsserver.h>
+#include <net/streamloadtest.h>
+#include <net/timesyncclient.h>
+#include <net/timesyncrelay.h>
+#include <net/timesyncserver.h>
+#include <core/clockcodec.h>
+#include <core/metrics.h>
 #include <models/modelpaths.h>
 #include <models/modelappinfo.h>
+#include <models/modelmain.h>
+#include <models/modelkeyboard.h>
+#include <models/modelshortcutmap.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+// Check whether the given option is present on the command line.
+static bool hasOption(int argc, char **argv, const char *option)
+{
+	for(int k=1; k<argc; ++k) {
+		if(std::strcmp(argv[k], option)==0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Value of the given option on the command line (`<option>=<value>`), or nullptr if the option is not present.
+static const char *optionValue(int argc, char **argv, const char *option)
+{
+	std::size_t length = std::strlen(option);
+	for(int k=1; k<argc; ++k) {
+		if(std::strncmp(argv[k], option, length)==0 && argv[k][length]=='=') {
+			return argv[k] + length + 1;
+		}
+	}
+	return nullptr;
+}
+
+
+// Split a comma-separated list.
+static std::vector<std::string> splitList(const char *list)
+{
+	std::vector<std::string> retval;
+	std::string current;
+	for(const char *it=list; *it!='\0'; ++it) {
+		if(*it==',') {
+			retval.push_back(current);
+			current.clear();
+		}
+		else {
+			current.push_back(*it);
+		}
+	}
+	if(!current.empty()) {
+		retval.push_back(current);
+	}
+	return retval;
+}
+
+
+// Print the quantiles of the delay with which the key events read from the input devices have been processed
+// (bucket estimates, see `Metrics::quantiles()`).
+static void printDeliveryReport(bool realtime)
+{
+	Metrics &metrics(Metrics::instance());
+	std::vector<double> values = metrics.quantiles("vcc_evdev_delivery_seconds", { 0.5, 0.99, 0.999, 1.0 });
+	if(values.empty()) {
+		std::cout << "No key event has been read from the input devices." << std::endl;
+		return;
+	}
+	std::printf("evdev delivery (us, %s real-time mode), %llu events: p50 %.0f, p99 %.0f, p99.9 %.0f, max %.0f\n",
+		realtime ? "with" : "without", static_cast<unsigned long long>(metrics.observations("vcc_evdev_delivery_seconds")),
+		values[0]*1e6, values[1]*1e6, values[2]*1e6, values[3]*1e6);
+}
+
+
+// Run the headless clock engine.
+static int runEngine(const char *clockId, const char *broadcast, const char *metrics, const char *timeSync, const char *evdev, const char *inputRoutes,
+	const char *debounce, const char *arbitration, const char *realtime, bool latencyReport)
+{
+	#ifdef OS_IS_UNIX
+		try {
+			// Clock instance (`--clock-id=<id>`), so that several engines can run side by side.
+			ClockEngine engine(clockId==nullptr ? 0 : static_cast<unsigned int>(std::atoi(clockId)));
+
+			// The engine owns the time control from now on: it starts with the configured one, and the UI clients
+			// mirror it (they push it only when the user changes it).
+			engine.set_time_control(ModelMain::instance().time_control());
+
+			// Optional metrics endpoint, on the loopback interface only (`--metrics=<port>`).
+			std::unique_ptr<MetricsServer> metricsServer;
+			if(metrics!=nullptr) {
+				metricsServer.reset(new MetricsServer("127.0.0.1", static_cast<std::uint16_t>(std::atoi(metrics))));
+			}
+
+			// Optional network stream of the clock state (`--broadcast=<address>:<port>`).
+			if(broadcast!=nullptr) {
+				const char *separator = std::strrchr(broadcast, ':');
+				if(separator==nullptr) {
+					throw std::invalid_argument("Invalid broadcast endpoint (expected <address>:<port>).");
+				}
+				engine.enable_broadcast(std::string(broadcast, separator), static_cast<std::uint16_t>(std::atoi(separator+1)));
+			}
+
+			// Optional common time base for the broadcast stream (`--time-sync=<address>`).
+			if(timeSync!=nullptr) {
+				engine.enable_time_sync(timeSync);
+			}
+
+			// Optional debounce of the key presses (`--debounce=<rules>`, see `PressFilter`) and arbitration between
+			// the presses of both players (`--arbitration=<ms>`, see `SwitchArbiter`).
+			engine.configure_input_filters(debounce==nullptr ? std::string() : debounce,
+				boost::posix_time::milliseconds(arbitration==nullptr ? 0 : std::atoi(arbitration)));
+
+			// Optional direct reading of the keyboards (`--evdev[=<device>,...]`, all the keyboards if no device is given),
+			// possibly with per-device routing (`--input-routes=<rules>`, see `InputRouter`).
+			if(evdev!=nullptr) {
+				engine.enable_evdev(splitList(evdev), inputRoutes==nullptr ? std::string() : inputRoutes);
+			}
+
+			// Optional real-time mode of the input path (`--realtime[=<cpu>]`): applied last, once everything is allocated.
+			std::unique_ptr<RealtimeMode> realtimeMode;
+			if(realtime!=nullptr) {
+				realtimeMode.reset(new RealtimeMode(*realtime=='\0' ? -1 : std::atoi(realtime)));
+				engine.enable_realtime(*realtimeMode);
+				for(const std::string &warning : realtimeMode->warnings()) {
+					std::cerr << "Real-time mode: " << warning << std::endl;
+				}
+			}
+			engine.run();
+
+			// Tail latency of the input path, once the engine is stopped (`--latency-report`), to compare the runs
+			// with and without the real-time mode.
+			if(latencyReport) {
+				printDeliveryReport(realtimeMode.get()!=nullptr);
+			}
+			return 0;
+		}
+		catch(std::exception &err) {
+			std::cerr << err.what() << std::endl;
+			return 1;
+		}
+	#else
+		(void)clockId;
+		(void)broadcast;
+		(void)metrics;
+		(void)timeSync;
+		(void)evdev;
+		(void)inputRoutes;
+		(void)debounce;
+		(void)arbitration;
+		(void)realtime;
+		(void)latencyReport;
+		std::cerr << "The clock engine is not available on this platform." << std::endl;
+		return 1;
+	#endif
+}
+
+
+// Run the hall-wide aggregator (`--aggregator[=<address>:<port>]`).
+static int runAggregator(const char *endpoint)
+{
+	try {
+		std::string   address = "0.0.0.0";
+		std::uint16_t port    = CLOCK_FEED_DEFAULT_PORT;
+		if(endpoint!=nullptr) {
+			const char *separator = std::strrchr(endpoint, ':');
+			if(separator==nullptr) {
+				throw std::invalid_argument("Invalid aggregator endpoint (expected <address>:<port>).");
+			}
+			address = std::string(endpoint, separator);
+			port    = static_cast<std::uint16_t>(std::atoi(separator+1));
+		}
+		ClockAggregator aggregator(address, port);
+
+		// The aggregator is also the reference clock of the hall.
+		std::unique_ptr<TimeSyncServer> timeSyncServer;
+		try {
+			timeSyncServer.reset(new TimeSyncServer(address));
+		}
+		catch(std::runtime_error &err) {
+			std::cerr << err.what() << std::endl;
+		}
+		aggregator.run();
+		return 0;
+	}
+	catch(std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
+
+
+// Play engine-vs-engine games (`--match --white=<command> --black=<command> [--tc=<seconds>+<increment>] [--games=<n>]`).
+static int runMatch(const char *white, const char *black, const char *tc, const char *games, const char *broadcast)
+{
+	try {
+		if(white==nullptr || black==nullptr) {
+			throw std::invalid_argument("Both --white=<command> and --black=<command> are required.");
+		}
+
+		// Time control: Fischer mode if given on the command line, the configured one otherwise.
+		TimeControl timeControl = ModelMain::instance().time_control();
+		if(tc!=nullptr) {
+			const char *separator = std::strchr(tc, '+');
+			TimeDuration mainTime  = boost::posix_time::microseconds(static_cast<std::int64_t>(std::atof(tc)*1e6));
+			TimeDuration increment = boost::posix_time::microseconds(separator==nullptr ? 0 : static_cast<std::int64_t>(std::atof(separator+1)*1e6));
+			timeControl = TimeControl();
+			timeControl.set_mode(TimeControl::Mode::FISCHER);
+			for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+				timeControl.set_main_time(*s, mainTime );
+				timeControl.set_increment(*s, increment);
+			}
+		}
+
+		// Optional network stream of the clock state (`--broadcast=<address>:<port>`).
+		std::unique_ptr<BroadcastServer> broadcastServer;
+		if(broadcast!=nullptr) {
+			const char *separator = std::strrchr(broadcast, ':');
+			if(separator==nullptr) {
+				throw std::invalid_argument("Invalid broadcast endpoint (expected <address>:<port>).");
+			}
+			broadcastServer.reset(new BroadcastServer(std::string(broadcast, separator), static_cast<std::uint16_t>(std::atoi(separator+1))));
+			broadcastServer->enable_discovery();
+		}
+
+		// Games, the engines swapping the colors after each game.
+		int gameCount = games==nullptr ? 1 : std::max(1, std::atoi(games));
+		double score[2] = { 0.0, 0.0 };
+		for(int k=0; k<gameCount; ++k) {
+			int whiteIndex = k%2;
+			Enum::array<Side, std::string> names;
+			names[Side::LEFT ] = whiteIndex==0 ? white : black;
+			names[Side::RIGHT] = whiteIndex==0 ? black : white;
+			EngineMatch match(names[Side::LEFT], names[Side::RIGHT], timeControl);
+			sig::scoped_connection connection;
+			if(broadcastServer) {
+				const BiTimer &biTimer(match.bi_timer());
+				connection = biTimer.connect_state_changed([&]() { broadcastServer->publish(biTimer.state(), names); });
+			}
+			EngineMatch::Result result = match.play();
+			if(result.result=="1-0") {
+				score[whiteIndex] += 1.0;
+			}
+			else if(result.result=="0-1") {
+				score[1-whiteIndex] += 1.0;
+			}
+			else if(result.result=="1/2-1/2") {
+				score[0] += 0.5;
+				score[1] += 0.5;
+			}
+			std::cout << "Game " << (k+1) << ": " << names[Side::LEFT] << " - " << names[Side::RIGHT] << " " << result.result
+				<< " (" << result.reason << ", " << result.moves.size() << " plies)" << std::endl;
+		}
+		std::cout << "Score: " << white << " " << score[0] << " - " << score[1] << " " << black << std::endl;
+		return 0;
+	}
+	catch(std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
+
+
+// Run a scripted UCI engine on the standard input and output, for the tests of `--match` (`--uci-stub[=<think>[:<plies>]]`).
+static int runUciStub(const char *spec)
+{
+	int thinkTime = 10;
+	int plies     = 40;
+	if(spec!=nullptr && (std::sscanf(spec, "%d:%d", &thinkTime, &plies)<1 || thinkTime<0)) {
+		std::cerr << "Invalid UCI stub (expected <think>[:<plies>])." << std::endl;
+		return 1;
+	}
+	run_uci_stub(std::cin, std::cout, thinkTime, plies);
+	return 0;
+}
+
+
+// Print the estimate of the time base of the given server every second (`--time-sync-probe=<address>[:<port>]`).
+// With `--time-sync-probe=simulated[:<delay>[:<offset>[:<drift>]]]`, the server runs locally behind a relay that adds
+// random delays (mean in milliseconds, in each direction) and simulates the offset (in milliseconds) and the drift
+// (in ppm) of a remote clock, and the error of the estimate is printed as well.
+static int runTimeSyncProbe(const char *endpoint)
+{
+	try {
+		std::unique_ptr<TimeSyncServer> server;
+		std::unique_ptr<TimeSyncRelay > relay ;
+		std::string   address = endpoint;
+		std::uint16_t port    = TIME_SYNC_DEFAULT_PORT;
+		if(std::strncmp(endpoint, "simulated", 9)==0) {
+			double delay  =  1.5;
+			double offset =  5.0;
+			double drift  = 80.0;
+			if(endpoint[9]!='\0' && (std::sscanf(endpoint+9, ":%lf:%lf:%lf", &delay, &offset, &drift)<1 || delay<0.0)) {
+				throw std::invalid_argument("Invalid simulation (expected simulated[:<delay>[:<offset>[:<drift>]]]).");
+			}
+			server.reset(new TimeSyncServer("127.0.0.1", 0));
+			relay .reset(new TimeSyncRelay(server->port(), delay*1000, static_cast<std::int64_t>(offset*1000), drift));
+			address = "127.0.0.1";
+			port    = relay->port();
+		}
+		else {
+			std::size_t separator = address.rfind(':');
+			if(separator!=std::string::npos) {
+				port    = static_cast<std::uint16_t>(std::atoi(address.c_str() + separator + 1));
+				address = address.substr(0, separator);
+			}
+		}
+		TimeSyncClient client(address, port);
+		while(true) {
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			TimeSyncEstimator::Estimate estimate = client.estimate();
+			if(estimate.synchronized) {
+				std::cout << "offset " << estimate.offset << " us, drift " << estimate.drift << " ppm, delay " << estimate.delay
+					<< " us, jitter " << estimate.jitter << " us, " << estimate.samples << " samples";
+				if(relay) {
+					std::int64_t now = time_sync_now();
+					std::cout << ", error " << (client.to_reference(now) - now - relay->offset_at(now)) << " us";
+				}
+				std::cout << std::endl;
+			}
+			else {
+				std::cout << "not synchronized" << std::endl;
+			}
+		}
+	}
+	catch(std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
+
+
+// Load-test the broadcast stream over the loopback interface (`--stream-load-test[=<subscribers>[:<changes>[:<rate>]]]`).
+static int runStreamLoadTest(const char *spec)
+{
+	try {
+		unsigned long subscribers = 1000;
+		unsigned long changes     = 2000;
+		double        rate        = 1000.0;
+		if(spec!=nullptr && (std::sscanf(spec, "%lu:%lu:%lf", &subscribers, &changes, &rate)<1 || subscribers==0 || rate<=0.0)) {
+			throw std::invalid_argument("Invalid load test (expected <subscribers>[:<changes>[:<rate>]]).");
+		}
+		StreamLoadTestResult result = run_stream_load_test(subscribers, changes, rate);
+		std::cout << result.report();
+		return result.passed() ? 0 : 1;
+	}
+	catch(std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
+
+
+// Load-test the aggregator with simulated boards over the loopback interface (`--aggregator-load-test[=<boards>[:<changes>[:<rate>]]]`).
+static int runAggregatorLoadTest(const char *spec)
+{
+	try {
+		unsigned long boards  = 50;
+		unsigned long changes = 25000;
+		double        rate    = 25000.0;
+		if(spec!=nullptr && (std::sscanf(spec, "%lu:%lu:%lf", &boards, &changes, &rate)<1 || boards==0 || rate<=0.0)) {
+			throw std::invalid_argument("Invalid load test (expected <boards>[:<changes>[:<rate>]]).");
+		}
+		AggregatorLoadTestResult result = run_aggregator_load_test(boards, changes, rate);
+		std::cout << result.report();
+		return result.passed() ? 0 : 1;
+	}
+	catch(std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
+
+
+// Check the binary encoding of the clock state against known records, in several time zones (`--codec-check`).
+static int runCodecCheck()
+{
+	std::vector<std::string> failures = check_clock_codec();
+	for(const auto &failure : failures) {
+		std::cout << failure << std::endl;
+	}
+	std::cout << (failures.empty() ? "PASSED" : "FAILED") << std::endl;
+	return failures.empty() ? 0 : 1;
+}
+
+
+// Start the replay of a recorded or synthetic key stream (`--replay=<file>` or `--replay=synthetic[:<rate>[:<count>]]`,
+// the synthetic presses alternating between the clock buttons of both players). The application prints the report
+// and exits once the replay is over. With `--replay=lookup[:<count>]`, only the resolution of the key presses
+// is benchmarked, on the loaded shortcut configuration.
+static void startReplay(const char *spec, const MainWindow &mainWindow)
+{
+	if(std::strncmp(spec, "lookup", 6)==0) {
+		std::size_t count = 10000000;
+		if(spec[6]!='\0' && std::sscanf(spec+6, ":%zu", &count)<1) {
+			throw std::invalid_argument("Invalid lookup benchmark (expected lookup[:<count>]).");
+		}
+		std::cout << InputReplay::lookupBenchmark(mainWindow.shortcutManager(), count);
+		qApp->quit();
+		return;
+	}
+	std::vector<InputReplay::Event> events;
+	if(std::strncmp(spec, "synthetic", 9)==0) {
+		double      rate  = 1000.0;
+		std::size_t count = 10000;
+		if(spec[9]!='\0' && (std::sscanf(spec+9, ":%lf:%zu", &rate, &count)<1 || rate<=0.0)) {
+			throw std::invalid_argument("Invalid synthetic stream (expected synthetic[:<rate>[:<count>]]).");
+		}
+		Enum::array<Side, int> button;
+		button[Side::LEFT ] = -1;
+		button[Side::RIGHT] = -1;
+		for(const auto &entry : mainWindow.shortcutManager().table()) {
+			if(entry.shortcut_low==1 && button[Side::LEFT ]<0) { button[Side::LEFT ] = entry.scan_code; }
+			if(entry.shortcut_low==2 && button[Side::RIGHT]<0) { button[Side::RIGHT] = entry.scan_code; }
+		}
+		if(button[Side::LEFT]<0 || button[Side::RIGHT]<0) {
+			throw std::invalid_argument("No key is bound to the clock buttons.");
+		}
+		events = InputReplay::synthetic(button[Side::LEFT], button[Side::RIGHT], rate, count);
+	}
+	else {
+		events = InputReplay::load(spec);
+	}
+	if(ModelMain::instance().evdev_enabled()) {
+		std::cerr << "The keyboards are read from the input devices (input.evdev): the replayed presses will be ignored." << std::endl;
+	}
+
+	InputReplay *replay = new InputReplay(events, mainWindow.biTimerWidget(), qApp);
+	QObject::connect(replay, &InputReplay::finished, [replay]() {
+		std::cout << replay->report();
+		qApp->quit();
+	});
+	QTimer::singleShot(0, replay, &InputReplay::start);
+}
 
 
 int main(int argc, char **argv)
 {
+	// Create the metric registry before any thread may use it (the first call to `instance()` is not thread-safe).
+	Metrics::instance();
+
+	// Headless clock engine: no GUI at all.
+	if(hasOption(argc, argv, "--engine")) {
+		const char *evdev    = hasOption(argc, argv, "--evdev"   ) ? "" : optionValue(argc, argv, "--evdev"   );
+		const char *realtime = hasOption(argc, argv, "--realtime") ? "" : optionValue(argc, argv, "--realtime");
+		return runEngine(optionValue(argc, argv, "--clock-id"), optionValue(argc, argv, "--broadcast"), optionValue(argc, argv, "--metrics"),
+			optionValue(argc, argv, "--time-sync"), evdev, optionValue(argc, argv, "--input-routes"),
+			optionValue(argc, argv, "--debounce"), optionValue(argc, argv, "--arbitration"), realtime,
+			hasOption(argc, argv, "--latency-report"));
+	}
+
+	// Hall-wide aggregator: no GUI either.
+	if(hasOption(argc, argv, "--aggregator") || optionValue(argc, argv, "--aggregator")!=nullptr) {
+		return runAggregator(optionValue(argc, argv, "--aggregator"));
+	}
+
+	// Engine-vs-engine games: no GUI either.
+	if(hasOption(argc, argv, "--match")) {
+		return runMatch(optionValue(argc, argv, "--white"), optionValue(argc, argv, "--black"), optionValue(argc, argv, "--tc"),
+			optionValue(argc, argv, "--games"), optionValue(argc, argv, "--broadcast"));
+	}
+
+	// Scripted UCI engine, to be run by `--match`.
+	if(hasOption(argc, argv, "--uci-stub") || optionValue(argc, argv, "--uci-stub")!=nullptr) {
+		return runUciStub(optionValue(argc, argv, "--uci-stub"));
+	}
+
+	// Time-base diagnostic: no GUI either.
+	if(optionValue(argc, argv, "--time-sync-probe")!=nullptr) {
+		return runTimeSyncProbe(optionValue(argc, argv, "--time-sync-probe"));
+	}
+
+	// Load test of the broadcast stream.
+	if(hasOption(argc, argv, "--stream-load-test") || optionValue(argc, argv, "--stream-load-test")!=nullptr) {
+		return runStreamLoadTest(optionValue(argc, argv, "--stream-load-test"));
+	}
+
+	// Load test of the aggregator.
+	if(hasOption(argc, argv, "--aggregator-load-test") || optionValue(argc, argv, "--aggregator-load-test")!=nullptr) {
+		return runAggregatorLoadTest(optionValue(argc, argv, "--aggregator-load-test"));
+	}
+
+	// Checks of the binary encoding of the clock state.
+	if(hasOption(argc, argv, "--codec-check")) {
+		return runCodecCheck();
+	}
+
+	// Load-test of the press path: headless by default.
+	const char *replay = optionValue(argc, argv, "--replay");
+	if(replay!=nullptr && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+
+	// Kiosk mode (`--kiosk`): no display server, the timers being drawn full-screen on the framebuffer (unless another
+	// platform is requested, e.g. `QT_QPA_PLATFORM=offscreen` for tests), and the keyboards being read by vcc itself.
+	bool kiosk = hasOption(argc, argv, "--kiosk");
+	if(kiosk) {
+		if(!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+			qputenv("QT_QPA_PLATFORM", "linuxfb");
+		}
+		if(!qEnvironmentVariableIsSet("QT_QPA_FB_DISABLE_INPUT")) {
+			qputenv("QT_QPA_FB_DISABLE_INPUT", "1"); // <- The input devices are not opened twice (see `EvdevReader`).
+		}
+	}
+
 	QApplication app(argc, argv);
 	app.setApplicationName(QString::fromStdString(ModelAppInfo::instance().name()));
 
@@ -41,7 +559,59 @@ int main(int argc, char **argv)
 	customTranslator.load(QLocale::system(), "", "", QString::fromStdString(ModelPaths::instance().translation_path()));
 	app.installTranslator(&customTranslator);
 
-	MainWindow mainWindow;
+	// Run the continuations of the background tasks in the event loop, and start reading
+	// the configuration files while the main window is being built.
+	MainThreadDispatcher mainThreadDispatcher;
+	ModelKeyboard   ::instance().prefetch();
+	ModelShortcutMap::instance().prefetch();
+
+	// In client mode, the timers are owned by the clock engine (spawned if necessary).
+	std::unique_ptr<EngineClient> engineClient;
+	if(hasOption(argc, argv, "--client")) {
+		engineClient.reset(new EngineClient);
+	}
+
+	MainWindow mainWindow(engineClient.get(), kiosk);
 	mainWindow.show();
+
+	// Metrics: optional HTTP endpoint on the loopback interface, and event-loop lag (measured only if the metrics
+	// are exported, and while the main window is exposed).
+	std::unique_ptr<MetricsServer> metricsServer;
+	std::unique_ptr<EventLoopMonitor> eventLoopMonitor;
+	if(ModelMain::instance().metrics_enabled()) {
+		try {
+			metricsServer.reset(new MetricsServer("127.0.0.1", static_cast<std::uint16_t>(ModelMain::instance().metrics_port())));
+			eventLoopMonitor.reset(new EventLoopMonitor(mainWindow.windowHandle()));
+		}
+		catch(std::runtime_error &err) {
+			std::cerr << err.what() << std::endl;
+		}
+	}
+
+	// Recording (`--record=<file>`) or replay of the key events.
+	try {
+		if(optionValue(argc, argv, "--record")!=nullptr) {
+			new InputRecorder(optionValue(argc, argv, "--record"), &mainWindow);
+		}
+	}
+	catch(std::exception &err) {
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+	if(replay!=nullptr) {
+
+		// The replay starts once the shortcuts are available (the keyboard and shortcut maps are loaded in the background).
+		auto connection = std::make_shared<QMetaObject::Connection>();
+		*connection = QObject::connect(&mainWindow, &MainWindow::shortcutManagerChanged, [connection, replay, &mainWindow]() {
+			QObject::disconnect(*connection);
+			try {
+				startReplay(replay, mainWindow);
+			}
+			catch(std::exception &err) {
+				std::cerr << err.what() << std::endl;
+				qApp->exit(1);
+			}
+		});
+	}
 	return app.exec();
 }
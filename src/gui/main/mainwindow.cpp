@@ -31,7 +31,11 @@
 #include <models/modelshortcutmap.h>
 #include <models/modelmain.h>
 
+#include <core/latencytrace.h>
+#include <core/taskscheduler.h>
+
 #include <gui/core/keyboardhandler.h>
+#include <gui/core/engineclient.h>
 #include <gui/widgets/bitimerwidget.h>
 #include <gui/dialogs/timecontroldialog.h>
 #include <gui/dialogs/namedialog.h>
@@ -42,22 +46,29 @@
 #include <QEvent>
 #include <QMenu>
 #include <QMessageBox>
+#include <QSocketNotifier>
 #include <QStatusBar>
 #include <QToolBar>
 #include <QToolButton>
+#include <iostream>
 
 
 // Constructor.
-MainWindow::MainWindow() : _debugDialog(nullptr)
+MainWindow::MainWindow(EngineClient *engineClient, bool kiosk) : _engineClient(engineClient), _switchArbiter(_biTimer), _kiosk(kiosk),
+	_mirroringTimeControl(false), _shortcutRefresh(0), _debugDialog(nullptr), _resetConfirmation(nullptr)
 {
 	ModelAppInfo &appInfo(ModelAppInfo::instance());
 	setWindowTitle(QString::fromStdString(appInfo.full_name()));
 	setWindowIcon(appInfo.icon());
 	qApp->installEventFilter(this);
 
-	// Low-level keyboard handler
-	_keyboardHandler = new KeyboardHandler(this);
-	connect(_keyboardHandler, &KeyboardHandler::keyPressed, this, &MainWindow::onKeyPressed);
+	// Low-level keyboard handler: enabled for the whole life of the window, and subscribed to the background events,
+	// so that the clock keeps receiving the key presses whatever the dialog on screen (see `InputHub`; only the switches
+	// are honored in that case, see `isKeyboardInBackground()`).
+	_keyboardHandler = new KeyboardHandler(this, InputHub::KEY_EVENTS | InputHub::BACKGROUND);
+	connect(_keyboardHandler, &KeyboardHandler::keyPressed , this, &MainWindow::onKeyPressed );
+	connect(_keyboardHandler, &KeyboardHandler::keyReleased, this, &MainWindow::onKeyReleased);
+	_keyboardHandler->setEnabled(true);
 
 	// Tool-bar timer.
 	_toolBarTimer = new QTimer(this);
@@ -142,13 +153,121 @@ MainWindow::MainWindow() : _debugDialog(nullptr)
 	_statusBar = statusBar();
 	model.show_status_bar.connect_changed(std::bind(&MainWindow::refreshStatusBarVisibility, this));
 	refreshStatusBarVisibility();
+	model.connect_save_failed(std::bind(&MainWindow::onConfigurationSaveFailed, this, std::placeholders::_1));
+	ModelShortcutMap::instance().connect_save_failed(std::bind(&MainWindow::onConfigurationSaveFailed, this, std::placeholders::_1));
 
-	// Load the time control
+	// Load the time control. In client mode, the time control is owned by the engine: the saved one is not sent
+	// (it would reset a running game), only the ones edited afterwards are.
 	model.time_control.connect_changed(std::bind(&MainWindow::refreshTimeControl, this));
-	refreshTimeControl();
+	if(_engineClient==nullptr) {
+		refreshTimeControl();
+	}
+	else {
+		_statusBar->showMessage(QString::fromStdString(model.time_control().description()));
+	}
 
-	// Initialize the shortcut manager.
+	// Initialize the shortcut manager (once the keyboard and shortcut maps are loaded).
 	refreshShortcutManager();
+
+	// Reload the keyboard and shortcut maps when their files are modified by another program (e.g. when a new
+	// configuration is rolled out), and update the shortcut manager accordingly. The files are reloaded
+	// once they have stopped changing for a short while.
+	_reloadTimer = new QTimer(this);
+	_reloadTimer->setInterval(250);
+	_reloadTimer->setSingleShot(true);
+	connect(_reloadTimer, &QTimer::timeout, this, &MainWindow::onReloadTimerElapsed);
+	ModelShortcutMap::instance().shortcut_map.connect_changed(std::bind(&MainWindow::refreshShortcutManager, this));
+	ModelKeyboard::instance().connect_keyboard_map_reloaded(std::bind(&MainWindow::onKeyboardMapReloaded, this, std::placeholders::_1));
+	try {
+		ModelPaths &paths(ModelPaths::instance());
+		paths.ensure_config_path_exists();
+		_fileWatcher.reset(new FileWatcher({paths.config_path(), paths.share_path(), paths.share_path() + "/keyboard-maps"}));
+		auto notifier = new QSocketNotifier(_fileWatcher->notify_fd(), QSocketNotifier::Read, this);
+		connect(notifier, &QSocketNotifier::activated, this, &MainWindow::onWatchedFilesChanged);
+	}
+	catch(std::exception &) {} // <- The files are then only read at startup.
+
+	// Export the clock state to the other local processes and to the stream subscribers on each transition
+	// (in client mode, the engine does it).
+	if(_engineClient==nullptr) {
+		try {
+			_sharedState = SharedClockState::create(SharedClockState::default_name());
+		}
+		catch(std::runtime_error &) {} // <- The export is optional (another instance may already publish its state): the clock works without it.
+		if(model.broadcast_enabled()) {
+			try {
+				_broadcastServer.reset(new BroadcastServer(model.broadcast_address(), static_cast<std::uint16_t>(model.broadcast_port())));
+				_broadcastServer->enable_discovery();
+				if(!model.time_sync_server().empty()) {
+					_timeSyncClient.reset(new TimeSyncClient(model.time_sync_server()));
+					_broadcastServer->set_time_base(_timeSyncClient.get());
+				}
+			}
+			catch(std::runtime_error &) {}
+		}
+	}
+	_biTimer.connect_state_changed(std::bind(&MainWindow::publishClockState, this));
+	model.left_player .connect_changed(std::bind(&MainWindow::onPlayerNamesChanged, this));
+	model.right_player.connect_changed(std::bind(&MainWindow::onPlayerNamesChanged, this));
+	publishClockState();
+
+	// Client mode
+	if(_engineClient!=nullptr) {
+		connect(_engineClient, &EngineClient::connected   , this, &MainWindow::onEngineConnected   );
+		connect(_engineClient, &EngineClient::disconnected, this, &MainWindow::onEngineDisconnected);
+		connect(_engineClient, &EngineClient::stateChanged, this, &MainWindow::onEngineStateChanged);
+		connect(_engineClient, &EngineClient::sidesSwapped, this, &MainWindow::onSidesSwapped      );
+		connect(_engineClient, &EngineClient::timeControlChanged, this, &MainWindow::onEngineTimeControlChanged);
+		if(_engineClient->isConnected()) {
+			onEngineConnected();
+		}
+		else {
+			onEngineDisconnected();
+		}
+	}
+
+	// Command socket (in client mode, the engine serves it).
+	else {
+		try {
+			_commandServer.reset(new CommandServer);
+			auto notifier = new QSocketNotifier(_commandServer->notify_fd(), QSocketNotifier::Read, this);
+			connect(notifier, &QSocketNotifier::activated, this, &MainWindow::onCommandsPending);
+		}
+		catch(std::runtime_error &) {} // <- Another instance may already serve the socket.
+	}
+
+	// Direct reading of the keyboards (in client mode, the engine does it). The key events are then processed
+	// whatever the active window, and the ones received through the display server are ignored.
+	if(_engineClient==nullptr && (model.evdev_enabled() || _kiosk)) {
+		try {
+			_inputRouter.set_rules(model.input_routes());
+			_evdevReader.reset(new EvdevReader(_inputRouter.devices(EvdevReader::find_keyboards())));
+			_inputRouter.bind(_evdevReader->devices());
+			auto notifier = new QSocketNotifier(_evdevReader->notify_fd(), QSocketNotifier::Read, this);
+			connect(notifier, &QSocketNotifier::activated, this, &MainWindow::onEvdevEventsPending);
+		}
+		catch(std::exception &err) { // <- Fall back on the key events received through the display server.
+			_evdevReader.reset();
+			if(_kiosk) {
+				std::cerr << "Kiosk mode: the keyboards cannot be read (" << err.what() << ")." << std::endl;
+			}
+		}
+	}
+
+	// Debounce and arbitration (in client mode, the engine does it).
+	if(_engineClient==nullptr) {
+		model.input_debounce   .connect_changed(std::bind(&MainWindow::refreshInputFilters, this));
+		model.input_arbitration.connect_changed(std::bind(&MainWindow::refreshInputFilters, this));
+		refreshInputFilters();
+	}
+
+	// Kiosk mode: nothing but the timers, full-screen from the start.
+	if(_kiosk) {
+		setWindowState(Qt::WindowFullScreen);
+		_toolBar->setVisible(false);
+		refreshStatusBarVisibility();
+		setCursor(Qt::BlankCursor);
+	}
 }
 
 
@@ -157,16 +276,22 @@ void MainWindow::closeEvent(QCloseEvent *)
 {
 	ModelMain::instance().save();
 	ModelShortcutMap::instance().save();
+
+	// Do not let the application quit before the files are written.
+	ModelMain::instance().flush();
+	ModelShortcutMap::instance().flush();
 }
 
 
-// Window state-change handler.
-void MainWindow::changeEvent(QEvent *event)
+// Generic event handler.
+bool MainWindow::event(QEvent *event)
 {
-	if(event->type()==QEvent::ActivationChange) {
-		_keyboardHandler->setEnabled(isActiveWindow());
+	// The update requests of the window repaint the dirty widgets, then flush the back-buffer to the screen.
+	bool retval = QMainWindow::event(event);
+	if(event->type()==QEvent::UpdateRequest) {
+		LatencyTrace::instance().mark(TraceStage::FLUSH);
 	}
-	QMainWindow::changeEvent(event);
+	return retval;
 }
 
 
@@ -183,7 +308,7 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
 // Triggered when the mouse is moved.
 void MainWindow::onMouseMoveEvent()
 {
-	if(!isFullScreen()) {
+	if(!isFullScreen() || _kiosk) {
 		return;
 	}
 	_toolBar->setVisible(true);
@@ -204,17 +329,102 @@ void MainWindow::onToolbarTimerElapsed()
 // Key-press event handler.
 void MainWindow::onKeyPressed(ScanCode scanCode)
 {
-	// Retrieve the shortcut that is triggered by the given scan-code, if any.
-	bool modifierKeysActivated =
-		_keyboardHandler->isDown(_shortcutManager.modifier_key(Side::LEFT )) &&
-		_keyboardHandler->isDown(_shortcutManager.modifier_key(Side::RIGHT));
+	// The keyboards are read directly from the input devices.
+	if(isEvdevEnabled()) {
+		return;
+	}
+
+	// In client mode, the shortcuts are resolved by the engine (only the switches are forwarded while the keyboard
+	// is used by something else, see `isKeyboardInBackground()`).
+	if(_engineClient!=nullptr) {
+		if(isKeyboardInBackground()) {
+			int shortcut = _shortcutManager.shortcut(scanCode, _shortcutManager.modifier_keys_activated(_keyboardHandler->keysDown()));
+			if(shortcut!=1 && shortcut!=2) {
+				return;
+			}
+		}
+		LatencyTrace::instance().begin(InputHub::instance().pressStamp());
+		_engineClient->sendKeyPressed(scanCode);
+		return;
+	}
+
+	// Debounce, arbitration and switch at the instant the system has stamped the event.
+	TimePoint at = InputHub::instance().pressTime();
+	if(_pressFilter.press(PressFilter::OTHER_DEVICE, scanCode, at)) {
+		LatencyTrace::instance().begin(InputHub::instance().pressStamp());
+		executeShortcut(scanCode, _shortcutManager.modifier_keys_activated(_keyboardHandler->keysDown()), at);
+	}
+}
+
+
+// Key-release handler.
+void MainWindow::onKeyReleased(ScanCode scanCode)
+{
+	if(isEvdevEnabled()) {
+		return;
+	}
+	if(_engineClient!=nullptr) {
+		_engineClient->sendKeyReleased(scanCode);
+	}
+	else {
+		_pressFilter.release(PressFilter::OTHER_DEVICE, scanCode, InputHub::instance().releaseTime());
+	}
+}
+
+
+// Process the key events read from the input devices.
+void MainWindow::onEvdevEventsPending()
+{
+	_evdevReader->process([this](const RawKeyEvent &event) {
+
+		// Debounce
+		TimePoint at = EvdevReader::to_time_point(event.timestamp);
+		if(!event.pressed) {
+			_pressFilter.release(event.device, event.scan_code, at);
+		}
+		else if(!_pressFilter.press(event.device, event.scan_code, at)) {
+			return;
+		}
+		else {
+			auto age = std::chrono::microseconds((current_time() - at).total_microseconds());
+			LatencyTrace::instance().begin(std::chrono::steady_clock::now() - age);
+		}
+
+		// Keys routed to a player: this window is the clock instance 0.
+		InputRoute route = _inputRouter.route(event.device, event.scan_code);
+		if(route.routed()) {
+			if(event.pressed && route.clock==0) {
+				_switchArbiter.press(route.side, at);
+			}
+			return;
+		}
+
+		if(!event.pressed) {
+			_evdevKeysDown.release(event.scan_code);
+			return;
+		}
+		_evdevKeysDown.press(event.scan_code, at);
+		executeShortcut(event.scan_code, _shortcutManager.modifier_keys_activated(_evdevKeysDown), at);
+	});
+}
+
+
+// Execute the shortcut triggered by the given scan-code, if any (the switches being applied at the instant `at`).
+void MainWindow::executeShortcut(ScanCode scanCode, bool modifierKeysActivated, const TimePoint &at)
+{
 	int shortcut = _shortcutManager.shortcut(scanCode, modifierKeysActivated);
+	LatencyTrace::instance().mark(TraceStage::SHORTCUT);
 
-	// Execute the requested actions.
+	// Only the switches are honored while the keyboard is used by something else: typing in a dialog must not
+	// pause, reset or swap the clock (the reset confirmation is bypassed here).
+	if(shortcut!=1 && shortcut!=2 && isKeyboardInBackground()) {
+		return;
+	}
+	ShortcutManager::count_key_press(shortcut);
 	switch(shortcut)
 	{
-		case 1: _biTimer.start_timer(Side::RIGHT); break;
-		case 2: _biTimer.start_timer(Side::LEFT ); break;
+		case 1: _switchArbiter.press(Side::LEFT , at); break; // <- Button of the left player: start the right timer.
+		case 2: _switchArbiter.press(Side::RIGHT, at); break;
 		case 3: _biTimer.stop_timer  (); break;
 		case 4: _biTimer.reset_timers(); break;
 		case 5: onSwapClicked(); break;
@@ -223,35 +433,161 @@ void MainWindow::onKeyPressed(ScanCode scanCode)
 }
 
 
+// Whether the keyboard is used by something else than the clock: another handler owns the focus
+// (e.g. the shortcut editor), or another window of the application is active (a dialog).
+bool MainWindow::isKeyboardInBackground() const
+{
+	KeyboardHandler *focusOwner = InputHub::instance().focusOwner();
+	QWidget *activeWindow = QApplication::activeWindow();
+	return (focusOwner!=nullptr && focusOwner!=_keyboardHandler) || (activeWindow!=nullptr && activeWindow!=this);
+}
+
+
+// Apply the debounce rules and the arbitration window defined in the preferences.
+void MainWindow::refreshInputFilters()
+{
+	ModelMain &model(ModelMain::instance());
+	try {
+		_pressFilter.set_rules(model.input_debounce());
+	}
+	catch(std::invalid_argument &) {
+		_pressFilter.set_rules(std::string());
+	}
+	_pressFilter.bind(_evdevReader ? _evdevReader->devices() : std::vector<std::string>());
+	int arbitration = model.input_arbitration();
+	_switchArbiter.set_window(boost::posix_time::milliseconds(arbitration>0 ? arbitration : 0));
+}
+
+
+// Whether the key events are read directly from the input devices (by the window, or by the engine in client mode).
+bool MainWindow::isEvdevEnabled() const
+{
+	return _engineClient!=nullptr ? ModelMain::instance().evdev_enabled() : static_cast<bool>(_evdevReader);
+}
+
+
+// Handler called when the connection with the engine is established.
+void MainWindow::onEngineConnected()
+{
+	// A running game must not be disturbed: the saved time control is neither sent here nor when the window is
+	// created (it is owned by the engine, which announces it right after the connection, see
+	// `onEngineTimeControlChanged()`; only the time controls edited by the user are sent, see `refreshTimeControl()`),
+	// and the clock state is taken from the engine.
+	_engineClient->setShortcuts(_shortcutManager);
+	onPlayerNamesChanged();
+	onEngineStateChanged();
+}
+
+
+// Handler called when the connection with the engine is lost.
+void MainWindow::onEngineDisconnected()
+{
+	_statusBar->showMessage(_("Connecting to the clock engine..."));
+}
+
+
+// Mirror the clock state published by the engine.
+void MainWindow::onEngineStateChanged()
+{
+	BiTimer::State state;
+	if(_engineClient->readState(state)) {
+		_biTimer.restore(state);
+	}
+}
+
+
+// Save the time control announced by the engine (e.g. changed through the command socket), without sending it back.
+void MainWindow::onEngineTimeControlChanged()
+{
+	ModelMain &model(ModelMain::instance());
+	if(model.time_control()==_engineClient->timeControl()) {
+		_statusBar->showMessage(QString::fromStdString(model.time_control().description()));
+		return;
+	}
+	_mirroringTimeControl = true;
+	model.time_control(_engineClient->timeControl());
+	_mirroringTimeControl = false;
+}
+
+
 // Reset button handler.
 void MainWindow::onResetClicked()
 {
 	ResetConfirmation mode = ModelMain::instance().reset_confirmation();
-	if(mode==ResetConfirmation::ALWAYS || (mode==ResetConfirmation::IF_ACTIVE && _biTimer.is_active())) {
-		auto response = QMessageBox::question(this, _("Stop this game?"), _("Do you really want to start a new game?"));
-		if(response!=QMessageBox::Yes) {
-			return;
-		}
+	if(mode==ResetConfirmation::NEVER || (mode==ResetConfirmation::IF_ACTIVE && !_biTimer.is_active())) {
+		resetTimers();
+		return;
+	}
+
+	// The confirmation does not block, and is shown without being activated: the keyboard remains grabbed
+	// by the clock (hence, a clock key cannot answer the question by accident).
+	if(_resetConfirmation==nullptr) {
+		_resetConfirmation = new QMessageBox(QMessageBox::Question, _("Stop this game?"), _("Do you really want to start a new game?"),
+			QMessageBox::Yes | QMessageBox::No, this);
+		_resetConfirmation->setDefaultButton(QMessageBox::No);
+		_resetConfirmation->setWindowModality(Qt::NonModal);
+		_resetConfirmation->setAttribute(Qt::WA_ShowWithoutActivating);
+		connect(_resetConfirmation, &QMessageBox::finished, this, &MainWindow::onResetConfirmationFinished);
+	}
+	_resetConfirmation->show();
+}
+
+
+// Answer to the reset confirmation.
+void MainWindow::onResetConfirmationFinished(int result)
+{
+	if(result==QMessageBox::Yes) {
+		resetTimers();
+	}
+}
+
+
+// Reset the timers.
+void MainWindow::resetTimers()
+{
+	if(_engineClient!=nullptr) {
+		_engineClient->resetTimers();
+	}
+	else {
+		_biTimer.reset_timers();
 	}
-	_biTimer.reset_timers();
 }
 
 
 // Pause button handler.
 void MainWindow::onPauseClicked()
 {
-	_biTimer.stop_timer();
+	if(_engineClient!=nullptr) {
+		_engineClient->stopTimer();
+	}
+	else {
+		_biTimer.stop_timer();
+	}
 }
 
 
 // Swap-sides button handler.
 void MainWindow::onSwapClicked()
+{
+	// In client mode, the engine notifies the swap back (see `onSidesSwapped()`).
+	if(_engineClient!=nullptr) {
+		_engineClient->swapSides();
+		return;
+	}
+	_biTimer.swap_sides();
+	onSidesSwapped();
+}
+
+
+// Save the swapped time control, and swap the players' names.
+void MainWindow::onSidesSwapped()
 {
 	ModelMain &model(ModelMain::instance());
 
-	// Swap the time control options.
-	_biTimer.swap_sides();
-	model.time_control(_biTimer.time_control());
+	// Save the swapped time control options (in client mode, the engine announces them, see `onEngineTimeControlChanged()`).
+	if(_engineClient==nullptr) {
+		model.time_control(_biTimer.time_control());
+	}
 
 	// Swap the players' names.
 	QString name_buffer = model.left_player();
@@ -260,6 +596,47 @@ void MainWindow::onSwapClicked()
 }
 
 
+// Export the new players' names.
+void MainWindow::onPlayerNamesChanged()
+{
+	ModelMain &model(ModelMain::instance());
+	if(_engineClient!=nullptr) {
+		_engineClient->setPlayerName(Side::LEFT , model.left_player ());
+		_engineClient->setPlayerName(Side::RIGHT, model.right_player());
+	}
+	publishClockState();
+}
+
+
+// Publish the clock state in the shared-memory segment and on the broadcast stream (standalone mode only).
+void MainWindow::publishClockState()
+{
+	if(!_sharedState && !_broadcastServer) {
+		return;
+	}
+	ModelMain &model(ModelMain::instance());
+	Enum::array<Side, std::string> names;
+	names[Side::LEFT ] = model.left_player ().toStdString();
+	names[Side::RIGHT] = model.right_player().toStdString();
+	BiTimer::State state = _biTimer.state();
+	if(_sharedState) {
+		_sharedState->publish(state, names);
+	}
+	if(_broadcastServer) {
+		_broadcastServer->publish(state, names);
+	}
+}
+
+
+// Execute the commands received on the command socket (standalone mode only).
+void MainWindow::onCommandsPending()
+{
+	_commandServer->process([this](const ClockCommand &command) {
+		return execute_clock_command(_biTimer, command, [this]() { _biTimer.swap_sides(); onSidesSwapped(); });
+	});
+}
+
+
 // Full-screen button handler.
 void MainWindow::onFlScrClicked()
 {
@@ -283,13 +660,18 @@ void MainWindow::onFlScrClicked()
 // Time control button handler.
 void MainWindow::onTCtrlClicked()
 {
-	ModelMain &model(ModelMain::instance());
-	TimeControlDialog dialog(this);
-	dialog.setTimeControl(model.time_control());
-	if(dialog.exec()!=QDialog::Accepted) {
-		return;
-	}
-	model.time_control(dialog.timeControl());
+	TimeControlDialog *dialog = new TimeControlDialog(this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->setTimeControl(ModelMain::instance().time_control());
+	connect(dialog, &QDialog::accepted, std::bind(&MainWindow::onTimeControlDialogAccepted, this, dialog));
+	dialog->open();
+}
+
+
+// Validation of the time control dialog.
+void MainWindow::onTimeControlDialogAccepted(TimeControlDialog *dialog)
+{
+	ModelMain::instance().time_control(dialog->timeControl());
 }
 
 
@@ -297,28 +679,41 @@ void MainWindow::onTCtrlClicked()
 void MainWindow::onNamesClicked()
 {
 	ModelMain &model(ModelMain::instance());
-	NameDialog dialog(this);
-	dialog.setName(Side::LEFT , model.left_player ());
-	dialog.setName(Side::RIGHT, model.right_player());
-	dialog.setDisplayNames(model.show_player_names());
-	if(dialog.exec()!=QDialog::Accepted) {
-		return;
-	}
-	model.left_player (dialog.name(Side::LEFT ));
-	model.right_player(dialog.name(Side::RIGHT));
-	model.show_player_names(dialog.displayNames());
+	NameDialog *dialog = new NameDialog(this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->setName(Side::LEFT , model.left_player ());
+	dialog->setName(Side::RIGHT, model.right_player());
+	dialog->setDisplayNames(model.show_player_names());
+	connect(dialog, &QDialog::accepted, std::bind(&MainWindow::onNameDialogAccepted, this, dialog));
+	dialog->open();
+}
+
+
+// Validation of the players' names dialog.
+void MainWindow::onNameDialogAccepted(NameDialog *dialog)
+{
+	ModelMain &model(ModelMain::instance());
+	model.left_player (dialog->name(Side::LEFT ));
+	model.right_player(dialog->name(Side::RIGHT));
+	model.show_player_names(dialog->displayNames());
 }
 
 
 // Preference button handler.
 void MainWindow::onPrefsClicked()
 {
-	PreferenceDialog dialog(this);
-	dialog.loadParameters();
-	if(dialog.exec()!=QDialog::Accepted) {
-		return;
-	}
-	dialog.saveParameters();
+	PreferenceDialog *dialog = new PreferenceDialog(this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->loadParameters();
+	connect(dialog, &QDialog::accepted, std::bind(&MainWindow::onPreferenceDialogAccepted, this, dialog));
+	dialog->open();
+}
+
+
+// Validation of the preference dialog.
+void MainWindow::onPreferenceDialogAccepted(PreferenceDialog *dialog)
+{
+	dialog->saveParameters();
 	refreshShortcutManager();
 }
 
@@ -424,11 +819,18 @@ void MainWindow::onAboutClicked()
 }
 
 
-// Refresh the time control.
+// Refresh the time control (in client mode, forward the time control edited by the user to the engine).
 void MainWindow::refreshTimeControl()
 {
 	ModelMain &model(ModelMain::instance());
-	_biTimer.set_time_control(model.time_control());
+	if(_engineClient!=nullptr) {
+		if(!_mirroringTimeControl) {
+			_engineClient->setTimeControl(model.time_control());
+		}
+	}
+	else {
+		_biTimer.set_time_control(model.time_control());
+	}
 	_statusBar->showMessage(QString::fromStdString(model.time_control().description()));
 }
 
@@ -440,12 +842,106 @@ void MainWindow::refreshStatusBarVisibility()
 }
 
 
-// Refresh the shortcut manager based on the keyboard settings.
+// Refresh the shortcut manager based on the keyboard settings. The maps are loaded in the background if necessary,
+// and the new manager is swapped in from the main thread once they are available (the key presses being resolved
+// with the current one in the meantime).
 void MainWindow::refreshShortcutManager()
 {
-	_shortcutManager.reset(
-		ModelMain::instance().modifier_keys(),
-		ModelKeyboard::instance().keyboard_map(ModelMain::instance().keyboard_id()),
-		ModelShortcutMap::instance().shortcut_map()
-	);
+	std::uint64_t request = ++_shortcutRefresh;
+	ModelKeyboard::instance().ids_async().then(MainThreadExecutor::instance(), [this, request]() {
+		if(request!=_shortcutRefresh) {
+			return; // <- Superseded by a more recent request.
+		}
+		std::string keyboardId = ModelMain::instance().keyboard_id();
+		ModelKeyboard::instance().keyboard_map_async(keyboardId).then(MainThreadExecutor::instance(),
+			[this, request, keyboardId](const KeyboardMap *keyboardMap)
+		{
+			ModelShortcutMap::instance().shortcut_map_async().then(MainThreadExecutor::instance(),
+				[this, request, keyboardId, keyboardMap](const ShortcutMap *shortcutMap)
+			{
+				if(request==_shortcutRefresh) {
+					applyShortcutManager(keyboardId, *keyboardMap, *shortcutMap);
+				}
+			});
+		});
+	});
+}
+
+
+// Swap in the shortcut manager built from the given maps.
+void MainWindow::applyShortcutManager(const std::string &keyboardId, const KeyboardMap &keyboardMap, const ShortcutMap &shortcutMap)
+{
+	ModifierKeys modifierKeys = ModelMain::instance().modifier_keys();
+
+	// The new configuration is built aside, and swapped in at once. If only the shortcut map has changed,
+	// the keys whose shortcuts are unchanged are not visited again. The timers are not affected.
+	ShortcutManager next(_shortcutManager);
+	if(keyboardId==_shortcutKeyboardId && modifierKeys==_shortcutModifierKeys) {
+		std::vector<KeyId> keys = shortcutMap.diff(_shortcutMap);
+		if(keys.empty()) {
+			return;
+		}
+		next.update(keyboardMap, shortcutMap, keys);
+	}
+	else {
+		next.reset(modifierKeys, keyboardMap, shortcutMap);
+	}
+	_shortcutManager      = next;
+	_shortcutModifierKeys = modifierKeys;
+	_shortcutKeyboardId   = keyboardId;
+	_shortcutMap          = shortcutMap;
+	if(_engineClient!=nullptr) {
+		_engineClient->setShortcuts(_shortcutManager);
+	}
+	emit shortcutManagerChanged();
+}
+
+
+// Rebuild the shortcut manager if the keyboard map in use has been reloaded (its scan-codes may have changed).
+void MainWindow::onKeyboardMapReloaded(const std::string &id)
+{
+	if(id==_shortcutKeyboardId) {
+		_shortcutKeyboardId.clear();
+		refreshShortcutManager();
+	}
+}
+
+
+// Report the failure of a write operation of the models.
+void MainWindow::onConfigurationSaveFailed(const std::string &message)
+{
+	_statusBar->showMessage(QString(_("Unable to save the configuration: %1")).arg(QString::fromStdString(message)));
+}
+
+
+// Collect the files modified by other programs (they are reloaded when the reload timer elapses).
+void MainWindow::onWatchedFilesChanged()
+{
+	for(const auto &path : _fileWatcher->changed_files()) {
+		_changedFiles.insert(path);
+	}
+	_reloadTimer->start();
+}
+
+
+// Reload the keyboard and shortcut maps whose files have been modified (in the background).
+void MainWindow::onReloadTimerElapsed()
+{
+	ModelShortcutMap &shortcutModel(ModelShortcutMap::instance());
+	std::string keyboardMapFolder = ModelPaths::instance().share_path() + "/keyboard-maps/";
+	bool shortcutMapChanged = false;
+	for(const auto &path : _changedFiles) {
+		if(path==shortcutModel.custom_shortcut_map_file() || path==shortcutModel.default_shortcut_map_file()) {
+			shortcutMapChanged = true;
+		}
+		else if(path.size()>keyboardMapFolder.size()+4 && path.compare(0, keyboardMapFolder.size(), keyboardMapFolder)==0 &&
+			path.compare(path.size()-4, 4, ".kbm")==0)
+		{
+			ModelKeyboard::instance().reload_keyboard_map(path.substr(keyboardMapFolder.size(), path.size()-keyboardMapFolder.size()-4));
+		}
+	}
+	_changedFiles.clear();
+	if(shortcutMapChanged) {
+		shortcutModel.reload(); // <- `refreshShortcutManager()` is called back if the content of the map has changed.
+	}
 }
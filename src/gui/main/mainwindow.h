@@ -27,12 +27,31 @@
 #include <QTimer>
 
 #include <core/keys.h>
+#include <core/keystate.h>
 #include <core/bitimer.h>
 #include <core/shortcutmanager.h>
+#include <core/shortcutmap.h>
+#include <core/filewatcher.h>
+#include <core/switcharbiter.h>
+#include <ipc/sharedclockstate.h>
+#include <net/broadcastserver.h>
+#include <net/timesyncclient.h>
+#include <ipc/commandserver.h>
+#include <input/evdevreader.h>
+#include <input/inputrouter.h>
+#include <input/pressfilter.h>
+#include <memory>
+#include <set>
+#include <string>
 
 class KeyboardHandler;
+class EngineClient;
 class BiTimerWidget;
 class DebugDialog;
+class TimeControlDialog;
+class NameDialog;
+class PreferenceDialog;
+class QMessageBox;
 
 
 /**
@@ -46,8 +65,32 @@ public:
 
 	/**
 	 * Constructor.
+	 *
+	 * If an engine client is provided, the window runs in client mode: the timers are owned by the clock engine,
+	 * the key events and the commands are forwarded to it, and `_biTimer` only mirrors the state it publishes.
+	 *
+	 * In kiosk mode (typically on the linuxfb platform, without display server), the window only shows the timers,
+	 * full-screen, without tool-bar, status bar nor mouse cursor, and the keyboards are read directly from the input
+	 * devices (see `EvdevReader`) whatever the `evdev_enabled` setting (in client mode, the engine reads them).
 	 */
-	MainWindow();
+	MainWindow(EngineClient *engineClient=nullptr, bool kiosk=false);
+
+	/**
+	 * Widget displaying the timers.
+	 */
+	const BiTimerWidget *biTimerWidget() const { return _biTimerWidget; }
+
+	/**
+	 * Shortcuts associated to the keys (empty until the keyboard and shortcut maps are loaded, see `shortcutManagerChanged()`).
+	 */
+	const ShortcutManager &shortcutManager() const { return _shortcutManager; }
+
+signals:
+
+	/**
+	 * Emitted when the shortcut manager has been rebuilt (the keyboard and shortcut maps are loaded in the background).
+	 */
+	void shortcutManagerChanged();
 
 protected:
 
@@ -57,9 +100,9 @@ protected:
 	void closeEvent(QCloseEvent *event) override;
 
 	/**
-	 * Window state-change handler.
+	 * Generic event handler.
 	 */
-	void changeEvent(QEvent *event) override;
+	bool event(QEvent *event) override;
 
 	/**
 	 * General event filter.
@@ -72,7 +115,26 @@ private:
 	void onMouseMoveEvent();
 	void onToolbarTimerElapsed();
 	void onKeyPressed(ScanCode scanCode);
+	void onKeyReleased(ScanCode scanCode);
+	void onEvdevEventsPending();
+	void executeShortcut(ScanCode scanCode, bool modifierKeysActivated, const TimePoint &at);
+	bool isKeyboardInBackground() const;
+	bool isEvdevEnabled() const;
+	void refreshInputFilters();
+	void onEngineConnected();
+	void onEngineDisconnected();
+	void onEngineStateChanged();
+	void onEngineTimeControlChanged();
+	void onSidesSwapped();
+	void onPlayerNamesChanged();
+	void publishClockState();
+	void onCommandsPending();
 	void onResetClicked();
+	void onResetConfirmationFinished(int result);
+	void resetTimers();
+	void onTimeControlDialogAccepted(TimeControlDialog *dialog);
+	void onNameDialogAccepted(NameDialog *dialog);
+	void onPreferenceDialogAccepted(PreferenceDialog *dialog);
 	void onPauseClicked();
 	void onSwapClicked ();
 	void onFlScrClicked();
@@ -85,19 +147,46 @@ private:
 	void refreshTimeControl();
 	void refreshStatusBarVisibility();
 	void refreshShortcutManager();
+	void applyShortcutManager(const std::string &keyboardId, const KeyboardMap &keyboardMap, const ShortcutMap &shortcutMap);
+	void onKeyboardMapReloaded(const std::string &id);
+	void onConfigurationSaveFailed(const std::string &message);
+	void onWatchedFilesChanged();
+	void onReloadTimerElapsed();
 
 	// Private members
 	KeyboardHandler  *_keyboardHandler;
+	EngineClient     *_engineClient   ;
 	QTimer           *_toolBarTimer   ;
+	QTimer           *_reloadTimer    ;
 	ShortcutManager   _shortcutManager;
 	BiTimer           _biTimer        ;
+	SwitchArbiter     _switchArbiter  ;
 	Qt::WindowStates  _previousState  ;
+	bool              _kiosk          ;
+	std::unique_ptr<SharedClockState> _sharedState;
+	std::unique_ptr<TimeSyncClient>   _timeSyncClient ;
+	std::unique_ptr<BroadcastServer>  _broadcastServer;
+	std::unique_ptr<CommandServer>    _commandServer  ;
+	std::unique_ptr<EvdevReader>      _evdevReader    ;
+	std::unique_ptr<FileWatcher>      _fileWatcher    ;
+	std::set<std::string>             _changedFiles   ; // Modified files waiting to be reloaded.
+	KeyState                          _evdevKeysDown  ;
+	InputRouter                       _inputRouter    ;
+	PressFilter                       _pressFilter    ;
+	bool                              _mirroringTimeControl; // The time control announced by the engine is being saved.
+
+	// Configuration from which the shortcut manager has been built (see `refreshShortcutManager()`).
+	ModifierKeys  _shortcutModifierKeys;
+	std::string   _shortcutKeyboardId  ;
+	ShortcutMap   _shortcutMap         ;
+	std::uint64_t _shortcutRefresh     ; // Number of refresh requests (only the last one is applied).
 
 	// Widgets
-	BiTimerWidget *_biTimerWidget;
-	QToolBar      *_toolBar      ;
-	QStatusBar    *_statusBar    ;
-	DebugDialog   *_debugDialog  ;
+	BiTimerWidget *_biTimerWidget    ;
+	QToolBar      *_toolBar          ;
+	QStatusBar    *_statusBar        ;
+	DebugDialog   *_debugDialog      ;
+	QMessageBox   *_resetConfirmation;
 };
 
 #endif /* MAINWINDOW_H_ */
@@ -28,6 +28,8 @@
 #include <models/modelshortcutmap.h>
 #include <models/modelmain.h>
 
+#include <core/taskscheduler.h>
+
 #include <gui/core/keyboardhandler.h>
 #include <gui/widgets/captionwidget.h>
 #include <gui/widgets/modifierkeyswidget.h>
@@ -44,6 +46,7 @@
 #include <QGridLayout>
 #include <QGroupBox>
 #include <QLabel>
+#include <QPointer>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QTabWidget>
@@ -131,16 +134,28 @@ QWidget *PreferenceDialog::createKeyboardPage()
 	_shortcutModeSelector->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 	connect(_shortcutModeSelector, &QPushButton::toggled, this, &PreferenceDialog::onShortcutModeChanged);
 
+	// Undo/redo buttons
+	_undoButton = new QPushButton(_("Undo"), this);
+	_redoButton = new QPushButton(_("Redo"), this);
+	connect(_undoButton, &QPushButton::clicked, this, &PreferenceDialog::onUndoClicked);
+	connect(_redoButton, &QPushButton::clicked, this, &PreferenceDialog::onRedoClicked);
+	QVBoxLayout *historyLayout = new QVBoxLayout;
+	historyLayout->addWidget(_undoButton);
+	historyLayout->addWidget(_redoButton);
+	historyLayout->addStretch(1);
+
 	// Layout for the captions and the modifier keys toggle
 	QHBoxLayout *bottomLayout = new QHBoxLayout;
 	bottomLayout->addLayout(captionLayout        , 5);
 	bottomLayout->addWidget(_shortcutModeSelector, 2);
+	bottomLayout->addLayout(historyLayout           );
 	layout->addLayout(bottomLayout);
 
 	// Ensure that the widget's states are coherent.
 	onHasNumericKeypadToggled();
 	onModifierKeysChanged    ();
 	onShortcutModeChanged    ();
+	refreshHistoryButtons    ();
 
 	// Tool-tips
 	_keyboardWidget->setToolTip(QString("<p><b>%1</b></p><p>%2</p><p>%3</p>")
@@ -329,7 +344,14 @@ std::string PreferenceDialog::retrieveSelectedKeyboard() const
 // Action performed when the selected item in the keyboard selector combo-box changes.
 void PreferenceDialog::onSelectedKeyboardChanged()
 {
-	_keyboardWidget->bindKeyboardMap(ModelKeyboard::instance().keyboard_map(retrieveSelectedKeyboard()));
+	// The keyboard map is loaded in the background; it is bound only if the selection has not changed in the meantime.
+	std::string id = retrieveSelectedKeyboard();
+	QPointer<PreferenceDialog> self(this);
+	ModelKeyboard::instance().keyboard_map_async(id).then(MainThreadExecutor::instance(), [self, id](const KeyboardMap *keyboardMap) {
+		if(self && self->retrieveSelectedKeyboard()==id) {
+			self->_keyboardWidget->bindKeyboardMap(*keyboardMap);
+		}
+	});
 }
 
 
@@ -380,7 +402,7 @@ void PreferenceDialog::onCaptionToggled(CaptionWidget *widget, int shortcut)
 
 
 // Action performed when the user clicks on the graphic representation of a key in the keyboard widget.
-void PreferenceDialog::onKeyClicked(const std::string &id, Qt::MouseButton button)
+void PreferenceDialog::onKeyClicked(KeyId id, Qt::MouseButton button)
 {
 	// Nothing to do if no caption is selected or if it was not the left button.
 	if(_selectedShortcut==0 || button!=Qt::LeftButton) {
@@ -391,8 +413,46 @@ void PreferenceDialog::onKeyClicked(const std::string &id, Qt::MouseButton butto
 	bool useShortcutHigh = _shortcutModeSelector->isChecked();
 	int  currentShortcut = _shortcutMap.shortcut(id, useShortcutHigh);
 
-	// Update the shortcut associated to the key.
+	// Update the shortcut associated to the key, keeping the previous version of the map in the history
+	// (this is cheap, as both versions share all the keys but the modified one).
+	_undoHistory.push_back(_shortcutMap);
+	_redoHistory.clear();
 	_shortcutMap.set_shortcut(id, useShortcutHigh, currentShortcut==_selectedShortcut ? 0 : _selectedShortcut);
+	refreshHistoryButtons();
+}
+
+
+// Go back to the previous version of the shortcut map.
+void PreferenceDialog::onUndoClicked()
+{
+	if(_undoHistory.empty()) {
+		return;
+	}
+	_redoHistory.push_back(_shortcutMap);
+	_shortcutMap = _undoHistory.back();
+	_undoHistory.pop_back();
+	refreshHistoryButtons();
+}
+
+
+// Re-apply the last undone modification of the shortcut map.
+void PreferenceDialog::onRedoClicked()
+{
+	if(_redoHistory.empty()) {
+		return;
+	}
+	_undoHistory.push_back(_shortcutMap);
+	_shortcutMap = _redoHistory.back();
+	_redoHistory.pop_back();
+	refreshHistoryButtons();
+}
+
+
+// Enable the undo/redo buttons depending on the state of the history.
+void PreferenceDialog::refreshHistoryButtons()
+{
+	_undoButton->setEnabled(!_undoHistory.empty());
+	_redoButton->setEnabled(!_redoHistory.empty());
 }
 
 
@@ -406,6 +466,9 @@ void PreferenceDialog::loadParameters()
 	_modifierKeysSelector->setModifierKeys(model.modifier_keys              ());
 	_hasNumericKeypad    ->setChecked     (model.keyboard_has_numeric_keypad());
 	_shortcutMap = ModelShortcutMap::instance().shortcut_map();
+	_undoHistory.clear();
+	_redoHistory.clear();
+	refreshHistoryButtons();
 
 	// Time display page
 	_delayBeforeDisplaySeconds->setValue  (model.delay_before_display_seconds());
@@ -428,7 +491,9 @@ void PreferenceDialog::saveParameters()
 	model.keyboard_id(retrieveSelectedKeyboard());
 	model.modifier_keys              (_modifierKeysSelector->modifierKeys());
 	model.keyboard_has_numeric_keypad(_hasNumericKeypad    ->isChecked   ());
-	ModelShortcutMap::instance().shortcut_map(_shortcutMap);
+	if(!_shortcutMap.diff(ModelShortcutMap::instance().shortcut_map()).empty()) {
+		ModelShortcutMap::instance().shortcut_map(_shortcutMap); // <- Only rewritten if some key has actually changed.
+	}
 
 	// Time display page
 	model.delay_before_display_seconds(_delayBeforeDisplaySeconds->value    ());
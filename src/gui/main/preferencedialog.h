@@ -27,6 +27,7 @@
 
 #include <core/options.h>
 #include <core/shortcutmap.h>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 	class QTabWidget;
@@ -89,7 +90,10 @@ private:
 	void onModifierKeysChanged    ();
 	void onShortcutModeChanged    ();
 	void onCaptionToggled(CaptionWidget *widget, int shortcut);
-	void onKeyClicked(const std::string &id, Qt::MouseButton button);
+	void onKeyClicked(KeyId id, Qt::MouseButton button);
+	void onUndoClicked();
+	void onRedoClicked();
+	void refreshHistoryButtons();
 
 	// Tab widget
 	QTabWidget *_tabWidget;
@@ -105,6 +109,12 @@ private:
 	int                 _selectedShortcut    ;
 	ModifierKeysWidget *_modifierKeysSelector;
 	QPushButton        *_shortcutModeSelector;
+	QPushButton        *_undoButton          ;
+	QPushButton        *_redoButton          ;
+
+	// Edit history of the shortcut map (most recent versions last)
+	std::vector<ShortcutMap> _undoHistory;
+	std::vector<ShortcutMap> _redoHistory;
 
 	// Time display page
 	TimeDurationWidget *_delayBeforeDisplaySeconds;
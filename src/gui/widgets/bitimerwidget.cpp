@@ -21,25 +21,50 @@
 
 
 #include "bitimerwidget.h"
+#include <core/metrics.h>
+#include <core/latencytrace.h>
 #include <wrappers/translation.h>
 #include <QPainter>
 #include <QTimer>
+#include <QWindow>
+#include <cstdint>
 #include <cstdlib>
 #include <algorithm>
 #include <cmath>
 #include <functional>
 
 
+// Longest interval between two repaints while a timer is running (even if the displayed texts do not change).
+static const std::int64_t MAX_REPAINT_INTERVAL = 3600 * 1000000LL;
+
+
+// Nearest value of a duration (in microseconds) at which the number of seconds obtained by rounding it
+// (see `to_seconds()`) reaches `k`, coming from below if `increasing`, from above otherwise.
+static std::int64_t roundingBoundary(long k, bool increasing)
+{
+	static const std::int64_t SECOND   = 1000000;
+	static const std::int64_t POSITIVE =  500000; // <- to_seconds(u)>=k+1 iff u>=k*SECOND+POSITIVE (for u>=0).
+	static const std::int64_t NEGATIVE =  501000; // <- to_seconds(u)<=-k-1 iff u<=-k*SECOND-NEGATIVE (for u<0).
+	if(increasing) {
+		return k>=1 ? (k-1)*SECOND + POSITIVE : k*SECOND - NEGATIVE + 1;
+	}
+	else {
+		return k>=0 ? k*SECOND + POSITIVE - 1 : (k+1)*SECOND - NEGATIVE;
+	}
+}
+
+
 // Constructor.
 BiTimerWidget::BiTimerWidget(QWidget *parent) : QWidget(parent), _biTimer(nullptr),
 	_showLabels(false), _delayBeforeDisplaySeconds(from_seconds(3600)),
 	_displayTimeAfterTimeout(true), _displayBronsteinExtraInfo(true), _displayByoYomiExtraInfo(true),
 	_painter(nullptr)
 {
+	_window = nullptr;
 	_timer = new QTimer(this);
-	_timer->setInterval(100);
+	_timer->setSingleShot(true);
+	_timer->setTimerType(Qt::PreciseTimer);
 	connect(_timer, &QTimer::timeout, this, &BiTimerWidget::onTimeoutEvent);
-	_timer->start();
 }
 
 
@@ -66,7 +91,7 @@ void BiTimerWidget::bindTimer(const BiTimer &biTimer)
 	_biTimer = &biTimer;
 
 	// Refresh the widget.
-	update();
+	refresh();
 }
 
 
@@ -81,7 +106,7 @@ void BiTimerWidget::unbindTimer()
 	// Otherwise, disconnect the timer and refresh the widget.
 	_connection.reset();
 	_biTimer = nullptr;
-	update();
+	refresh();
 }
 
 
@@ -105,7 +130,7 @@ void BiTimerWidget::setShowLabels(bool value)
 void BiTimerWidget::setDelayBeforeDisplaySeconds(const TimeDuration &value)
 {
 	_delayBeforeDisplaySeconds = value;
-	update();
+	refresh();
 }
 
 
@@ -113,7 +138,7 @@ void BiTimerWidget::setDelayBeforeDisplaySeconds(const TimeDuration &value)
 void BiTimerWidget::setDisplayTimeAfterTimeout(bool value)
 {
 	_displayTimeAfterTimeout = value;
-	update();
+	refresh();
 }
 
 
@@ -121,7 +146,7 @@ void BiTimerWidget::setDisplayTimeAfterTimeout(bool value)
 void BiTimerWidget::setDisplayBronsteinExtraInfo(bool value)
 {
 	_displayBronsteinExtraInfo = value;
-	update();
+	refresh();
 }
 
 
@@ -129,7 +154,7 @@ void BiTimerWidget::setDisplayBronsteinExtraInfo(bool value)
 void BiTimerWidget::setDisplayByoYomiExtraInfo(bool value)
 {
 	_displayByoYomiExtraInfo = value;
-	update();
+	refresh();
 }
 
 
@@ -141,23 +166,233 @@ QSize BiTimerWidget::sizeHint       () const { return QSize(800, 300); }
 // Handler for the timer state-change event.
 void BiTimerWidget::onTimerStateChanged()
 {
+	LatencyTrace &trace(LatencyTrace::instance());
+	trace.mark(TraceStage::SWITCH);
 	update();
+	trace.mark(TraceStage::UPDATE);
+	scheduleRepaint(current_time());
 }
 
 
-// Handler periodically called by the internal QTimer object.
+// Handler called by the internal QTimer object when the displayed texts are expected to change.
 void BiTimerWidget::onTimeoutEvent()
 {
-	if(_biTimer==nullptr || !_biTimer->is_active()) {
+	static const Metrics::Counter wakeups = Metrics::instance().counter("vcc_timer_widget_wakeups_total",
+		"Wake-ups of the repaint timer of the timer widget.");
+	wakeups.increment();
+
+	// The widget is not repainted if the timer elapses before the change (e.g. because the system clock has been
+	// adjusted in the meantime), so that the same texts are never drawn twice.
+	if(_biTimer==nullptr) {
 		return;
 	}
+	TimePoint now = current_time();
+	if(display(now)!=_displayed) {
+		update();
+	}
+	scheduleRepaint(now);
+}
+
+
+// Repaint the widget, and schedule the next repaint again.
+void BiTimerWidget::refresh()
+{
 	update();
+	scheduleRepaint(current_time());
+}
+
+
+// Schedule the next repaint at the instant at which the displayed texts change, if some timer is running
+// and the widget is on screen.
+void BiTimerWidget::scheduleRepaint(const TimePoint &now)
+{
+	if(_biTimer==nullptr || !_biTimer->is_active() || !isOnScreen()) {
+		_timer->stop();
+		return;
+	}
+	std::int64_t delay = (nextDisplayChange(now) - now).total_microseconds();
+	_timer->start(static_cast<int>(std::max<std::int64_t>(1, (delay + 999) / 1000))); // <- Rounded up to the next millisecond.
+}
+
+
+// Whether the widget is actually visible on screen (neither hidden, nor minimized, nor occluded).
+bool BiTimerWidget::isOnScreen() const
+{
+	return isVisible() && _window!=nullptr && _window->isExposed();
+}
+
+
+// First instant after `now` at which the displayed texts change (or at most `MAX_REPAINT_INTERVAL` after `now`).
+// The durations displayed for a side all evolve with its timer, so the delay before each of its texts changes
+// follows from the current value of the duration it shows, and from the display mode of this duration.
+TimePoint BiTimerWidget::nextDisplayChange(const TimePoint &now) const
+{
+	std::int64_t delay = MAX_REPAINT_INTERVAL;
+	for(auto it=Enum::cursor<Side>::first(); it.valid(); ++it) {
+		Timer::Mode mode = _biTimer->timer_mode(*it);
+		if(mode==Timer::Mode::PAUSED) {
+			continue;
+		}
+		bool increasing = mode==Timer::Mode::INCREMENT;
+		BiTimer::TimeInfo info = _biTimer->detailed_time(*it, now);
+		std::int64_t tt = info.total_time.total_microseconds();
+
+		// Flag down: only the elapsed time since the timeout changes, if it is displayed (and the flag itself,
+		// if the time goes back above zero).
+		if(tt<0) {
+			if(increasing) {
+				delay = std::min(delay, -tt);
+			}
+			if(_displayTimeAfterTimeout) {
+				delay = std::min(delay, textChangeDelay(tt, increasing));
+			}
+			continue;
+		}
+		if(!increasing) {
+			delay = std::min(delay, tt + 1);
+		}
+
+		// Bronstein: the main time is frozen while the Bronstein time runs out, then "Main time" is displayed.
+		if(_biTimer->time_control().mode()==TimeControl::Mode::BRONSTEIN && _displayBronsteinExtraInfo &&
+			info.bronstein_time>TIME_DURATION_ZERO)
+		{
+			std::int64_t bt = info.bronstein_time.total_microseconds();
+			delay = std::min(delay, textChangeDelay(bt, increasing));
+			if(!increasing) {
+				delay = std::min(delay, bt);
+			}
+		}
+
+		// Byo-yomi: the main time is the time left in the current period, and the next period begins when it runs out.
+		else if(_biTimer->time_control().mode()==TimeControl::Mode::BYO_YOMI && _displayByoYomiExtraInfo) {
+			std::int64_t mt = info.main_time.total_microseconds();
+			delay = std::min(delay, textChangeDelay(mt, increasing));
+			if(!increasing && mt>0) {
+				delay = std::min(delay, mt);
+			}
+		}
+
+		// Otherwise, the total time is displayed (it is also the main time displayed in Bronstein mode, once
+		// the Bronstein time has run out).
+		else {
+			delay = std::min(delay, textChangeDelay(tt, increasing));
+		}
+	}
+	return now + boost::posix_time::microseconds(std::max<std::int64_t>(1, delay));
+}
+
+
+// Delay (in microseconds) before the text representing a duration (see `timeDurationAsString()`), currently
+// equal to `value`, changes: at the next second while the seconds are displayed, at the next minute otherwise
+// (or when the seconds start being displayed).
+std::int64_t BiTimerWidget::textChangeDelay(std::int64_t value, bool increasing) const
+{
+	long seconds   = to_seconds(TimeDuration(boost::posix_time::microseconds(value)));
+	long magnitude = std::abs(seconds);
+	long threshold = to_seconds(_delayBeforeDisplaySeconds);
+	long target    = 0;
+	if(magnitude<threshold) {
+		target = increasing ? seconds+1 : seconds-1;
+	}
+	else if(seconds==0 || (seconds>0)==increasing) {
+		target = (magnitude/60 + 1) * 60;
+		target = (seconds>0 || (seconds==0 && increasing)) ? target : -target;
+	}
+	else {
+		target = std::max<long>(0, std::max(magnitude/60*60 - 1, threshold - 1));
+		target = seconds>0 ? target : -target;
+	}
+	return std::abs(roundingBoundary(target, increasing) - value);
+}
+
+
+// Texts displayed for each side at the given instant.
+BiTimerWidget::Display BiTimerWidget::display(const TimePoint &at) const
+{
+	Display retval;
+	for(auto it=Enum::cursor<Side>::first(); it.valid(); ++it) {
+		BiTimer::TimeInfo info = _biTimer->detailed_time(*it, at);
+		bool isNegative = info.total_time<TIME_DURATION_ZERO;
+		retval.isNegative[*it] = isNegative;
+		if(isNegative) {
+			retval.mainText [*it] = _("Flag down");
+			retval.extraText[*it] = _displayTimeAfterTimeout ? QString(_("Since: %1")).arg(timeDurationAsString(info.total_time)) : "";
+		}
+		else if(_biTimer->time_control().mode()==TimeControl::Mode::BRONSTEIN && _displayBronsteinExtraInfo) {
+			retval.mainText [*it] = timeDurationAsString(info.main_time);
+			retval.extraText[*it] = info.bronstein_time<=TIME_DURATION_ZERO ? _("Main time") : timeDurationAsString(info.bronstein_time);
+		}
+		else if(_biTimer->time_control().mode()==TimeControl::Mode::BYO_YOMI && _displayByoYomiExtraInfo) {
+			retval.mainText [*it] = timeDurationAsString(info.main_time);
+			retval.extraText[*it] = info.current_byo_period<=0 ? _("Main time") : (info.total_byo_periods==1 ? _("Byo-yomi period") :
+				QString(_("Byo-yomi period %1/%2")).arg(info.current_byo_period).arg(info.total_byo_periods));
+		}
+		else {
+			retval.mainText [*it] = timeDurationAsString(info.total_time);
+			retval.extraText[*it] = "";
+		}
+	}
+	return retval;
+}
+
+
+// Comparison of the displayed texts.
+bool BiTimerWidget::Display::operator==(const Display &op) const
+{
+	for(auto it=Enum::cursor<Side>::first(); it.valid(); ++it) {
+		if(mainText[*it]!=op.mainText[*it] || extraText[*it]!=op.extraText[*it]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Show event handler.
+void BiTimerWidget::showEvent(QShowEvent *event)
+{
+	// Follow the exposure of the window (the native window is created when it is first shown).
+	QWindow *handle = window()->windowHandle();
+	if(handle!=_window) {
+		if(_window!=nullptr) {
+			_window->removeEventFilter(this);
+		}
+		_window = handle;
+		if(_window!=nullptr) {
+			_window->installEventFilter(this);
+		}
+	}
+	QWidget::showEvent(event);
+	refresh();
+}
+
+
+// Hide event handler.
+void BiTimerWidget::hideEvent(QHideEvent *event)
+{
+	QWidget::hideEvent(event);
+	_timer->stop();
+}
+
+
+// Event filter: suspend the repaints while the window is minimized or occluded, and resume them when it is exposed.
+bool BiTimerWidget::eventFilter(QObject *object, QEvent *event)
+{
+	if(object==_window && event->type()==QEvent::Expose && _window->isExposed()!=_timer->isActive()) {
+		refresh();
+	}
+	return QWidget::eventFilter(object, event);
 }
 
 
 // Widget rendering method.
 void BiTimerWidget::paintEvent(QPaintEvent *)
 {
+	static const Metrics::Histogram paintDuration = Metrics::instance().histogram("vcc_paint_duration_seconds",
+		"Duration of the repaints of the timer widget.");
+	Metrics::ScopedTimer paintTimer(paintDuration);
+	LatencyTrace::instance().mark(TraceStage::PAINT_BEGIN);
+
 	// Create the painter object.
 	QPainter painter(this);
 	painter.setRenderHint(QPainter::Antialiasing, true);
@@ -192,34 +427,17 @@ void BiTimerWidget::paintEvent(QPaintEvent *)
 	// Color to use for the text.
 	Enum::array<Side, QColor> textColor;
 
+	// Texts to show in the main field and the bottom field (remembered, so that the next repaint is skipped
+	// if they do not change).
+	_displayed = display(current_time());
+
 	// Time rendering.
 	for(auto it=Enum::cursor<Side>::first(); it.valid(); ++it) {
-		BiTimer::TimeInfo info = _biTimer->detailed_time(*it);
-		bool isNegative = info.total_time<TIME_DURATION_ZERO;
+		const QString &mainText (_displayed.mainText [*it]);
+		const QString &extraText(_displayed.extraText[*it]);
 
 		// Color to use for the text.
-		textColor[*it] = isNegative ? QColor(208,0,0) : Qt::black;
-
-		// Text to show in the main field and the bottom field.
-		QString mainText ;
-		QString extraText;
-		if(isNegative) {
-			mainText  = _("Flag down");
-			extraText = _displayTimeAfterTimeout ? QString(_("Since: %1")).arg(timeDurationAsString(info.total_time)) : "";
-		}
-		else if(_biTimer->time_control().mode()==TimeControl::Mode::BRONSTEIN && _displayBronsteinExtraInfo) {
-			mainText  = timeDurationAsString(info.main_time);
-			extraText = info.bronstein_time<=TIME_DURATION_ZERO ? _("Main time") : timeDurationAsString(info.bronstein_time);
-		}
-		else if(_biTimer->time_control().mode()==TimeControl::Mode::BYO_YOMI && _displayByoYomiExtraInfo) {
-			mainText  = timeDurationAsString(info.main_time);
-			extraText = info.current_byo_period<=0 ? _("Main time") : (info.total_byo_periods==1 ? _("Byo-yomi period") :
-				QString(_("Byo-yomi period %1/%2")).arg(info.current_byo_period).arg(info.total_byo_periods));
-		}
-		else {
-			mainText  = timeDurationAsString(info.total_time);
-			extraText = "";
-		}
+		textColor[*it] = _displayed.isNegative[*it] ? QColor(208,0,0) : Qt::black;
 
 		// Text rendering.
 		_painter->setPen(textColor[*it]);
@@ -253,6 +471,9 @@ void BiTimerWidget::paintEvent(QPaintEvent *)
 			_painter->drawText(QRectF(x[*it]+w[*it]*0.05, y+15, w[*it]*0.9, h*0.1), Qt::AlignCenter, _label[*it]);
 		}
 	}
+
+	LatencyTrace::instance().mark(TraceStage::PAINT_END);
+	emit painted();
 }
 
 
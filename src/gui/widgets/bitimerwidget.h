@@ -24,17 +24,23 @@
 #define BITIMERWIDGET_H_
 
 #include <QWidget>
+#include <cstdint>
 #include <memory>
 #include <core/bitimer.h>
 
 QT_BEGIN_NAMESPACE
 	class QTimer;
 	class QPainter;
+	class QWindow;
 QT_END_NAMESPACE
 
 
 /**
  * Display a BiTimer object.
+ *
+ * While a timer is running, the widget is not repainted periodically: the next repaint is scheduled (with a precise
+ * timer) at the instant at which the displayed texts change, i.e. once a second, or once a minute when the seconds
+ * are not displayed. Nothing is scheduled while the widget is hidden, or while its window is minimized or occluded.
  */
 class BiTimerWidget : public QWidget
 {
@@ -136,6 +142,13 @@ public:
 	QSize sizeHint() const override;
 	/**@} */
 
+signals:
+
+	/**
+	 * Signal emitted each time the timers have been repainted.
+	 */
+	void painted();
+
 protected:
 
 	/**
@@ -143,12 +156,43 @@ protected:
 	 */
 	void paintEvent(QPaintEvent *event) override;
 
+	/**
+	 * Show event handler.
+	 */
+	void showEvent(QShowEvent *event) override;
+
+	/**
+	 * Hide event handler.
+	 */
+	void hideEvent(QHideEvent *event) override;
+
+	/**
+	 * Event filter (exposure of the window).
+	 */
+	bool eventFilter(QObject *object, QEvent *event) override;
+
 private:
 
+	// Texts displayed for each side.
+	struct Display
+	{
+		Enum::array<Side, QString> mainText  ;
+		Enum::array<Side, QString> extraText ;
+		Enum::array<Side, bool   > isNegative;
+		bool operator==(const Display &op) const;
+		bool operator!=(const Display &op) const { return !(*this==op); }
+	};
+
 	// Private functions
 	void ensureTimerBinded() const;
 	void onTimerStateChanged();
 	void onTimeoutEvent();
+	void refresh();
+	void scheduleRepaint(const TimePoint &now);
+	bool isOnScreen() const;
+	Display display(const TimePoint &at) const;
+	TimePoint nextDisplayChange(const TimePoint &now) const;
+	std::int64_t textChangeDelay(std::int64_t value, bool increasing) const;
 	void drawText(double x, double y, double w, double h, Qt::Alignment flags, const QString &text);
 	void applyFontFactor(double factor);
 	double computeFontFactor(double w, double h, const QString &text) const;
@@ -159,6 +203,8 @@ private:
 	QTimer                                 *_timer     ;
 	const BiTimer                          *_biTimer   ;
 	Enum::array<Side, QString>              _label     ;
+	QWindow                                *_window    ; // Window whose exposure is followed.
+	Display                                 _displayed ; // Texts drawn by the last repaint.
 	bool         _showLabels               ;
 	TimeDuration _delayBeforeDisplaySeconds;
 	bool         _displayTimeAfterTimeout  ;
@@ -268,12 +268,7 @@ void KeyboardWidget::paintEvent(QPaintEvent *)
 // Whether the given key is a modifier key.
 bool KeyboardWidget::isModifierKey(const KeyboardMap::KeyDescriptor &key) const
 {
-	switch(_modifierKeys) {
-		case ModifierKeys::DOUBLE_CTRL : return key.id()=="ctrl-left"  || key.id()=="ctrl-right" ;
-		case ModifierKeys::DOUBLE_SHIFT: return key.id()=="shift-left" || key.id()=="shift-right";
-		case ModifierKeys::DOUBLE_ALT  : return key.id()=="alt-left"   || key.id()=="alt-right"  ;
-		default: return false;
-	}
+	return key.id()==modifier_key_id(_modifierKeys, Side::LEFT) || key.id()==modifier_key_id(_modifierKeys, Side::RIGHT);
 }
 
 
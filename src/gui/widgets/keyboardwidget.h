@@ -157,7 +157,7 @@ signals:
 	/**
 	 * Signal triggered when the user clicks on the graphic representation of a key.
 	 */
-	void keyClicked(const std::string &id, Qt::MouseButton button);
+	void keyClicked(KeyId id, Qt::MouseButton button);
 
 protected:
 
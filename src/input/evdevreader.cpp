@@ -0,0 +1,367 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "evdevreader.h"
+#include <core/metrics.h>
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+// Offset between the evdev key codes and the scan-codes reported by the X server.
+static const ScanCode EVDEV_SCAN_CODE_OFFSET = 8;
+
+
+// Current time, on the time base of the kernel timestamps (us since the Unix epoch).
+static std::int64_t kernel_now()
+{
+	timeval now;
+	gettimeofday(&now, nullptr);
+	return static_cast<std::int64_t>(now.tv_sec)*1000000 + now.tv_usec;
+}
+
+
+// Check whether the device behind the given descriptor has keyboard keys.
+static bool is_keyboard(int fd)
+{
+	unsigned char bits[(KEY_MAX+7)/8];
+	std::memset(bits, 0, sizeof(bits));
+	if(ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(bits)), bits)<0) {
+		return false;
+	}
+	for(int code=KEY_ESC; code<BTN_MISC; ++code) { // <- Mouse and joystick buttons are not keys.
+		if(bits[code/8] & (1 << (code%8))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// List the keyboards of the system.
+std::vector<std::string> EvdevReader::find_keyboards()
+{
+	std::vector<std::string> retval;
+	DIR *directory = opendir("/dev/input");
+	if(directory==nullptr) {
+		return retval;
+	}
+	while(dirent *entry = readdir(directory)) {
+		if(std::strncmp(entry->d_name, "event", 5)!=0) {
+			continue;
+		}
+		std::string path = std::string("/dev/input/") + entry->d_name;
+		int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if(fd>=0) {
+			if(is_keyboard(fd)) {
+				retval.push_back(path);
+			}
+			close(fd);
+		}
+	}
+	closedir(directory);
+	std::sort(retval.begin(), retval.end());
+	return retval;
+}
+
+
+// Constructor.
+EvdevReader::EvdevReader(const std::vector<std::string> &devices) :
+	_held(0), _notify_fd(-1), _stop_fd(-1), _epoll_fd(-1), _dropped(0)
+{
+	static_assert(KEY_CNT<=KEY_CODE_COUNT, "Unexpected number of evdev key codes.");
+
+	// Devices
+	for(const std::string &path : devices.empty() ? find_keyboards() : devices) {
+		int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if(fd>=0) {
+			struct stat status;
+			_paths.push_back(path);
+			_fds  .push_back(fd  );
+			_fifos.push_back(fstat(fd, &status)==0 && S_ISFIFO(status.st_mode));
+		}
+	}
+	_partial  .resize(_fds.size());
+	_keys_down.resize(_fds.size());
+	_resyncing.resize(_fds.size(), false);
+
+	// Event loop
+	_notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_stop_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_epoll_fd  = epoll_create1(EPOLL_CLOEXEC);
+	if(_fds.empty() || _notify_fd<0 || _stop_fd<0 || _epoll_fd<0) {
+		for(int fd : _fds) {
+			close(fd);
+		}
+		for(int fd : {_notify_fd, _stop_fd, _epoll_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw std::runtime_error(_fds.empty() ? "No readable input device." : "Unable to create the input event loop.");
+	}
+	epoll_event event;
+	event.events   = EPOLLIN;
+	event.data.u64 = _fds.size(); // <- Index past the devices: stop request.
+	epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _stop_fd, &event);
+	for(std::size_t k=0; k<_fds.size(); ++k) {
+		event.data.u64 = k;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _fds[k], &event);
+	}
+
+	_thread = std::thread(&EvdevReader::run, this);
+}
+
+
+// Destructor.
+EvdevReader::~EvdevReader()
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_stop_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+	for(int fd : _fds) {
+		if(fd>=0) {
+			close(fd);
+		}
+	}
+	close(_notify_fd);
+	close(_stop_fd);
+	close(_epoll_fd);
+}
+
+
+// Process the pending events.
+std::size_t EvdevReader::process(const std::function<void(const RawKeyEvent &)> &handler)
+{
+	// Finer buckets than the default ones, as the quantiles of this histogram are compared with and without the real-time mode.
+	static const std::vector<double> delivery_bounds{1e-5, 2e-5, 5e-5, 1e-4, 2e-4, 5e-4, 1e-3, 2e-3, 5e-3, 1e-2, 2e-2, 5e-2, 1e-1, 1.0};
+	static const Metrics::Histogram delivery = Metrics::instance().histogram("vcc_evdev_delivery_seconds",
+		"Delay between the kernel timestamp of a key event and its processing by the clock.", "", delivery_bounds);
+
+	std::uint64_t buffer;
+	ssize_t ignored = read(_notify_fd, &buffer, sizeof(buffer));
+	(void)ignored;
+
+	std::size_t retval = 0;
+	RawKeyEvent event;
+	while(_queue.pop(event)) {
+		delivery.observe((kernel_now() - event.timestamp) * 1e-6);
+		handler(event);
+		++retval;
+	}
+	return retval;
+}
+
+
+// Convert a kernel timestamp to a time point.
+TimePoint EvdevReader::to_time_point(std::int64_t timestamp)
+{
+	// The kernel stamps the events with CLOCK_REALTIME, while `current_time()` is the local time: convert the age of the event.
+	TimePoint    retval = current_time();
+	std::int64_t age    = kernel_now() - timestamp;
+	return age>0 ? retval - boost::posix_time::microseconds(age) : retval;
+}
+
+
+// Event loop of the reader thread.
+void EvdevReader::run()
+{
+	epoll_event events[16];
+	while(true) {
+		int count = epoll_wait(_epoll_fd, events, 16, -1);
+		for(int k=0; k<count; ++k) {
+			if(events[k].data.u64>=_fds.size()) {
+				return;
+			}
+			read_device(static_cast<std::uint32_t>(events[k].data.u64));
+		}
+	}
+}
+
+
+// Read the events available on a device.
+void EvdevReader::read_device(std::uint32_t index)
+{
+	static const Metrics::Counter dropped = Metrics::instance().counter("vcc_evdev_dropped_total",
+		"Key presses dropped because the clock did not consume them fast enough.");
+
+	bool pushed = false;
+	while(true) {
+
+		// A named pipe may deliver a part of an event: it is kept until the rest is received.
+		char        buffer[64*sizeof(input_event)];
+		std::string &partial(_partial[index]);
+		std::memcpy(buffer, partial.data(), partial.size());
+		ssize_t received = read(_fds[index], buffer + partial.size(), sizeof(buffer) - partial.size());
+		if(received<=0) {
+			if(received==0 || (errno!=EAGAIN && errno!=EINTR)) { // <- The device has been unplugged (or the writer has closed the pipe).
+				pushed = release_keys(index, kernel_now(), KeyBits()) || pushed;
+				epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _fds[index], nullptr);
+				close(_fds[index]);
+				_fds[index] = _fifos[index] ? open(_paths[index].c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC) : -1;
+				partial.clear();
+				if(_fds[index]>=0) {
+					epoll_event event;
+					event.events   = EPOLLIN;
+					event.data.u64 = index;
+					epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _fds[index], &event);
+				}
+			}
+			break;
+		}
+		std::size_t size  = partial.size() + received;
+		std::size_t count = size / sizeof(input_event);
+		partial.assign(buffer + count*sizeof(input_event), size - count*sizeof(input_event));
+		for(std::size_t k=0; k<count; ++k) {
+			input_event it;
+			std::memcpy(&it, buffer + k*sizeof(input_event), sizeof(input_event));
+			std::int64_t timestamp = static_cast<std::int64_t>(it.input_event_sec)*1000000 + it.input_event_usec;
+
+			// The kernel has dropped some events: the ones up to the end of the report are incomplete, and the
+			// state of the keys is read from the device once the report is complete.
+			if(it.type==EV_SYN) {
+				if(it.code==SYN_DROPPED) {
+					_resyncing[index] = true;
+				}
+				else if(it.code==SYN_REPORT && _resyncing[index]) {
+					_resyncing[index] = false;
+					pushed = resync_device(index, timestamp) || pushed;
+				}
+				continue;
+			}
+			if(it.type!=EV_KEY || it.value==2 || it.code>=KEY_CODE_COUNT || _resyncing[index]) { // <- value 2: auto-repeat.
+				continue;
+			}
+
+			// Release (discarded if the press has not been queued).
+			if(it.value==0) {
+				if(_keys_down[index][it.code]) {
+					queue_release(index, it.code, timestamp);
+					pushed = true;
+				}
+				continue;
+			}
+
+			// Press: it is queued only if a slot remains for its release, and for the releases of the other keys down.
+			if(_keys_down[index][it.code]) {
+				continue;
+			}
+			RawKeyEvent event;
+			event.scan_code = it.code + EVDEV_SCAN_CODE_OFFSET;
+			event.pressed   = true;
+			event.timestamp = timestamp;
+			event.device    = index;
+			if(_queue.push(event, _held+1)) {
+				_keys_down[index].set(it.code);
+				++_held;
+				pushed = true;
+			}
+			else {
+				++_dropped;
+				dropped.increment();
+			}
+		}
+	}
+	if(pushed) {
+		std::uint64_t one = 1;
+		ssize_t ignored = write(_notify_fd, &one, sizeof(one));
+		(void)ignored;
+	}
+}
+
+
+// Release the keys whose press has been queued, but that are not down anymore according to the device (after some
+// events have been dropped by the kernel). Return whether some releases have been queued.
+bool EvdevReader::resync_device(std::uint32_t index, std::int64_t timestamp)
+{
+	unsigned char bits[(KEY_CNT+7)/8];
+	std::memset(bits, 0, sizeof(bits));
+	KeyBits still_down;
+	if(ioctl(_fds[index], EVIOCGKEY(sizeof(bits)), bits)>=0) {
+		for(std::size_t code=0; code<KEY_CNT; ++code) {
+			if(bits[code/8] & (1 << (code%8))) {
+				still_down.set(code);
+			}
+		}
+	}
+	return release_keys(index, timestamp, still_down); // <- The presses missed in the meantime are not recovered.
+}
+
+
+// Queue the releases of the keys down on a device, except the ones in `still_down`. Return whether some releases
+// have been queued.
+bool EvdevReader::release_keys(std::uint32_t index, std::int64_t timestamp, const KeyBits &still_down)
+{
+	KeyBits released = _keys_down[index] & ~still_down;
+	if(released.none()) {
+		return false;
+	}
+	for(std::size_t code=0; code<KEY_CODE_COUNT; ++code) {
+		if(released[code]) {
+			queue_release(index, code, timestamp);
+		}
+	}
+	return true;
+}
+
+
+// Queue the release of a key down (a slot is always available for it, see `read_device()`).
+void EvdevReader::queue_release(std::uint32_t index, std::size_t code, std::int64_t timestamp)
+{
+	RawKeyEvent event;
+	event.scan_code = static_cast<ScanCode>(code) + EVDEV_SCAN_CODE_OFFSET;
+	event.pressed   = false;
+	event.timestamp = timestamp;
+	event.device    = index;
+	_queue.push(event);
+	_keys_down[index].reset(code);
+	--_held;
+}
+
+#else
+
+// The input devices cannot be read directly on this platform.
+EvdevReader::EvdevReader(const std::vector<std::string> &) : _notify_fd(-1), _stop_fd(-1), _epoll_fd(-1), _dropped(0)
+{
+	throw std::runtime_error("The evdev input backend is not supported on this platform.");
+}
+
+EvdevReader::~EvdevReader() {}
+std::size_t EvdevReader::process(const std::function<void(const RawKeyEvent &)> &) { return 0; }
+std::vector<std::string> EvdevReader::find_keyboards() { return std::vector<std::string>(); }
+TimePoint EvdevReader::to_time_point(std::int64_t) { return current_time(); }
+
+#endif /* OS_IS_UNIX */
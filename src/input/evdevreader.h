@@ -0,0 +1,165 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef EVDEVREADER_H_
+#define EVDEVREADER_H_
+
+#include <core/chrono.h>
+#include <core/keys.h>
+#include <core/realtime.h>
+#include <core/spscqueue.h>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Key event read from an input device, stamped by the kernel.
+ */
+struct RawKeyEvent
+{
+	ScanCode      scan_code; //!< Same scan-code as the one reported by `KeyboardHandler` (evdev key code + 8).
+	bool          pressed  ; //!< `true` for a key press, `false` for a key release (auto-repeat events are discarded).
+	std::int64_t  timestamp; //!< Instant at which the kernel received the event (us since the Unix epoch, UTC).
+	std::uint32_t device   ; //!< Index of the device, in the order in which the reader has opened them.
+};
+
+
+/**
+ * Keyboard backend reading the Linux input devices (`/dev/input/event*`) directly, on a dedicated thread.
+ *
+ * Contrary to `KeyboardHandler`, the key events do not go through the display server nor through the Qt event
+ * loop: they are stamped by the kernel, read by the reader thread as soon as they are available, and pushed into
+ * a lock-free single-producer single-consumer queue. The consumer (typically the clock engine, or the main window
+ * in standalone mode) is woken up through `notify_fd()`, and applies the transitions at the instant stamped
+ * by the kernel (see `to_time_point()`), so that the time charged to the players does not depend on the load
+ * of the consumer thread.
+ *
+ * The user must be allowed to read the devices (typically, by being a member of the `input` group).
+ * For tests, a virtual keyboard can be created with uinput, and passed explicitly to the constructor. A named pipe
+ * can also stand in for a device (e.g. `mkfifo /tmp/kbd` and `vcc --engine --evdev=/tmp/kbd`): the test writes
+ * `struct input_event` records to it, in the native layout, as the kernel would. Closing the pipe on the writer side
+ * acts as an unplug (the keys held are released), and the next writer is read as a new plug of the same device.
+ * A pipe has no key state, so after a `SYN_DROPPED` event all the keys held on it are released.
+ *
+ * Only available on Unix platforms (Linux).
+ */
+class EvdevReader
+{
+public:
+
+	/**
+	 * Capacity of the event queue.
+	 */
+	static const std::size_t QUEUE_CAPACITY = 1024;
+
+	/**
+	 * Constructor. Open the given devices (all the keyboards found in `/dev/input` if empty), and start the reader thread.
+	 * @throw std::runtime_error If no device can be opened.
+	 */
+	explicit EvdevReader(const std::vector<std::string> &devices=std::vector<std::string>());
+
+	/**
+	 * Destructor. Stop the reader thread, and close the devices.
+	 */
+	~EvdevReader();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	EvdevReader(const EvdevReader &op) = delete;
+	EvdevReader &operator=(const EvdevReader &op) = delete;
+	/**@} */
+
+	/**
+	 * Paths of the opened devices (indexed by `RawKeyEvent::device`).
+	 */
+	const std::vector<std::string> &devices() const { return _paths; }
+
+	/**
+	 * Descriptor that becomes readable when some events are waiting to be processed.
+	 */
+	int notify_fd() const { return _notify_fd; }
+
+	/**
+	 * Process the pending events with `handler`. Consumer thread only.
+	 * @returns Number of processed events.
+	 */
+	std::size_t process(const std::function<void(const RawKeyEvent &)> &handler);
+
+	/**
+	 * Number of events dropped because the queue was full. Only key presses are dropped: a slot of the queue is kept
+	 * for the release of each key whose press has been queued. The releases missed by the kernel (`SYN_DROPPED`)
+	 * are recovered from the state of the device, and the keys held on an unplugged device are released.
+	 */
+	std::uint64_t dropped() const { return _dropped; }
+
+	/**
+	 * Pin the reader thread to the CPU of the real-time mode, and switch it to `SCHED_FIFO`.
+	 */
+	void promote(RealtimeMode &realtime) { realtime.promote_thread(_thread.native_handle(), "input reader thread"); }
+
+	/**
+	 * List the keyboards of the system (the devices of `/dev/input` that have keyboard keys and that can be read).
+	 */
+	static std::vector<std::string> find_keyboards();
+
+	/**
+	 * Convert a kernel timestamp to a time point (on the time base of `current_time()`).
+	 */
+	static TimePoint to_time_point(std::int64_t timestamp);
+
+private:
+
+	// Number of evdev key codes (KEY_CNT).
+	static const std::size_t KEY_CODE_COUNT = 0x300;
+	typedef std::bitset<KEY_CODE_COUNT> KeyBits;
+
+	// Private functions
+	void run();
+	void read_device(std::uint32_t index);
+	bool resync_device(std::uint32_t index, std::int64_t timestamp);
+	bool release_keys(std::uint32_t index, std::int64_t timestamp, const KeyBits &still_down);
+	void queue_release(std::uint32_t index, std::size_t code, std::int64_t timestamp);
+
+	// Private members
+	std::vector<std::string>                  _paths    ;
+	std::vector<int>                          _fds      ; // Reader thread only, once started.
+	std::vector<bool>                         _fifos    ; // Whether the devices are named pipes standing in for actual devices.
+	std::vector<std::string>                  _partial  ; // Reader thread only: incomplete event read from a named pipe.
+	std::vector<KeyBits>                      _keys_down; // Reader thread only: keys whose press has been queued, but not their release.
+	std::vector<bool>                         _resyncing; // Reader thread only: events dropped by the kernel, waiting for the end of the report.
+	std::size_t                               _held     ; // Reader thread only: number of keys down (slots kept for their releases).
+	int                                       _notify_fd;
+	int                                       _stop_fd  ;
+	int                                       _epoll_fd ;
+	std::atomic<std::uint64_t>                _dropped  ;
+	SPSCQueue<RawKeyEvent, QUEUE_CAPACITY>    _queue    ;
+	std::thread                               _thread   ;
+};
+
+#endif /* EVDEVREADER_H_ */
@@ -0,0 +1,147 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "inputrouter.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+
+// Remove the leading and trailing whitespaces.
+static std::string trim(const std::string &text)
+{
+	std::size_t begin = text.find_first_not_of(" \t\r\n");
+	if(begin==std::string::npos) {
+		return std::string();
+	}
+	std::size_t end = text.find_last_not_of(" \t\r\n");
+	return text.substr(begin, end-begin+1);
+}
+
+
+// Canonical path of a device (resolving the symbolic links, if the device exists).
+static std::string canonical_path(const std::string &path)
+{
+	#ifdef OS_IS_UNIX
+		char buffer[PATH_MAX];
+		if(realpath(path.c_str(), buffer)!=nullptr) {
+			return buffer;
+		}
+	#endif
+	return path;
+}
+
+
+// Parse a non-negative integer.
+static unsigned long parse_integer(const std::string &text, unsigned long max)
+{
+	char *end = nullptr;
+	unsigned long retval = std::strtoul(text.c_str(), &end, 10);
+	if(text.empty() || *end!='\0' || retval>max) {
+		throw std::invalid_argument("Invalid number in an input route: " + text);
+	}
+	return retval;
+}
+
+
+// Constructor.
+InputRouter::InputRouter()
+{}
+
+
+// Parse the rules.
+void InputRouter::set_rules(const std::string &rules)
+{
+	std::vector<Rule> parsed;
+	std::istringstream stream(rules);
+	std::string item;
+	while(std::getline(stream, item, ';')) {
+		item = trim(item);
+		if(item.empty()) {
+			continue;
+		}
+		std::size_t equal = item.rfind('=');
+		std::size_t colon = item.rfind(':');
+		if(equal==std::string::npos || colon==std::string::npos || colon<equal) {
+			throw std::invalid_argument("Invalid input route (expected <device>[@<scan-code>]=<clock>:<left|right>): " + item);
+		}
+		Rule rule;
+		std::string source = trim(item.substr(0, equal));
+		std::size_t at = source.rfind('@');
+		rule.any_key   = at==std::string::npos;
+		rule.scan_code = rule.any_key ? 0 : static_cast<ScanCode>(parse_integer(trim(source.substr(at+1)), UINT32_MAX));
+		rule.device    = canonical_path(trim(source.substr(0, at)));
+		rule.route.clock = static_cast<std::uint16_t>(parse_integer(trim(item.substr(equal+1, colon-equal-1)), InputRoute::UNROUTED-1));
+		std::string side = trim(item.substr(colon+1));
+		if     (side=="left" ) { rule.route.side = Side::LEFT ; }
+		else if(side=="right") { rule.route.side = Side::RIGHT; }
+		else {
+			throw std::invalid_argument("Invalid side in an input route: " + side);
+		}
+		if(rule.device.empty()) {
+			throw std::invalid_argument("Missing device in an input route: " + item);
+		}
+		parsed.push_back(rule);
+	}
+	_rules.swap(parsed);
+}
+
+
+// Devices referred to by the rules.
+std::vector<std::string> InputRouter::devices(const std::vector<std::string> &others) const
+{
+	std::vector<std::string> retval = others;
+	for(const auto &rule : _rules) {
+		if(std::find(retval.begin(), retval.end(), rule.device)==retval.end()) {
+			retval.push_back(rule.device);
+		}
+	}
+	return retval;
+}
+
+
+// Build the lookup table.
+void InputRouter::bind(const std::vector<std::string> &devices)
+{
+	const InputRoute unrouted{InputRoute::UNROUTED, Side::LEFT};
+	_device_routes.assign(devices.size(), unrouted);
+	_table        .assign(devices.size()*SCAN_CODE_COUNT, unrouted);
+	for(std::size_t k=0; k<devices.size(); ++k) {
+		std::string device = canonical_path(devices[k]);
+
+		// Device-wide rules first, so that the key-specific rules override them.
+		for(const auto &rule : _rules) {
+			if(rule.device==device && rule.any_key) {
+				_device_routes[k] = rule.route;
+				std::fill(_table.begin() + k*SCAN_CODE_COUNT, _table.begin() + (k+1)*SCAN_CODE_COUNT, rule.route);
+			}
+		}
+		for(const auto &rule : _rules) {
+			if(rule.device==device && !rule.any_key && rule.scan_code<SCAN_CODE_COUNT) {
+				_table[k*SCAN_CODE_COUNT + rule.scan_code] = rule.route;
+			}
+		}
+	}
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef INPUTROUTER_H_
+#define INPUTROUTER_H_
+
+#include <core/keys.h>
+#include <core/side.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Destination of a key event: the clock instance and the side whose button has been pressed.
+ */
+struct InputRoute
+{
+	/**
+	 * Value of `clock` for the events that are not routed (they go through the shortcuts of the clock).
+	 */
+	static const std::uint16_t UNROUTED = 0xffff;
+
+	std::uint16_t clock; //!< Clock instance (see the `--clock-id` option of the engine), or `UNROUTED`.
+	Side          side ; //!< Player whose button has been pressed (meaningless if the event is not routed).
+
+	/**
+	 * Whether the event is routed.
+	 */
+	bool routed() const { return clock!=UNROUTED; }
+};
+
+
+/**
+ * Routing of the key events read from the input devices (see `EvdevReader`) to the clock instances.
+ *
+ * Each rule maps a device, or a key of a device, to a clock instance and a side, so that several cheap keypads
+ * or foot pedals plugged into a single machine can drive several boards. A key press on a routed key is
+ * interpreted as the button of the given player (i.e. it starts the timer of the opponent), whatever
+ * the shortcuts. The keys that are not routed are processed by the shortcuts as usual.
+ *
+ * The rules are written as a `;`-separated list of `<device>[@<scan-code>]=<clock>:<left|right>`, for instance:
+ *
+ *     /dev/input/by-id/usb-pedal-a-event-kbd=1:left; /dev/input/by-id/usb-pedal-b-event-kbd=1:right
+ *
+ * The devices are compared after symbolic link resolution, so the stable names of `/dev/input/by-id` can be used.
+ * Once the rules are bound to the devices actually opened, the routing of an event is a single table lookup.
+ */
+class InputRouter
+{
+public:
+
+	/**
+	 * Number of scan-codes covered by the lookup table (the routes of the larger scan-codes are the one of the device).
+	 */
+	static const std::size_t SCAN_CODE_COUNT = 1024;
+
+	/**
+	 * Constructor. No rule: all the events are unrouted.
+	 */
+	InputRouter();
+
+	/**
+	 * Parse the given rules (see the class description), replacing the current ones. Call `bind()` afterward.
+	 * @throw std::invalid_argument If the rules are malformed.
+	 */
+	void set_rules(const std::string &rules);
+
+	/**
+	 * Devices referred to by the rules, appended to `others` if they are not already listed in it
+	 * (typically, the keyboards that are read anyway).
+	 */
+	std::vector<std::string> devices(const std::vector<std::string> &others=std::vector<std::string>()) const;
+
+	/**
+	 * Build the lookup table for the given devices (indexed by `RawKeyEvent::device`).
+	 */
+	void bind(const std::vector<std::string> &devices);
+
+	/**
+	 * Destination of a key event of the given device.
+	 */
+	InputRoute route(std::uint32_t device, ScanCode scan_code) const
+	{
+		if(device>=_device_routes.size()) {
+			return InputRoute{InputRoute::UNROUTED, Side::LEFT};
+		}
+		return scan_code<SCAN_CODE_COUNT ? _table[device*SCAN_CODE_COUNT + scan_code] : _device_routes[device];
+	}
+
+private:
+
+	// Routing rule.
+	struct Rule
+	{
+		std::string device   ; // Canonical path of the device.
+		bool        any_key  ; // Whether the rule applies to all the keys of the device.
+		ScanCode    scan_code;
+		InputRoute  route    ;
+	};
+
+	// Private members
+	std::vector<Rule>       _rules        ;
+	std::vector<InputRoute> _device_routes; // Route of each bound device (for the keys without a specific rule).
+	std::vector<InputRoute> _table        ; // SCAN_CODE_COUNT routes per bound device.
+};
+
+#endif /* INPUTROUTER_H_ */
@@ -0,0 +1,186 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "pressfilter.h"
+#include <core/metrics.h>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+
+// Remove the leading and trailing whitespaces.
+static std::string trim(const std::string &text)
+{
+	std::size_t begin = text.find_first_not_of(" \t\r\n");
+	if(begin==std::string::npos) {
+		return std::string();
+	}
+	std::size_t end = text.find_last_not_of(" \t\r\n");
+	return text.substr(begin, end-begin+1);
+}
+
+
+// Canonical path of a device (resolving the symbolic links, if the device exists).
+static std::string canonical_path(const std::string &path)
+{
+	#ifdef OS_IS_UNIX
+		char buffer[PATH_MAX];
+		if(realpath(path.c_str(), buffer)!=nullptr) {
+			return buffer;
+		}
+	#endif
+	return path;
+}
+
+
+// Parse a non-negative integer.
+static unsigned long parse_integer(const std::string &text, unsigned long max)
+{
+	char *end = nullptr;
+	unsigned long retval = std::strtoul(text.c_str(), &end, 10);
+	if(text.empty() || *end!='\0' || retval>max) {
+		throw std::invalid_argument("Invalid number in a debounce rule: " + text);
+	}
+	return retval;
+}
+
+
+// Constructor.
+PressFilter::PressFilter() : _default_window(0), _device_count(0), _suppressed(0)
+{
+	bind(std::vector<std::string>());
+}
+
+
+// Parse the rules.
+void PressFilter::set_rules(const std::string &rules)
+{
+	std::int64_t      default_window = 0;
+	std::vector<Rule> parsed;
+	std::istringstream stream(rules);
+	std::string item;
+	while(std::getline(stream, item, ';')) {
+		item = trim(item);
+		if(item.empty()) {
+			continue;
+		}
+		std::size_t equal = item.rfind('=');
+		if(equal==std::string::npos) {
+			default_window = static_cast<std::int64_t>(parse_integer(item, 60000)) * 1000;
+			continue;
+		}
+		Rule rule;
+		std::string source = trim(item.substr(0, equal));
+		std::size_t at = source.rfind('@');
+		rule.any_key   = at==std::string::npos;
+		rule.scan_code = rule.any_key ? 0 : static_cast<ScanCode>(parse_integer(trim(source.substr(at+1)), KeyState::KEY_COUNT-1));
+		rule.device    = trim(source.substr(0, at));
+		rule.device    = rule.device.empty() ? rule.device : canonical_path(rule.device);
+		rule.window    = static_cast<std::int64_t>(parse_integer(trim(item.substr(equal+1)), 60000)) * 1000;
+		if(rule.device.empty() && rule.any_key) {
+			throw std::invalid_argument("Invalid debounce rule (expected <device>[@<scan-code>]=<ms> or @<scan-code>=<ms>): " + item);
+		}
+		parsed.push_back(rule);
+	}
+	_default_window = default_window;
+	_rules.swap(parsed);
+}
+
+
+// Build the lookup table.
+void PressFilter::bind(const std::vector<std::string> &devices)
+{
+	_device_count = devices.size();
+	_slots.assign((_device_count+1) * KeyState::KEY_COUNT, Slot{_default_window, 0});
+	for(std::size_t k=0; k<=_device_count; ++k) {
+		std::string device = k<_device_count ? canonical_path(devices[k]) : std::string();
+		Slot *slots = &_slots[k * KeyState::KEY_COUNT];
+
+		// From the least specific rules to the most specific ones: device, key (any device), device and key.
+		for(int pass=0; pass<3; ++pass) {
+			for(const auto &rule : _rules) {
+				bool applies =
+					(pass==0 &&  rule.any_key && !device.empty() && rule.device==device) ||
+					(pass==1 && !rule.any_key &&  rule.device.empty()) ||
+					(pass==2 && !rule.any_key && !device.empty() && rule.device==device);
+				if(!applies) {
+					continue;
+				}
+				if(rule.any_key) {
+					for(std::size_t s=0; s<KeyState::KEY_COUNT; ++s) {
+						slots[s].window = rule.window;
+					}
+				}
+				else {
+					slots[rule.scan_code].window = rule.window;
+				}
+			}
+		}
+	}
+}
+
+
+// Slot of the given key of the given device (nullptr if the key is not tracked).
+PressFilter::Slot *PressFilter::slot(std::uint32_t device, ScanCode scan_code)
+{
+	if(scan_code>=KeyState::KEY_COUNT) {
+		return nullptr;
+	}
+	std::size_t index = device<_device_count ? device : _device_count;
+	return &_slots[index * KeyState::KEY_COUNT + scan_code];
+}
+
+
+// Filter a key press.
+bool PressFilter::press(std::uint32_t device, ScanCode scan_code, const TimePoint &at)
+{
+	static const Metrics::Counter suppressed = Metrics::instance().counter("vcc_input_suppressed_total",
+		"Key events suppressed by the input filters.", "reason=\"bounce\"");
+
+	Slot *it = slot(device, scan_code);
+	if(it==nullptr) {
+		return true;
+	}
+
+	// The window is measured from the last edge, so that the bounces of a release are suppressed too. A missed
+	// release does not block the key: a press reported while it is down is accepted as any other one.
+	std::int64_t now       = to_epoch_microseconds(at);
+	std::int64_t last_edge = it->last_edge;
+	it->last_edge = now;
+	if(last_edge!=0 && now - last_edge < it->window) {
+		++_suppressed;
+		suppressed.increment();
+		return false;
+	}
+	return true;
+}
+
+
+// Register a key release.
+void PressFilter::release(std::uint32_t device, ScanCode scan_code, const TimePoint &at)
+{
+	Slot *it = slot(device, scan_code);
+	if(it!=nullptr) {
+		it->last_edge = to_epoch_microseconds(at);
+	}
+}
@@ -0,0 +1,123 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef PRESSFILTER_H_
+#define PRESSFILTER_H_
+
+#include <core/keys.h>
+#include <core/keystate.h>
+#include <core/chrono.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Debounce filter for the key events, for the mechanical buttons (arcade buttons, foot pedals...) whose contacts
+ * bounce when pressed or released.
+ *
+ * The filter is eager: the first press of a key is always accepted immediately (no latency is added), and the
+ * presses of the same key that follow an edge of this key (press or release) within its debounce window are
+ * suppressed, so that both the press bounces and the release bounces of a held button are ignored. A press
+ * reported while the key is considered down (its release has been missed) is accepted as well once the window
+ * has elapsed. The windows are measured on the timestamps of the events, and may be configured per device and
+ * per key, as a `;`-separated list
+ * of items, each of them being either a plain number of milliseconds (default window) or
+ * `<device>=<ms>`, `@<scan-code>=<ms>` (any device) or `<device>@<scan-code>=<ms>`, for instance:
+ *
+ *     10; /dev/input/by-id/usb-pedal-event-kbd=40; @50=0
+ *
+ * The most specific item applies. The devices are compared after symbolic link resolution. Once the rules are
+ * bound to the opened devices, filtering an event is a table lookup, without allocation.
+ */
+class PressFilter
+{
+public:
+
+	/**
+	 * Device index of the events that are not read from an input device (e.g. received through the display server).
+	 */
+	static const std::uint32_t OTHER_DEVICE = 0xffffffff;
+
+	/**
+	 * Constructor. No debounce.
+	 */
+	PressFilter();
+
+	/**
+	 * Parse the given rules (see the class description), replacing the current ones. Call `bind()` afterward.
+	 * @throw std::invalid_argument If the rules are malformed.
+	 */
+	void set_rules(const std::string &rules);
+
+	/**
+	 * Build the lookup table for the given devices (indexed by `RawKeyEvent::device`), and forget the state of the keys.
+	 */
+	void bind(const std::vector<std::string> &devices);
+
+	/**
+	 * Filter a key press.
+	 * @returns `false` if the press must be ignored (bounce).
+	 */
+	bool press(std::uint32_t device, ScanCode scan_code, const TimePoint &at);
+
+	/**
+	 * Register a key release (it opens a debounce window, as a press).
+	 */
+	void release(std::uint32_t device, ScanCode scan_code, const TimePoint &at);
+
+	/**
+	 * Number of presses suppressed as bounces.
+	 */
+	std::uint64_t suppressed() const { return _suppressed; }
+
+private:
+
+	// Debounce rule.
+	struct Rule
+	{
+		std::string  device   ; // Canonical path of the device (empty: any device).
+		bool         any_key  ; // Whether the rule applies to all the keys.
+		ScanCode     scan_code;
+		std::int64_t window   ; // In microseconds.
+	};
+
+	// State of a key of a device.
+	struct Slot
+	{
+		std::int64_t window   ; // Debounce window (us).
+		std::int64_t last_edge; // Instant of the last press or release, suppressed or not (us since the epoch).
+	};
+
+	// Private functions
+	Slot *slot(std::uint32_t device, ScanCode scan_code);
+
+	// Private members
+	std::int64_t      _default_window;
+	std::vector<Rule> _rules         ;
+	std::vector<Slot> _slots         ; // KeyState::KEY_COUNT slots per bound device, plus the ones of OTHER_DEVICE.
+	std::size_t       _device_count  ;
+	std::uint64_t     _suppressed    ;
+};
+
+#endif /* PRESSFILTER_H_ */
@@ -0,0 +1,170 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "clockcommand.h"
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+
+// Names of the time control modes, in the order of the enumeration.
+static const char *const TIME_CONTROL_MODE_NAMES[] = { "sudden-death", "fischer", "bronstein", "hourglass", "byo-yomi" };
+
+
+// Parse a side.
+static Side parse_side(const std::string &token)
+{
+	if(token=="left" ) { return Side::LEFT ; }
+	if(token=="right") { return Side::RIGHT; }
+	throw std::invalid_argument("invalid side: " + token);
+}
+
+
+// Parse an integer.
+static long long parse_integer(const std::string &token)
+{
+	char *end = nullptr;
+	long long retval = std::strtoll(token.c_str(), &end, 10);
+	if(token.empty() || *end!='\0') {
+		throw std::invalid_argument("invalid number: " + token);
+	}
+	return retval;
+}
+
+
+// Parse a time control mode.
+static TimeControl::Mode parse_time_control_mode(const std::string &token)
+{
+	for(auto mode = Enum::cursor<TimeControl::Mode>::first(); mode.valid(); ++mode) {
+		if(token==TIME_CONTROL_MODE_NAMES[Enum::to_value(*mode)]) {
+			return *mode;
+		}
+	}
+	throw std::invalid_argument("invalid time control mode: " + token);
+}
+
+
+// Parse a command line.
+ClockCommand parse_clock_command(const std::string &line)
+{
+	std::vector<std::string> tokens;
+	std::istringstream stream(line);
+	for(std::string token; stream >> token; ) {
+		tokens.push_back(token);
+	}
+	if(tokens.empty()) {
+		throw std::invalid_argument("empty command");
+	}
+
+	auto expect_arguments = [&tokens](std::size_t count) {
+		if(tokens.size()!=count+1) {
+			throw std::invalid_argument("wrong number of arguments for " + tokens[0]);
+		}
+	};
+
+	ClockCommand retval;
+	retval.side   = Side::LEFT;
+	retval.amount = TIME_DURATION_ZERO;
+	const std::string &name(tokens[0]);
+	if(name=="ping") {
+		expect_arguments(0);
+		retval.type = ClockCommandType::PING;
+	}
+	else if(name=="start") {
+		expect_arguments(1);
+		retval.type = ClockCommandType::START;
+		retval.side = parse_side(tokens[1]);
+	}
+	else if(name=="switch") { expect_arguments(0); retval.type = ClockCommandType::SWITCH; }
+	else if(name=="pause" ) { expect_arguments(0); retval.type = ClockCommandType::PAUSE ; }
+	else if(name=="reset" ) { expect_arguments(0); retval.type = ClockCommandType::RESET ; }
+	else if(name=="swap"  ) { expect_arguments(0); retval.type = ClockCommandType::SWAP  ; }
+	else if(name=="state" ) { expect_arguments(0); retval.type = ClockCommandType::STATE ; }
+	else if(name=="adjust" || name=="set") {
+		expect_arguments(2);
+		retval.type   = name=="adjust" ? ClockCommandType::ADJUST : ClockCommandType::SET_TIME;
+		retval.side   = parse_side(tokens[1]);
+		retval.amount = boost::posix_time::milliseconds(parse_integer(tokens[2]));
+	}
+	else if(name=="time-control") {
+		if(tokens.size()!=5 && tokens.size()!=8) {
+			throw std::invalid_argument("wrong number of arguments for time-control");
+		}
+		retval.type = ClockCommandType::TIME_CONTROL;
+		retval.time_control.set_mode(parse_time_control_mode(tokens[1]));
+		for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+			std::size_t offset = (*s==Side::RIGHT && tokens.size()==8) ? 5 : 2;
+			retval.time_control.set_main_time  (*s, boost::posix_time::milliseconds(parse_integer(tokens[offset  ])));
+			retval.time_control.set_increment  (*s, boost::posix_time::milliseconds(parse_integer(tokens[offset+1])));
+			retval.time_control.set_byo_periods(*s, static_cast<int>(parse_integer(tokens[offset+2])));
+		}
+	}
+	else {
+		throw std::invalid_argument("unknown command: " + name);
+	}
+	return retval;
+}
+
+
+// Execute a command.
+std::string execute_clock_command(BiTimer &bi_timer, const ClockCommand &command, const std::function<void()> &swap_sides)
+{
+	switch(command.type)
+	{
+		case ClockCommandType::PING  : break;
+		case ClockCommandType::START : bi_timer.start_timer(command.side); break;
+		case ClockCommandType::SWITCH: bi_timer.change_timer(); break;
+		case ClockCommandType::PAUSE : bi_timer.stop_timer  (); break;
+		case ClockCommandType::RESET : bi_timer.reset_timers(); break;
+		case ClockCommandType::SWAP  : swap_sides(); break;
+		case ClockCommandType::TIME_CONTROL: bi_timer.set_time_control(command.time_control); break;
+
+		// The time adjustments are applied to the time at the reference instant of the state,
+		// so that a running timer keeps running.
+		case ClockCommandType::ADJUST:
+		case ClockCommandType::SET_TIME:
+		{
+			BiTimer::State state = bi_timer.state();
+			if(command.type==ClockCommandType::ADJUST) {
+				state.time[command.side] += command.amount;
+			}
+			else {
+				state.time[command.side] = command.amount + (state.time[command.side] - bi_timer.time(command.side));
+			}
+			bi_timer.restore(state);
+			break;
+		}
+
+		case ClockCommandType::STATE:
+		{
+			std::ostringstream reply;
+			const auto &active_side(bi_timer.active_side());
+			reply << "ok " << (active_side ? (*active_side==Side::LEFT ? "left" : "right") : "none");
+			for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+				reply << " " << bi_timer.time(*s).total_milliseconds();
+			}
+			return reply.str();
+		}
+	}
+	return "ok";
+}
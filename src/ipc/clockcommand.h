@@ -0,0 +1,80 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef CLOCKCOMMAND_H_
+#define CLOCKCOMMAND_H_
+
+#include <core/bitimer.h>
+#include <functional>
+#include <string>
+
+
+/**
+ * Type of the commands accepted on the command socket (see `CommandServer`).
+ */
+enum class ClockCommandType
+{
+	PING        , //!< `ping`
+	START       , //!< `start <side>`
+	SWITCH      , //!< `switch`
+	PAUSE       , //!< `pause`
+	RESET       , //!< `reset`
+	SWAP        , //!< `swap`
+	ADJUST      , //!< `adjust <side> <milliseconds>` (the amount may be negative)
+	SET_TIME    , //!< `set <side> <milliseconds>`
+	TIME_CONTROL, //!< `time-control <mode> <main-ms> <increment-ms> <byo-periods> [<right-main-ms> <right-increment-ms> <right-byo-periods>]`
+	STATE         //!< `state`
+};
+
+
+/**
+ * Parsed command.
+ *
+ * The commands are text lines, made of space-separated tokens; `<side>` is either `left` or `right`, and `<mode>`
+ * one of `sudden-death`, `fischer`, `bronstein`, `hourglass` and `byo-yomi`. Each command produces exactly one
+ * reply line, either `ok [...]` or `error <message>`. The reply of `state` is:
+ *
+ *     ok <active-side|none> <left-ms> <right-ms>
+ */
+struct ClockCommand
+{
+	ClockCommandType type        ;
+	Side             side        ; //!< START, ADJUST, SET_TIME
+	TimeDuration     amount      ; //!< ADJUST, SET_TIME
+	TimeControl      time_control; //!< TIME_CONTROL
+};
+
+
+/**
+ * Parse a command line (without its end-of-line character).
+ * @throw std::invalid_argument If the line is not a valid command.
+ */
+ClockCommand parse_clock_command(const std::string &line);
+
+/**
+ * Execute a command on the given timer pair, and return the reply (without its end-of-line character).
+ * @param swap_sides Function called to execute the SWAP command (the owner of the timers usually has to do more
+ *        than just calling `BiTimer::swap_sides()`).
+ */
+std::string execute_clock_command(BiTimer &bi_timer, const ClockCommand &command, const std::function<void()> &swap_sides);
+
+#endif /* CLOCKCOMMAND_H_ */
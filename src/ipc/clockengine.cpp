@@ -0,0 +1,415 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "clockengine.h"
+
+#ifdef OS_IS_UNIX
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// Write end of the pipe used to forward the termination signals to the event loop.
+static int g_signal_pipe_write_end = -1;
+
+
+// Termination signal handler.
+static void on_termination_signal(int)
+{
+	char byte = 0;
+	ssize_t ignored = write(g_signal_pipe_write_end, &byte, 1);
+	(void)ignored;
+}
+
+
+// Fill a sockaddr_un structure with the given path.
+static sockaddr_un make_address(const std::string &path)
+{
+	sockaddr_un retval;
+	std::memset(&retval, 0, sizeof(retval));
+	retval.sun_family = AF_UNIX;
+	if(path.size()>=sizeof(retval.sun_path)) {
+		throw std::runtime_error("The engine socket path is too long.");
+	}
+	std::strcpy(retval.sun_path, path.c_str());
+	return retval;
+}
+
+
+// Constructor.
+ClockEngine::ClockEngine(unsigned int clock_id) :
+	_clock_id(clock_id), _server_fd(-1), _signal_pipe{-1, -1}, _socket_path(engine_socket_path(clock_id)), _switch_arbiter(_bi_timer)
+{
+	sockaddr_un address = make_address(_socket_path);
+
+	// Refuse to start if another engine is listening on the socket; otherwise remove the stale socket file, if any.
+	int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(probe>=0) {
+		bool in_use = connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address))==0;
+		close(probe);
+		if(in_use) {
+			throw std::runtime_error("Another clock engine is already running for this clock.");
+		}
+	}
+	unlink(_socket_path.c_str());
+
+	// Listening socket
+	_server_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(_server_fd<0 || bind(_server_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))!=0 || listen(_server_fd, 8)!=0) {
+		if(_server_fd>=0) {
+			close(_server_fd);
+		}
+		throw std::runtime_error("Unable to create the engine control socket.");
+	}
+
+	// Signal pipe
+	if(pipe2(_signal_pipe, O_CLOEXEC | O_NONBLOCK)!=0) {
+		close(_server_fd);
+		unlink(_socket_path.c_str());
+		throw std::runtime_error("Unable to create the engine signal pipe.");
+	}
+
+	// Shared clock state, published each time the timers change.
+	try {
+		_shared_state = SharedClockState::create(SharedClockState::default_name(clock_id));
+	}
+	catch(...) {
+		close(_server_fd);
+		close(_signal_pipe[0]);
+		close(_signal_pipe[1]);
+		unlink(_socket_path.c_str());
+		throw;
+	}
+	_bi_timer.connect_state_changed(std::bind(&ClockEngine::on_state_changed, this));
+	on_state_changed();
+
+	// Command socket (optional: the engine works without it).
+	try {
+		_command_server.reset(new CommandServer(command_socket_path(clock_id)));
+	}
+	catch(std::runtime_error &) {}
+}
+
+
+// Destructor.
+ClockEngine::~ClockEngine()
+{
+	for(const auto &it : _clients) {
+		close(it.fd);
+	}
+	close(_server_fd);
+	close(_signal_pipe[0]);
+	close(_signal_pipe[1]);
+	unlink(_socket_path.c_str());
+}
+
+
+// Event loop.
+void ClockEngine::run()
+{
+	g_signal_pipe_write_end = _signal_pipe[1];
+	std::signal(SIGINT , &on_termination_signal);
+	std::signal(SIGTERM, &on_termination_signal);
+	std::signal(SIGHUP , SIG_IGN); // <- The engine must survive the terminal/session of the UI that spawned it.
+
+	while(true) {
+		std::vector<pollfd> fds;
+		fds.push_back(pollfd{_signal_pipe[0], POLLIN, 0});
+		fds.push_back(pollfd{_server_fd     , POLLIN, 0});
+		fds.push_back(pollfd{_command_server ? _command_server->notify_fd() : -1, POLLIN, 0}); // <- Negative descriptors are ignored.
+		fds.push_back(pollfd{_evdev_reader   ? _evdev_reader  ->notify_fd() : -1, POLLIN, 0});
+		for(const auto &it : _clients) {
+			fds.push_back(pollfd{it.fd, POLLIN, 0});
+		}
+		if(poll(fds.data(), fds.size(), -1)<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			throw std::runtime_error("The engine event loop has failed.");
+		}
+
+		// Termination request
+		if(fds[0].revents!=0) {
+			break;
+		}
+
+		// Key events read from the input devices (first, as they are the most time-sensitive)
+		if(fds[3].revents!=0) {
+			_evdev_reader->process(std::bind(&ClockEngine::on_raw_key_event, this, std::placeholders::_1));
+		}
+
+		// Commands received on the command socket
+		if(fds[2].revents!=0) {
+			_command_server->process(std::bind(&ClockEngine::execute_command, this, std::placeholders::_1));
+		}
+
+		// Client messages (processed before the new connections, as `_clients` is in sync with `fds`)
+		std::vector<int> disconnected;
+		for(std::size_t k=0; k<_clients.size(); ++k) {
+			if(fds[k+4].revents==0) {
+				continue;
+			}
+			EngineMessage message;
+			if(!receive_engine_message(_clients[k].fd, message) || !process_message(_clients[k], message)) {
+				disconnected.push_back(_clients[k].fd);
+			}
+		}
+		for(int fd : disconnected) {
+			close(fd);
+			for(auto it=_clients.begin(); it!=_clients.end(); ++it) {
+				if(it->fd==fd) {
+					_clients.erase(it);
+					break;
+				}
+			}
+		}
+
+		// New connection
+		if(fds[1].revents!=0) {
+			accept_client();
+		}
+	}
+
+	std::signal(SIGINT , SIG_DFL);
+	std::signal(SIGTERM, SIG_DFL);
+	g_signal_pipe_write_end = -1;
+}
+
+
+// Accept a new client connection.
+void ClockEngine::accept_client()
+{
+	int fd = accept4(_server_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK); // <- A stalled client must never block the engine.
+	if(fd>=0) {
+		_clients.push_back(Client{fd, KeyState()});
+	}
+}
+
+
+// Process a message sent by a client. Return false if the client must be disconnected.
+bool ClockEngine::process_message(Client &client, const EngineMessage &message)
+{
+	try {
+		switch(message.type)
+		{
+			case EngineMessageType::HELLO:
+				if(message.argument!=ENGINE_PROTOCOL_VERSION) {
+					return false;
+				}
+				return send_engine_message(client.fd, make_time_control_message(_bi_timer.time_control(), EngineMessageType::TIME_CONTROL_CHANGED)) &&
+					send_engine_message(client.fd, EngineMessage(EngineMessageType::STATE_CHANGED, 0));
+
+			case EngineMessageType::KEY_PRESSED:
+			{
+				TimePoint at = current_time();
+				if(_press_filter.press(PressFilter::OTHER_DEVICE, message.argument, at)) {
+					on_key_pressed(client.keys_down, message.argument, at);
+				}
+				return true;
+			}
+
+			case EngineMessageType::KEY_RELEASED:
+				_press_filter.release(PressFilter::OTHER_DEVICE, message.argument, current_time());
+				client.keys_down.release(message.argument);
+				return true;
+
+			case EngineMessageType::STOP_TIMER      : _bi_timer.stop_timer  (); return true;
+			case EngineMessageType::RESET_TIMERS    : _bi_timer.reset_timers(); return true;
+			case EngineMessageType::SWAP_SIDES      : swap_sides(); return true;
+			case EngineMessageType::SET_TIME_CONTROL: _bi_timer.set_time_control(parse_time_control_message(message)); return true;
+			case EngineMessageType::SET_SHORTCUTS   : parse_shortcuts_message(message, _shortcut_manager); return true;
+
+			case EngineMessageType::SET_PLAYER_NAME:
+				if(message.argument>=Enum::traits<Side>::count) {
+					return false;
+				}
+				_player_names[Enum::from_value<Side>(message.argument)] = message.text;
+				on_state_changed();
+				return true;
+
+			case EngineMessageType::START_TIMER:
+				if(message.argument>=Enum::traits<Side>::count) {
+					return false;
+				}
+				_bi_timer.start_timer(Enum::from_value<Side>(message.argument));
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	// Malformed message
+	catch(std::invalid_argument &) {
+		return false;
+	}
+}
+
+
+// Key-press handler: resolve and execute the associated shortcut (the switches being applied at the instant `at`).
+void ClockEngine::on_key_pressed(KeyState &keys_down, ScanCode scan_code, const TimePoint &at)
+{
+	keys_down.press(scan_code, at);
+	int shortcut = _shortcut_manager.shortcut(scan_code, _shortcut_manager.modifier_keys_activated(keys_down));
+	ShortcutManager::count_key_press(shortcut);
+	switch(shortcut)
+	{
+		case 1: _switch_arbiter.press(Side::LEFT , at); break; // <- Button of the left player: start the right timer.
+		case 2: _switch_arbiter.press(Side::RIGHT, at); break;
+		case 3: _bi_timer.stop_timer  (); break;
+		case 4: _bi_timer.reset_timers(); break;
+		case 5: swap_sides(); break;
+		default: break;
+	}
+}
+
+
+// Key event read from the input devices.
+void ClockEngine::on_raw_key_event(const RawKeyEvent &event)
+{
+	// Debounce
+	TimePoint at = EvdevReader::to_time_point(event.timestamp);
+	if(!event.pressed) {
+		_press_filter.release(event.device, event.scan_code, at);
+	}
+	else if(!_press_filter.press(event.device, event.scan_code, at)) {
+		return;
+	}
+
+	// Keys routed to a player of a clock: only the presses matter, and only for this clock.
+	InputRoute route = _input_router.route(event.device, event.scan_code);
+	if(route.routed()) {
+		if(event.pressed && route.clock==_clock_id) {
+			_switch_arbiter.press(route.side, at);
+		}
+		return;
+	}
+
+	if(event.pressed) {
+		on_key_pressed(_evdev_keys_down, event.scan_code, at);
+	}
+	else {
+		_evdev_keys_down.release(event.scan_code);
+	}
+}
+
+
+// Swap the sides, and let the clients swap the players' names.
+void ClockEngine::swap_sides()
+{
+	_bi_timer.swap_sides();
+	broadcast(EngineMessage(EngineMessageType::SIDES_SWAPPED));
+}
+
+
+// Start streaming the clock state to the local network subscribers.
+void ClockEngine::enable_broadcast(const std::string &address, std::uint16_t port)
+{
+	_broadcast_server.reset(new BroadcastServer(address, port));
+	_broadcast_server->enable_discovery();
+	_broadcast_server->set_time_base(_time_sync_client.get());
+	_broadcast_server->publish(_bi_timer.state(), _player_names);
+}
+
+
+// Express the instants of the broadcast stream on the time base of the given server.
+void ClockEngine::enable_time_sync(const std::string &server_address)
+{
+	_time_sync_client.reset(new TimeSyncClient(server_address));
+	if(_broadcast_server) {
+		_broadcast_server->set_time_base(_time_sync_client.get());
+	}
+}
+
+
+// Read the keyboards directly from the input devices.
+void ClockEngine::enable_evdev(const std::vector<std::string> &devices, const std::string &routes)
+{
+	_input_router.set_rules(routes);
+	_evdev_reader.reset(new EvdevReader(_input_router.devices(devices.empty() ? EvdevReader::find_keyboards() : devices)));
+	_input_router.bind(_evdev_reader->devices());
+	_press_filter.bind(_evdev_reader->devices());
+}
+
+
+// Configure the debounce of the key presses and the arbitration between the players.
+void ClockEngine::configure_input_filters(const std::string &debounce_rules, const TimeDuration &arbitration_window)
+{
+	_press_filter.set_rules(debounce_rules);
+	_press_filter.bind(_evdev_reader ? _evdev_reader->devices() : std::vector<std::string>());
+	_switch_arbiter.set_window(arbitration_window);
+}
+
+
+// Switch the input path to the real-time mode.
+void ClockEngine::enable_realtime(RealtimeMode &realtime)
+{
+	realtime.promote_current_thread("engine thread");
+	if(_evdev_reader) {
+		_evdev_reader->promote(realtime);
+	}
+	realtime.lock_memory();
+}
+
+
+// Execute a command received on the command socket.
+std::string ClockEngine::execute_command(const ClockCommand &command)
+{
+	return execute_clock_command(_bi_timer, command, std::bind(&ClockEngine::swap_sides, this));
+}
+
+
+// Publish the new state of the timers, and notify the clients.
+void ClockEngine::on_state_changed()
+{
+	// The time control may be changed by any client, or by the command socket: the clients mirror it, so that
+	// none of them pushes a stale one (which would reset the timers).
+	if(_bi_timer.time_control()!=_time_control) {
+		_time_control = _bi_timer.time_control();
+		broadcast(make_time_control_message(_time_control, EngineMessageType::TIME_CONTROL_CHANGED));
+	}
+
+	BiTimer::State state = _bi_timer.state();
+	std::uint32_t sequence = _shared_state->publish(state, _player_names);
+	if(_broadcast_server) {
+		_broadcast_server->publish(state, _player_names);
+	}
+	broadcast(EngineMessage(EngineMessageType::STATE_CHANGED, sequence));
+}
+
+
+// Send a message to all the clients (the clients that are gone are detected by the event loop).
+void ClockEngine::broadcast(const EngineMessage &message)
+{
+	for(const auto &it : _clients) {
+		send_engine_message(it.fd, message);
+	}
+}
+
+#endif /* OS_IS_UNIX */
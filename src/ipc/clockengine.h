@@ -0,0 +1,163 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef CLOCKENGINE_H_
+#define CLOCKENGINE_H_
+
+#include "engineprotocol.h"
+#include "sharedclockstate.h"
+#include "commandserver.h"
+#include <net/broadcastserver.h>
+#include <net/timesyncclient.h>
+#include <input/evdevreader.h>
+#include <input/inputrouter.h>
+#include <input/pressfilter.h>
+#include <core/bitimer.h>
+#include <core/realtime.h>
+#include <core/shortcutmanager.h>
+#include <core/switcharbiter.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/**
+ * Headless clock engine (`vcc --engine`).
+ *
+ * The engine owns the authoritative `BiTimer` and the input path (shortcut resolution and
+ * command execution), so that the timers keep running accurately whatever happens to the UI.
+ * UI clients connect through the engine control socket (see `engine_socket_path()`): they forward
+ * the raw scan-codes and the user commands, and mirror the clock state that the engine publishes
+ * in shared memory (see `SharedClockState`) each time it changes. Scripts and arbiter tools may also drive
+ * the timers through the command socket (see `CommandServer`).
+ */
+class ClockEngine
+{
+public:
+
+	/**
+	 * Constructor. Create the control socket and the shared-memory segment of the given clock instance.
+	 * @throw std::runtime_error If another engine is already running for this instance, or if the resources cannot be created.
+	 */
+	explicit ClockEngine(unsigned int clock_id=0);
+
+	/**
+	 * Destructor.
+	 */
+	~ClockEngine();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	ClockEngine(const ClockEngine &op) = delete;
+	ClockEngine &operator=(const ClockEngine &op) = delete;
+	/**@} */
+
+	/**
+	 * Set the initial time control (typically the one of the preferences). The clients may change it afterwards.
+	 */
+	void set_time_control(const TimeControl &time_control) { _bi_timer.set_time_control(time_control); }
+
+	/**
+	 * Stream the clock state to the local network subscribers (see `BroadcastServer`).
+	 * @throw std::runtime_error If the broadcast sockets cannot be created.
+	 */
+	void enable_broadcast(const std::string &address, std::uint16_t port);
+
+	/**
+	 * Express the instants of the broadcast stream on the time base of the given time-base server (see `TimeSyncClient`).
+	 * @throw std::runtime_error If the time-base client cannot be created.
+	 */
+	void enable_time_sync(const std::string &server_address);
+
+	/**
+	 * Read the keyboards directly from the input devices (see `EvdevReader`), instead of relying on the key events
+	 * forwarded by the UI clients. The switches are then applied at the instant stamped by the kernel.
+	 * @param devices Devices to read (all the keyboards if empty), in addition to the ones referred to by the routes.
+	 * @param routes  Routing rules of the devices (see `InputRouter`): the events routed to other clock instances are ignored.
+	 * @throw std::runtime_error If no input device can be opened.
+	 * @throw std::invalid_argument If the routing rules are malformed.
+	 */
+	void enable_evdev(const std::vector<std::string> &devices=std::vector<std::string>(), const std::string &routes=std::string());
+
+	/**
+	 * Configure the debounce of the key presses (see `PressFilter`) and the arbitration window between the presses
+	 * of both players (see `SwitchArbiter`).
+	 * @throw std::invalid_argument If the debounce rules are malformed.
+	 */
+	void configure_input_filters(const std::string &debounce_rules, const TimeDuration &arbitration_window);
+
+	/**
+	 * Switch the input path to the real-time mode: promote the calling thread (which must be the one calling `run()`)
+	 * and the reader thread of the input devices, and lock the memory. To be called last, right before `run()`.
+	 * The steps that cannot be applied are listed in `RealtimeMode::warnings()`.
+	 */
+	void enable_realtime(RealtimeMode &realtime);
+
+	/**
+	 * Serve the clients until SIGINT or SIGTERM is received.
+	 */
+	void run();
+
+private:
+
+	// Connected client.
+	struct Client
+	{
+		int      fd       ;
+		KeyState keys_down;
+	};
+
+	// Private functions
+	void accept_client();
+	bool process_message(Client &client, const EngineMessage &message);
+	void on_key_pressed(KeyState &keys_down, ScanCode scan_code, const TimePoint &at);
+	void on_raw_key_event(const RawKeyEvent &event);
+	void on_state_changed();
+	void broadcast(const EngineMessage &message);
+	void swap_sides();
+	std::string execute_command(const ClockCommand &command);
+
+	// Private members
+	unsigned int                      _clock_id        ;
+	int                               _server_fd       ;
+	int                               _signal_pipe[2]  ;
+	std::string                       _socket_path     ;
+	std::unique_ptr<SharedClockState> _shared_state    ;
+	std::unique_ptr<TimeSyncClient>   _time_sync_client; // <- Declared before `_broadcast_server`, which refers to it.
+	std::unique_ptr<BroadcastServer>  _broadcast_server;
+	std::unique_ptr<CommandServer>    _command_server  ;
+	std::unique_ptr<EvdevReader>      _evdev_reader    ;
+	KeyState                          _evdev_keys_down ;
+	InputRouter                       _input_router    ;
+	PressFilter                       _press_filter    ;
+	std::vector<Client>               _clients         ;
+	BiTimer                           _bi_timer        ;
+	SwitchArbiter                     _switch_arbiter  ; // <- Declared after `_bi_timer`, which it refers to.
+	ShortcutManager                   _shortcut_manager;
+	Enum::array<Side, std::string>    _player_names    ;
+	TimeControl                       _time_control    ; // Time control last announced to the clients.
+};
+
+#endif /* CLOCKENGINE_H_ */
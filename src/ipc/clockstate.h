@@ -0,0 +1,156 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef VCC_CLOCKSTATE_H_
+#define VCC_CLOCKSTATE_H_
+
+/*
+ * Public C interface to the live clock state exported by Virtual Chess Clock.
+ *
+ * vcc publishes the state of its clock into the POSIX shared-memory segment named "/vcc-clock-<uid>"
+ * (<uid> being the numeric ID of the user running vcc, followed by "-<id>" for the headless engines
+ * started with `--clock-id=<id>`) each time the clock changes (start, stop, change of side, reset,
+ * etc...). Nothing is written while the timers simply run: the current time of each side is computed
+ * by the readers from the base time and the reference instant, so that reading the clock costs
+ * no system call at all.
+ *
+ * Typical usage:
+ *
+ *     int fd = shm_open("/vcc-clock-1000", O_RDONLY, 0);
+ *     const struct vcc_clock_state *shared = mmap(NULL, sizeof(struct vcc_clock_state), PROT_READ, MAP_SHARED, fd, 0);
+ *     struct vcc_clock_state snapshot;
+ *     if(vcc_clock_state_read(shared, &snapshot)) {
+ *         int64_t left_ns = vcc_clock_state_time_ns(&snapshot, VCC_SIDE_LEFT, vcc_clock_monotonic_ns());
+ *     }
+ *
+ * The segment is written by a single process and protected by a sequence lock: `sequence` is odd
+ * while a snapshot is being written, and incremented again once the snapshot is complete.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define VCC_CLOCK_STATE_MAGIC        0x56434b53u /* "VCKS" */
+#define VCC_CLOCK_STATE_VERSION      1u
+#define VCC_CLOCK_STATE_NAME_PREFIX  "/vcc-clock-"
+#define VCC_CLOCK_STATE_NAME_SIZE    64
+
+
+/* Sides of the clock. */
+#define VCC_SIDE_NONE  (-1)
+#define VCC_SIDE_LEFT    0
+#define VCC_SIDE_RIGHT   1
+
+/* Time control modes. */
+#define VCC_MODE_SUDDEN_DEATH  0u
+#define VCC_MODE_FISCHER       1u
+#define VCC_MODE_BRONSTEIN     2u
+#define VCC_MODE_HOURGLASS     3u
+#define VCC_MODE_BYO_YOMI      4u
+
+/* Timer modes. */
+#define VCC_TIMER_INCREMENT  0u /* The time increases from the reference instant (hourglass mode). */
+#define VCC_TIMER_DECREMENT  1u /* The time decreases from the reference instant.                 */
+#define VCC_TIMER_PAUSED     2u /* The time does not change.                                      */
+
+
+/* State of one side of the clock. All the durations are expressed in nanoseconds. */
+struct vcc_clock_side
+{
+	int64_t  base_time_ns      ; /* Time of the timer at the reference instant (negative after a timeout). */
+	int64_t  main_time_ns      ; /* Main time of the time control.                                          */
+	int64_t  increment_ns      ; /* Increment (Fischer, Bronstein) or byo-yomi period duration.             */
+	int64_t  bronstein_limit_ns; /* Bronstein mode: value that the time cannot exceed.                      */
+	int32_t  byo_periods       ; /* Byo-yomi mode: number of byo-yomi periods.                              */
+	uint32_t timer_mode        ; /* One of the VCC_TIMER_* constants.                                       */
+	char     name[VCC_CLOCK_STATE_NAME_SIZE]; /* Player's name (UTF-8, NUL-terminated, possibly truncated). */
+};
+
+
+/* Layout of the shared-memory segment. */
+struct vcc_clock_state
+{
+	uint32_t              sequence         ; /* Sequence lock (0 if nothing has been published yet).    */
+	uint32_t              magic            ; /* VCC_CLOCK_STATE_MAGIC.                                  */
+	uint32_t              version          ; /* VCC_CLOCK_STATE_VERSION.                                */
+	uint32_t              time_control_mode; /* One of the VCC_MODE_* constants.                        */
+	int32_t               active_side      ; /* VCC_SIDE_LEFT, VCC_SIDE_RIGHT, or VCC_SIDE_NONE.        */
+	uint32_t              reserved         ;
+	int64_t               reference_ns     ; /* Reference instant, on the CLOCK_MONOTONIC time base.    */
+	struct vcc_clock_side side[2]          ;
+};
+
+
+/* Current CLOCK_MONOTONIC time, in nanoseconds (served by the vDSO on Linux: no system call). */
+static inline int64_t vcc_clock_monotonic_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/* Copy a consistent snapshot of the shared state into `snapshot`.
+ * Returns 0 if nothing has been published yet or if the segment is not compatible, 1 otherwise. */
+static inline int vcc_clock_state_read(const struct vcc_clock_state *shared, struct vcc_clock_state *snapshot)
+{
+	for(;;) {
+		uint32_t before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+		if(before==0) {
+			return 0;
+		}
+		if(before & 1u) {
+			continue;
+		}
+		memcpy(snapshot, shared, sizeof(*snapshot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED)==before) {
+			return snapshot->magic==VCC_CLOCK_STATE_MAGIC && snapshot->version==VCC_CLOCK_STATE_VERSION;
+		}
+	}
+}
+
+
+/* Time of the given side at the instant `now_ns` (CLOCK_MONOTONIC time base), in nanoseconds. */
+static inline int64_t vcc_clock_state_time_ns(const struct vcc_clock_state *snapshot, int side, int64_t now_ns)
+{
+	const struct vcc_clock_side *data = &snapshot->side[side];
+	int64_t elapsed = now_ns - snapshot->reference_ns;
+	switch(data->timer_mode) {
+		case VCC_TIMER_INCREMENT: return data->base_time_ns + elapsed;
+		case VCC_TIMER_DECREMENT: return data->base_time_ns - elapsed;
+		default: return data->base_time_ns;
+	}
+}
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* VCC_CLOCKSTATE_H_ */
@@ -0,0 +1,351 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "commandserver.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// Maximal length of a command line.
+static const std::size_t MAX_LINE_LENGTH = 4096;
+
+// Size of the backlog of replies above which the commands of a client are not read anymore.
+static const std::size_t MAX_BACKLOG = 1 << 20;
+
+
+// Path of the command socket.
+std::string command_socket_path(unsigned int clock_id)
+{
+	std::string suffix = clock_id==0 ? std::string() : "-" + std::to_string(clock_id);
+	const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+	if(runtime_dir!=nullptr && *runtime_dir!='\0') {
+		return std::string(runtime_dir) + "/vcc-command" + suffix + ".sock";
+	}
+	return "/tmp/vcc-command-" + std::to_string(getuid()) + suffix + ".sock";
+}
+
+
+// Close the socket of a connection.
+CommandServer::Connection::~Connection()
+{
+	close(fd);
+}
+
+
+// Constructor.
+CommandServer::CommandServer(const std::string &path) :
+	_path(path), _server_fd(-1), _notify_fd(-1), _stop_fd(-1), _epoll_fd(-1), _stopping(false)
+{
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(_path.size()>=sizeof(address.sun_path)) {
+		throw std::runtime_error("The command socket path is too long.");
+	}
+	std::strcpy(address.sun_path, _path.c_str());
+
+	// Refuse to start if another process is listening on the socket; otherwise remove the stale socket file, if any.
+	int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(probe>=0) {
+		bool in_use = connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address))==0;
+		close(probe);
+		if(in_use) {
+			throw std::runtime_error("Another process is already listening on the command socket.");
+		}
+	}
+	unlink(_path.c_str());
+
+	try
+	{
+		_server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(_server_fd<0 || bind(_server_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))!=0 || listen(_server_fd, 16)!=0) {
+			throw std::runtime_error("Unable to create the command socket.");
+		}
+		_notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		_stop_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		_epoll_fd  = epoll_create1(EPOLL_CLOEXEC);
+		if(_notify_fd<0 || _stop_fd<0 || _epoll_fd<0) {
+			throw std::runtime_error("Unable to create the command server event loop.");
+		}
+		for(int fd : {_server_fd, _stop_fd}) {
+			epoll_event event;
+			event.events  = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		}
+	}
+	catch(...) {
+		for(int fd : {_server_fd, _notify_fd, _stop_fd, _epoll_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		unlink(_path.c_str());
+		throw;
+	}
+
+	_thread = std::thread(&CommandServer::run, this);
+}
+
+
+// Destructor.
+CommandServer::~CommandServer()
+{
+	_stopping = true;
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_stop_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+
+	_connections.clear();
+	for(int fd : {_server_fd, _notify_fd, _stop_fd, _epoll_fd}) {
+		close(fd);
+	}
+	unlink(_path.c_str());
+}
+
+
+// Execute the pending commands, and send the replies.
+std::size_t CommandServer::process(const std::function<std::string(const ClockCommand &)> &handler)
+{
+	std::uint64_t buffer;
+	ssize_t ignored = read(_notify_fd, &buffer, sizeof(buffer));
+	(void)ignored;
+
+	// Execute the commands, and gather the replies per connection.
+	std::vector<std::shared_ptr<Connection>> touched;
+	std::size_t retval = 0;
+	for(Request request; _requests.pop(request); ++retval) {
+		std::string reply;
+		if(request.error.empty()) {
+			try {
+				reply = handler(request.command);
+			}
+			catch(std::exception &err) {
+				reply = std::string("error ") + err.what();
+			}
+		}
+		else {
+			reply = "error " + request.error;
+		}
+		if(request.connection->output.empty()) {
+			touched.push_back(request.connection);
+		}
+		request.connection->output += reply;
+		request.connection->output += '\n';
+	}
+
+	// Send the replies (the I/O thread takes care of what cannot be sent immediately).
+	for(const auto &connection : touched) {
+		std::lock_guard<std::mutex> lock(connection->mutex);
+		if(!send_replies(*connection, connection->output)) {
+			shutdown(connection->fd, SHUT_RDWR); // <- The I/O thread detects the end of the connection.
+		}
+		connection->output.clear();
+	}
+	return retval;
+}
+
+
+// Send some replies after the backlog, or append them to the backlog. Must be called with the connection mutex locked.
+// Return false if the connection is broken.
+bool CommandServer::send_replies(Connection &connection, const std::string &data)
+{
+	std::size_t offset = 0;
+	if(connection.backlog.empty()) {
+		while(offset<data.size()) {
+			ssize_t sent = send(connection.fd, data.data()+offset, data.size()-offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if(sent<0) {
+				if(errno==EINTR) {
+					continue;
+				}
+				if(errno!=EAGAIN && errno!=EWOULDBLOCK) {
+					return false;
+				}
+				break;
+			}
+			offset += sent;
+		}
+	}
+	connection.backlog.append(data, offset, std::string::npos);
+	update_events(connection);
+	return true;
+}
+
+
+// Watch the events matching the state of the backlog. Must be called with the connection mutex locked.
+void CommandServer::update_events(Connection &connection)
+{
+	std::uint32_t events = 0;
+	if(!connection.backlog.empty()) {
+		events |= EPOLLOUT;
+	}
+	if(connection.backlog.size()<=MAX_BACKLOG) {
+		events |= EPOLLIN;
+	}
+	if(events!=connection.events) {
+		epoll_event event;
+		event.events  = events;
+		event.data.fd = connection.fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+		connection.events = events;
+	}
+}
+
+
+// Event loop of the I/O thread.
+void CommandServer::run()
+{
+	std::vector<epoll_event> events(64);
+	while(!_stopping) {
+		int count = epoll_wait(_epoll_fd, events.data(), events.size(), -1);
+		if(count<0 && errno!=EINTR) {
+			break;
+		}
+		bool notify = false;
+		for(int k=0; k<count; ++k) {
+			int fd = events[k].data.fd;
+			if(fd==_stop_fd) {
+				continue;
+			}
+			if(fd==_server_fd) {
+				accept_connection();
+				continue;
+			}
+			auto it = _connections.find(fd);
+			if(it==_connections.end()) {
+				continue;
+			}
+			if(events[k].events & EPOLLOUT) {
+				std::lock_guard<std::mutex> lock(it->second->mutex);
+				std::string backlog;
+				backlog.swap(it->second->backlog);
+				if(!send_replies(*it->second, backlog)) {
+					shutdown(fd, SHUT_RDWR);
+				}
+			}
+
+			// No more commands are read while the backlog is full (EPOLLIN is not watched in that case,
+			// and EPOLLOUT alone must not trigger a read), only the end of the connection.
+			if((events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !read_connection(it->second, notify)) {
+				epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+				_connections.erase(it);
+			}
+		}
+
+		// Wake up the consumer once per batch of events.
+		if(notify) {
+			std::uint64_t one = 1;
+			ssize_t ignored = write(_notify_fd, &one, sizeof(one));
+			(void)ignored;
+		}
+	}
+}
+
+
+// Accept the pending connections.
+void CommandServer::accept_connection()
+{
+	while(true) {
+		int fd = accept4(_server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd<0) {
+			return;
+		}
+		epoll_event event;
+		event.events  = EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		_connections[fd] = std::make_shared<Connection>(fd);
+		_connections[fd]->events = EPOLLIN;
+	}
+}
+
+
+// Read the available data, and queue the complete command lines. Return false if the connection must be closed.
+bool CommandServer::read_connection(const std::shared_ptr<Connection> &connection, bool &pushed)
+{
+	char buffer[16384];
+	while(true) {
+		ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+		if(received==0) {
+			return false;
+		}
+		if(received<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			return errno==EAGAIN || errno==EWOULDBLOCK;
+		}
+		connection->input.append(buffer, received);
+
+		// Parse the complete lines.
+		std::size_t begin = 0;
+		for(std::size_t end; (end = connection->input.find('\n', begin))!=std::string::npos; begin = end+1) {
+			std::string line = connection->input.substr(begin, end-begin);
+			if(!line.empty() && line.back()=='\r') {
+				line.pop_back();
+			}
+			Request request;
+			request.connection = connection;
+			try {
+				request.command = parse_clock_command(line);
+			}
+			catch(std::invalid_argument &err) {
+				request.error = err.what();
+			}
+			_requests.push(std::move(request));
+			pushed = true;
+		}
+		connection->input.erase(0, begin);
+		if(connection->input.size()>MAX_LINE_LENGTH) {
+			return false;
+		}
+	}
+}
+
+#else
+
+// Unix-domain sockets are not available: the server cannot be started.
+std::string command_socket_path(unsigned int) { return std::string(); }
+CommandServer::Connection::~Connection() {}
+
+CommandServer::CommandServer(const std::string &path) :
+	_path(path), _server_fd(-1), _notify_fd(-1), _stop_fd(-1), _epoll_fd(-1), _stopping(true)
+{
+	throw std::runtime_error("The command socket is not supported on this platform.");
+}
+
+CommandServer::~CommandServer() {}
+std::size_t CommandServer::process(const std::function<std::string(const ClockCommand &)> &) { return 0; }
+
+#endif /* OS_IS_UNIX */
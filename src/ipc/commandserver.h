@@ -0,0 +1,134 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef COMMANDSERVER_H_
+#define COMMANDSERVER_H_
+
+#include "clockcommand.h"
+#include <core/mpscqueue.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+/**
+ * Path of the command socket of the given clock instance.
+ */
+std::string command_socket_path(unsigned int clock_id=0);
+
+
+/**
+ * Unix-domain socket accepting text commands, for scripted and arbiter control of the clock (see `ClockCommand`).
+ *
+ * The connections are served by a dedicated I/O thread, which splits the received data into lines, parses them,
+ * and pushes the resulting commands into a lock-free queue; the owner of the timers executes them by calling
+ * `process()` from its own thread, when the descriptor `notify_fd()` becomes readable. The commands are pipelined:
+ * a client may send any number of commands without waiting for the replies, which are sent back in order,
+ * one line per command. All the replies produced by a call to `process()` are sent with a single write per client;
+ * if the client does not read them fast enough, the remainder is sent by the I/O thread, which stops reading
+ * new commands from this client until its backlog of replies is small enough.
+ *
+ * Only available on Unix platforms.
+ */
+class CommandServer
+{
+public:
+
+	/**
+	 * Constructor. Create the socket, and start the I/O thread.
+	 * @throw std::runtime_error If another process is already listening on the socket, or if it cannot be created.
+	 */
+	explicit CommandServer(const std::string &path=command_socket_path());
+
+	/**
+	 * Destructor. Stop the I/O thread, close the connections and remove the socket file.
+	 */
+	~CommandServer();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	CommandServer(const CommandServer &op) = delete;
+	CommandServer &operator=(const CommandServer &op) = delete;
+	/**@} */
+
+	/**
+	 * Descriptor that becomes readable when some commands are waiting to be processed.
+	 */
+	int notify_fd() const { return _notify_fd; }
+
+	/**
+	 * Execute the pending commands with `handler`, and send the replies.
+	 * @returns Number of processed commands.
+	 */
+	std::size_t process(const std::function<std::string(const ClockCommand &)> &handler);
+
+private:
+
+	// Client connection (the socket is closed when the last reference is released).
+	struct Connection
+	{
+		explicit Connection(int f) : fd(f), events(0) {}
+		~Connection();
+		int           fd     ;
+		std::string   input  ; // Received data not forming a complete line yet (I/O thread only).
+		std::string   output ; // Replies produced by the current call to `process()` (consumer thread only).
+		std::mutex    mutex  ;
+		std::string   backlog; // Replies that could not be sent immediately (protected by `mutex`).
+		std::uint32_t events ; // Events currently watched by the I/O thread (protected by `mutex`).
+	};
+
+	// Request queued by the I/O thread.
+	struct Request
+	{
+		std::shared_ptr<Connection> connection;
+		ClockCommand                command   ;
+		std::string                 error     ; // Non-empty if the line could not be parsed.
+	};
+
+	// Private functions
+	void run();
+	void accept_connection();
+	bool read_connection(const std::shared_ptr<Connection> &connection, bool &pushed);
+	bool send_replies(Connection &connection, const std::string &data);
+	void update_events(Connection &connection);
+
+	// Private members
+	std::string        _path      ;
+	int                _server_fd ;
+	int                _notify_fd ;
+	int                _stop_fd   ;
+	int                _epoll_fd  ;
+	std::atomic<bool>  _stopping  ;
+	MPSCQueue<Request> _requests  ;
+	std::thread        _thread    ;
+	std::map<int, std::shared_ptr<Connection>> _connections; // I/O thread only.
+};
+
+#endif /* COMMANDSERVER_H_ */
@@ -0,0 +1,405 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "enginematch.h"
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef OS_IS_UNIX
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// Maximal delay granted to the engines to answer the initialization commands (in milliseconds).
+static const int INIT_TIMEOUT = 10000;
+
+// Maximal delay granted to the engines to exit after the `quit` command (in milliseconds).
+static const int QUIT_TIMEOUT = 1000;
+
+
+// Split a line into whitespace-separated tokens.
+static std::vector<std::string> tokenize(const std::string &line)
+{
+	std::vector<std::string> retval;
+	std::istringstream stream(line);
+	std::string token;
+	while(stream >> token) {
+		retval.push_back(token);
+	}
+	return retval;
+}
+
+
+// Constructor.
+EngineMatch::EngineMatch(const std::string &white_command, const std::string &black_command, const TimeControl &time_control, int max_plies) :
+	_epoll_fd(-1), _max_plies(max_plies)
+{
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		_engines[*s] = Engine{-1, -1, -1, std::string(), false};
+	}
+	_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(_epoll_fd<0) {
+		throw std::runtime_error("Unable to create the match event loop.");
+	}
+	std::signal(SIGPIPE, SIG_IGN); // <- An engine that exits must not kill the match: the write simply fails.
+	try {
+		spawn(Side::LEFT , white_command);
+		spawn(Side::RIGHT, black_command);
+	}
+	catch(...) {
+		terminate();
+		throw;
+	}
+	_bi_timer.set_time_control(time_control);
+}
+
+
+// Destructor.
+EngineMatch::~EngineMatch()
+{
+	terminate();
+}
+
+
+// Terminate the engine processes, and release the resources.
+void EngineMatch::terminate()
+{
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		Engine &engine(_engines[*s]);
+		if(engine.pid<0) {
+			continue;
+		}
+		send(*s, "quit");
+		close(engine.input_fd);
+		close(engine.output_fd);
+		int status;
+		int waited = 0;
+		while(waitpid(engine.pid, &status, WNOHANG)==0 && waited<QUIT_TIMEOUT) {
+			usleep(10000);
+			waited += 10;
+		}
+		if(waited>=QUIT_TIMEOUT) {
+			kill(engine.pid, SIGKILL);
+			waitpid(engine.pid, &status, 0);
+		}
+		engine.pid = -1;
+	}
+	if(_epoll_fd>=0) {
+		close(_epoll_fd);
+		_epoll_fd = -1;
+	}
+}
+
+
+// Start the process of an engine.
+void EngineMatch::spawn(Side side, const std::string &command)
+{
+	int to_child[2];
+	int from_child[2];
+	if(pipe2(to_child, O_CLOEXEC)!=0) {
+		throw std::runtime_error("Unable to create the engine pipes.");
+	}
+	if(pipe2(from_child, O_CLOEXEC)!=0) {
+		close(to_child[0]);
+		close(to_child[1]);
+		throw std::runtime_error("Unable to create the engine pipes.");
+	}
+
+	int pid = fork();
+	if(pid==0) {
+		dup2(to_child[0], STDIN_FILENO);
+		dup2(from_child[1], STDOUT_FILENO);
+		execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+		_exit(127);
+	}
+	close(to_child[0]);
+	close(from_child[1]);
+	if(pid<0) {
+		close(to_child[1]);
+		close(from_child[0]);
+		throw std::runtime_error("Unable to start the engine: " + command);
+	}
+
+	Engine &engine(_engines[side]);
+	engine.pid       = pid;
+	engine.input_fd  = to_child[1];
+	engine.output_fd = from_child[0];
+	fcntl(engine.output_fd, F_SETFL, fcntl(engine.output_fd, F_GETFL) | O_NONBLOCK);
+	epoll_event event;
+	event.events   = EPOLLIN;
+	event.data.u32 = Enum::to_value(side);
+	epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, engine.output_fd, &event);
+}
+
+
+// Play the game.
+EngineMatch::Result EngineMatch::play()
+{
+	Result retval;
+	retval.result = "*";
+
+	// Initialization
+	for(const char *command : { "uci", "isready" }) {
+		send(Side::LEFT , command);
+		send(Side::RIGHT, command);
+		if(!wait_for(std::string(command)=="uci" ? "uciok" : "readyok", INIT_TIMEOUT)) {
+			retval.reason = "engine initialization failed";
+			return retval;
+		}
+	}
+	send(Side::LEFT , "ucinewgame");
+	send(Side::RIGHT, "ucinewgame");
+
+	// Game loop
+	std::string position = "position startpos moves";
+	Side        to_move  = Side::LEFT;
+	_bi_timer.reset_timers();
+	_bi_timer.start_timer(to_move, current_time());
+	send(to_move, "position startpos");
+	send(to_move, go_command());
+	auto finish = [&](const char *result, const char *reason) {
+		_bi_timer.stop_timer();
+		retval.result = result;
+		retval.reason = reason;
+	};
+	while(true) {
+
+		// Flag fall
+		TimeDuration remaining = _bi_timer.time(to_move);
+		if(remaining<TIME_DURATION_ZERO) {
+			finish(to_move==Side::LEFT ? "0-1" : "1-0", "time forfeit");
+			return retval;
+		}
+
+		// Wait for the engines (at most until the flag of the side to move falls).
+		std::vector<Line> lines;
+		Side closed = to_move;
+		int timeout = static_cast<int>(remaining.total_milliseconds()) + 1;
+		if(!read_lines(timeout, lines, closed)) {
+			finish(closed==Side::LEFT ? "0-1" : "1-0", "engine exited");
+			return retval;
+		}
+
+		for(const Line &line : lines) {
+			std::vector<std::string> tokens = tokenize(line.text);
+			if(tokens.empty()) {
+				continue;
+			}
+
+			// Mate scores, used to tell checkmate from stalemate when an engine has no legal move.
+			if(tokens[0]=="info") {
+				for(std::size_t k=0; k+2<tokens.size(); ++k) {
+					if(tokens[k]=="score") {
+						_engines[line.side].mated = tokens[k+1]=="mate" && tokens[k+2]=="0";
+					}
+				}
+				continue;
+			}
+			if(tokens[0]!="bestmove" || line.side!=to_move) {
+				continue;
+			}
+
+			// Move received: switch the clock at the instant the line has been read.
+			if(_bi_timer.time(to_move, line.at)<TIME_DURATION_ZERO) {
+				finish(to_move==Side::LEFT ? "0-1" : "1-0", "time forfeit");
+				return retval;
+			}
+			if(tokens.size()<2 || tokens[1]=="(none)" || tokens[1]=="0000") {
+				if(_engines[to_move].mated) {
+					finish(to_move==Side::LEFT ? "0-1" : "1-0", "checkmate");
+				}
+				else {
+					finish("1/2-1/2", "stalemate");
+				}
+				return retval;
+			}
+			_bi_timer.change_timer(line.at);
+			retval.moves.push_back(tokens[1]);
+			position += " " + tokens[1];
+			if(static_cast<int>(retval.moves.size())>=_max_plies) {
+				finish("1/2-1/2", "move limit");
+				return retval;
+			}
+			to_move = flip(to_move);
+			send(to_move, position);
+			send(to_move, go_command());
+		}
+	}
+}
+
+
+// Send a command to an engine.
+void EngineMatch::send(Side side, const std::string &command)
+{
+	std::string line = command + "\n";
+	for(std::size_t offset=0; offset<line.size(); ) {
+		ssize_t written = write(_engines[side].input_fd, line.data()+offset, line.size()-offset);
+		if(written<0 && errno==EINTR) {
+			continue;
+		}
+		if(written<=0) {
+			return; // <- The engine has exited: this will be detected on its output.
+		}
+		offset += written;
+	}
+}
+
+
+// Wait until both engines have sent a line starting with the given token.
+bool EngineMatch::wait_for(const std::string &token, int timeout)
+{
+	Enum::array<Side, bool> received;
+	received[Side::LEFT ] = false;
+	received[Side::RIGHT] = false;
+	TimePoint deadline = current_time() + boost::posix_time::milliseconds(timeout);
+	while(!received[Side::LEFT] || !received[Side::RIGHT]) {
+		int remaining = static_cast<int>((deadline - current_time()).total_milliseconds());
+		std::vector<Line> lines;
+		Side closed;
+		if(remaining<=0 || !read_lines(remaining, lines, closed)) {
+			return false;
+		}
+		for(const Line &line : lines) {
+			std::vector<std::string> tokens = tokenize(line.text);
+			if(!tokens.empty() && tokens[0]==token) {
+				received[line.side] = true;
+			}
+		}
+	}
+	return true;
+}
+
+
+// Read the lines available on the outputs of the engines (waiting at most `timeout` milliseconds if there are none).
+// Return false if the output of one of the engines has been closed.
+bool EngineMatch::read_lines(int timeout, std::vector<Line> &lines, Side &closed)
+{
+	epoll_event events[2];
+	int count = epoll_wait(_epoll_fd, events, 2, timeout);
+	TimePoint at = current_time(); // <- Stamped before anything is read or parsed.
+	for(int k=0; k<count; ++k) {
+		Side    side = Enum::from_value<Side>(events[k].data.u32);
+		Engine &engine(_engines[side]);
+		while(true) {
+			char buffer[4096];
+			ssize_t received = read(engine.output_fd, buffer, sizeof(buffer));
+			if(received==0) {
+				closed = side;
+				return false;
+			}
+			if(received<0) {
+				break;
+			}
+			engine.buffer.append(buffer, received);
+		}
+		for(std::size_t end=engine.buffer.find('\n'); end!=std::string::npos; end=engine.buffer.find('\n')) {
+			std::string text = engine.buffer.substr(0, end);
+			if(!text.empty() && text.back()=='\r') {
+				text.pop_back();
+			}
+			lines.push_back(Line{side, text, at});
+			engine.buffer.erase(0, end+1);
+		}
+	}
+	return true;
+}
+
+
+// Build the `go` command corresponding to the current state of the timers.
+std::string EngineMatch::go_command() const
+{
+	const TimeControl &time_control(_bi_timer.time_control());
+	bool has_increment = time_control.mode()==TimeControl::Mode::FISCHER || time_control.mode()==TimeControl::Mode::BRONSTEIN;
+	std::ostringstream retval;
+	retval << "go wtime " << std::max<long>(0, _bi_timer.time(Side::LEFT ).total_milliseconds())
+		<< " btime " << std::max<long>(0, _bi_timer.time(Side::RIGHT).total_milliseconds())
+		<< " winc " << (has_increment ? time_control.increment(Side::LEFT ).total_milliseconds() : 0)
+		<< " binc " << (has_increment ? time_control.increment(Side::RIGHT).total_milliseconds() : 0);
+	return retval.str();
+}
+
+#else
+
+// Processes and pipes are not supported on this platform.
+EngineMatch::EngineMatch(const std::string &, const std::string &, const TimeControl &, int max_plies) : _epoll_fd(-1), _max_plies(max_plies)
+{
+	throw std::runtime_error("The engine matches are not supported on this platform.");
+}
+
+EngineMatch::~EngineMatch() {}
+void EngineMatch::terminate() {}
+EngineMatch::Result EngineMatch::play() { return Result(); }
+
+#endif /* OS_IS_UNIX */
+
+
+// Scripted UCI engine.
+void run_uci_stub(std::istream &input, std::ostream &output, int think_time, int plies)
+{
+	static const char *SHUFFLE[2][2] = { { "g1f3", "f3g1" }, { "g8f6", "f6g8" } };
+	int played = 0; // Number of moves of the last position.
+	std::string line;
+	while(std::getline(input, line)) {
+		std::istringstream tokens(line);
+		std::string command;
+		tokens >> command;
+		if(command=="uci") {
+			output << "id name vcc-uci-stub\nuciok" << std::endl;
+		}
+		else if(command=="isready") {
+			output << "readyok" << std::endl;
+		}
+		else if(command=="position") {
+			played = 0;
+			std::string token;
+			bool moves = false;
+			while(tokens >> token) {
+				if(moves) {
+					++played;
+				}
+				moves = moves || token=="moves";
+			}
+		}
+		else if(command=="go") {
+			std::this_thread::sleep_for(std::chrono::milliseconds(think_time));
+			if(played>=plies) {
+				output << "info score mate 0\nbestmove (none)" << std::endl;
+			}
+			else {
+				output << "info score cp 0\nbestmove " << SHUFFLE[played%2][(played/2)%2] << std::endl;
+			}
+		}
+		else if(command=="quit") {
+			return;
+		}
+	}
+}
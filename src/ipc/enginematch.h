@@ -0,0 +1,140 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef ENGINEMATCH_H_
+#define ENGINEMATCH_H_
+
+#include <core/bitimer.h>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+
+/**
+ * Game between two UCI chess engines, timed by a `BiTimer` (`vcc --match`).
+ *
+ * Each engine runs in its own process, and communicates with the match through its standard input and output.
+ * White plays on the left side of the clock. Each time an engine sends its `bestmove`, the clock is switched
+ * at the instant at which the line has been read (not when it has been processed), the move is appended to the
+ * game, and the other engine receives the new position with a `go wtime btime winc binc` command built from the
+ * live state of the timers. The output of both engines is multiplexed by a single epoll loop, whose timeout is
+ * the remaining time of the side to move, so that flag falls are detected without polling.
+ *
+ * The match does not know the rules of chess: the moves are not validated, and a game ends when an engine
+ * runs out of time, exits, or reports that it has no legal move (`bestmove (none)` or `bestmove 0000`, scored
+ * as a loss if its last `info` line was `score mate 0`, as a stalemate otherwise), or when the move limit is reached.
+ *
+ * Only available on Unix platforms.
+ */
+class EngineMatch
+{
+public:
+
+	/**
+	 * Outcome of a game.
+	 */
+	struct Result
+	{
+		std::string              result; //!< "1-0", "0-1", "1/2-1/2", or "*" if the game has been interrupted.
+		std::string              reason; //!< Human-readable termination reason.
+		std::vector<std::string> moves ; //!< Moves played, in UCI notation.
+	};
+
+	/**
+	 * Constructor. Start the engine processes (each command being run by `/bin/sh -c`).
+	 * @param max_plies Number of half-moves after which the game is adjudicated as a draw.
+	 * @throw std::runtime_error If the processes cannot be started.
+	 */
+	EngineMatch(const std::string &white_command, const std::string &black_command, const TimeControl &time_control, int max_plies=600);
+
+	/**
+	 * Destructor. Terminate the engine processes.
+	 */
+	~EngineMatch();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	EngineMatch(const EngineMatch &op) = delete;
+	EngineMatch &operator=(const EngineMatch &op) = delete;
+	/**@} */
+
+	/**
+	 * Timers of the game (e.g. to publish their state). Their signals are fired from the thread calling `play()`.
+	 */
+	const BiTimer &bi_timer() const { return _bi_timer; }
+
+	/**
+	 * Initialize the engines, play the game, and return its outcome. Blocks until the game is over.
+	 */
+	Result play();
+
+private:
+
+	// Engine process.
+	struct Engine
+	{
+		int          pid       ;
+		int          input_fd  ; // Standard input of the engine (write end).
+		int          output_fd ; // Standard output of the engine (read end, non-blocking).
+		std::string  buffer    ; // Incomplete line received from the engine.
+		bool         mated     ; // Whether the last `info` line reported `score mate 0`.
+	};
+
+	// Line received from an engine.
+	struct Line
+	{
+		Side        side;
+		std::string text;
+		TimePoint   at  ; // Instant at which the line has been read.
+	};
+
+	// Private functions
+	void terminate();
+	void spawn(Side side, const std::string &command);
+	void send(Side side, const std::string &command);
+	bool wait_for(const std::string &token, int timeout);
+	bool read_lines(int timeout, std::vector<Line> &lines, Side &closed);
+	std::string go_command() const;
+
+	// Private members
+	Enum::array<Side, Engine> _engines  ;
+	int                       _epoll_fd ;
+	int                       _max_plies;
+	BiTimer                   _bi_timer ;
+};
+
+
+
+/**
+ * Scripted UCI engine (`vcc --uci-stub[=<think>[:<plies>]]`), so that `vcc --match` can be run without a real engine.
+ *
+ * The stub reads the UCI commands from `input` and answers on `output`: each `go` command is answered after `think_time`
+ * milliseconds with the next move of a knight shuffle (Ng1-f3-g1 for White, Ng8-f6-g8 for Black, all legal moves), until
+ * the position holds `plies` moves: the side to move then reports a checkmate (`info score mate 0`, `bestmove (none)`).
+ * Returns when `quit` is received or when `input` is closed.
+ */
+void run_uci_stub(std::istream &input, std::ostream &output, int think_time=10, int plies=40);
+
+#endif /* ENGINEMATCH_H_ */
@@ -0,0 +1,170 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "engineprotocol.h"
+#include <core/clockcodec.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+	#include <sys/socket.h>
+	#include <sys/types.h>
+	#include <unistd.h>
+#endif
+
+
+// Header of an encoded message.
+struct EncodedHeader
+{
+	std::uint32_t type         ;
+	std::uint32_t argument     ;
+	std::uint32_t payload_count;
+	std::uint32_t text_size    ;
+};
+
+
+// Build a SET_TIME_CONTROL message.
+EngineMessage make_time_control_message(const TimeControl &time_control, EngineMessageType type)
+{
+	EngineMessage retval(type);
+	retval.text = encode_time_control(time_control);
+	return retval;
+}
+
+
+// Decode a SET_TIME_CONTROL message.
+TimeControl parse_time_control_message(const EngineMessage &message)
+{
+	return TimeControlView(message.text.data(), message.text.size()).decode();
+}
+
+
+// Build a SET_SHORTCUTS message.
+EngineMessage make_shortcuts_message(const ShortcutManager &shortcut_manager)
+{
+	EngineMessage retval(EngineMessageType::SET_SHORTCUTS);
+	retval.payload.push_back(shortcut_manager.modifier_key(Side::LEFT ));
+	retval.payload.push_back(shortcut_manager.modifier_key(Side::RIGHT));
+	for(const auto &it : shortcut_manager.table()) {
+		retval.payload.push_back(it.scan_code    );
+		retval.payload.push_back(it.shortcut_low );
+		retval.payload.push_back(it.shortcut_high);
+	}
+	return retval;
+}
+
+
+// Decode a SET_SHORTCUTS message.
+void parse_shortcuts_message(const EngineMessage &message, ShortcutManager &shortcut_manager)
+{
+	if(message.payload.size()<2 || (message.payload.size()-2)%3!=0) {
+		throw std::invalid_argument("Malformed shortcut table message.");
+	}
+	Enum::array<Side, ScanCode> modifier_key;
+	modifier_key[Side::LEFT ] = static_cast<ScanCode>(message.payload[0]);
+	modifier_key[Side::RIGHT] = static_cast<ScanCode>(message.payload[1]);
+	std::vector<ShortcutManager::Entry> table;
+	for(std::size_t k=2; k<message.payload.size(); k+=3) {
+		table.push_back(ShortcutManager::Entry{
+			static_cast<ScanCode>(message.payload[k]),
+			static_cast<int>(message.payload[k+1]),
+			static_cast<int>(message.payload[k+2])
+		});
+	}
+	shortcut_manager.reset(modifier_key, table);
+}
+
+
+#ifdef OS_IS_UNIX
+
+// Path to the engine control socket of the current user.
+std::string engine_socket_path(unsigned int clock_id)
+{
+	std::string suffix = clock_id==0 ? std::string() : "-" + std::to_string(clock_id);
+	const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+	if(runtime_dir!=nullptr && *runtime_dir!='\0') {
+		return std::string(runtime_dir) + "/vcc-engine" + suffix + ".sock";
+	}
+	return "/tmp/vcc-engine-" + std::to_string(getuid()) + suffix + ".sock";
+}
+
+
+// Send a message.
+bool send_engine_message(int fd, const EngineMessage &message)
+{
+	EncodedHeader header{static_cast<std::uint32_t>(message.type), message.argument,
+		static_cast<std::uint32_t>(message.payload.size()), static_cast<std::uint32_t>(message.text.size())};
+	std::size_t payload_size = message.payload.size()*sizeof(std::int64_t);
+	std::vector<char> buffer(sizeof(header) + payload_size + message.text.size());
+	if(buffer.size()>ENGINE_MESSAGE_MAX_SIZE) {
+		return false;
+	}
+	std::memcpy(buffer.data(), &header, sizeof(header));
+	if(!message.payload.empty()) {
+		std::memcpy(buffer.data() + sizeof(header), message.payload.data(), payload_size);
+	}
+	std::copy(message.text.begin(), message.text.end(), buffer.begin() + sizeof(header) + payload_size);
+	while(true) {
+		ssize_t sent = send(fd, buffer.data(), buffer.size(), MSG_NOSIGNAL);
+		if(sent>=0) {
+			return static_cast<std::size_t>(sent)==buffer.size();
+		}
+		if(errno!=EINTR) {
+			return false;
+		}
+	}
+}
+
+
+// Receive a message.
+bool receive_engine_message(int fd, EngineMessage &message)
+{
+	std::vector<char> buffer(ENGINE_MESSAGE_MAX_SIZE);
+	ssize_t received = 0;
+	do {
+		received = recv(fd, buffer.data(), buffer.size(), 0);
+	}
+	while(received<0 && errno==EINTR);
+	if(received<static_cast<ssize_t>(sizeof(EncodedHeader))) {
+		return false;
+	}
+
+	EncodedHeader header;
+	std::memcpy(&header, buffer.data(), sizeof(header));
+	std::size_t payload_size = static_cast<std::size_t>(header.payload_count)*sizeof(std::int64_t);
+	if(sizeof(header) + payload_size + header.text_size != static_cast<std::size_t>(received)) {
+		return false;
+	}
+	message.type     = static_cast<EngineMessageType>(header.type);
+	message.argument = header.argument;
+	message.payload.resize(header.payload_count);
+	if(header.payload_count>0) {
+		std::memcpy(message.payload.data(), buffer.data() + sizeof(header), payload_size);
+	}
+	message.text.assign(buffer.data() + sizeof(header) + payload_size, header.text_size);
+	return true;
+}
+
+#endif /* OS_IS_UNIX */
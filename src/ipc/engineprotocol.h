@@ -0,0 +1,129 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef ENGINEPROTOCOL_H_
+#define ENGINEPROTOCOL_H_
+
+#include <core/keys.h>
+#include <core/side.h>
+#include <core/timecontrol.h>
+#include <core/shortcutmanager.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Messages exchanged between the clock engine (see `ClockEngine`) and its UI clients
+ * over the engine control socket.
+ */
+enum class EngineMessageType : std::uint32_t
+{
+	// Client -> engine
+	HELLO            = 1, //!< First message sent by a client (argument: protocol version).
+	KEY_PRESSED      = 2, //!< A key has been pressed (argument: scan-code).
+	KEY_RELEASED     = 3, //!< A key has been released (argument: scan-code).
+	START_TIMER      = 4, //!< Start the timer of the given side (argument: side).
+	STOP_TIMER       = 5, //!< Stop the active timer.
+	RESET_TIMERS     = 6, //!< Reset the timers.
+	SWAP_SIDES       = 7, //!< Swap the sides.
+	SET_TIME_CONTROL = 8, //!< Change the time control (text: see `make_time_control_message()`).
+	SET_SHORTCUTS    = 9, //!< Change the shortcut table (payload: see `make_shortcuts_message()`).
+	SET_PLAYER_NAME  = 10, //!< Change the name of a player (argument: side, text: name).
+
+	// Engine -> client
+	STATE_CHANGED        = 101, //!< The shared clock state has been updated (argument: sequence number).
+	SIDES_SWAPPED        = 102, //!< The sides have been swapped (the client is expected to swap the players' names).
+	TIME_CONTROL_CHANGED = 103  //!< Time control of the engine, sent when it changes and after HELLO (text: as `SET_TIME_CONTROL`).
+};
+
+
+/**
+ * Message exchanged over the engine control socket.
+ */
+struct EngineMessage
+{
+	EngineMessageType         type    ;
+	std::uint32_t             argument;
+	std::vector<std::int64_t> payload ;
+	std::string               text    ;
+
+	/**
+	 * Constructor.
+	 */
+	explicit EngineMessage(EngineMessageType t = EngineMessageType::HELLO, std::uint32_t arg = 0) : type(t), argument(arg) {}
+};
+
+
+/**
+ * Version of the protocol, sent with the `HELLO` message.
+ */
+const std::uint32_t ENGINE_PROTOCOL_VERSION = 3;
+
+/**
+ * Largest encoded message size (in bytes).
+ */
+const std::size_t ENGINE_MESSAGE_MAX_SIZE = 64*1024;
+
+
+/**
+ * Path to the engine control socket of the current user, for the given clock instance
+ * (several engines may run side by side, see the `--clock-id` option).
+ */
+std::string engine_socket_path(unsigned int clock_id=0);
+
+/**
+ * Build a `SET_TIME_CONTROL` message (the text holds the time control record, see `encode_time_control()`),
+ * or a `TIME_CONTROL_CHANGED` message.
+ */
+EngineMessage make_time_control_message(const TimeControl &time_control, EngineMessageType type=EngineMessageType::SET_TIME_CONTROL);
+
+/**
+ * Decode the time control carried by a `SET_TIME_CONTROL` or `TIME_CONTROL_CHANGED` message.
+ * @throw std::invalid_argument If the message is malformed.
+ */
+TimeControl parse_time_control_message(const EngineMessage &message);
+
+/**
+ * Build a `SET_SHORTCUTS` message.
+ */
+EngineMessage make_shortcuts_message(const ShortcutManager &shortcut_manager);
+
+/**
+ * Configure a shortcut manager with the table carried by a `SET_SHORTCUTS` message.
+ * @throw std::invalid_argument If the message is malformed.
+ */
+void parse_shortcuts_message(const EngineMessage &message, ShortcutManager &shortcut_manager);
+
+/**
+ * Send a message on a `SOCK_SEQPACKET` socket.
+ * @returns `false` if the message could not be sent (typically because the peer is gone).
+ */
+bool send_engine_message(int fd, const EngineMessage &message);
+
+/**
+ * Receive a message from a `SOCK_SEQPACKET` socket.
+ * @returns `false` if the peer has closed the connection, or if an invalid message has been received.
+ */
+bool receive_engine_message(int fd, EngineMessage &message);
+
+#endif /* ENGINEPROTOCOL_H_ */
@@ -0,0 +1,215 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "sharedclockstate.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+	#include <fcntl.h>
+	#include <sys/file.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+#ifdef OS_IS_UNIX
+
+// Name of the segment of the current user.
+std::string SharedClockState::default_name(unsigned int clock_id)
+{
+	std::string retval = VCC_CLOCK_STATE_NAME_PREFIX + std::to_string(getuid());
+	return clock_id==0 ? retval : retval + "-" + std::to_string(clock_id);
+}
+
+
+// Open the segment to create, and lock it (the owner holds the lock as long as it publishes into the segment).
+// Return -1 if another process owns the segment.
+static int open_owned_segment(const std::string &name)
+{
+	for(int attempt=0; attempt<3; ++attempt) {
+		int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		if(fd<0) {
+			throw std::runtime_error("Unable to open the shared clock state segment.");
+		}
+		if(flock(fd, LOCK_EX | LOCK_NB)!=0) {
+			close(fd);
+			if(errno==EWOULDBLOCK) {
+				return -1;
+			}
+			throw std::runtime_error("Unable to lock the shared clock state segment.");
+		}
+
+		// The previous owner may have removed the segment between `shm_open()` and `flock()`: open it again.
+		struct stat info;
+		if(fstat(fd, &info)==0 && info.st_nlink>0) {
+			return fd;
+		}
+		close(fd);
+	}
+	throw std::runtime_error("Unable to open the shared clock state segment.");
+}
+
+
+// Constructor.
+SharedClockState::SharedClockState(const std::string &name, bool owner) : _name(name), _owner(owner), _fd(-1), _data(nullptr)
+{
+	// A segment whose owner is still running is not taken over (the stale segment of a process that has crashed is).
+	_fd = owner ? open_owned_segment(name) : shm_open(name.c_str(), O_RDONLY, 0);
+	if(_fd<0) {
+		throw std::runtime_error(owner ? "Another process is already publishing the clock state in the shared segment." :
+			"Unable to open the shared clock state segment.");
+	}
+	if(owner && ftruncate(_fd, sizeof(vcc_clock_state))!=0) {
+		shm_unlink(name.c_str());
+		close(_fd);
+		throw std::runtime_error("Unable to resize the shared clock state segment.");
+	}
+	struct stat info;
+	if(!owner && (fstat(_fd, &info)!=0 || static_cast<std::size_t>(info.st_size)<sizeof(vcc_clock_state))) {
+		close(_fd);
+		throw std::runtime_error("Invalid shared clock state segment.");
+	}
+	void *address = mmap(nullptr, sizeof(vcc_clock_state), owner ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, 0);
+	if(address==MAP_FAILED) {
+		if(owner) {
+			shm_unlink(name.c_str());
+		}
+		close(_fd);
+		throw std::runtime_error("Unable to map the shared clock state segment.");
+	}
+	if(!owner) {
+		close(_fd);
+		_fd = -1;
+	}
+	_data = static_cast<vcc_clock_state *>(address);
+	if(owner) {
+		std::memset(_data, 0, sizeof(vcc_clock_state)); // <- Content left by a previous owner, if any.
+		_data->magic   = VCC_CLOCK_STATE_MAGIC  ;
+		_data->version = VCC_CLOCK_STATE_VERSION;
+	}
+}
+
+
+// Destructor.
+SharedClockState::~SharedClockState()
+{
+	munmap(_data, sizeof(vcc_clock_state));
+	if(_owner) {
+		shm_unlink(_name.c_str()); // <- Before releasing the lock, so that the next owner does not get a removed segment.
+		close(_fd);
+	}
+}
+
+
+// Create the segment.
+std::unique_ptr<SharedClockState> SharedClockState::create(const std::string &name)
+{
+	return std::unique_ptr<SharedClockState>(new SharedClockState(name, true));
+}
+
+
+// Map an existing segment.
+std::unique_ptr<SharedClockState> SharedClockState::open(const std::string &name)
+{
+	return std::unique_ptr<SharedClockState>(new SharedClockState(name, false));
+}
+
+
+// Publish a new snapshot.
+std::uint32_t SharedClockState::publish(const BiTimer::State &state, const Enum::array<Side, std::string> &names)
+{
+	// The timer values are those at `state.reference`: find the corresponding instant on the monotonic time base.
+	std::int64_t reference_ns = vcc_clock_monotonic_ns() - (current_time() - state.reference).total_microseconds()*1000;
+
+	std::uint32_t sequence = __atomic_load_n(&_data->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&_data->sequence, sequence+1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	_data->reference_ns      = reference_ns;
+	_data->time_control_mode = Enum::to_value(state.time_control.mode());
+	_data->active_side       = state.active_side ? Enum::to_value(*state.active_side) : VCC_SIDE_NONE;
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		vcc_clock_side &target(_data->side[Enum::to_value(*s)]);
+		target.base_time_ns       = state.time[*s].total_microseconds()*1000;
+		target.main_time_ns       = state.time_control.main_time(*s).total_microseconds()*1000;
+		target.increment_ns       = state.time_control.increment(*s).total_microseconds()*1000;
+		target.bronstein_limit_ns = state.bronstein_limit[*s].total_microseconds()*1000;
+		target.byo_periods        = state.time_control.byo_periods(*s);
+		target.timer_mode         = static_cast<std::uint32_t>(state.mode[*s]);
+		std::size_t length = std::min(names[*s].size(), static_cast<std::size_t>(VCC_CLOCK_STATE_NAME_SIZE-1));
+		std::memset(target.name, 0, VCC_CLOCK_STATE_NAME_SIZE);
+		std::memcpy(target.name, names[*s].data(), length);
+	}
+
+	__atomic_store_n(&_data->sequence, sequence+2, __ATOMIC_RELEASE);
+	return sequence+2;
+}
+
+
+// Read the last published snapshot.
+bool SharedClockState::read(BiTimer::State &state) const
+{
+	vcc_clock_state snapshot;
+	if(!vcc_clock_state_read(_data, &snapshot)) {
+		return false;
+	}
+
+	// Convert the monotonic reference instant into a time point.
+	state.reference = current_time() - boost::posix_time::microseconds((vcc_clock_monotonic_ns() - snapshot.reference_ns)/1000);
+
+	state.time_control.set_mode(Enum::from_value<TimeControl::Mode>(snapshot.time_control_mode));
+	state.active_side = boost::none;
+	if(snapshot.active_side!=VCC_SIDE_NONE) {
+		state.active_side = Enum::from_value<Side>(snapshot.active_side);
+	}
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		const vcc_clock_side &source(snapshot.side[Enum::to_value(*s)]);
+		state.time_control.set_main_time  (*s, boost::posix_time::microseconds(source.main_time_ns/1000));
+		state.time_control.set_increment  (*s, boost::posix_time::microseconds(source.increment_ns/1000));
+		state.time_control.set_byo_periods(*s, source.byo_periods);
+		state.mode           [*s] = static_cast<Timer::Mode>(source.timer_mode);
+		state.time           [*s] = boost::posix_time::microseconds(source.base_time_ns/1000);
+		state.bronstein_limit[*s] = boost::posix_time::microseconds(source.bronstein_limit_ns/1000);
+	}
+	return true;
+}
+
+#else
+
+// POSIX shared memory is not available: the segment can be neither created nor opened.
+SharedClockState::SharedClockState(const std::string &, bool) : _owner(false), _fd(-1), _data(nullptr)
+{
+	throw std::runtime_error("Shared clock state segments are not supported on this platform.");
+}
+
+SharedClockState::~SharedClockState() {}
+std::string SharedClockState::default_name(unsigned int) { return VCC_CLOCK_STATE_NAME_PREFIX; }
+std::unique_ptr<SharedClockState> SharedClockState::create(const std::string &name) { return std::unique_ptr<SharedClockState>(new SharedClockState(name, true )); }
+std::unique_ptr<SharedClockState> SharedClockState::open  (const std::string &name) { return std::unique_ptr<SharedClockState>(new SharedClockState(name, false)); }
+std::uint32_t SharedClockState::publish(const BiTimer::State &, const Enum::array<Side, std::string> &) { return 0; }
+bool SharedClockState::read(BiTimer::State &) const { return false; }
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,100 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef SHAREDCLOCKSTATE_H_
+#define SHAREDCLOCKSTATE_H_
+
+#include "clockstate.h"
+#include <core/bitimer.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+/**
+ * Clock state shared between processes through a POSIX shared-memory segment.
+ *
+ * A single process (the writer) creates the segment and publishes `BiTimer` snapshots into it.
+ * The other processes map it read-only. The layout of the segment is the public one defined in
+ * `clockstate.h`, so that third-party tools can read it without linking anything.
+ */
+class SharedClockState
+{
+public:
+
+	/**
+	 * Name of the segment of the current user (`VCC_CLOCK_STATE_NAME_PREFIX` followed by the user ID),
+	 * for the given clock instance (the ID of the instance being appended if not 0).
+	 */
+	static std::string default_name(unsigned int clock_id=0);
+
+	/**
+	 * Create the segment with the given name (or take over the segment left by a process that has crashed),
+	 * and map it for writing. The segment is locked as long as the object exists, and removed when it is destroyed.
+	 * @throw std::runtime_error If the segment cannot be created, or if another process publishes into it.
+	 */
+	static std::unique_ptr<SharedClockState> create(const std::string &name);
+
+	/**
+	 * Map the existing segment with the given name for reading.
+	 * @throw std::runtime_error If the segment does not exist or is invalid.
+	 */
+	static std::unique_ptr<SharedClockState> open(const std::string &name);
+
+	/**
+	 * Destructor.
+	 */
+	~SharedClockState();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	SharedClockState(const SharedClockState &op) = delete;
+	SharedClockState &operator=(const SharedClockState &op) = delete;
+	/**@} */
+
+	/**
+	 * Publish a new snapshot. Must be called only on a segment obtained through `create()`.
+	 * @returns The sequence number of the published snapshot.
+	 */
+	std::uint32_t publish(const BiTimer::State &state, const Enum::array<Side, std::string> &names);
+
+	/**
+	 * Read the last published snapshot.
+	 * @returns `false` if nothing has been published yet.
+	 */
+	bool read(BiTimer::State &state) const;
+
+private:
+
+	// Constructor
+	SharedClockState(const std::string &name, bool owner);
+
+	// Private members
+	std::string      _name ;
+	bool             _owner;
+	int              _fd   ; // Owner only: locked as long as the segment is published.
+	vcc_clock_state *_data ;
+};
+
+#endif /* SHAREDCLOCKSTATE_H_ */
@@ -21,6 +21,9 @@
 
 
 #include "abstractmodel.h"
+#include <core/taskscheduler.h>
+#include <core/metrics.h>
+#include <exception>
 
 
 // Register the given constant property.
@@ -53,6 +56,43 @@ void AbstractModel::save()
 }
 
 
+// Block until the background write operations are completed.
+void AbstractModel::flush()
+{
+	_pending_write.get();
+}
+
+
+// Execute the given write operation in the task scheduler, after the previously scheduled ones.
+void AbstractModel::schedule_write(std::function<void()> write)
+{
+	static const Metrics::Histogram save_duration = Metrics::instance().histogram("vcc_config_save_duration_seconds",
+		"Duration of the writes of the configuration files.");
+	static const Metrics::Counter save_errors = Metrics::instance().counter("vcc_config_save_errors_total",
+		"Failed writes of the configuration files.");
+
+	// The failure of a write is reported to the main thread when it happens: the next write does not look at
+	// the previous one, and `flush()` only sees the last one (to which the exception is still forwarded).
+	_pending_write = _pending_write.continue_with(TaskScheduler::instance(), [this, write](const Future<void> &) {
+		Metrics::ScopedTimer timer(save_duration);
+		try {
+			write();
+		}
+		catch(const std::exception &err) {
+			save_errors.increment();
+			std::string message = err.what();
+			MainThreadExecutor::instance().post([this, message]() { _signal_save_failed(message); });
+			throw;
+		}
+		catch(...) {
+			save_errors.increment();
+			MainThreadExecutor::instance().post([this]() { _signal_save_failed("unknown error"); });
+			throw;
+		}
+	});
+}
+
+
 // Handler called when one of the registered property is saved.
 void AbstractModel::on_property_saved()
 {
@@ -23,8 +23,11 @@
 #ifndef ABSTRACTMODEL_H_
 #define ABSTRACTMODEL_H_
 
+#include <functional>
 #include <set>
+#include <string>
 #include <core/property.h>
+#include <core/future.h>
 
 
 /**
@@ -54,12 +57,26 @@ public:
 	 */
 	void save();
 
+	/**
+	 * Block until the write operations scheduled in the background are completed.
+	 * @throw std::runtime_error If the last of them has failed.
+	 */
+	void flush();
+
+	/**
+	 * Signal triggered in the main thread (with the error message) when a write operation has failed.
+	 */
+	sig::connection connect_save_failed(const sig::signal<void(const std::string &)>::slot_type &slot) const
+	{
+		return _signal_save_failed.connect(slot);
+	}
+
 protected:
 
 	/**
 	 * Constructor.
 	 */
-	AbstractModel() : _shunt_saved(false) {}
+	AbstractModel() : _shunt_saved(false), _pending_write(make_ready_future()) {}
 
 	/**
 	 * Register the given constant property.
@@ -76,14 +93,24 @@ protected:
 	 */
 	virtual void finalize_save() {}
 
+	/**
+	 * Execute the given write operation in the task scheduler. The write operations of a model
+	 * are executed one after the other, in the order they are scheduled.
+	 */
+	void schedule_write(std::function<void()> write);
+
 private:
 
 	// Private methods
 	void on_property_saved();
 
 	// Private members
-	bool _shunt_saved;
+	bool                                  _shunt_saved          ;
 	std::set<AbstractReadWriteProperty *> _read_write_properties;
+	Future<void>                          _pending_write        ;
+
+	// Signals
+	mutable sig::signal<void(const std::string &)> _signal_save_failed;
 };
 
 #endif /* ABSTRACTMODEL_H_ */
@@ -23,6 +23,7 @@
 #include "modelkeyboard.h"
 #include "modelpaths.h"
 #include "modelappinfo.h"
+#include <core/taskscheduler.h>
 #include <stdexcept>
 #include <boost/property_tree/xml_parser.hpp>
 
@@ -45,17 +46,97 @@ const KeyboardMap &ModelKeyboard::keyboard_map(const std::string &id)
 	ensure_id_exists(id);
 	auto it = _keyboard_maps.find(id);
 	if(it==_keyboard_maps.end()) {
-		try {
-			return _keyboard_maps[id].load(ModelPaths::instance().share_path() + "/keyboard-maps/" + id + ".kbm");
-		}
-		catch(boost::property_tree::ptree_error &) {
-			throw std::runtime_error("An error has occurred while reading a keyboard map file.");
-		}
+		Future<KeyboardMap> pending = fetch_keyboard_map(id);
+		_pending_maps.erase(id); // <- A failed load can be retried.
+		return store_keyboard_map(id, pending.get());
 	}
 	return it->second;
 }
 
 
+// Return the keyboard map corresponding to the given ID, without blocking.
+Future<const KeyboardMap *> ModelKeyboard::keyboard_map_async(const std::string &id)
+{
+	ensure_id_exists(id);
+	auto it = _keyboard_maps.find(id);
+	if(it!=_keyboard_maps.end()) {
+		return make_ready_future(static_cast<const KeyboardMap *>(&it->second));
+	}
+	return fetch_keyboard_map(id).then(MainThreadExecutor::instance(), [this, id](const KeyboardMap &keyboard_map) {
+		return &store_keyboard_map(id, keyboard_map);
+	});
+}
+
+
+// Load the `ids` property without blocking.
+Future<void> ModelKeyboard::ids_async()
+{
+	if(ids.loaded()) {
+		return make_ready_future();
+	}
+	prefetch(); // <- No-op if the index file is already being read.
+	return _index.then(MainThreadExecutor::instance(), [this](const std::vector<IndexEntry> &) {
+		ids.load(); // <- The index file has been read: this does not block.
+	});
+}
+
+
+// Start reading the keyboard index file in the background.
+void ModelKeyboard::prefetch()
+{
+	if(_index.valid()) {
+		return;
+	}
+	std::string path = index_file();
+	_index = TaskScheduler::instance().submit([path]() { return parse_index_file(path); });
+}
+
+
+// Read a keyboard map file again in the background.
+void ModelKeyboard::reload_keyboard_map(const std::string &id)
+{
+	if(_keyboard_maps.count(id)==0) {
+		return; // <- The map will be read from the new file when it is needed.
+	}
+
+	// A file that cannot be parsed (e.g. because it is being written) is ignored: the current map is kept.
+	std::string path = keyboard_map_file(id);
+	TaskScheduler::instance().submit([path]() { return parse_keyboard_map(path); }).then(MainThreadExecutor::instance(), [this, id](const KeyboardMap &keyboard_map) {
+		_keyboard_maps[id] = keyboard_map;
+		_signal_keyboard_map_reloaded(id);
+	});
+}
+
+
+// Path to the keyboard map file corresponding to the given ID.
+std::string ModelKeyboard::keyboard_map_file(const std::string &id)
+{
+	return ModelPaths::instance().share_path() + "/keyboard-maps/" + id + ".kbm";
+}
+
+
+// Start loading the given keyboard map in the background (if not already started).
+Future<KeyboardMap> ModelKeyboard::fetch_keyboard_map(const std::string &id)
+{
+	auto it = _pending_maps.find(id);
+	if(it!=_pending_maps.end()) {
+		return it->second;
+	}
+	std::string path = keyboard_map_file(id);
+	Future<KeyboardMap> retval = TaskScheduler::instance().submit([path]() { return parse_keyboard_map(path); });
+	_pending_maps[id] = retval;
+	return retval;
+}
+
+
+// Register a loaded keyboard map in the cache.
+const KeyboardMap &ModelKeyboard::store_keyboard_map(const std::string &id, const KeyboardMap &keyboard_map)
+{
+	_pending_maps.erase(id);
+	return _keyboard_maps.insert(std::make_pair(id, keyboard_map)).first->second;
+}
+
+
 // Throw an exception if the given keyboard ID exists and is registered in the keyboard index file.
 void ModelKeyboard::ensure_id_exists(const std::string &id)
 {
@@ -86,21 +167,68 @@ void ModelKeyboard::load_default_id(std::string &target)
 
 
 void ModelKeyboard::load_ids(std::set<std::string> &target)
+{
+	prefetch(); // <- No-op if the index file is already being read.
+	for(const auto &entry : _index.get()) {
+		load_keyboard(target, entry);
+	}
+}
+
+
+void ModelKeyboard::load_keyboard(std::set<std::string> &target, const IndexEntry &entry)
+{
+	// QIcon objects must be created in the main thread.
+	_names[entry.id] = entry.name;
+	_icons[entry.id] = entry.icon.empty() ? QIcon() : QIcon(QString::fromStdString(ModelPaths::instance().share_path() + "/flags/" + entry.icon));
+
+	// List the locales for which the keyboard will be considered as the default one.
+	for(const auto &locale : entry.locales) {
+		if(locale=="*") {
+			_wildcard_id = entry.id;
+		}
+		else {
+			_locale_to_id[locale] = entry.id;
+		}
+	}
+
+	// Register the keyboard in the list of available keyboards.
+	target.insert(entry.id);
+}
+
+
+
+// *****************************************************************************
+// Background parsing
+// *****************************************************************************
+
+
+std::vector<ModelKeyboard::IndexEntry> ModelKeyboard::parse_index_file(const std::string &path)
 {
 	try
 	{
 		// Read the keyboard index file
 		boost::property_tree::ptree keyboard_index;
-		boost::property_tree::read_xml(index_file(), keyboard_index, boost::property_tree::xml_parser::trim_whitespace);
+		boost::property_tree::read_xml(path, keyboard_index, boost::property_tree::xml_parser::trim_whitespace);
 
 		// Iterates over the list of keyboards
+		std::vector<IndexEntry> retval;
 		const boost::property_tree::ptree &keyboards(keyboard_index.get_child("keyboards"));
 		for(const auto &it : keyboards) {
 			if(it.first!="keyboard") {
 				continue;
 			}
-			load_keyboard(target, it.second);
+			IndexEntry entry;
+			entry.id   = it.second.get<std::string>("id"  );
+			entry.name = it.second.get<std::string>("name");
+			entry.icon = it.second.get<std::string>("icon");
+			for(const auto &locale : it.second.get_child("locales")) {
+				if(locale.first=="locale") {
+					entry.locales.push_back(locale.second.get_value<std::string>());
+				}
+			}
+			retval.push_back(std::move(entry));
 		}
+		return retval;
 	}
 
 	// The keyboard index file must be readable.
@@ -110,28 +238,14 @@ void ModelKeyboard::load_ids(std::set<std::string> &target)
 }
 
 
-void ModelKeyboard::load_keyboard(std::set<std::string> &target, const boost::property_tree::ptree &keyboard)
+KeyboardMap ModelKeyboard::parse_keyboard_map(const std::string &path)
 {
-	// Read the ID/name/icon data associated to the given keyboard.
-	std::string id   = keyboard.get<std::string>("id"  );
-	std::string icon = keyboard.get<std::string>("icon");
-	_names[id] = keyboard.get<std::string>("name");
-	_icons[id] = icon.empty() ? QIcon() : QIcon(QString::fromStdString(ModelPaths::instance().share_path() + "/flags/" + icon));
-
-	// List the locales for which the keyboard will be considered as the default one.
-	for(const auto &it : keyboard.get_child("locales")) {
-		if(it.first!="locale") {
-			continue;
-		}
-		std::string locale = it.second.get_value<std::string>();
-		if(locale=="*") {
-			_wildcard_id = id;
-		}
-		else {
-			_locale_to_id[locale] = id;
-		}
+	try {
+		KeyboardMap retval;
+		retval.load(path);
+		return retval;
+	}
+	catch(boost::property_tree::ptree_error &) {
+		throw std::runtime_error("An error has occurred while reading a keyboard map file.");
 	}
-
-	// Register the keyboard in the list of available keyboards.
-	target.insert(std::move(id));
 }
@@ -26,11 +26,12 @@
 #include "abstractmodel.h"
 #include <core/singleton.h>
 #include <core/keyboardmap.h>
+#include <core/future.h>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 #include <QIcon>
-#include <boost/property_tree/ptree.hpp>
 
 
 /**
@@ -69,11 +70,55 @@ public:
 
 	/**
 	 * Return the keyboard map corresponding to the given ID.
+	 * If the map is not loaded yet, the call blocks until it is.
 	 */
 	const KeyboardMap &keyboard_map(const std::string &id);
 
+	/**
+	 * Return the keyboard map corresponding to the given ID, without blocking. The map is loaded by the
+	 * task scheduler if necessary, and the returned future becomes ready in the main thread.
+	 * The `ids` property must be loaded (see `ids_async()`).
+	 */
+	Future<const KeyboardMap *> keyboard_map_async(const std::string &id);
+
+	/**
+	 * Load the `ids` property (and `default_id`) without blocking: the keyboard index file is read by the task
+	 * scheduler if necessary, and the returned future becomes ready in the main thread once the property is loaded.
+	 */
+	Future<void> ids_async();
+
+	/**
+	 * Start reading the keyboard index file in the background, so that the IDs are available
+	 * (or almost available) when they are needed.
+	 */
+	void prefetch();
+
+	/**
+	 * Read the keyboard map file corresponding to the given ID again in the background (typically because it has been
+	 * modified by another program), and replace the cached map once it has been parsed. The map is replaced in place,
+	 * so the references returned by `keyboard_map()` remain valid. Nothing is done if the map is not loaded yet.
+	 */
+	void reload_keyboard_map(const std::string &id);
+
+	/**
+	 * Signal triggered (with the ID of the keyboard) when a keyboard map has been reloaded.
+	 */
+	sig::connection connect_keyboard_map_reloaded(const sig::signal<void(const std::string &)>::slot_type &slot) const
+	{
+		return _signal_keyboard_map_reloaded.connect(slot);
+	}
+
 private:
 
+	// Content of a <keyboard></keyboard> node in the keyboard index file.
+	struct IndexEntry
+	{
+		std::string              id     ;
+		std::string              name   ;
+		std::string              icon   ;
+		std::vector<std::string> locales;
+	};
+
 	// Constructor
 	ModelKeyboard();
 
@@ -81,17 +126,29 @@ private:
 	void load_index_file(std::string           &target);
 	void load_default_id(std::string           &target);
 	void load_ids       (std::set<std::string> &target);
-	void load_keyboard  (std::set<std::string> &target, const boost::property_tree::ptree &keyboard);
+	void load_keyboard  (std::set<std::string> &target, const IndexEntry &entry);
+
+	// Background parsing (executed by the task scheduler)
+	static std::vector<IndexEntry> parse_index_file  (const std::string &path);
+	static KeyboardMap             parse_keyboard_map(const std::string &path);
 
 	// Private methods
 	void ensure_id_exists(const std::string &id);
+	static std::string keyboard_map_file(const std::string &id);
+	Future<KeyboardMap> fetch_keyboard_map(const std::string &id);
+	const KeyboardMap &store_keyboard_map(const std::string &id, const KeyboardMap &keyboard_map);
 
 	// Private members
-	std::map<std::string, std::string> _names        ;
-	std::map<std::string, QIcon      > _icons        ;
-	std::map<std::string, std::string> _locale_to_id ;
-	std::string                        _wildcard_id  ;
-	std::map<std::string, KeyboardMap> _keyboard_maps;
+	Future<std::vector<IndexEntry>>            _index        ;
+	std::map<std::string, Future<KeyboardMap>> _pending_maps ;
+	std::map<std::string, std::string>         _names        ;
+	std::map<std::string, QIcon      >         _icons        ;
+	std::map<std::string, std::string>         _locale_to_id ;
+	std::string                                _wildcard_id  ;
+	std::map<std::string, KeyboardMap>         _keyboard_maps;
+
+	// Signals
+	mutable sig::signal<void(const std::string &)> _signal_keyboard_map_reloaded;
 };
 
 #endif /* MODELKEYBOARD_H_ */
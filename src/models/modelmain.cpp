@@ -57,7 +57,19 @@ ModelMain::ModelMain() :
 	DECLARE_READ_WRITE(modifier_keys               ),
 	DECLARE_READ_WRITE(left_player                 ),
 	DECLARE_READ_WRITE(right_player                ),
-	DECLARE_READ_WRITE(show_player_names           )
+	DECLARE_READ_WRITE(show_player_names           ),
+	DECLARE_READ_WRITE(broadcast_enabled           ),
+	DECLARE_READ_WRITE(broadcast_address           ),
+	DECLARE_READ_WRITE(broadcast_port              ),
+	DECLARE_READ_WRITE(time_sync_server            ),
+	DECLARE_READ_WRITE(metrics_enabled             ),
+	DECLARE_READ_WRITE(metrics_port                ),
+	DECLARE_READ_WRITE(evdev_enabled               ),
+	DECLARE_READ_WRITE(input_routes                ),
+	DECLARE_READ_WRITE(input_debounce              ),
+	DECLARE_READ_WRITE(input_arbitration           ),
+	DECLARE_READ_WRITE(realtime_enabled            ),
+	DECLARE_READ_WRITE(realtime_cpu                )
 {
 	register_property(config_file                 );
 	register_property(time_control                );
@@ -73,6 +85,18 @@ ModelMain::ModelMain() :
 	register_property(left_player                 );
 	register_property(right_player                );
 	register_property(show_player_names           );
+	register_property(broadcast_enabled           );
+	register_property(broadcast_address           );
+	register_property(broadcast_port              );
+	register_property(time_sync_server            );
+	register_property(metrics_enabled             );
+	register_property(metrics_port                );
+	register_property(evdev_enabled               );
+	register_property(input_routes                );
+	register_property(input_debounce              );
+	register_property(input_arbitration           );
+	register_property(realtime_enabled            );
+	register_property(realtime_cpu                );
 
 	// Load the file if it exists.
 	if(boost::filesystem::exists(config_file())) {
@@ -98,14 +122,18 @@ void ModelMain::finalize_save()
 	// Create the parent folder if necessary.
 	ModelPaths::instance().ensure_config_path_exists();
 
-	// Write the file
-	try {
-		boost::property_tree::xml_writer_settings<ptree::key_type> settings('\t', 1);
-		boost::property_tree::write_xml(config_file(), _data, std::locale(), settings);
-	}
-	catch(boost::property_tree::xml_parser_error &) {
-		throw std::runtime_error("An error has occurred while writing the preference file.");
-	}
+	// Write a snapshot of the configuration tree in the background.
+	std::string path = config_file();
+	ptree       data = _data;
+	schedule_write([path, data]() {
+		try {
+			boost::property_tree::xml_writer_settings<ptree::key_type> settings('\t', 1);
+			boost::property_tree::write_xml(path, data, std::locale(), settings);
+		}
+		catch(boost::property_tree::xml_parser_error &) {
+			throw std::runtime_error("An error has occurred while writing the preference file.");
+		}
+	});
 }
 
 
@@ -309,3 +337,147 @@ void ModelMain::save_show_player_names(bool value)
 {
 	_root->put("players.show-names", value);
 }
+
+
+void ModelMain::load_broadcast_enabled(bool &target)
+{
+	target = _root->get("network.broadcast", false);
+}
+
+
+void ModelMain::save_broadcast_enabled(bool value)
+{
+	_root->put("network.broadcast", value);
+}
+
+
+void ModelMain::load_broadcast_address(std::string &target)
+{
+	target = _root->get("network.address", std::string("127.0.0.1"));
+}
+
+
+void ModelMain::save_broadcast_address(const std::string &value)
+{
+	_root->put("network.address", value);
+}
+
+
+void ModelMain::load_broadcast_port(int &target)
+{
+	target = _root->get("network.port", 12080);
+}
+
+
+void ModelMain::save_broadcast_port(int value)
+{
+	_root->put("network.port", value);
+}
+
+
+void ModelMain::load_time_sync_server(std::string &target)
+{
+	target = _root->get("network.time-sync", std::string());
+}
+
+
+void ModelMain::save_time_sync_server(const std::string &value)
+{
+	_root->put("network.time-sync", value);
+}
+
+
+void ModelMain::load_metrics_enabled(bool &target)
+{
+	target = _root->get("network.metrics", false);
+}
+
+
+void ModelMain::save_metrics_enabled(bool value)
+{
+	_root->put("network.metrics", value);
+}
+
+
+void ModelMain::load_metrics_port(int &target)
+{
+	target = _root->get("network.metrics-port", 9464);
+}
+
+
+void ModelMain::save_metrics_port(int value)
+{
+	_root->put("network.metrics-port", value);
+}
+
+
+void ModelMain::load_evdev_enabled(bool &target)
+{
+	target = _root->get("input.evdev", false);
+}
+
+
+void ModelMain::save_evdev_enabled(bool value)
+{
+	_root->put("input.evdev", value);
+}
+
+
+void ModelMain::load_input_routes(std::string &target)
+{
+	target = _root->get("input.routes", std::string());
+}
+
+
+void ModelMain::save_input_routes(const std::string &value)
+{
+	_root->put("input.routes", value);
+}
+
+
+void ModelMain::load_input_debounce(std::string &target)
+{
+	target = _root->get("input.debounce", std::string());
+}
+
+
+void ModelMain::save_input_debounce(const std::string &value)
+{
+	_root->put("input.debounce", value);
+}
+
+
+void ModelMain::load_input_arbitration(int &target)
+{
+	target = _root->get("input.arbitration-ms", 0);
+}
+
+
+void ModelMain::save_input_arbitration(int value)
+{
+	_root->put("input.arbitration-ms", value);
+}
+
+
+void ModelMain::load_realtime_enabled(bool &target)
+{
+	target = _root->get("engine.realtime", false);
+}
+
+
+void ModelMain::save_realtime_enabled(bool value)
+{
+	_root->put("engine.realtime", value);
+}
+
+
+void ModelMain::load_realtime_cpu(int &target)
+{
+	target = _root->get("engine.realtime-cpu", -1);
+}
+
+
+void ModelMain::save_realtime_cpu(int value)
+{
+	_root->put("engine.realtime-cpu", value);
+}
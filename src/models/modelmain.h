@@ -112,6 +112,69 @@ public:
 	 */
 	ReadWriteProperty<bool> show_player_names;
 
+	/**
+	 * Whether the clock state should be streamed to the local network subscribers (see `BroadcastServer`).
+	 */
+	ReadWriteProperty<bool> broadcast_enabled;
+
+	/**
+	 * IPv4 address on which the broadcast stream is served.
+	 */
+	ReadWriteProperty<std::string> broadcast_address;
+
+	/**
+	 * Port on which the broadcast stream is served (TCP and UDP).
+	 */
+	ReadWriteProperty<int> broadcast_port;
+
+	/**
+	 * IPv4 address of the time-base server of the hall (see `TimeSyncClient`), or an empty string
+	 * if the instants of the broadcast stream must be expressed on the local clock.
+	 */
+	ReadWriteProperty<std::string> time_sync_server;
+
+	/**
+	 * Whether the metrics should be exposed over HTTP on the loopback interface (see `MetricsServer`).
+	 */
+	ReadWriteProperty<bool> metrics_enabled;
+
+	/**
+	 * Port of the metrics endpoint (the clock engine, if any, uses the next one).
+	 */
+	ReadWriteProperty<int> metrics_port;
+
+	/**
+	 * Whether the keyboards should be read directly from the input devices (see `EvdevReader`)
+	 * rather than through the display server.
+	 */
+	ReadWriteProperty<bool> evdev_enabled;
+
+	/**
+	 * Routing of the input devices to the clock instances and sides (see `InputRouter`), used when the keyboards
+	 * are read directly from the input devices. This window (or its engine) is the clock instance 0.
+	 */
+	ReadWriteProperty<std::string> input_routes;
+
+	/**
+	 * Debounce windows of the keys (see `PressFilter`).
+	 */
+	ReadWriteProperty<std::string> input_debounce;
+
+	/**
+	 * Arbitration window between the presses of both players (in milliseconds, see `SwitchArbiter`).
+	 */
+	ReadWriteProperty<int> input_arbitration;
+
+	/**
+	 * Whether the clock engine should run its input path in real-time mode (see `RealtimeMode`).
+	 */
+	ReadWriteProperty<bool> realtime_enabled;
+
+	/**
+	 * CPU to which the real-time threads are pinned (-1 for none).
+	 */
+	ReadWriteProperty<int> realtime_cpu;
+
 protected:
 
 	// Implement the save method.
@@ -137,6 +200,18 @@ private:
 	void load_left_player                 (QString           &target);
 	void load_right_player                (QString           &target);
 	void load_show_player_names           (bool              &target);
+	void load_broadcast_enabled           (bool              &target);
+	void load_broadcast_address           (std::string       &target);
+	void load_broadcast_port              (int               &target);
+	void load_time_sync_server            (std::string       &target);
+	void load_metrics_enabled             (bool              &target);
+	void load_metrics_port                (int               &target);
+	void load_evdev_enabled               (bool              &target);
+	void load_input_routes                (std::string       &target);
+	void load_input_debounce              (std::string       &target);
+	void load_input_arbitration           (int               &target);
+	void load_realtime_enabled            (bool              &target);
+	void load_realtime_cpu                (int               &target);
 
 	// Savers
 	void save_time_control                (const TimeControl  &value);
@@ -152,6 +227,18 @@ private:
 	void save_left_player                 (const QString      &value);
 	void save_right_player                (const QString      &value);
 	void save_show_player_names           (bool                value);
+	void save_broadcast_enabled           (bool                value);
+	void save_broadcast_address           (const std::string  &value);
+	void save_broadcast_port              (int                 value);
+	void save_time_sync_server            (const std::string  &value);
+	void save_metrics_enabled             (bool                value);
+	void save_metrics_port                (int                 value);
+	void save_evdev_enabled               (bool                value);
+	void save_input_routes                (const std::string  &value);
+	void save_input_debounce              (const std::string  &value);
+	void save_input_arbitration           (int                 value);
+	void save_realtime_enabled            (bool                value);
+	void save_realtime_cpu                (int                 value);
 
 	// Useful alias
 	typedef boost::property_tree::ptree ptree;
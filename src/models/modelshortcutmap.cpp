@@ -22,6 +22,7 @@
 
 #include "modelshortcutmap.h"
 #include "modelpaths.h"
+#include <core/taskscheduler.h>
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
@@ -41,26 +42,55 @@ ModelShortcutMap::ModelShortcutMap() :
 }
 
 
-// Load the shortcut map file.
-void ModelShortcutMap::load_shortcut_map(ShortcutMap &target)
+// Load the shortcut map without blocking.
+Future<const ShortcutMap *> ModelShortcutMap::shortcut_map_async()
 {
-	try
-	{
-		// Try to load the user-defined shortcut map file if it exists.
-		if(boost::filesystem::exists(custom_shortcut_map_file())) {
-			target.load(custom_shortcut_map_file());
-		}
+	if(shortcut_map.loaded()) {
+		return make_ready_future(&shortcut_map());
+	}
+	prefetch(); // <- No-op if the file is already being read.
+	return _prefetched.then(MainThreadExecutor::instance(), [this](const ShortcutMap &) {
+		return &shortcut_map(); // <- The file has been read: the property is loaded from the prefetched map, without blocking.
+	});
+}
 
-		// Otherwise, try to load the default shortcut map file.
-		else {
-			target.load(default_shortcut_map_file());
-		}
+
+// Start reading the shortcut map file in the background.
+void ModelShortcutMap::prefetch()
+{
+	if(_prefetched.valid()) {
+		return;
 	}
 
-	// The keyboard index file must be readable.
-	catch(boost::property_tree::xml_parser_error &) {
-		throw std::runtime_error("An error has occurred while reading the shortcut map file.");
+	std::string path = shortcut_map_path();
+	_prefetched = TaskScheduler::instance().submit([path]() { return parse_shortcut_map(path); });
+}
+
+
+// Read the shortcut map file again in the background.
+void ModelShortcutMap::reload()
+{
+	if(!shortcut_map.loaded()) {
+		return;
 	}
+
+	// A file that cannot be parsed (e.g. because it is being written) is ignored: the current map is kept.
+	std::string path = shortcut_map_path();
+	TaskScheduler::instance().submit([path]() { return parse_shortcut_map(path); }).then(MainThreadExecutor::instance(), [this](const ShortcutMap &value) {
+		if(!shortcut_map().diff(value).empty()) {
+			shortcut_map.reload(value);
+		}
+	});
+}
+
+
+// Load the shortcut map file.
+void ModelShortcutMap::load_shortcut_map(ShortcutMap &target)
+{
+	prefetch(); // <- No-op if the file is already being read.
+	Future<ShortcutMap> prefetched = _prefetched;
+	_prefetched = Future<ShortcutMap>(); // <- A subsequent load must read the file again.
+	target = prefetched.get();
 }
 
 
@@ -70,12 +100,38 @@ void ModelShortcutMap::save_shortcut_map(const ShortcutMap &value)
 	// Create the parent folder if necessary.
 	ModelPaths::instance().ensure_config_path_exists();
 
-	// Write the file.
+	// Write a snapshot of the shortcut map in the background.
+	std::string path = custom_shortcut_map_file();
+	ShortcutMap data = value;
+	schedule_write([path, data]() {
+		try {
+			data.save(path);
+		}
+		catch(boost::property_tree::xml_parser_error &) {
+			throw std::runtime_error("An error has occurred while writing the shortcut map file.");
+		}
+	});
+}
+
+
+// Path of the shortcut map file to read.
+std::string ModelShortcutMap::shortcut_map_path()
+{
+	// Use the user-defined shortcut map file if it exists, the default one otherwise.
+	return boost::filesystem::exists(custom_shortcut_map_file()) ? custom_shortcut_map_file() : default_shortcut_map_file();
+}
+
+
+// Parse a shortcut map file.
+ShortcutMap ModelShortcutMap::parse_shortcut_map(const std::string &path)
+{
 	try {
-		value.save(custom_shortcut_map_file());
+		ShortcutMap retval;
+		retval.load(path);
+		return retval;
 	}
 	catch(boost::property_tree::xml_parser_error &) {
-		throw std::runtime_error("An error has occurred while writing the shortcut map file.");
+		throw std::runtime_error("An error has occurred while reading the shortcut map file.");
 	}
 }
 
@@ -26,6 +26,7 @@
 #include "abstractmodel.h"
 #include <core/singleton.h>
 #include <core/shortcutmap.h>
+#include <core/future.h>
 
 
 /**
@@ -52,6 +53,25 @@ public:
 	 */
 	ReadWriteProperty<ShortcutMap> shortcut_map;
 
+	/**
+	 * Load the `shortcut_map` property without blocking: the file is read by the task scheduler if necessary,
+	 * and the returned future becomes ready in the main thread once the property is loaded.
+	 */
+	Future<const ShortcutMap *> shortcut_map_async();
+
+	/**
+	 * Start reading the shortcut map file in the background, so that it is available
+	 * (or almost available) when the `shortcut_map` property is loaded.
+	 */
+	void prefetch();
+
+	/**
+	 * Read the shortcut map file again in the background (typically because it has been modified by another program),
+	 * and update the `shortcut_map` property if its content has changed. Nothing is done if the property
+	 * is not loaded yet.
+	 */
+	void reload();
+
 private:
 
 	// Constructor
@@ -64,6 +84,15 @@ private:
 	// Shortcut map management.
 	void load_shortcut_map(ShortcutMap &target);
 	void save_shortcut_map(const ShortcutMap &value);
+
+	// Background parsing (executed by the task scheduler)
+	static ShortcutMap parse_shortcut_map(const std::string &path);
+
+	// Private methods
+	std::string shortcut_map_path();
+
+	// Private members
+	Future<ShortcutMap> _prefetched;
 };
 
 #endif /* MODELSHORTCUTMAP_H_ */
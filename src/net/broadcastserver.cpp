@@ -0,0 +1,472 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "broadcastserver.h"
+#include "timesyncclient.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// Maximal number of UDP subscribers.
+static const std::size_t MAX_UDP_SUBSCRIBERS = 4096;
+
+
+// Prefix a frame with its size, for the TCP stream.
+static std::string make_tcp_frame(const std::string &frame)
+{
+	std::string retval;
+	retval.reserve(frame.size()+2);
+	retval.push_back(static_cast<char>( frame.size()       & 0xff));
+	retval.push_back(static_cast<char>((frame.size() >> 8) & 0xff));
+	retval += frame;
+	return retval;
+}
+
+
+// Constructor.
+BroadcastServer::BroadcastServer(const std::string &address, std::uint16_t port, std::size_t queue_limit) :
+	_has_latest(false), _stopping(false), _discovery_port(0), _time_sync_client(nullptr), _epoll_fd(-1), _event_fd(-1), _tcp_fd(-1), _udp_fd(-1), _port(port), _queue_limit(queue_limit),
+	_has_state(false), _sequence(0), _tcp_client_count(0), _udp_subscriber_count(0), _frames_sent(0), _frames_dropped(0), _resyncs(0)
+{
+	sockaddr_in bind_address;
+	std::memset(&bind_address, 0, sizeof(bind_address));
+	bind_address.sin_family = AF_INET;
+	bind_address.sin_port   = htons(port);
+	if(inet_pton(AF_INET, address.c_str(), &bind_address.sin_addr)!=1) {
+		throw std::runtime_error("Invalid broadcast address: " + address);
+	}
+	_bind_address = bind_address.sin_addr.s_addr;
+
+	try
+	{
+		// TCP listening socket
+		int enable = 1;
+		_tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(_tcp_fd<0 || setsockopt(_tcp_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable))!=0 ||
+			bind(_tcp_fd, reinterpret_cast<sockaddr *>(&bind_address), sizeof(bind_address))!=0 || listen(_tcp_fd, 128)!=0)
+		{
+			throw std::runtime_error("Unable to create the broadcast TCP socket.");
+		}
+
+		// The UDP socket uses the same port as the TCP one (which may have been chosen by the system).
+		socklen_t length = sizeof(bind_address);
+		getsockname(_tcp_fd, reinterpret_cast<sockaddr *>(&bind_address), &length);
+		_port = ntohs(bind_address.sin_port);
+		int buffer_size = 1 << 20; // <- Room for bursts of subscription requests.
+		_udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(_udp_fd>=0) {
+			setsockopt(_udp_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+			setsockopt(_udp_fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+		}
+		if(_udp_fd<0 || bind(_udp_fd, reinterpret_cast<sockaddr *>(&bind_address), sizeof(bind_address))!=0) {
+			throw std::runtime_error("Unable to create the broadcast UDP socket.");
+		}
+
+		// Event loop
+		_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if(_event_fd<0 || _epoll_fd<0) {
+			throw std::runtime_error("Unable to create the broadcast event loop.");
+		}
+		for(int fd : {_event_fd, _tcp_fd, _udp_fd}) {
+			epoll_event event;
+			event.events  = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		}
+	}
+	catch(...) {
+		for(int fd : {_tcp_fd, _udp_fd, _event_fd, _epoll_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw;
+	}
+
+	_thread = std::thread(&BroadcastServer::run, this);
+}
+
+
+// Destructor.
+BroadcastServer::~BroadcastServer()
+{
+	_stopping = true;
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_event_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+
+	for(const auto &it : _tcp_clients) {
+		close(it.first);
+	}
+	for(int fd : {_tcp_fd, _udp_fd, _event_fd, _epoll_fd}) {
+		close(fd);
+	}
+}
+
+
+// Publish a new clock state.
+void BroadcastServer::publish(const BiTimer::State &state, const Enum::array<Side, std::string> &names)
+{
+	ClockFrameState frame_state = ClockFrameState::make(state, names);
+	if(_time_sync_client!=nullptr) {
+		frame_state.reference = _time_sync_client->to_reference(frame_state.reference);
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_latest     = std::move(frame_state);
+		_has_latest = true;
+	}
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_event_fd, &one, sizeof(one));
+	(void)ignored;
+}
+
+
+// Start announcing the server on the discovery port.
+void BroadcastServer::enable_discovery(std::uint16_t discovery_port)
+{
+	_discovery_port = discovery_port;
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_event_fd, &one, sizeof(one)); // <- Send the first announcement right away.
+	(void)ignored;
+}
+
+
+// Snapshot of the activity counters.
+BroadcastServer::Statistics BroadcastServer::statistics() const
+{
+	Statistics retval;
+	retval.tcp_clients     = _tcp_client_count    ;
+	retval.udp_subscribers = _udp_subscriber_count;
+	retval.frames_sent     = _frames_sent         ;
+	retval.frames_dropped  = _frames_dropped      ;
+	retval.resyncs         = _resyncs             ;
+	return retval;
+}
+
+
+// Event loop of the server thread.
+void BroadcastServer::run()
+{
+	std::vector<epoll_event> events(256);
+	while(!_stopping) {
+		int count = epoll_wait(_epoll_fd, events.data(), events.size(), 1000);
+		if(count<0 && errno!=EINTR) {
+			break;
+		}
+		for(int k=0; k<count; ++k) {
+			int fd = events[k].data.fd;
+			if(fd==_event_fd) {
+				std::uint64_t buffer;
+				ssize_t ignored = read(_event_fd, &buffer, sizeof(buffer));
+				(void)ignored;
+				on_state_published();
+			}
+			else if(fd==_tcp_fd) {
+				accept_clients();
+			}
+			else if(fd==_udp_fd) {
+				on_udp_readable();
+			}
+			else {
+				on_tcp_event(fd, events[k].events);
+			}
+		}
+		expire_udp_subscribers();
+		announce();
+	}
+}
+
+
+// Accept the pending TCP connections.
+void BroadcastServer::accept_clients()
+{
+	while(true) {
+		int fd = accept4(_tcp_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd<0) {
+			return;
+		}
+		int enable = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+		epoll_event event;
+		event.events  = EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+		TcpClient &client(_tcp_clients[fd]);
+		client.offset         = 0;
+		client.needs_snapshot = !_has_state;
+		client.write_armed    = false;
+		_tcp_client_count = _tcp_clients.size();
+		if(_has_state) {
+			enqueue(fd, client, make_tcp_frame(encode_clock_snapshot(_sequence, _state)));
+		}
+	}
+}
+
+
+// Activity on a TCP client socket.
+void BroadcastServer::on_tcp_event(int fd, std::uint32_t events)
+{
+	auto it = _tcp_clients.find(fd);
+	if(it==_tcp_clients.end()) {
+		return;
+	}
+
+	// The clients are not supposed to send anything: the incoming data is discarded, and only the end of stream matters.
+	if(events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+		char buffer[256];
+		while(true) {
+			ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+			if(received==0 || (received<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)) {
+				close_client(fd);
+				return;
+			}
+			if(received<0) {
+				break;
+			}
+		}
+	}
+	if(events & EPOLLOUT) {
+		if(!flush(fd, it->second)) {
+			close_client(fd);
+		}
+	}
+}
+
+
+// Datagram received on the UDP socket (subscription requests).
+void BroadcastServer::on_udp_readable()
+{
+	while(true) {
+		char buffer[512];
+		sockaddr_in sender;
+		socklen_t length = sizeof(sender);
+		ssize_t received = recvfrom(_udp_fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&sender), &length);
+		if(received<0) {
+			return;
+		}
+		ClockFrameInfo  info;
+		ClockFrameState ignored;
+		if(!decode_clock_frame(buffer, received, info, ignored) || info.type!=ClockFrameType::SUBSCRIBE) {
+			continue;
+		}
+		UdpAddress address(sender.sin_addr.s_addr, sender.sin_port);
+		if(_udp_subscribers.count(address)==0 && _udp_subscribers.size()>=MAX_UDP_SUBSCRIBERS) {
+			continue;
+		}
+		_udp_subscribers[address] = std::chrono::steady_clock::now() + std::chrono::seconds(CLOCK_STREAM_UDP_LEASE);
+		_udp_subscriber_count = _udp_subscribers.size();
+		if(_has_state) {
+			send_udp(address, encode_clock_snapshot(_sequence, _state));
+		}
+	}
+}
+
+
+// Send the frame corresponding to the latest published state.
+void BroadcastServer::on_state_published()
+{
+	ClockFrameState state;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if(!_has_latest) {
+			return;
+		}
+		state       = std::move(_latest);
+		_has_latest = false;
+	}
+	++_sequence;
+	std::string delta    = _has_state ? encode_clock_delta(_sequence, _state, state) : encode_clock_snapshot(_sequence, state);
+	std::string snapshot = encode_clock_snapshot(_sequence, state);
+	_state     = std::move(state);
+	_has_state = true;
+
+	std::string tcp_delta    = make_tcp_frame(delta   );
+	std::string tcp_snapshot = make_tcp_frame(snapshot);
+	for(auto &it : _tcp_clients) {
+		enqueue(it.first, it.second, it.second.needs_snapshot ? tcp_snapshot : tcp_delta);
+		it.second.needs_snapshot = false;
+	}
+	for(const auto &it : _udp_subscribers) {
+		send_udp(it.first, delta);
+	}
+
+	// Try to send the queued data right away.
+	std::vector<int> failed;
+	for(auto &it : _tcp_clients) {
+		if(!it.second.write_armed && !flush(it.first, it.second)) {
+			failed.push_back(it.first);
+		}
+	}
+	for(int fd : failed) {
+		close_client(fd);
+	}
+}
+
+
+// Send a datagram to a UDP subscriber (the frame is lost if the socket buffer is full).
+void BroadcastServer::send_udp(const UdpAddress &address, const std::string &frame)
+{
+	sockaddr_in target;
+	std::memset(&target, 0, sizeof(target));
+	target.sin_family      = AF_INET;
+	target.sin_addr.s_addr = address.first;
+	target.sin_port        = address.second;
+	if(sendto(_udp_fd, frame.data(), frame.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr *>(&target), sizeof(target))<0) {
+		++_frames_dropped;
+	}
+	else {
+		++_frames_sent;
+	}
+}
+
+
+// Queue a frame for a TCP client, dropping the queued deltas in favor of a snapshot if the queue is full.
+void BroadcastServer::enqueue(int fd, TcpClient &client, const std::string &frame)
+{
+	if(client.queue.size()>=_queue_limit) {
+
+		// The front frame cannot be dropped if it has already been partially sent.
+		std::size_t kept = client.offset>0 ? 1 : 0;
+		_frames_dropped += client.queue.size() - kept;
+		client.queue.resize(kept);
+		client.queue.push_back(make_tcp_frame(encode_clock_snapshot(_sequence, _state)));
+		++_resyncs;
+		return;
+	}
+	client.queue.push_back(frame);
+	(void)fd;
+}
+
+
+// Write as much queued data as possible. Return false if the connection is broken.
+bool BroadcastServer::flush(int fd, TcpClient &client)
+{
+	while(!client.queue.empty()) {
+		const std::string &front(client.queue.front());
+		ssize_t sent = send(fd, front.data() + client.offset, front.size() - client.offset, MSG_NOSIGNAL);
+		if(sent<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			if(errno!=EAGAIN && errno!=EWOULDBLOCK) {
+				return false;
+			}
+			break;
+		}
+		client.offset += sent;
+		if(client.offset==front.size()) {
+			client.queue.pop_front();
+			client.offset = 0;
+			++_frames_sent;
+		}
+	}
+
+	// Ask to be notified when the socket becomes writable only if some data is still pending.
+	bool need_write = !client.queue.empty();
+	if(need_write!=client.write_armed) {
+		epoll_event event;
+		event.events  = need_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+		client.write_armed = need_write;
+	}
+	return true;
+}
+
+
+// Close a TCP connection.
+void BroadcastServer::close_client(int fd)
+{
+	epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	_tcp_clients.erase(fd);
+	_tcp_client_count = _tcp_clients.size();
+}
+
+
+// Remove the UDP subscribers whose lease has expired.
+void BroadcastServer::expire_udp_subscribers()
+{
+	auto now = std::chrono::steady_clock::now();
+	for(auto it=_udp_subscribers.begin(); it!=_udp_subscribers.end(); ) {
+		if(it->second<now) {
+			it = _udp_subscribers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	_udp_subscriber_count = _udp_subscribers.size();
+}
+
+
+// Send an ANNOUNCE frame to the discovery port, if discovery is enabled and the previous one is old enough.
+void BroadcastServer::announce()
+{
+	std::uint16_t discovery_port = _discovery_port;
+	auto now = std::chrono::steady_clock::now();
+	if(discovery_port==0 || now<_next_announce) {
+		return;
+	}
+	_next_announce = now + std::chrono::seconds(CLOCK_STREAM_ANNOUNCE_INTERVAL);
+
+	sockaddr_in target;
+	std::memset(&target, 0, sizeof(target));
+	target.sin_family      = AF_INET;
+	target.sin_addr.s_addr = (ntohl(_bind_address) >> 24)==127 ? _bind_address : htonl(INADDR_BROADCAST);
+	target.sin_port        = htons(discovery_port);
+	std::string frame = encode_clock_announce(_sequence);
+	sendto(_udp_fd, frame.data(), frame.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr *>(&target), sizeof(target));
+}
+
+#else
+
+// epoll and eventfd are not available: the server cannot be started.
+BroadcastServer::BroadcastServer(const std::string &, std::uint16_t port, std::size_t queue_limit) :
+	_has_latest(false), _stopping(true), _discovery_port(0), _time_sync_client(nullptr), _epoll_fd(-1), _event_fd(-1), _tcp_fd(-1), _udp_fd(-1), _port(port), _queue_limit(queue_limit),
+	_has_state(false), _sequence(0), _tcp_client_count(0), _udp_subscriber_count(0), _frames_sent(0), _frames_dropped(0), _resyncs(0)
+{
+	throw std::runtime_error("The broadcast stream is not supported on this platform.");
+}
+
+BroadcastServer::~BroadcastServer() {}
+void BroadcastServer::enable_discovery(std::uint16_t) {}
+void BroadcastServer::publish(const BiTimer::State &, const Enum::array<Side, std::string> &) {}
+BroadcastServer::Statistics BroadcastServer::statistics() const { return Statistics(); }
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,177 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef BROADCASTSERVER_H_
+#define BROADCASTSERVER_H_
+
+#include "clockstream.h"
+#include <core/bitimer.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+class TimeSyncClient;
+
+/**
+ * Server streaming the clock state to local subscribers, over TCP and UDP (see `clockstream.h` for the protocol).
+ *
+ * The server runs in its own thread: `publish()` only records the new state, and returns immediately.
+ * If several states are published while the server thread is busy, only the latest one is sent (the
+ * intermediate states are superseded anyway, and the deltas are always computed against the last state sent).
+ * Each TCP client has a bounded queue of pending frames: when a client does not read fast enough and its
+ * queue overflows, the queued deltas are dropped and replaced by a single snapshot (the client sees a jump
+ * in the sequence numbers, and starts again from the snapshot). UDP subscribers whose socket buffer is full
+ * simply lose the frame, and are expected to re-subscribe when they detect a gap.
+ *
+ * Only available on Unix platforms.
+ */
+class BroadcastServer
+{
+public:
+
+	/**
+	 * Activity counters.
+	 */
+	struct Statistics
+	{
+		std::size_t   tcp_clients    ; //!< Number of connected TCP clients.
+		std::size_t   udp_subscribers; //!< Number of UDP subscribers.
+		std::uint64_t frames_sent    ; //!< Number of frames sent (TCP and UDP).
+		std::uint64_t frames_dropped ; //!< Number of frames dropped because of the backpressure.
+		std::uint64_t resyncs        ; //!< Number of snapshots sent to replace dropped frames.
+	};
+
+	/**
+	 * Constructor. Bind the TCP and UDP sockets on the given IPv4 address and port, and start the server thread.
+	 * @param queue_limit Maximal number of frames queued for each TCP client.
+	 * @throw std::runtime_error If the sockets cannot be created.
+	 */
+	BroadcastServer(const std::string &address, std::uint16_t port, std::size_t queue_limit=64);
+
+	/**
+	 * Destructor. Stop the server thread and close all the connections.
+	 */
+	~BroadcastServer();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	BroadcastServer(const BroadcastServer &op) = delete;
+	BroadcastServer &operator=(const BroadcastServer &op) = delete;
+	/**@} */
+
+	/**
+	 * Port actually used by the sockets (useful if the server has been created with port 0).
+	 */
+	std::uint16_t port() const { return _port; }
+
+	/**
+	 * Start announcing the server on the given discovery port (see `ClockFrameType::ANNOUNCE`). The announcements
+	 * are sent to the loopback interface if the server is bound to it, and broadcast on the local network otherwise.
+	 */
+	void enable_discovery(std::uint16_t discovery_port=CLOCK_STREAM_DISCOVERY_PORT);
+
+	/**
+	 * Express the reference instants of the published states on the time base estimated by the given client,
+	 * instead of the local clock (nullptr to go back to the local clock). The client must outlive the server,
+	 * and this function must be called from the thread that publishes the states.
+	 */
+	void set_time_base(const TimeSyncClient *time_sync_client) { _time_sync_client = time_sync_client; }
+
+	/**
+	 * Publish a new clock state. Thread-safe, and never blocks on the network.
+	 */
+	void publish(const BiTimer::State &state, const Enum::array<Side, std::string> &names);
+
+	/**
+	 * Snapshot of the activity counters.
+	 */
+	Statistics statistics() const;
+
+private:
+
+	// Connected TCP client.
+	struct TcpClient
+	{
+		std::deque<std::string> queue         ; // Frames (with their size prefix) waiting to be sent.
+		std::size_t             offset        ; // Number of bytes of the front frame already sent.
+		bool                    needs_snapshot; // No frame sent yet because no state has been published.
+		bool                    write_armed   ; // Whether EPOLLOUT is currently requested.
+	};
+
+	// UDP subscriber, identified by its IPv4 address and port.
+	typedef std::pair<std::uint32_t, std::uint16_t>      UdpAddress;
+	typedef std::chrono::steady_clock::time_point        Deadline  ;
+
+	// Private functions
+	void run();
+	void accept_clients();
+	void on_tcp_event(int fd, std::uint32_t events);
+	void on_udp_readable();
+	void on_state_published();
+	void send_udp(const UdpAddress &address, const std::string &frame);
+	void enqueue(int fd, TcpClient &client, const std::string &frame);
+	bool flush(int fd, TcpClient &client);
+	void close_client(int fd);
+	void expire_udp_subscribers();
+	void announce();
+
+	// Private members (shared with the publishing threads)
+	std::mutex        _mutex      ;
+	ClockFrameState   _latest     ;
+	bool              _has_latest ;
+	std::thread       _thread     ;
+	std::atomic<bool> _stopping   ;
+	std::atomic<std::uint16_t> _discovery_port;
+	const TimeSyncClient *_time_sync_client; // Publishing thread only.
+
+	// Private members (server thread only)
+	int                              _epoll_fd       ;
+	int                              _event_fd       ;
+	int                              _tcp_fd         ;
+	int                              _udp_fd         ;
+	std::uint16_t                    _port           ;
+	std::size_t                      _queue_limit    ;
+	ClockFrameState                  _state          ;
+	bool                             _has_state      ;
+	std::uint32_t                    _sequence       ;
+	std::map<int, TcpClient>         _tcp_clients    ;
+	std::map<UdpAddress, Deadline>   _udp_subscribers;
+	std::uint32_t                    _bind_address   ; // Network byte order.
+	Deadline                         _next_announce  ;
+
+	// Statistics
+	std::atomic<std::size_t>   _tcp_client_count    ;
+	std::atomic<std::size_t>   _udp_subscriber_count;
+	std::atomic<std::uint64_t> _frames_sent         ;
+	std::atomic<std::uint64_t> _frames_dropped      ;
+	std::atomic<std::uint64_t> _resyncs             ;
+};
+
+#endif /* BROADCASTSERVER_H_ */
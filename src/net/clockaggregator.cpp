@@ -0,0 +1,608 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "clockaggregator.h"
+#include <core/chrono.h>
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// Event file descriptor used to forward the termination signals to the event loop.
+static int g_stop_event_fd = -1;
+
+
+// Termination signal handler.
+static void on_termination_signal(int)
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(g_stop_event_fd, &one, sizeof(one));
+	(void)ignored;
+}
+
+
+// Prefix a record with its size, for the TCP stream.
+static std::string make_tcp_record(const std::string &record)
+{
+	std::string retval;
+	retval.reserve(record.size()+2);
+	retval.push_back(static_cast<char>( record.size()       & 0xff));
+	retval.push_back(static_cast<char>((record.size() >> 8) & 0xff));
+	retval += record;
+	return retval;
+}
+
+
+// Constructor.
+ClockAggregator::ClockAggregator(const std::string &address, std::uint16_t port, std::uint16_t discovery_port, std::size_t queue_limit) :
+	_epoll_fd(-1), _event_fd(-1), _feed_fd(-1), _discovery_fd(-1), _port(port), _discovery_port(discovery_port), _queue_limit(queue_limit),
+	_stopping(false), _last_stamp(0), _board_count(0), _feed_client_count(0), _frames_received(0), _gaps(0), _records_sent(0),
+	_records_dropped(0), _resyncs(0), _total_latency(0), _max_latency(0)
+{
+	sockaddr_in feed_address;
+	std::memset(&feed_address, 0, sizeof(feed_address));
+	feed_address.sin_family = AF_INET;
+	feed_address.sin_port   = htons(port);
+	if(inet_pton(AF_INET, address.c_str(), &feed_address.sin_addr)!=1) {
+		throw std::runtime_error("Invalid aggregator address: " + address);
+	}
+	sockaddr_in discovery_address;
+	std::memset(&discovery_address, 0, sizeof(discovery_address));
+	discovery_address.sin_family      = AF_INET;
+	discovery_address.sin_port        = htons(discovery_port);
+	discovery_address.sin_addr.s_addr = htonl(INADDR_ANY); // <- The announcements may be sent to the broadcast address.
+
+	try
+	{
+		// Feed listening socket
+		int enable = 1;
+		_feed_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(_feed_fd<0 || setsockopt(_feed_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable))!=0 ||
+			bind(_feed_fd, reinterpret_cast<sockaddr *>(&feed_address), sizeof(feed_address))!=0 || listen(_feed_fd, 128)!=0)
+		{
+			throw std::runtime_error("Unable to create the aggregator feed socket.");
+		}
+		socklen_t length = sizeof(feed_address);
+		getsockname(_feed_fd, reinterpret_cast<sockaddr *>(&feed_address), &length);
+		_port = ntohs(feed_address.sin_port);
+
+		// Discovery socket (several aggregators may run on the same host)
+		int buffer_size = 1 << 20;
+		_discovery_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(_discovery_fd<0 || setsockopt(_discovery_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable))!=0 ||
+			bind(_discovery_fd, reinterpret_cast<sockaddr *>(&discovery_address), sizeof(discovery_address))!=0)
+		{
+			throw std::runtime_error("Unable to create the aggregator discovery socket.");
+		}
+		setsockopt(_discovery_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+		length = sizeof(discovery_address);
+		getsockname(_discovery_fd, reinterpret_cast<sockaddr *>(&discovery_address), &length);
+		_discovery_port = ntohs(discovery_address.sin_port);
+
+		// Event loop
+		_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if(_event_fd<0 || _epoll_fd<0) {
+			throw std::runtime_error("Unable to create the aggregator event loop.");
+		}
+		for(int fd : {_event_fd, _feed_fd, _discovery_fd}) {
+			epoll_event event;
+			event.events  = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		}
+	}
+	catch(...) {
+		for(int fd : {_feed_fd, _discovery_fd, _event_fd, _epoll_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw;
+	}
+}
+
+
+// Destructor.
+ClockAggregator::~ClockAggregator()
+{
+	for(const auto &it : _boards) {
+		close(it.first);
+	}
+	for(const auto &it : _feed_clients) {
+		close(it.first);
+	}
+	for(int fd : {_feed_fd, _discovery_fd, _event_fd, _epoll_fd}) {
+		close(fd);
+	}
+}
+
+
+// Event loop.
+void ClockAggregator::run()
+{
+	g_stop_event_fd = _event_fd;
+	std::signal(SIGINT , &on_termination_signal);
+	std::signal(SIGTERM, &on_termination_signal);
+
+	std::vector<epoll_event> events(256);
+	while(!_stopping) {
+		int count = epoll_wait(_epoll_fd, events.data(), events.size(), -1);
+		if(count<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			throw std::runtime_error("The aggregator event loop has failed.");
+		}
+		for(int k=0; k<count; ++k) {
+			int fd = events[k].data.fd;
+			if(fd==_event_fd) {
+				_stopping = true;
+			}
+			else if(fd==_discovery_fd) {
+				on_announce();
+			}
+			else if(fd==_feed_fd) {
+				accept_feed_clients();
+			}
+			else if(_boards.count(fd)>0) {
+				on_board_event(fd, events[k].events);
+			}
+			else {
+				on_feed_event(fd, events[k].events);
+			}
+		}
+
+		// The records are flushed once per batch of events, which keeps the number of system calls low under load.
+		flush_batch();
+	}
+
+	std::signal(SIGINT , SIG_DFL);
+	std::signal(SIGTERM, SIG_DFL);
+	g_stop_event_fd = -1;
+}
+
+
+// Make `run()` return.
+void ClockAggregator::stop()
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_event_fd, &one, sizeof(one));
+	(void)ignored;
+}
+
+
+// Snapshot of the activity counters.
+ClockAggregator::Statistics ClockAggregator::statistics() const
+{
+	Statistics retval;
+	retval.boards          = _board_count      ;
+	retval.feed_clients    = _feed_client_count;
+	retval.frames_received = _frames_received  ;
+	retval.gaps            = _gaps             ;
+	retval.records_sent    = _records_sent     ;
+	retval.records_dropped = _records_dropped  ;
+	retval.resyncs         = _resyncs          ;
+	retval.total_latency   = _total_latency    ;
+	retval.max_latency     = _max_latency      ;
+	return retval;
+}
+
+
+// Process the ANNOUNCE frames received on the discovery socket.
+void ClockAggregator::on_announce()
+{
+	while(true) {
+		char buffer[512];
+		sockaddr_in sender;
+		socklen_t length = sizeof(sender);
+		ssize_t received = recvfrom(_discovery_fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&sender), &length);
+		if(received<0) {
+			return;
+		}
+		ClockFrameInfo  info;
+		ClockFrameState ignored;
+		if(!decode_clock_frame(buffer, received, info, ignored) || info.type!=ClockFrameType::ANNOUNCE) {
+			continue;
+		}
+
+		// The announcements are sent from the stream port of the board.
+		Endpoint endpoint(sender.sin_addr.s_addr, sender.sin_port);
+		bool known = false;
+		for(const auto &it : _boards) {
+			if(it.second.endpoint==endpoint) {
+				known = true;
+				break;
+			}
+		}
+		if(!known) {
+			connect_board(endpoint);
+		}
+	}
+}
+
+
+// Open a connection to the stream of a newly discovered board.
+void ClockAggregator::connect_board(const Endpoint &endpoint)
+{
+	sockaddr_in address;
+	std::memset(&address, 0, sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_addr.s_addr = endpoint.first;
+	address.sin_port        = endpoint.second;
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd<0) {
+		return;
+	}
+	if(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))!=0 && errno!=EINPROGRESS) {
+		close(fd);
+		return;
+	}
+	int enable = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+	// The board keeps its identifier across reconnections.
+	auto id = _board_ids.find(endpoint);
+	if(id==_board_ids.end()) {
+		id = _board_ids.insert(std::make_pair(endpoint, static_cast<std::uint32_t>(_board_ids.size()+1))).first;
+	}
+	Board &board(_boards[fd]);
+	board.id            = id->second;
+	board.endpoint      = endpoint;
+	board.connected     = false;
+	board.has_sequence  = false;
+	board.last_sequence = 0;
+	board.has_state     = false;
+
+	// EPOLLOUT signals the completion of the connection.
+	epoll_event event;
+	event.events  = EPOLLIN | EPOLLOUT;
+	event.data.fd = fd;
+	epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+
+// Activity on a board connection.
+void ClockAggregator::on_board_event(int fd, std::uint32_t events)
+{
+	Board &board(_boards[fd]);
+	if(!board.connected) {
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length)!=0 || error!=0) {
+			close_board(fd);
+			return;
+		}
+		board.connected = true;
+		_board_count = _board_count + 1;
+		epoll_event event;
+		event.events  = EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+		publish(board_record(ClockFeedRecordKind::BOARD_ADDED, board, stamp()));
+	}
+	if((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !read_board(fd, board)) {
+		close_board(fd);
+	}
+}
+
+
+// Read the frames available on a board connection. Return false if the connection is broken.
+bool ClockAggregator::read_board(int fd, Board &board)
+{
+	char buffer[16384];
+	while(true) {
+		ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+		if(received==0) {
+			return false;
+		}
+		if(received<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			return errno==EAGAIN || errno==EWOULDBLOCK;
+		}
+		auto received_at = std::chrono::steady_clock::now();
+		board.buffer.append(buffer, received);
+
+		// Extract the complete frames.
+		std::size_t offset = 0;
+		while(board.buffer.size()-offset>=2) {
+			std::size_t size = static_cast<unsigned char>(board.buffer[offset]) | (static_cast<unsigned char>(board.buffer[offset+1]) << 8);
+			if(size<CLOCK_FRAME_HEADER_SIZE) {
+				return false;
+			}
+			if(board.buffer.size()-offset-2<size) {
+				break;
+			}
+			on_frame(board, board.buffer.data()+offset+2, size, received_at);
+			offset += 2 + size;
+		}
+		board.buffer.erase(0, offset);
+	}
+}
+
+
+// Frame received from a board.
+void ClockAggregator::on_frame(Board &board, const char *data, std::size_t size, std::chrono::steady_clock::time_point received_at)
+{
+	ClockFrameInfo info;
+	if(!decode_clock_frame(data, size, info, board.state) || (info.type!=ClockFrameType::SNAPSHOT && info.type!=ClockFrameType::DELTA)) {
+		return;
+	}
+	++_frames_received;
+
+	// Gap detection: the server replaces the frames it drops by a snapshot, so the state of the board remains valid
+	// after a gap unless the frame that follows it is a delta.
+	bool gap = board.has_sequence && info.sequence!=board.last_sequence+1;
+	if(gap) {
+		++_gaps;
+	}
+	board.has_sequence  = true;
+	board.last_sequence = info.sequence;
+	board.has_state     = info.type==ClockFrameType::SNAPSHOT || (board.has_state && !gap);
+
+	ClockFeedRecord record(board_record(ClockFeedRecordKind::FRAME, board, stamp()));
+	record.flags = gap ? ClockFeedFlag::GAP : 0;
+	record.frame.assign(data, size);
+	publish(record);
+	_batch_received.push_back(received_at);
+}
+
+
+// Close a board connection.
+void ClockAggregator::close_board(int fd)
+{
+	auto it = _boards.find(fd);
+	if(it->second.connected) {
+		publish(board_record(ClockFeedRecordKind::BOARD_LOST, it->second, stamp()));
+		_board_count = _board_count - 1;
+	}
+	epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	_boards.erase(it);
+}
+
+
+// Accept the pending feed connections.
+void ClockAggregator::accept_feed_clients()
+{
+	while(true) {
+		int fd = accept4(_feed_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd<0) {
+			return;
+		}
+		int enable = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+		epoll_event event;
+		event.events  = EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+		FeedClient &client(_feed_clients[fd]);
+		client.offset      = 0;
+		client.replayed    = 0;
+		client.write_armed = false;
+		_feed_client_count = _feed_clients.size();
+		replay(client);
+	}
+}
+
+
+// Activity on a feed client socket.
+void ClockAggregator::on_feed_event(int fd, std::uint32_t events)
+{
+	auto it = _feed_clients.find(fd);
+	if(it==_feed_clients.end()) {
+		return;
+	}
+
+	// The feed clients are not supposed to send anything: only the end of stream matters.
+	if(events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+		char buffer[256];
+		while(true) {
+			ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+			if(received==0 || (received<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)) {
+				close_feed_client(fd);
+				return;
+			}
+			if(received<0) {
+				break;
+			}
+		}
+	}
+	if((events & EPOLLOUT) && !flush(fd, it->second)) {
+		close_feed_client(fd);
+	}
+}
+
+
+// Queue a record for all the feed clients.
+void ClockAggregator::publish(const ClockFeedRecord &record)
+{
+	std::string data = make_tcp_record(encode_clock_feed_record(record));
+	for(auto &it : _feed_clients) {
+		FeedClient &client(it.second);
+		if(client.queue.size()-client.replayed<_queue_limit) {
+			client.queue.push_back(data);
+			continue;
+		}
+
+		// Backpressure: drop the queue (except the front record if it has been partially sent), and re-synchronize.
+		std::size_t kept = client.offset>0 ? 1 : 0;
+		_records_dropped += client.queue.size() - kept;
+		client.queue.resize(kept);
+		replay(client);
+		++_resyncs;
+	}
+}
+
+
+// Queue the current state of all the boards for a feed client (these records, and the front record kept
+// if it has been partially sent, are excluded from the queue limit).
+void ClockAggregator::replay(FeedClient &client)
+{
+	std::int64_t now = stamp();
+	for(const auto &it : _boards) {
+		const Board &board(it.second);
+		if(!board.connected) {
+			continue;
+		}
+		ClockFeedRecord added(board_record(ClockFeedRecordKind::BOARD_ADDED, board, now));
+		added.flags = ClockFeedFlag::REPLAY;
+		client.queue.push_back(make_tcp_record(encode_clock_feed_record(added)));
+		if(board.has_state) {
+			ClockFeedRecord frame(board_record(ClockFeedRecordKind::FRAME, board, now));
+			frame.flags = ClockFeedFlag::REPLAY;
+			frame.frame = encode_clock_snapshot(board.last_sequence, board.state);
+			client.queue.push_back(make_tcp_record(encode_clock_feed_record(frame)));
+		}
+	}
+	client.replayed = client.queue.size();
+}
+
+
+// Write as much queued data as possible. Return false if the connection is broken.
+bool ClockAggregator::flush(int fd, FeedClient &client)
+{
+	while(!client.queue.empty()) {
+		const std::string &front(client.queue.front());
+		ssize_t sent = send(fd, front.data() + client.offset, front.size() - client.offset, MSG_NOSIGNAL);
+		if(sent<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			if(errno!=EAGAIN && errno!=EWOULDBLOCK) {
+				return false;
+			}
+			break;
+		}
+		client.offset += sent;
+		if(client.offset==front.size()) {
+			client.queue.pop_front();
+			client.offset = 0;
+			if(client.replayed>0) {
+				--client.replayed;
+			}
+			++_records_sent;
+		}
+	}
+
+	// Ask to be notified when the socket becomes writable only if some data is still pending.
+	bool need_write = !client.queue.empty();
+	if(need_write!=client.write_armed) {
+		epoll_event event;
+		event.events  = need_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+		client.write_armed = need_write;
+	}
+	return true;
+}
+
+
+// Close a feed connection.
+void ClockAggregator::close_feed_client(int fd)
+{
+	epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	_feed_clients.erase(fd);
+	_feed_client_count = _feed_clients.size();
+}
+
+
+// Send the records queued during the last batch of events, and update the latency statistics.
+void ClockAggregator::flush_batch()
+{
+	std::vector<int> failed;
+	for(auto &it : _feed_clients) {
+		if(!it.second.write_armed && !it.second.queue.empty() && !flush(it.first, it.second)) {
+			failed.push_back(it.first);
+		}
+	}
+	for(int fd : failed) {
+		close_feed_client(fd);
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	for(const auto &received_at : _batch_received) {
+		std::uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(now - received_at).count();
+		_total_latency += latency;
+		if(latency>_max_latency) {
+			_max_latency = latency;
+		}
+	}
+	_batch_received.clear();
+}
+
+
+// Reception instant of a record (never decreases, so that the feed remains ordered if the system clock is adjusted).
+std::int64_t ClockAggregator::stamp()
+{
+	std::int64_t now = to_epoch_microseconds(boost::posix_time::microsec_clock::universal_time());
+	_last_stamp = std::max(_last_stamp, now);
+	return _last_stamp;
+}
+
+
+// Build a record about the given board.
+ClockFeedRecord ClockAggregator::board_record(ClockFeedRecordKind kind, const Board &board, std::int64_t received)
+{
+	ClockFeedRecord retval;
+	retval.kind     = kind;
+	retval.flags    = 0;
+	retval.board    = board.id;
+	retval.received = received;
+	std::memcpy(retval.address, &board.endpoint.first, 4);
+	retval.port     = ntohs(board.endpoint.second);
+	return retval;
+}
+
+#else
+
+// epoll and eventfd are not available: the aggregator cannot be started.
+ClockAggregator::ClockAggregator(const std::string &, std::uint16_t port, std::uint16_t discovery_port, std::size_t queue_limit) :
+	_epoll_fd(-1), _event_fd(-1), _feed_fd(-1), _discovery_fd(-1), _port(port), _discovery_port(discovery_port), _queue_limit(queue_limit),
+	_stopping(true), _last_stamp(0), _board_count(0), _feed_client_count(0), _frames_received(0), _gaps(0), _records_sent(0),
+	_records_dropped(0), _resyncs(0), _total_latency(0), _max_latency(0)
+{
+	throw std::runtime_error("The aggregator is not supported on this platform.");
+}
+
+ClockAggregator::~ClockAggregator() {}
+void ClockAggregator::run() {}
+void ClockAggregator::stop() {}
+ClockAggregator::Statistics ClockAggregator::statistics() const { return Statistics(); }
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,190 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef CLOCKAGGREGATOR_H_
+#define CLOCKAGGREGATOR_H_
+
+#include "clockstream.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/**
+ * Hall-wide aggregator (`vcc --aggregator`).
+ *
+ * The aggregator listens for the ANNOUNCE frames sent by the clock instances that have discovery enabled
+ * (see `BroadcastServer::enable_discovery()`), subscribes to the TCP stream of each of them, and merges
+ * all the transitions into a single feed, served over TCP (see `ClockFeedRecordKind` for the format).
+ * The sequence numbers of each board are tracked, so that the frames that follow a gap are flagged.
+ *
+ * The frames are forwarded as they are received (without being re-encoded), from a single event loop.
+ * A feed client that does not read fast enough has its queue replaced by a full re-synchronization
+ * (the current state of all the boards), as in `BroadcastServer`. The records of the re-synchronization do not
+ * count against the queue limit, so that a client can catch up whatever the number of boards.
+ *
+ * Only available on Unix platforms.
+ */
+class ClockAggregator
+{
+public:
+
+	/**
+	 * Activity counters.
+	 */
+	struct Statistics
+	{
+		std::size_t   boards          ; //!< Number of boards currently connected.
+		std::size_t   feed_clients    ; //!< Number of clients connected to the merged feed.
+		std::uint64_t frames_received ; //!< Number of SNAPSHOT/DELTA frames received from the boards.
+		std::uint64_t gaps            ; //!< Number of sequence gaps detected.
+		std::uint64_t records_sent    ; //!< Number of records sent to the feed clients.
+		std::uint64_t records_dropped ; //!< Number of records dropped because of the backpressure.
+		std::uint64_t resyncs         ; //!< Number of re-synchronizations of feed clients.
+		std::uint64_t total_latency   ; //!< Cumulated time between the reception of a frame and its forwarding (in microseconds).
+		std::uint64_t max_latency     ; //!< Highest time between the reception of a frame and its forwarding (in microseconds).
+	};
+
+	/**
+	 * Constructor. Bind the feed socket on the given IPv4 address and port, and the discovery socket on the given port.
+	 * @param queue_limit Maximal number of records queued for each feed client (besides the re-synchronization records).
+	 * @throw std::runtime_error If the sockets cannot be created.
+	 */
+	ClockAggregator(const std::string &address, std::uint16_t port, std::uint16_t discovery_port=CLOCK_STREAM_DISCOVERY_PORT,
+		std::size_t queue_limit=4096);
+
+	/**
+	 * Destructor.
+	 */
+	~ClockAggregator();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	ClockAggregator(const ClockAggregator &op) = delete;
+	ClockAggregator &operator=(const ClockAggregator &op) = delete;
+	/**@} */
+
+	/**
+	 * Port actually used by the feed socket (useful if the aggregator has been created with port 0).
+	 */
+	std::uint16_t port() const { return _port; }
+
+	/**
+	 * Port actually used by the discovery socket.
+	 */
+	std::uint16_t discovery_port() const { return _discovery_port; }
+
+	/**
+	 * Serve the feed until `stop()` is called, or until SIGINT or SIGTERM is received.
+	 */
+	void run();
+
+	/**
+	 * Make `run()` return. Thread-safe.
+	 */
+	void stop();
+
+	/**
+	 * Snapshot of the activity counters. Thread-safe.
+	 */
+	Statistics statistics() const;
+
+private:
+
+	// IPv4 address and port (network byte order).
+	typedef std::pair<std::uint32_t, std::uint16_t> Endpoint;
+
+	// Board to which the aggregator is subscribed.
+	struct Board
+	{
+		std::uint32_t   id           ;
+		Endpoint        endpoint     ;
+		bool            connected    ; // Whether the (non-blocking) connection is established.
+		std::string     buffer       ; // Received bytes that do not form a complete frame yet.
+		bool            has_sequence ;
+		std::uint32_t   last_sequence;
+		ClockFrameState state        ;
+		bool            has_state    ;
+	};
+
+	// Client of the merged feed.
+	struct FeedClient
+	{
+		std::deque<std::string> queue      ; // Records (with their size prefix) waiting to be sent.
+		std::size_t             offset     ; // Number of bytes of the front record already sent.
+		std::size_t             replayed   ; // Records at the front of the queue queued by the last re-synchronization.
+		bool                    write_armed; // Whether EPOLLOUT is currently requested.
+	};
+
+	// Private functions
+	void on_announce();
+	void connect_board(const Endpoint &endpoint);
+	void on_board_event(int fd, std::uint32_t events);
+	bool read_board(int fd, Board &board);
+	void on_frame(Board &board, const char *data, std::size_t size, std::chrono::steady_clock::time_point received_at);
+	void close_board(int fd);
+	void accept_feed_clients();
+	void on_feed_event(int fd, std::uint32_t events);
+	void publish(const ClockFeedRecord &record);
+	void replay(FeedClient &client);
+	bool flush(int fd, FeedClient &client);
+	void close_feed_client(int fd);
+	void flush_batch();
+	std::int64_t stamp();
+	static ClockFeedRecord board_record(ClockFeedRecordKind kind, const Board &board, std::int64_t received);
+
+	// Private members
+	int                                _epoll_fd      ;
+	int                                _event_fd      ;
+	int                                _feed_fd       ;
+	int                                _discovery_fd  ;
+	std::uint16_t                      _port          ;
+	std::uint16_t                      _discovery_port;
+	std::size_t                        _queue_limit   ;
+	std::atomic<bool>                  _stopping      ;
+	std::map<int, Board>               _boards        ;
+	std::map<Endpoint, std::uint32_t>  _board_ids     ; // Stable identifiers, kept when a board disconnects.
+	std::map<int, FeedClient>          _feed_clients  ;
+	std::int64_t                       _last_stamp    ;
+	std::vector<std::chrono::steady_clock::time_point> _batch_received; // Reception instants of the frames not yet flushed.
+
+	// Statistics
+	std::atomic<std::size_t>   _board_count      ;
+	std::atomic<std::size_t>   _feed_client_count;
+	std::atomic<std::uint64_t> _frames_received  ;
+	std::atomic<std::uint64_t> _gaps             ;
+	std::atomic<std::uint64_t> _records_sent     ;
+	std::atomic<std::uint64_t> _records_dropped  ;
+	std::atomic<std::uint64_t> _resyncs          ;
+	std::atomic<std::uint64_t> _total_latency    ;
+	std::atomic<std::uint64_t> _max_latency      ;
+};
+
+#endif /* CLOCKAGGREGATOR_H_ */
@@ -0,0 +1,345 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "clockstream.h"
+#include <algorithm>
+
+
+// Little-endian encoder.
+class ByteWriter
+{
+public:
+	void put_u8 (std::uint8_t  value) { _data.push_back(static_cast<char>(value)); }
+	void put_u16(std::uint16_t value) { put(value, 2); }
+	void put_u32(std::uint32_t value) { put(value, 4); }
+	void put_i64(std::int64_t  value) { put(static_cast<std::uint64_t>(value), 8); }
+	void put_string(const std::string &value)
+	{
+		std::size_t length = std::min<std::size_t>(value.size(), 255);
+		put_u8(static_cast<std::uint8_t>(length));
+		_data.append(value, 0, length);
+	}
+	std::string &data() { return _data; }
+
+private:
+	void put(std::uint64_t value, int bytes)
+	{
+		for(int k=0; k<bytes; ++k) {
+			_data.push_back(static_cast<char>((value >> (8*k)) & 0xff));
+		}
+	}
+	std::string _data;
+};
+
+
+// Little-endian decoder (all the getters return false if the end of the buffer is reached).
+class ByteReader
+{
+public:
+	ByteReader(const char *data, std::size_t size) : _data(reinterpret_cast<const unsigned char *>(data)), _size(size), _offset(0) {}
+	bool get_u8 (std::uint8_t  &value) { std::uint64_t buffer; if(!get(buffer, 1)) return false; value = static_cast<std::uint8_t >(buffer); return true; }
+	bool get_i8 (std::int8_t   &value) { std::uint8_t  buffer; if(!get_u8(buffer)) return false; value = static_cast<std::int8_t  >(buffer); return true; }
+	bool get_u16(std::uint16_t &value) { std::uint64_t buffer; if(!get(buffer, 2)) return false; value = static_cast<std::uint16_t>(buffer); return true; }
+	bool get_u32(std::uint32_t &value) { std::uint64_t buffer; if(!get(buffer, 4)) return false; value = static_cast<std::uint32_t>(buffer); return true; }
+	bool get_i64(std::int64_t  &value) { std::uint64_t buffer; if(!get(buffer, 8)) return false; value = static_cast<std::int64_t >(buffer); return true; }
+	bool get_string(std::string &value)
+	{
+		std::uint8_t length;
+		if(!get_u8(length) || _offset+length>_size) {
+			return false;
+		}
+		value.assign(reinterpret_cast<const char *>(_data + _offset), length);
+		_offset += length;
+		return true;
+	}
+	bool at_end() const { return _offset==_size; }
+
+private:
+	bool get(std::uint64_t &value, int bytes)
+	{
+		if(_offset+bytes>_size) {
+			return false;
+		}
+		value = 0;
+		for(int k=0; k<bytes; ++k) {
+			value |= static_cast<std::uint64_t>(_data[_offset+k]) << (8*k);
+		}
+		_offset += bytes;
+		return true;
+	}
+	const unsigned char *_data  ;
+	std::size_t          _size  ;
+	std::size_t          _offset;
+};
+
+
+// Constructor.
+ClockFrameState::ClockFrameState() : reference(0), time_control_mode(0), active_side(-1)
+{
+	for(auto &it : side) {
+		it.timer_mode      = static_cast<std::uint8_t>(Timer::Mode::PAUSED);
+		it.time            = 0;
+		it.bronstein_limit = 0;
+		it.main_time       = 0;
+		it.increment       = 0;
+		it.byo_periods     = 0;
+	}
+}
+
+
+// Build the stream state corresponding to the given timer state.
+ClockFrameState ClockFrameState::make(const BiTimer::State &state, const Enum::array<Side, std::string> &names)
+{
+	// The timer state is expressed in local time: convert its reference instant to UTC.
+	TimePoint utc_now = boost::posix_time::microsec_clock::universal_time();
+
+	ClockFrameState retval;
+	retval.reference         = to_epoch_microseconds(utc_now) - (current_time() - state.reference).total_microseconds();
+	retval.time_control_mode = Enum::to_value(state.time_control.mode());
+	retval.active_side       = state.active_side ? Enum::to_value(*state.active_side) : -1;
+	for(auto s = Enum::cursor<Side>::first(); s.valid(); ++s) {
+		SideState &target(retval.side[Enum::to_value(*s)]);
+		target.timer_mode      = static_cast<std::uint8_t>(state.mode[*s]);
+		target.time            = state.time[*s].total_microseconds();
+		target.bronstein_limit = state.bronstein_limit[*s].total_microseconds();
+		target.main_time       = state.time_control.main_time(*s).total_microseconds();
+		target.increment       = state.time_control.increment(*s).total_microseconds();
+		target.byo_periods     = static_cast<std::uint16_t>(state.time_control.byo_periods(*s));
+		target.name            = names[*s].substr(0, 255);
+	}
+	return retval;
+}
+
+
+// Time of the given side at the given instant.
+std::int64_t ClockFrameState::time_at(int s, std::int64_t at) const
+{
+	switch(static_cast<Timer::Mode>(side[s].timer_mode)) {
+		case Timer::Mode::INCREMENT: return side[s].time + (at - reference);
+		case Timer::Mode::DECREMENT: return side[s].time - (at - reference);
+		default: return side[s].time;
+	}
+}
+
+
+// Encode a frame carrying the given fields of `state`.
+static std::string encode_frame(ClockFrameType type, std::uint32_t sequence, const ClockFrameState &state, std::uint8_t fields)
+{
+	ByteWriter writer;
+	writer.put_u8('V');
+	writer.put_u8('C');
+	writer.put_u8(CLOCK_STREAM_VERSION);
+	writer.put_u8(static_cast<std::uint8_t>(type));
+	writer.put_u32(sequence);
+	writer.put_i64(state.reference);
+	writer.put_u8(fields);
+	if(fields & ClockFrameField::ACTIVE_SIDE) {
+		writer.put_u8(static_cast<std::uint8_t>(state.active_side));
+	}
+	if(fields & ClockFrameField::TIME_CONTROL) {
+		writer.put_u8(state.time_control_mode);
+		for(const auto &it : state.side) {
+			writer.put_i64(it.main_time  );
+			writer.put_i64(it.increment  );
+			writer.put_u16(it.byo_periods);
+		}
+	}
+	for(int s=0; s<2; ++s) {
+		if(fields & (s==0 ? ClockFrameField::LEFT_TIMER : ClockFrameField::RIGHT_TIMER)) {
+			writer.put_u8 (state.side[s].timer_mode     );
+			writer.put_i64(state.side[s].time           );
+			writer.put_i64(state.side[s].bronstein_limit);
+		}
+	}
+	if(fields & ClockFrameField::NAMES) {
+		writer.put_string(state.side[0].name);
+		writer.put_string(state.side[1].name);
+	}
+	return std::move(writer.data());
+}
+
+
+// Encode a SNAPSHOT frame.
+std::string encode_clock_snapshot(std::uint32_t sequence, const ClockFrameState &state)
+{
+	return encode_frame(ClockFrameType::SNAPSHOT, sequence, state, ClockFrameField::ALL);
+}
+
+
+// Tolerance used to decide whether a running timer must be re-sent in a delta frame (in microseconds): the
+// local-time to UTC conversion of the reference instant may introduce a few microseconds of jitter.
+static const std::int64_t EXTRAPOLATION_TOLERANCE = 50;
+
+
+// Encode a DELTA frame.
+std::string encode_clock_delta(std::uint32_t sequence, const ClockFrameState &previous, const ClockFrameState &current)
+{
+	std::uint8_t fields = 0;
+	if(previous.active_side!=current.active_side) {
+		fields |= ClockFrameField::ACTIVE_SIDE;
+	}
+	if(previous.time_control_mode!=current.time_control_mode) {
+		fields |= ClockFrameField::TIME_CONTROL;
+	}
+	for(int s=0; s<2; ++s) {
+		const ClockFrameState::SideState &p(previous.side[s]);
+		const ClockFrameState::SideState &c(current .side[s]);
+		if(p.main_time!=c.main_time || p.increment!=c.increment || p.byo_periods!=c.byo_periods) {
+			fields |= ClockFrameField::TIME_CONTROL;
+		}
+
+		// A timer is sent only if its extrapolated value drifts from the new one (mode change, increment, etc...).
+		std::int64_t drift = previous.time_at(s, current.reference) - c.time;
+		if(p.timer_mode!=c.timer_mode || p.bronstein_limit!=c.bronstein_limit || drift>EXTRAPOLATION_TOLERANCE || drift<-EXTRAPOLATION_TOLERANCE) {
+			fields |= (s==0 ? ClockFrameField::LEFT_TIMER : ClockFrameField::RIGHT_TIMER);
+		}
+		if(p.name!=c.name) {
+			fields |= ClockFrameField::NAMES;
+		}
+	}
+	return encode_frame(ClockFrameType::DELTA, sequence, current, fields);
+}
+
+
+// Encode a SUBSCRIBE frame.
+std::string encode_clock_subscribe()
+{
+	ClockFrameState empty;
+	return encode_frame(ClockFrameType::SUBSCRIBE, 0, empty, 0);
+}
+
+
+// Encode an ANNOUNCE frame.
+std::string encode_clock_announce(std::uint32_t sequence)
+{
+	ClockFrameState empty;
+	return encode_frame(ClockFrameType::ANNOUNCE, sequence, empty, 0);
+}
+
+
+// Decode a frame.
+bool decode_clock_frame(const char *data, std::size_t size, ClockFrameInfo &info, ClockFrameState &state)
+{
+	ByteReader reader(data, size);
+	std::uint8_t magic0, magic1, version, type;
+	std::int64_t reference;
+	if(!reader.get_u8(magic0) || !reader.get_u8(magic1) || !reader.get_u8(version) || !reader.get_u8(type) ||
+		!reader.get_u32(info.sequence) || !reader.get_i64(reference) || !reader.get_u8(info.fields))
+	{
+		return false;
+	}
+	if(magic0!='V' || magic1!='C' || version!=CLOCK_STREAM_VERSION || type<1 || type>4) {
+		return false;
+	}
+	info.type = static_cast<ClockFrameType>(type);
+	if(info.type==ClockFrameType::SUBSCRIBE || info.type==ClockFrameType::ANNOUNCE) {
+		return info.fields==0 && reader.at_end();
+	}
+
+	// The timers that are not carried by a delta frame are re-based on the new reference instant.
+	ClockFrameState result(state);
+	result.reference = reference;
+	if(info.type==ClockFrameType::DELTA) {
+		for(int s=0; s<2; ++s) {
+			result.side[s].time = state.time_at(s, reference);
+		}
+	}
+
+	bool ok = true;
+	if(info.fields & ClockFrameField::ACTIVE_SIDE) {
+		ok = ok && reader.get_i8(result.active_side);
+	}
+	if(info.fields & ClockFrameField::TIME_CONTROL) {
+		ok = ok && reader.get_u8(result.time_control_mode);
+		for(auto &it : result.side) {
+			ok = ok && reader.get_i64(it.main_time) && reader.get_i64(it.increment) && reader.get_u16(it.byo_periods);
+		}
+	}
+	for(int s=0; s<2; ++s) {
+		if(info.fields & (s==0 ? ClockFrameField::LEFT_TIMER : ClockFrameField::RIGHT_TIMER)) {
+			ok = ok && reader.get_u8(result.side[s].timer_mode) && reader.get_i64(result.side[s].time) && reader.get_i64(result.side[s].bronstein_limit);
+		}
+	}
+	if(info.fields & ClockFrameField::NAMES) {
+		ok = ok && reader.get_string(result.side[0].name) && reader.get_string(result.side[1].name);
+	}
+	if(!ok || !reader.at_end()) {
+		return false;
+	}
+	state = std::move(result);
+	return true;
+}
+
+
+
+// Encode a feed record.
+std::string encode_clock_feed_record(const ClockFeedRecord &record)
+{
+	ByteWriter writer;
+	writer.put_u8 (static_cast<std::uint8_t>(record.kind));
+	writer.put_u8 (record.flags   );
+	writer.put_u32(record.board   );
+	writer.put_i64(record.received);
+	switch(record.kind) {
+		case ClockFeedRecordKind::BOARD_ADDED:
+			for(std::uint8_t byte : record.address) {
+				writer.put_u8(byte);
+			}
+			writer.put_u16(record.port);
+			break;
+		case ClockFeedRecordKind::FRAME:
+			writer.data() += record.frame;
+			break;
+		case ClockFeedRecordKind::BOARD_LOST:
+			break;
+	}
+	return std::move(writer.data());
+}
+
+
+// Decode a feed record.
+bool decode_clock_feed_record(const char *data, std::size_t size, ClockFeedRecord &record)
+{
+	ByteReader reader(data, size);
+	std::uint8_t kind;
+	if(!reader.get_u8(kind) || !reader.get_u8(record.flags) || !reader.get_u32(record.board) || !reader.get_i64(record.received)) {
+		return false;
+	}
+	record.kind = static_cast<ClockFeedRecordKind>(kind);
+	record.frame.clear();
+	switch(record.kind) {
+		case ClockFeedRecordKind::BOARD_ADDED:
+			for(std::uint8_t &byte : record.address) {
+				if(!reader.get_u8(byte)) {
+					return false;
+				}
+			}
+			return reader.get_u16(record.port) && reader.at_end();
+		case ClockFeedRecordKind::FRAME:
+			record.frame.assign(data + CLOCK_FEED_RECORD_HEADER_SIZE, size - CLOCK_FEED_RECORD_HEADER_SIZE);
+			return true;
+		case ClockFeedRecordKind::BOARD_LOST:
+			return reader.at_end();
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,260 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef CLOCKSTREAM_H_
+#define CLOCKSTREAM_H_
+
+#include <core/bitimer.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Binary protocol of the clock-state broadcast stream (see `BroadcastServer`).
+ *
+ * All the integers are little-endian. Each frame starts with the following header:
+ *
+ *     u8  'V', u8 'C'     magic
+ *     u8  version         CLOCK_STREAM_VERSION
+ *     u8  type            ClockFrameType
+ *     u32 sequence        incremented for each SNAPSHOT/DELTA frame sent by the server
+ *     i64 reference_us    reference instant, in microseconds since the Unix epoch (UTC)
+ *     u8  fields          combination of ClockFrameField flags
+ *
+ * followed by the fields announced in `fields`, in the order of the flags:
+ *
+ *     ACTIVE_SIDE    i8  side (-1: none, 0: left, 1: right)
+ *     TIME_CONTROL   u8  mode, then for each side: i64 main time (us), i64 increment (us), u16 byo-periods
+ *     LEFT_TIMER     u8  timer mode, i64 time at the reference instant (us), i64 Bronstein limit (us)
+ *     RIGHT_TIMER    same as LEFT_TIMER
+ *     NAMES          for each side: u8 length, then the UTF-8 bytes of the name
+ *
+ * A SNAPSHOT frame carries all the fields. A DELTA frame carries only the fields that have changed:
+ * the timers it does not carry keep their mode, and their time at the new reference instant is obtained
+ * by extrapolating their previous state. Over TCP, each frame is preceded by its size (u16).
+ * Over UDP, each datagram holds exactly one frame; subscribers register by sending a SUBSCRIBE frame
+ * (header only), and must renew their subscription regularly (see `CLOCK_STREAM_UDP_LEASE`).
+ *
+ * Servers with discovery enabled also send an ANNOUNCE frame (header only, carrying the last sequence number)
+ * every `CLOCK_STREAM_ANNOUNCE_INTERVAL` seconds to the discovery port, from their stream port, so that
+ * aggregators can find them (see `ClockAggregator`).
+ */
+enum class ClockFrameType : std::uint8_t
+{
+	SNAPSHOT  = 1,
+	DELTA     = 2,
+	SUBSCRIBE = 3,
+	ANNOUNCE  = 4
+};
+
+
+/**
+ * Fields that may be present in a frame.
+ */
+namespace ClockFrameField
+{
+	const std::uint8_t ACTIVE_SIDE  = 0x01;
+	const std::uint8_t TIME_CONTROL = 0x02;
+	const std::uint8_t LEFT_TIMER   = 0x04;
+	const std::uint8_t RIGHT_TIMER  = 0x08;
+	const std::uint8_t NAMES        = 0x10;
+	const std::uint8_t ALL          = 0x1f;
+}
+
+
+/**
+ * Protocol version.
+ */
+const std::uint8_t CLOCK_STREAM_VERSION = 1;
+
+/**
+ * Size of the frame header (in bytes).
+ */
+const std::size_t CLOCK_FRAME_HEADER_SIZE = 17;
+
+/**
+ * Duration of a UDP subscription (in seconds).
+ */
+const int CLOCK_STREAM_UDP_LEASE = 30;
+
+/**
+ * UDP port on which the ANNOUNCE frames are sent.
+ */
+const std::uint16_t CLOCK_STREAM_DISCOVERY_PORT = 12079;
+
+/**
+ * Delay between two ANNOUNCE frames (in seconds).
+ */
+const int CLOCK_STREAM_ANNOUNCE_INTERVAL = 1;
+
+
+/**
+ * Clock state as carried by the stream.
+ */
+struct ClockFrameState
+{
+	struct SideState
+	{
+		std::uint8_t  timer_mode     ; //!< Mode of the timer (see `Timer::Mode`).
+		std::int64_t  time           ; //!< Time at the reference instant (us).
+		std::int64_t  bronstein_limit; //!< Bronstein limit (us).
+		std::int64_t  main_time      ; //!< Main time of the time control (us).
+		std::int64_t  increment      ; //!< Increment of the time control (us).
+		std::uint16_t byo_periods    ; //!< Number of byo-periods.
+		std::string   name           ; //!< Player's name (UTF-8, at most 255 bytes).
+	};
+
+	std::int64_t reference        ; //!< Reference instant (us since the Unix epoch, UTC).
+	std::uint8_t time_control_mode; //!< Time control mode (see `TimeControl::Mode`).
+	std::int8_t  active_side      ; //!< -1: none, 0: left, 1: right.
+	SideState    side[2]          ;
+
+	/**
+	 * Constructor (empty state).
+	 */
+	ClockFrameState();
+
+	/**
+	 * Build the stream state corresponding to the given timer state and players' names.
+	 */
+	static ClockFrameState make(const BiTimer::State &state, const Enum::array<Side, std::string> &names);
+
+	/**
+	 * Time of the given side (0: left, 1: right) at the given instant (us since the Unix epoch, UTC).
+	 */
+	std::int64_t time_at(int s, std::int64_t at) const;
+};
+
+
+/**
+ * Encode a SNAPSHOT frame.
+ */
+std::string encode_clock_snapshot(std::uint32_t sequence, const ClockFrameState &state);
+
+/**
+ * Encode a DELTA frame, carrying the fields of `current` that differ from `previous`.
+ */
+std::string encode_clock_delta(std::uint32_t sequence, const ClockFrameState &previous, const ClockFrameState &current);
+
+/**
+ * Encode a SUBSCRIBE frame.
+ */
+std::string encode_clock_subscribe();
+
+/**
+ * Encode an ANNOUNCE frame.
+ */
+std::string encode_clock_announce(std::uint32_t sequence);
+
+/**
+ * Header information of a decoded frame.
+ */
+struct ClockFrameInfo
+{
+	ClockFrameType type    ;
+	std::uint32_t  sequence;
+	std::uint8_t   fields  ;
+};
+
+/**
+ * Decode a frame, and apply it to `state` (which must hold the state of the previous frame in case of a DELTA frame).
+ * SUBSCRIBE and ANNOUNCE frames leave `state` unchanged.
+ * @returns `false` if the frame is malformed (`state` is left unchanged in this case).
+ */
+bool decode_clock_frame(const char *data, std::size_t size, ClockFrameInfo &info, ClockFrameState &state);
+
+
+
+/**
+ * Kind of the records of the aggregated feed served by `ClockAggregator`.
+ *
+ * Over TCP, each record is preceded by its size (u16), and starts with the following header:
+ *
+ *     u8  kind            ClockFeedRecordKind
+ *     u8  flags           combination of ClockFeedFlag flags
+ *     u32 board           board identifier, assigned by the aggregator
+ *     i64 received_us     instant at which the aggregator received the frame (us since the Unix epoch, UTC)
+ *
+ * followed by:
+ *
+ *     BOARD_ADDED    u8[4] IPv4 address of the board, u16 stream port
+ *     FRAME          the SNAPSHOT or DELTA frame received from the board, unchanged
+ *     BOARD_LOST     nothing
+ *
+ * The records are sent in the order in which the aggregator received the frames, and `received_us`
+ * never decreases along the feed.
+ */
+enum class ClockFeedRecordKind : std::uint8_t
+{
+	BOARD_ADDED = 1,
+	FRAME       = 2,
+	BOARD_LOST  = 3
+};
+
+
+/**
+ * Flags of the feed records.
+ */
+namespace ClockFeedFlag
+{
+	const std::uint8_t GAP    = 0x01; //!< Some frames of the board have been lost before this one (sequence jump).
+	const std::uint8_t REPLAY = 0x02; //!< Record re-sent to (re)synchronize a feed client, not a new transition.
+}
+
+
+/**
+ * Record of the aggregated feed.
+ */
+struct ClockFeedRecord
+{
+	ClockFeedRecordKind kind      ;
+	std::uint8_t        flags     ;
+	std::uint32_t       board     ;
+	std::int64_t        received  ; //!< us since the Unix epoch, UTC.
+	std::uint8_t        address[4]; //!< BOARD_ADDED only.
+	std::uint16_t       port      ; //!< BOARD_ADDED only.
+	std::string         frame     ; //!< FRAME only.
+};
+
+/**
+ * Default TCP port of the aggregated feed.
+ */
+const std::uint16_t CLOCK_FEED_DEFAULT_PORT = 12081;
+
+/**
+ * Size of the header of the feed records (in bytes).
+ */
+const std::size_t CLOCK_FEED_RECORD_HEADER_SIZE = 14;
+
+/**
+ * Encode a feed record (without its size prefix).
+ */
+std::string encode_clock_feed_record(const ClockFeedRecord &record);
+
+/**
+ * Decode a feed record (without its size prefix).
+ * @returns `false` if the record is malformed.
+ */
+bool decode_clock_feed_record(const char *data, std::size_t size, ClockFeedRecord &record);
+
+#endif /* CLOCKSTREAM_H_ */
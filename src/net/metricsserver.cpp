@@ -0,0 +1,161 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "metricsserver.h"
+#include <core/metrics.h>
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// Maximal time spent waiting for the request of a client (in milliseconds).
+static const int REQUEST_TIMEOUT = 1000;
+
+
+// Constructor.
+MetricsServer::MetricsServer(const std::string &address, std::uint16_t port) : _server_fd(-1), _stop_fd(-1), _port(port)
+{
+	sockaddr_in bind_address;
+	std::memset(&bind_address, 0, sizeof(bind_address));
+	bind_address.sin_family = AF_INET;
+	bind_address.sin_port   = htons(port);
+	if(inet_pton(AF_INET, address.c_str(), &bind_address.sin_addr)!=1) {
+		throw std::runtime_error("Invalid metrics address: " + address);
+	}
+
+	int enable = 1;
+	_server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	_stop_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(_server_fd<0 || _stop_fd<0 || setsockopt(_server_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable))!=0 ||
+		bind(_server_fd, reinterpret_cast<sockaddr *>(&bind_address), sizeof(bind_address))!=0 || listen(_server_fd, 16)!=0)
+	{
+		for(int fd : {_server_fd, _stop_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw std::runtime_error("Unable to create the metrics socket.");
+	}
+	socklen_t length = sizeof(bind_address);
+	getsockname(_server_fd, reinterpret_cast<sockaddr *>(&bind_address), &length);
+	_port = ntohs(bind_address.sin_port);
+
+	_thread = std::thread(&MetricsServer::run, this);
+}
+
+
+// Destructor.
+MetricsServer::~MetricsServer()
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_stop_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+	close(_server_fd);
+	close(_stop_fd);
+}
+
+
+// Event loop of the server thread.
+void MetricsServer::run()
+{
+	while(true) {
+		pollfd fds[2] = { {_stop_fd, POLLIN, 0}, {_server_fd, POLLIN, 0} };
+		if(poll(fds, 2, -1)<0) {
+			continue;
+		}
+		if(fds[0].revents!=0) {
+			return;
+		}
+		int fd = accept4(_server_fd, nullptr, nullptr, SOCK_CLOEXEC);
+		if(fd>=0) {
+			serve(fd);
+			close(fd);
+		}
+	}
+}
+
+
+// Serve one request.
+void MetricsServer::serve(int fd)
+{
+	// Read the request line and the headers (the body, if any, is ignored).
+	std::string request;
+	while(request.find("\r\n\r\n")==std::string::npos && request.size()<8192) {
+		pollfd pfd{fd, POLLIN, 0};
+		if(poll(&pfd, 1, REQUEST_TIMEOUT)<=0) {
+			return;
+		}
+		char buffer[1024];
+		ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+		if(received<=0) {
+			return;
+		}
+		request.append(buffer, received);
+	}
+
+	std::string status  = "200 OK";
+	std::string type    = "text/plain; version=0.0.4; charset=utf-8";
+	std::string body;
+	bool        is_head = request.compare(0, 5, "HEAD ")==0;
+	if(request.compare(0, 13, "GET /metrics ")==0 || request.compare(0, 14, "HEAD /metrics ")==0) {
+		body = Metrics::instance().scrape();
+	}
+	else {
+		status = "404 Not Found";
+		type   = "text/plain; charset=utf-8";
+		body   = "Not found\n";
+	}
+
+	std::string response = "HTTP/1.0 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: " +
+		std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+	if(!is_head) {
+		response += body;
+	}
+	for(std::size_t offset=0; offset<response.size(); ) {
+		ssize_t sent = send(fd, response.data()+offset, response.size()-offset, MSG_NOSIGNAL);
+		if(sent<=0) {
+			return;
+		}
+		offset += sent;
+	}
+}
+
+#else
+
+// Sockets are not supported on this platform.
+MetricsServer::MetricsServer(const std::string &, std::uint16_t port) : _server_fd(-1), _stop_fd(-1), _port(port)
+{
+	throw std::runtime_error("The metrics endpoint is not supported on this platform.");
+}
+
+MetricsServer::~MetricsServer() {}
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,78 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef METRICSSERVER_H_
+#define METRICSSERVER_H_
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+
+/**
+ * Minimal HTTP server exposing the metrics registered in `Metrics`, at `/metrics`.
+ *
+ * The requests are served one at a time by a dedicated thread: scrapes are infrequent, and must not
+ * disturb the other threads. Only available on Unix platforms.
+ */
+class MetricsServer
+{
+public:
+
+	/**
+	 * Constructor. Bind the socket on the given IPv4 address and port, and start the server thread.
+	 * @throw std::runtime_error If the socket cannot be created.
+	 */
+	MetricsServer(const std::string &address, std::uint16_t port);
+
+	/**
+	 * Destructor. Stop the server thread.
+	 */
+	~MetricsServer();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	MetricsServer(const MetricsServer &op) = delete;
+	MetricsServer &operator=(const MetricsServer &op) = delete;
+	/**@} */
+
+	/**
+	 * Port actually used by the socket (useful if the server has been created with port 0).
+	 */
+	std::uint16_t port() const { return _port; }
+
+private:
+
+	// Private functions
+	void run();
+	void serve(int fd);
+
+	// Private members
+	int           _server_fd;
+	int           _stop_fd  ;
+	std::uint16_t _port     ;
+	std::thread   _thread   ;
+};
+
+#endif /* METRICSSERVER_H_ */
@@ -0,0 +1,567 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "streamloadtest.h"
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+
+// Human-readable report.
+std::string StreamLoadTestResult::report() const
+{
+	std::ostringstream retval;
+	retval << std::fixed << std::setprecision(3)
+		<< "Published " << changes << " changes in " << duration << " s to " << udp_subscribers << " UDP subscribers and "
+		<< tcp_clients << " TCP clients\n"
+		<< "subscribers: " << frames_received << " frames received, " << gaps << " sequence gaps, " << malformed << " malformed frames, "
+		<< stale << " out-of-date at the end\n"
+		<< "server: " << server.frames_sent << " frames sent, " << server.frames_dropped << " dropped, " << server.resyncs << " resyncs\n"
+		<< (passed() ? "PASSED" : "FAILED") << "\n";
+	return retval.str();
+}
+
+
+// Human-readable report.
+std::string AggregatorLoadTestResult::report() const
+{
+	std::ostringstream retval;
+	retval << std::fixed << std::setprecision(3)
+		<< "Published " << changes << " changes in " << duration << " s on " << boards << " boards\n"
+		<< "feed: " << records_received << " records received, " << gaps << " sequence gaps, " << malformed << " malformed records, "
+		<< unordered << " out of order, " << stale << " boards out-of-date at the end\n"
+		<< std::setprecision(0)
+		<< "aggregator: " << aggregator.frames_received << " frames received, " << aggregator.records_sent << " records sent, "
+		<< aggregator.records_dropped << " dropped, " << aggregator.resyncs << " resyncs, added latency "
+		<< (aggregator.frames_received==0 ? 0.0 : static_cast<double>(aggregator.total_latency) / aggregator.frames_received)
+		<< " us (mean), " << aggregator.max_latency << " us (max)\n"
+		<< (passed() ? "PASSED" : "FAILED") << "\n";
+	return retval.str();
+}
+
+
+#ifdef OS_IS_UNIX
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+// One subscriber in ten uses TCP.
+static const std::size_t TCP_CLIENT_RATIO = 10;
+
+// Delay without any received frame after which the subscribers are considered to have received everything.
+static const std::chrono::milliseconds SETTLE_DELAY(500);
+
+// Largest delay to wait for the subscriptions, or for the frames to be received.
+static const std::chrono::seconds TIMEOUT(10);
+
+// Tolerance on the time of the timers in the final state (in microseconds).
+static const std::int64_t TIME_TOLERANCE = 1000;
+
+
+// Subscriber of the stream, and what it has received.
+struct LoadTestSubscriber
+{
+	int             fd      ;
+	bool            tcp     ;
+	std::string     buffer  ; // Incomplete TCP frame.
+	ClockFrameState state   ;
+	bool            synced  ; // Whether a snapshot has been received.
+	std::uint32_t   sequence; // Sequence number of the last frame.
+	LoadTestSubscriber() : fd(-1), tcp(false), synced(false), sequence(0) {}
+};
+
+
+// Sockets of the subscribers, closed when the test ends (even if it fails).
+struct LoadTestSockets
+{
+	int                             epoll_fd;
+	std::vector<LoadTestSubscriber> clients ;
+	LoadTestSockets() : epoll_fd(-1) {}
+	~LoadTestSockets()
+	{
+		for(const auto &it : clients) {
+			if(it.fd>=0) {
+				close(it.fd);
+			}
+		}
+		if(epoll_fd>=0) {
+			close(epoll_fd);
+		}
+	}
+};
+
+
+// Counters of the receiving thread.
+struct LoadTestCounters
+{
+	std::atomic<std::uint64_t> frames_received;
+	std::uint64_t              gaps           ;
+	std::uint64_t              malformed      ;
+	LoadTestCounters() : frames_received(0), gaps(0), malformed(0) {}
+};
+
+
+// Loopback address of the server.
+static sockaddr_in loopback_address(std::uint16_t port)
+{
+	sockaddr_in retval;
+	std::memset(&retval, 0, sizeof(retval));
+	retval.sin_family      = AF_INET;
+	retval.sin_port        = htons(port);
+	retval.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return retval;
+}
+
+
+// Process a frame received by a subscriber.
+static void on_frame(LoadTestSubscriber &subscriber, const char *data, std::size_t size, LoadTestCounters &counters)
+{
+	++counters.frames_received;
+	ClockFrameInfo info;
+	if(!decode_clock_frame(data, size, info, subscriber.state)) {
+		++counters.malformed;
+		return;
+	}
+	if(info.type==ClockFrameType::SNAPSHOT) {
+
+		// A snapshot re-sending the current state (e.g. when the subscription is renewed) is not a gap.
+		if(subscriber.synced && info.sequence!=subscriber.sequence && info.sequence!=subscriber.sequence+1) {
+			++counters.gaps;
+		}
+		subscriber.synced = true;
+	}
+	else if(info.type==ClockFrameType::DELTA && (!subscriber.synced || info.sequence!=subscriber.sequence+1)) {
+		++counters.gaps;
+	}
+	subscriber.sequence = info.sequence;
+}
+
+
+// Read all the data available for a subscriber.
+static void on_readable(LoadTestSubscriber &subscriber, LoadTestCounters &counters)
+{
+	char buffer[4096];
+	while(true) {
+		ssize_t received = recv(subscriber.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if(received<=0) {
+			return;
+		}
+		if(!subscriber.tcp) {
+			on_frame(subscriber, buffer, received, counters);
+			continue;
+		}
+		subscriber.buffer.append(buffer, received);
+		std::size_t offset = 0;
+		while(subscriber.buffer.size()-offset>=2) {
+			std::size_t size = static_cast<unsigned char>(subscriber.buffer[offset]) |
+				static_cast<std::size_t>(static_cast<unsigned char>(subscriber.buffer[offset+1])) << 8;
+			if(subscriber.buffer.size()-offset-2<size) {
+				break;
+			}
+			on_frame(subscriber, subscriber.buffer.data()+offset+2, size, counters);
+			offset += 2 + size;
+		}
+		subscriber.buffer.erase(0, offset);
+	}
+}
+
+
+// Whether a received state matches the last published state.
+static bool is_up_to_date(const ClockFrameState &state, const ClockFrameState &expected)
+{
+	if(state.active_side!=expected.active_side) {
+		return false;
+	}
+	for(int s=0; s<2; ++s) {
+		std::int64_t error = state.time_at(s, expected.reference) - expected.side[s].time;
+		if(state.side[s].timer_mode!=expected.side[s].timer_mode || error>TIME_TOLERANCE || error<-TIME_TOLERANCE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Run the load test.
+StreamLoadTestResult run_stream_load_test(std::size_t subscribers, std::size_t changes, double rate)
+{
+	StreamLoadTestResult retval;
+	retval.tcp_clients     = subscribers / TCP_CLIENT_RATIO;
+	retval.udp_subscribers = subscribers - retval.tcp_clients;
+	retval.changes         = changes;
+
+	// Each TCP client uses two descriptors (one on each side of the connection).
+	rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit)==0 && limit.rlim_cur<limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	// Initial state, published before the subscriptions so that each subscriber starts with a snapshot.
+	BroadcastServer server("127.0.0.1", 0);
+	BiTimer bi_timer;
+	Enum::array<Side, std::string> names;
+	names[Side::LEFT ] = "White";
+	names[Side::RIGHT] = "Black";
+	server.publish(bi_timer.state(), names);
+
+	// Subscribers
+	LoadTestSockets sockets;
+	std::vector<LoadTestSubscriber> &clients(sockets.clients);
+	clients.resize(subscribers);
+	sockets.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(sockets.epoll_fd<0) {
+		throw std::runtime_error("Unable to create the subscriber event loop.");
+	}
+	sockaddr_in server_address = loopback_address(server.port());
+	std::string subscribe = encode_clock_subscribe();
+	for(std::size_t k=0; k<subscribers; ++k) {
+		LoadTestSubscriber &client(clients[k]);
+		client.tcp = k % TCP_CLIENT_RATIO == TCP_CLIENT_RATIO-1;
+		client.fd  = socket(AF_INET, client.tcp ? SOCK_STREAM | SOCK_CLOEXEC : SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if(client.fd<0) {
+			throw std::runtime_error("Unable to create the subscriber sockets.");
+		}
+		if(client.tcp) {
+			if(connect(client.fd, reinterpret_cast<sockaddr *>(&server_address), sizeof(server_address))!=0) {
+				throw std::runtime_error("Unable to connect to the broadcast server.");
+			}
+		}
+		else {
+			int buffer_size = 1 << 20;
+			setsockopt(client.fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+			sockaddr_in local_address = loopback_address(0);
+			if(bind(client.fd, reinterpret_cast<sockaddr *>(&local_address), sizeof(local_address))!=0 ||
+				sendto(client.fd, subscribe.data(), subscribe.size(), 0, reinterpret_cast<sockaddr *>(&server_address), sizeof(server_address))<0)
+			{
+				throw std::runtime_error("Unable to subscribe to the broadcast server.");
+			}
+		}
+		epoll_event event;
+		event.events   = EPOLLIN;
+		event.data.u64 = k;
+		epoll_ctl(sockets.epoll_fd, EPOLL_CTL_ADD, client.fd, &event);
+	}
+
+	// Wait for the server to register all the subscribers.
+	auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+	while(true) {
+		BroadcastServer::Statistics statistics = server.statistics();
+		if(statistics.udp_subscribers==retval.udp_subscribers && statistics.tcp_clients==retval.tcp_clients) {
+			break;
+		}
+		if(std::chrono::steady_clock::now()>deadline) {
+			throw std::runtime_error("The subscribers have not all been registered by the broadcast server.");
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	// Receiving thread.
+	LoadTestCounters counters;
+	std::atomic<bool> stopping(false);
+	std::thread receiver([&]() {
+		std::vector<epoll_event> events(256);
+		while(!stopping) {
+			int count = epoll_wait(sockets.epoll_fd, events.data(), events.size(), 100);
+			for(int k=0; k<count; ++k) {
+				on_readable(clients[events[k].data.u64], counters);
+			}
+		}
+	});
+
+	// Publish the clock presses.
+	auto started_at = std::chrono::steady_clock::now();
+	bi_timer.start_timer(Side::LEFT);
+	for(std::size_t k=0; k<changes; ++k) {
+		std::this_thread::sleep_until(started_at + std::chrono::microseconds(static_cast<std::int64_t>(k * 1e6 / rate)));
+		bi_timer.change_timer();
+		server.publish(bi_timer.state(), names);
+	}
+	retval.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+
+	// Wait until the subscribers stop receiving frames.
+	deadline = std::chrono::steady_clock::now() + TIMEOUT;
+	std::uint64_t received = counters.frames_received;
+	auto last_activity = std::chrono::steady_clock::now();
+	while(std::chrono::steady_clock::now()-last_activity<SETTLE_DELAY && std::chrono::steady_clock::now()<deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if(counters.frames_received!=received) {
+			received      = counters.frames_received;
+			last_activity = std::chrono::steady_clock::now();
+		}
+	}
+	stopping = true;
+	receiver.join();
+
+	// Results
+	ClockFrameState expected = ClockFrameState::make(bi_timer.state(), names);
+	retval.frames_received = counters.frames_received;
+	retval.gaps            = counters.gaps;
+	retval.malformed       = counters.malformed;
+	retval.stale           = 0;
+	for(const auto &it : clients) {
+		if(!it.synced || !is_up_to_date(it.state, expected)) {
+			++retval.stale;
+		}
+	}
+	retval.server = server.statistics();
+	return retval;
+}
+
+
+// Board simulated by the aggregator load test, and its state as seen through the feed.
+struct LoadTestBoard
+{
+	std::unique_ptr<BroadcastServer> server  ;
+	BiTimer                          bi_timer;
+	std::uint32_t                    id      ; // Identifier assigned by the aggregator.
+	bool                             added   ; // Whether the BOARD_ADDED record has been received.
+	ClockFrameState                  state   ;
+	bool                             synced  ; // Whether a snapshot has been received through the feed.
+	LoadTestBoard() : id(0), added(false), synced(false) {}
+};
+
+
+// Counters of the feed client.
+struct LoadTestFeedCounters
+{
+	std::atomic<std::uint64_t> records_received;
+	std::atomic<std::size_t>   boards_added    ;
+	std::uint64_t              gaps            ;
+	std::uint64_t              malformed       ;
+	std::uint64_t              unordered       ;
+	std::int64_t               last_received   ;
+	LoadTestFeedCounters() : records_received(0), boards_added(0), gaps(0), malformed(0), unordered(0), last_received(0) {}
+};
+
+
+// Thread of the aggregator load test, stopped and joined when the test ends (even if it fails).
+struct LoadTestThread
+{
+	std::function<void()> stop  ;
+	std::thread           thread;
+	void join()
+	{
+		if(thread.joinable()) {
+			stop();
+			thread.join();
+		}
+	}
+	~LoadTestThread() { join(); }
+};
+
+
+// Process a record of the aggregated feed.
+static void on_feed_record(std::vector<LoadTestBoard> &boards, const char *data, std::size_t size, LoadTestFeedCounters &counters)
+{
+	++counters.records_received;
+	ClockFeedRecord record;
+	if(!decode_clock_feed_record(data, size, record)) {
+		++counters.malformed;
+		return;
+	}
+	if(record.received<counters.last_received) {
+		++counters.unordered;
+	}
+	counters.last_received = record.received;
+
+	// The boards are identified by their stream port (they all run on the loopback interface).
+	if(record.kind==ClockFeedRecordKind::BOARD_ADDED) {
+		for(auto &it : boards) {
+			if(it.server->port()==record.port && !it.added) {
+				it.id    = record.board;
+				it.added = true;
+				++counters.boards_added;
+			}
+		}
+		return;
+	}
+	if(record.kind!=ClockFeedRecordKind::FRAME) {
+		return;
+	}
+	if(record.flags & ClockFeedFlag::GAP) {
+		++counters.gaps;
+	}
+	for(auto &it : boards) {
+		if(it.added && it.id==record.board) {
+			ClockFrameInfo info;
+			if(!decode_clock_frame(record.frame.data(), record.frame.size(), info, it.state)) {
+				++counters.malformed;
+			}
+			else if(info.type==ClockFrameType::SNAPSHOT) {
+				it.synced = true;
+			}
+			return;
+		}
+	}
+}
+
+
+// Run the load test of the aggregator.
+AggregatorLoadTestResult run_aggregator_load_test(std::size_t board_count, std::size_t changes, double rate)
+{
+	AggregatorLoadTestResult retval;
+	retval.boards  = board_count;
+	retval.changes = changes;
+
+	// Aggregator, on an ephemeral discovery port so that it does not interfere with the actual boards of the hall.
+	ClockAggregator aggregator("127.0.0.1", 0, 0);
+	LoadTestThread aggregator_thread;
+	aggregator_thread.stop   = [&aggregator]() { aggregator.stop(); };
+	aggregator_thread.thread = std::thread([&aggregator]() {
+		try {
+			aggregator.run();
+		}
+		catch(std::exception &) {} // <- Detected afterwards, through the missing records.
+	});
+
+	// Feed client, connected before the boards are discovered.
+	LoadTestSockets sockets;
+	sockets.clients.resize(1);
+	LoadTestSubscriber &feed(sockets.clients[0]);
+	feed.tcp = true;
+	feed.fd  = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_in feed_address = loopback_address(aggregator.port());
+	if(feed.fd<0 || connect(feed.fd, reinterpret_cast<sockaddr *>(&feed_address), sizeof(feed_address))!=0) {
+		throw std::runtime_error("Unable to connect to the aggregator feed.");
+	}
+
+	// Boards, each one starting with its own initial state.
+	std::vector<LoadTestBoard> boards(board_count);
+	Enum::array<Side, std::string> names;
+	names[Side::LEFT ] = "White";
+	names[Side::RIGHT] = "Black";
+	for(auto &it : boards) {
+		it.server.reset(new BroadcastServer("127.0.0.1", 0));
+		it.server->publish(it.bi_timer.state(), names);
+		it.server->enable_discovery(aggregator.discovery_port());
+	}
+
+	// Receiving thread.
+	LoadTestFeedCounters counters;
+	std::atomic<bool> stopping(false);
+	LoadTestThread receiver;
+	receiver.stop   = [&stopping]() { stopping = true; };
+	receiver.thread = std::thread([&]() {
+		timeval timeout = { 0, 100000 };
+		setsockopt(feed.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		char buffer[65536];
+		while(!stopping) {
+			ssize_t received = recv(feed.fd, buffer, sizeof(buffer), 0);
+			if(received<=0) {
+				continue;
+			}
+			feed.buffer.append(buffer, received);
+			std::size_t offset = 0;
+			while(feed.buffer.size()-offset>=2) {
+				std::size_t size = static_cast<unsigned char>(feed.buffer[offset]) |
+					static_cast<std::size_t>(static_cast<unsigned char>(feed.buffer[offset+1])) << 8;
+				if(feed.buffer.size()-offset-2<size) {
+					break;
+				}
+				on_feed_record(boards, feed.buffer.data()+offset+2, size, counters);
+				offset += 2 + size;
+			}
+			feed.buffer.erase(0, offset);
+		}
+	});
+
+	// Wait for the aggregator to discover all the boards.
+	auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+	while(aggregator.statistics().boards<board_count || counters.boards_added<board_count) {
+		if(std::chrono::steady_clock::now()>deadline) {
+			throw std::runtime_error("The boards have not all been discovered by the aggregator.");
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	// Publish the clock presses, on each board in turn.
+	auto started_at = std::chrono::steady_clock::now();
+	for(auto &it : boards) {
+		it.bi_timer.start_timer(Side::LEFT);
+		it.server->publish(it.bi_timer.state(), names);
+	}
+	for(std::size_t k=0; k<changes; ++k) {
+		std::this_thread::sleep_until(started_at + std::chrono::microseconds(static_cast<std::int64_t>(k * 1e6 / rate)));
+		LoadTestBoard &board(boards[k % board_count]);
+		board.bi_timer.change_timer();
+		board.server->publish(board.bi_timer.state(), names);
+	}
+	retval.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+
+	// Wait until the feed client stops receiving records.
+	deadline = std::chrono::steady_clock::now() + TIMEOUT;
+	std::uint64_t received = counters.records_received;
+	auto last_activity = std::chrono::steady_clock::now();
+	while(std::chrono::steady_clock::now()-last_activity<SETTLE_DELAY && std::chrono::steady_clock::now()<deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if(counters.records_received!=received) {
+			received      = counters.records_received;
+			last_activity = std::chrono::steady_clock::now();
+		}
+	}
+	receiver.join();
+
+	// Results
+	retval.records_received = counters.records_received;
+	retval.gaps             = counters.gaps;
+	retval.malformed        = counters.malformed;
+	retval.unordered        = counters.unordered;
+	retval.stale            = 0;
+	for(const auto &it : boards) {
+		if(!it.synced || !is_up_to_date(it.state, ClockFrameState::make(it.bi_timer.state(), names))) {
+			++retval.stale;
+		}
+	}
+	retval.aggregator = aggregator.statistics();
+	return retval;
+}
+
+#else
+
+// The broadcast server is not available.
+StreamLoadTestResult run_stream_load_test(std::size_t, std::size_t, double)
+{
+	throw std::runtime_error("The broadcast stream is not available on this platform.");
+}
+
+
+// The aggregator is not available.
+AggregatorLoadTestResult run_aggregator_load_test(std::size_t, std::size_t, double)
+{
+	throw std::runtime_error("The aggregator is not available on this platform.");
+}
+
+#endif /* OS_IS_UNIX */
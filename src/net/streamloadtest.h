@@ -0,0 +1,113 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef STREAMLOADTEST_H_
+#define STREAMLOADTEST_H_
+
+#include "broadcastserver.h"
+#include "clockaggregator.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Result of a load test of the broadcast stream (see `run_stream_load_test()`).
+ */
+struct StreamLoadTestResult
+{
+	std::size_t                 udp_subscribers; //!< Number of UDP subscribers.
+	std::size_t                 tcp_clients    ; //!< Number of TCP clients.
+	std::size_t                 changes        ; //!< Number of published state changes.
+	double                      duration       ; //!< Duration of the publishing phase (in seconds).
+	std::uint64_t               frames_received; //!< Frames received by all the subscribers.
+	std::uint64_t               gaps           ; //!< Jumps in the sequence numbers seen by the subscribers.
+	std::uint64_t               malformed      ; //!< Frames that could not be decoded.
+	std::size_t                 stale          ; //!< Subscribers that did not end up with the last published state.
+	BroadcastServer::Statistics server         ; //!< Counters of the server at the end of the test.
+
+	/**
+	 * Whether every subscriber received all the frames in sequence, and ended up with the last published state.
+	 */
+	bool passed() const { return gaps==0 && malformed==0 && stale==0; }
+
+	/**
+	 * Human-readable report.
+	 */
+	std::string report() const;
+};
+
+
+/**
+ * Load test of the broadcast stream over the loopback interface: a `BroadcastServer` is started on 127.0.0.1,
+ * `subscribers` subscribers connect to it (one in ten over TCP, the others over UDP), and `changes` state changes
+ * (clock presses) are published at the given rate. Each subscriber decodes the frames it receives, checks their
+ * sequence numbers, and its final state is compared to the last published one.
+ *
+ * Only available on Unix platforms.
+ * @throw std::runtime_error If the sockets cannot be created.
+ */
+StreamLoadTestResult run_stream_load_test(std::size_t subscribers, std::size_t changes, double rate);
+
+
+
+/**
+ * Result of a load test of the hall-wide aggregator (see `run_aggregator_load_test()`).
+ */
+struct AggregatorLoadTestResult
+{
+	std::size_t                 boards          ; //!< Number of simulated boards.
+	std::size_t                 changes         ; //!< Number of published state changes (all boards together).
+	double                      duration        ; //!< Duration of the publishing phase (in seconds).
+	std::uint64_t               records_received; //!< Records received by the feed client.
+	std::uint64_t               gaps            ; //!< Records flagged with `ClockFeedFlag::GAP`.
+	std::uint64_t               malformed       ; //!< Records (or forwarded frames) that could not be decoded.
+	std::uint64_t               unordered       ; //!< Records whose reception instant is before the one of the previous record.
+	std::size_t                 stale           ; //!< Boards whose state, as seen through the feed, is not the last published one.
+	ClockAggregator::Statistics aggregator      ; //!< Counters of the aggregator at the end of the test.
+
+	/**
+	 * Whether the feed carried all the transitions of all the boards, in order and without loss.
+	 */
+	bool passed() const { return gaps==0 && malformed==0 && unordered==0 && stale==0 && aggregator.records_dropped==0; }
+
+	/**
+	 * Human-readable report.
+	 */
+	std::string report() const;
+};
+
+
+/**
+ * Load test of the hall-wide aggregator over the loopback interface: a `ClockAggregator` and `boards` simulated boards
+ * (each one a `BroadcastServer` announcing itself on the discovery port of the aggregator) are started on 127.0.0.1,
+ * a client connects to the merged feed, and `changes` state changes (clock presses, spread over the boards in turn)
+ * are published at the given overall rate. The client decodes the records, checks their order and their gap flags,
+ * and the final state of each board is compared to the last published one.
+ *
+ * Only available on Unix platforms.
+ * @throw std::runtime_error If the sockets cannot be created.
+ */
+AggregatorLoadTestResult run_aggregator_load_test(std::size_t boards, std::size_t changes, double rate);
+
+
+#endif /* STREAMLOADTEST_H_ */
@@ -0,0 +1,232 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "timesync.h"
+#include <algorithm>
+#include <cmath>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+
+// Minimal time span of the fit window before the drift is estimated (us).
+static const std::int64_t MIN_DRIFT_SPAN = 10000000;
+
+// Maximal drift accepted (ppm): larger values would come from a broken fit, not from a real oscillator.
+static const double MAX_DRIFT = 500.0;
+
+// Delay added to the one of the samples when computing their weight, so that a few very fast exchanges do not
+// take all the weight (us).
+static const double DELAY_FLOOR = 50.0;
+
+// Number of consecutive outliers after which the reference clock is considered as stepped.
+static const std::size_t MAX_CONSECUTIVE_OUTLIERS = 3;
+
+
+// Little-endian helpers.
+static void put(std::string &out, std::uint64_t value, int bytes)
+{
+	for(int k=0; k<bytes; ++k) {
+		out.push_back(static_cast<char>((value >> (8*k)) & 0xff));
+	}
+}
+
+static std::uint64_t get(const char *in, int bytes)
+{
+	std::uint64_t retval = 0;
+	for(int k=0; k<bytes; ++k) {
+		retval |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[k])) << (8*k);
+	}
+	return retval;
+}
+
+
+// Encode a packet.
+std::string encode_time_sync_packet(const TimeSyncPacket &packet)
+{
+	std::string retval;
+	retval.reserve(TIME_SYNC_PACKET_SIZE);
+	retval.push_back('V');
+	retval.push_back('S');
+	put(retval, TIME_SYNC_VERSION, 1);
+	put(retval, static_cast<std::uint8_t>(packet.type), 1);
+	put(retval, packet.sequence, 4);
+	put(retval, static_cast<std::uint64_t>(packet.origin  ), 8);
+	put(retval, static_cast<std::uint64_t>(packet.receive ), 8);
+	put(retval, static_cast<std::uint64_t>(packet.transmit), 8);
+	return retval;
+}
+
+
+// Decode a packet.
+bool decode_time_sync_packet(const char *data, std::size_t size, TimeSyncPacket &packet)
+{
+	if(size!=TIME_SYNC_PACKET_SIZE || data[0]!='V' || data[1]!='S' || static_cast<std::uint8_t>(data[2])!=TIME_SYNC_VERSION) {
+		return false;
+	}
+	std::uint8_t type = static_cast<std::uint8_t>(data[3]);
+	if(type!=static_cast<std::uint8_t>(TimeSyncPacketType::REQUEST) && type!=static_cast<std::uint8_t>(TimeSyncPacketType::RESPONSE)) {
+		return false;
+	}
+	packet.type     = static_cast<TimeSyncPacketType>(type);
+	packet.sequence = static_cast<std::uint32_t>(get(data+ 4, 4));
+	packet.origin   = static_cast<std::int64_t >(get(data+ 8, 8));
+	packet.receive  = static_cast<std::int64_t >(get(data+16, 8));
+	packet.transmit = static_cast<std::int64_t >(get(data+24, 8));
+	return true;
+}
+
+
+// Current instant on the local clock.
+std::int64_t time_sync_now()
+{
+	static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+	return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+
+// Constructor.
+TimeSyncEstimator::TimeSyncEstimator() :
+	_last_kept(0), _rejected(0), _base_local(0), _base_offset(0.0), _drift(0.0), _jitter(0.0)
+{}
+
+
+// Process the 4 instants of an exchange.
+bool TimeSyncEstimator::add_sample(std::int64_t t1, std::int64_t t2, std::int64_t t3, std::int64_t t4)
+{
+	Sample sample;
+	sample.local  = t1 + (t4 - t1)/2;
+	sample.offset = ((t2 - t1) + (t3 - t4))/2;
+	sample.delay  = (t4 - t1) - (t3 - t2);
+	if(sample.delay<0 || t4<t1) {
+		return false;
+	}
+
+	// Clock filter: keep only the sample with the smallest delay among the last ones, and only once.
+	_recent.push_back(sample);
+	if(_recent.size()>FILTER_SIZE) {
+		_recent.pop_front();
+	}
+	Sample best = *std::min_element(_recent.begin(), _recent.end(),
+		[](const Sample &lhs, const Sample &rhs) { return lhs.delay < rhs.delay; });
+	if(!_window.empty() && best.local<=_last_kept) {
+		return false;
+	}
+
+	// Outliers: further from the fit than the jitter and the uncertainty of the sample can explain.
+	if(_window.size()>=2) {
+		double tolerance = 4.0*_jitter + best.delay/2 + 100.0;
+		if(std::fabs(best.offset - predict(best.local)) > tolerance) {
+			if(++_rejected<MAX_CONSECUTIVE_OUTLIERS) {
+				return false;
+			}
+			// Step of the reference clock: start again from the new offset.
+			_window.clear();
+			_recent.assign(1, sample);
+			best = sample;
+		}
+	}
+	_rejected  = 0;
+	_last_kept = best.local;
+	_window.push_back(best);
+	if(_window.size()>WINDOW_SIZE) {
+		_window.pop_front();
+	}
+	fit();
+	return true;
+}
+
+
+// Current estimate.
+TimeSyncEstimator::Estimate TimeSyncEstimator::estimate() const
+{
+	Estimate retval;
+	retval.synchronized = !_window.empty();
+	retval.offset       = _window.empty() ? 0 : static_cast<std::int64_t>(std::llround(predict(_last_kept)));
+	retval.drift        = _drift * 1e6;
+	retval.delay        = _window.empty() ? 0 : _window.back().delay;
+	retval.jitter       = static_cast<std::int64_t>(std::llround(_jitter));
+	retval.samples      = _window.size();
+	return retval;
+}
+
+
+// Convert an instant of the local clock to the reference clock.
+std::int64_t TimeSyncEstimator::to_reference(std::int64_t local) const
+{
+	return _window.empty() ? local : local + static_cast<std::int64_t>(std::llround(predict(local)));
+}
+
+
+// Weighted least-squares fit of the offset as an affine function of the local time. The error on the offset
+// of a sample is bounded by half of its delay: the weight of each sample is the inverse of its squared delay.
+void TimeSyncEstimator::fit()
+{
+	// Weighted means (relative to the first sample, to keep the precision of the doubles).
+	std::int64_t origin = _window.front().local;
+	double sum_w  = 0.0;
+	double mean_t = 0.0;
+	double mean_o = 0.0;
+	for(const auto &it : _window) {
+		double w = weight(it);
+		sum_w  += w;
+		mean_t += w * static_cast<double>(it.local - origin);
+		mean_o += w * static_cast<double>(it.offset);
+	}
+	mean_t /= sum_w;
+	mean_o /= sum_w;
+
+	// Slope, only if the samples span a long enough time interval.
+	double stt = 0.0;
+	double sto = 0.0;
+	for(const auto &it : _window) {
+		double w  = weight(it);
+		double dt = static_cast<double>(it.local - origin) - mean_t;
+		stt += w * dt * dt;
+		sto += w * dt * (static_cast<double>(it.offset) - mean_o);
+	}
+	bool has_drift = _window.back().local - origin >= MIN_DRIFT_SPAN && stt>0.0;
+	_drift       = has_drift ? std::max(-MAX_DRIFT*1e-6, std::min(MAX_DRIFT*1e-6, sto/stt)) : 0.0;
+	_base_local  = origin + static_cast<std::int64_t>(std::llround(mean_t));
+	_base_offset = mean_o;
+
+	// Jitter
+	double residuals = 0.0;
+	for(const auto &it : _window) {
+		double r = static_cast<double>(it.offset) - predict(it.local);
+		residuals += weight(it) * r * r;
+	}
+	_jitter = std::sqrt(residuals / sum_w);
+}
+
+
+// Weight of a sample in the fit.
+double TimeSyncEstimator::weight(const Sample &sample)
+{
+	double uncertainty = static_cast<double>(sample.delay) + DELAY_FLOOR;
+	return 1.0 / (uncertainty * uncertainty);
+}
+
+
+// Offset predicted by the fit at the given local instant.
+double TimeSyncEstimator::predict(std::int64_t local) const
+{
+	return _base_offset + _drift * static_cast<double>(local - _base_local);
+}
@@ -0,0 +1,187 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef TIMESYNC_H_
+#define TIMESYNC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+
+/**
+ * Binary protocol used to align the time base of the clock instances of a hall (see `TimeSyncServer`
+ * and `TimeSyncClient`). This is a simplified NTP exchange, over UDP.
+ *
+ * All the integers are little-endian, and all the instants are expressed in microseconds since the Unix epoch
+ * (UTC), as read on the clock of the machine that stamped them. Each datagram holds exactly one packet:
+ *
+ *     u8  'V', u8 'S'     magic
+ *     u8  version         TIME_SYNC_VERSION
+ *     u8  type            TimeSyncPacketType
+ *     u32 sequence        chosen by the client, echoed by the server
+ *     i64 origin          instant at which the client sent the request (echoed by the server)
+ *     i64 receive         instant at which the server received the request (0 in requests)
+ *     i64 transmit        instant at which the server sent the response (0 in requests)
+ */
+enum class TimeSyncPacketType : std::uint8_t
+{
+	REQUEST  = 1,
+	RESPONSE = 2
+};
+
+
+/**
+ * Protocol version.
+ */
+const std::uint8_t TIME_SYNC_VERSION = 1;
+
+/**
+ * Size of a packet (in bytes).
+ */
+const std::size_t TIME_SYNC_PACKET_SIZE = 32;
+
+/**
+ * Default UDP port of the time-base server.
+ */
+const std::uint16_t TIME_SYNC_DEFAULT_PORT = 12078;
+
+
+/**
+ * Decoded packet.
+ */
+struct TimeSyncPacket
+{
+	TimeSyncPacketType type    ;
+	std::uint32_t      sequence;
+	std::int64_t       origin  ;
+	std::int64_t       receive ;
+	std::int64_t       transmit;
+};
+
+/**
+ * Encode a packet.
+ */
+std::string encode_time_sync_packet(const TimeSyncPacket &packet);
+
+/**
+ * Decode a packet.
+ * @returns `false` if the packet is malformed.
+ */
+bool decode_time_sync_packet(const char *data, std::size_t size, TimeSyncPacket &packet);
+
+/**
+ * Current instant on the local clock (us since the Unix epoch, UTC).
+ */
+std::int64_t time_sync_now();
+
+
+/**
+ * Estimation of the offset and of the drift of the local clock with respect to a reference clock,
+ * from the 4 instants of each request/response exchange.
+ *
+ * Each exchange gives an offset sample, whose error is bounded by half of the round-trip delay of the exchange:
+ * among the last `FILTER_SIZE` samples, only the one with the smallest delay is kept (as in the clock filter
+ * of NTP), and the samples that are far away from the current fit are rejected (unless several of them
+ * arrive in a row, which means that the reference clock has been stepped). The offset and the drift
+ * are then obtained by a least-squares fit over the last `WINDOW_SIZE` kept samples, weighted by
+ * the inverse of their squared delay.
+ *
+ * Not thread-safe.
+ */
+class TimeSyncEstimator
+{
+public:
+
+	/**
+	 * Current estimate.
+	 */
+	struct Estimate
+	{
+		bool          synchronized; //!< Whether at least one sample has been kept.
+		std::int64_t  offset      ; //!< Reference time minus local time, at the instant of the last kept sample (us).
+		double        drift       ; //!< Drift of the reference clock with respect to the local one (ppm).
+		std::int64_t  delay       ; //!< Round-trip delay of the last kept sample (us).
+		std::int64_t  jitter      ; //!< Weighted RMS of the residuals of the fit (us).
+		std::size_t   samples     ; //!< Number of samples used by the fit.
+	};
+
+	/**
+	 * Number of consecutive exchanges among which the sample with the smallest delay is selected.
+	 */
+	static const std::size_t FILTER_SIZE = 8;
+
+	/**
+	 * Number of kept samples used by the fit.
+	 */
+	static const std::size_t WINDOW_SIZE = 32;
+
+	/**
+	 * Constructor.
+	 */
+	TimeSyncEstimator();
+
+	/**
+	 * Process the 4 instants of an exchange (t1: request sent, t2: request received, t3: response sent,
+	 * t4: response received; t1 and t4 on the local clock, t2 and t3 on the reference clock).
+	 * @returns `true` if the sample has been kept.
+	 */
+	bool add_sample(std::int64_t t1, std::int64_t t2, std::int64_t t3, std::int64_t t4);
+
+	/**
+	 * Current estimate.
+	 */
+	Estimate estimate() const;
+
+	/**
+	 * Convert an instant of the local clock to the reference clock (no conversion until a sample has been kept).
+	 */
+	std::int64_t to_reference(std::int64_t local) const;
+
+private:
+
+	// Offset sample.
+	struct Sample
+	{
+		std::int64_t local ; // Local instant of the sample (middle of the exchange).
+		std::int64_t offset;
+		std::int64_t delay ;
+	};
+
+	// Private functions
+	void fit();
+	double predict(std::int64_t local) const;
+	static double weight(const Sample &sample);
+
+	// Private members
+	std::deque<Sample> _recent        ; // Last FILTER_SIZE samples, kept or not.
+	std::deque<Sample> _window        ; // Last WINDOW_SIZE kept samples.
+	std::int64_t       _last_kept     ; // Local instant of the last kept sample.
+	std::size_t        _rejected      ; // Number of consecutive samples rejected as outliers.
+	std::int64_t       _base_local    ; // The fit is: offset(t) = _base_offset + _drift * (t - _base_local).
+	double             _base_offset   ;
+	double             _drift         ;
+	double             _jitter        ;
+};
+
+#endif /* TIMESYNC_H_ */
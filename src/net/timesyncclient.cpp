@@ -0,0 +1,200 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "timesyncclient.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+// Delay between two requests of the start-up burst (in milliseconds).
+static const int BURST_INTERVAL = 100;
+
+
+// Constructor.
+TimeSyncClient::TimeSyncClient(const std::string &server_address, std::uint16_t port, int interval) :
+	_udp_fd(-1), _stop_fd(-1), _interval(interval), _sequence(0), _sent_at(0)
+{
+	sockaddr_in address;
+	std::memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port   = htons(port);
+	if(inet_pton(AF_INET, server_address.c_str(), &address.sin_addr)!=1) {
+		throw std::runtime_error("Invalid time-base server address: " + server_address);
+	}
+
+	// The socket is connected, so that only the datagrams sent by the server are received.
+	int enable = 1;
+	_udp_fd  = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(_udp_fd<0 || _stop_fd<0 || connect(_udp_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))!=0) {
+		for(int fd : {_udp_fd, _stop_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw std::runtime_error("Unable to create the time-base client socket.");
+	}
+	setsockopt(_udp_fd, SOL_SOCKET, SO_TIMESTAMP, &enable, sizeof(enable));
+
+	_thread = std::thread(&TimeSyncClient::run, this);
+}
+
+
+// Destructor.
+TimeSyncClient::~TimeSyncClient()
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_stop_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+	close(_udp_fd);
+	close(_stop_fd);
+}
+
+
+// Current estimate.
+TimeSyncEstimator::Estimate TimeSyncClient::estimate() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _estimator.estimate();
+}
+
+
+// Convert an instant of the local clock to the reference clock.
+std::int64_t TimeSyncClient::to_reference(std::int64_t local) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _estimator.to_reference(local);
+}
+
+
+// Event loop of the client thread.
+void TimeSyncClient::run()
+{
+	std::size_t  burst     = TimeSyncEstimator::FILTER_SIZE;
+	std::int64_t next_send = time_sync_now();
+	while(true) {
+		std::int64_t now = time_sync_now();
+		if(now>=next_send) {
+			send_request();
+			int delay = burst>0 ? BURST_INTERVAL : _interval;
+			if(burst>0) {
+				--burst;
+			}
+			next_send = now + static_cast<std::int64_t>(delay)*1000;
+		}
+
+		pollfd fds[2] = { {_stop_fd, POLLIN, 0}, {_udp_fd, POLLIN, 0} };
+		int timeout = static_cast<int>((next_send - now + 999)/1000);
+		if(poll(fds, 2, timeout>0 ? timeout : 0)<0) {
+			continue;
+		}
+		if(fds[0].revents!=0) {
+			return;
+		}
+		if(fds[1].revents!=0) {
+			receive_responses();
+		}
+	}
+}
+
+
+// Send a new request (the previous one, if still pending, is considered as lost).
+void TimeSyncClient::send_request()
+{
+	TimeSyncPacket packet;
+	packet.type     = TimeSyncPacketType::REQUEST;
+	packet.sequence = ++_sequence;
+	packet.receive  = 0;
+	packet.transmit = 0;
+	packet.origin   = time_sync_now();
+	_sent_at        = packet.origin;
+	std::string request = encode_time_sync_packet(packet);
+	ssize_t ignored = send(_udp_fd, request.data(), request.size(), 0); // <- A lost request is simply not answered.
+	(void)ignored;
+}
+
+
+// Process the responses received from the server.
+void TimeSyncClient::receive_responses()
+{
+	while(true) {
+		char   buffer[TIME_SYNC_PACKET_SIZE + 1];
+		char   control[CMSG_SPACE(sizeof(timeval))];
+		iovec  iov{buffer, sizeof(buffer)};
+		msghdr message;
+		std::memset(&message, 0, sizeof(message));
+		message.msg_iov        = &iov;
+		message.msg_iovlen     = 1;
+		message.msg_control    = control;
+		message.msg_controllen = sizeof(control);
+		ssize_t received = recvmsg(_udp_fd, &message, 0);
+		if(received<0) {
+			return;
+		}
+
+		// Reception instant
+		std::int64_t stamp = time_sync_now();
+		for(cmsghdr *it=CMSG_FIRSTHDR(&message); it!=nullptr; it=CMSG_NXTHDR(&message, it)) {
+			if(it->cmsg_level==SOL_SOCKET && it->cmsg_type==SCM_TIMESTAMP) {
+				timeval tv;
+				std::memcpy(&tv, CMSG_DATA(it), sizeof(tv));
+				stamp = static_cast<std::int64_t>(tv.tv_sec)*1000000 + tv.tv_usec;
+			}
+		}
+
+		// Only the response to the last request is used (the late ones have a large delay anyway).
+		TimeSyncPacket packet;
+		if(!decode_time_sync_packet(buffer, received, packet) || packet.type!=TimeSyncPacketType::RESPONSE ||
+			packet.sequence!=_sequence || packet.origin!=_sent_at)
+		{
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_estimator.add_sample(packet.origin, packet.receive, packet.transmit, stamp);
+	}
+}
+
+#else
+
+// Sockets are not supported on this platform.
+TimeSyncClient::TimeSyncClient(const std::string &, std::uint16_t, int interval) :
+	_udp_fd(-1), _stop_fd(-1), _interval(interval), _sequence(0), _sent_at(0)
+{
+	throw std::runtime_error("The time-base client is not supported on this platform.");
+}
+
+TimeSyncClient::~TimeSyncClient() {}
+TimeSyncEstimator::Estimate TimeSyncClient::estimate() const { return _estimator.estimate(); }
+std::int64_t TimeSyncClient::to_reference(std::int64_t local) const { return local; }
+
+#endif /* OS_IS_UNIX */
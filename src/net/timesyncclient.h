@@ -0,0 +1,103 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef TIMESYNCCLIENT_H_
+#define TIMESYNCCLIENT_H_
+
+#include "timesync.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+/**
+ * Estimate the offset and the drift of the local clock with respect to the reference clock of the hall
+ * (a `TimeSyncServer`), so that the instants exported to the other machines (e.g. the reference instant
+ * of the clock stream, see `BroadcastServer::set_time_base()`) are expressed on a common time base.
+ *
+ * The estimate is never applied to the local timers: a game is always measured with the local clock only,
+ * and a wrong estimate can only shift the exported timestamps.
+ *
+ * The requests are sent by a dedicated thread: a burst of `TimeSyncEstimator::FILTER_SIZE` requests at start-up,
+ * then one request per polling interval. To test the filtering on a single machine, an artificial delay can be
+ * added to the loopback interface (for instance `tc qdisc add dev lo root netem delay 5ms 2ms`),
+ * and the estimate watched with `vcc --time-sync-probe=127.0.0.1`, or the client run against a local server through
+ * a `TimeSyncRelay` simulating the delays and the clock of a remote server (`vcc --time-sync-probe=simulated`).
+ *
+ * Only available on Unix platforms.
+ */
+class TimeSyncClient
+{
+public:
+
+	/**
+	 * Constructor. Start the client thread.
+	 * @param interval Delay between two requests, once the start-up burst is over (in milliseconds).
+	 * @throw std::runtime_error If the socket cannot be created.
+	 */
+	TimeSyncClient(const std::string &server_address, std::uint16_t port=TIME_SYNC_DEFAULT_PORT, int interval=1000);
+
+	/**
+	 * Destructor. Stop the client thread.
+	 */
+	~TimeSyncClient();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	TimeSyncClient(const TimeSyncClient &op) = delete;
+	TimeSyncClient &operator=(const TimeSyncClient &op) = delete;
+	/**@} */
+
+	/**
+	 * Current estimate. Thread-safe.
+	 */
+	TimeSyncEstimator::Estimate estimate() const;
+
+	/**
+	 * Convert an instant of the local clock (us since the Unix epoch, UTC) to the reference clock. Thread-safe.
+	 */
+	std::int64_t to_reference(std::int64_t local) const;
+
+private:
+
+	// Private functions
+	void run();
+	void send_request();
+	void receive_responses();
+
+	// Private members (client thread only)
+	int               _udp_fd   ;
+	int               _stop_fd  ;
+	int               _interval ;
+	std::uint32_t     _sequence ;
+	std::int64_t      _sent_at  ; // Origin instant of the pending request.
+	std::thread       _thread   ;
+
+	// Private members (shared)
+	mutable std::mutex _mutex    ;
+	TimeSyncEstimator  _estimator;
+};
+
+#endif /* TIMESYNCCLIENT_H_ */
@@ -0,0 +1,183 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "timesyncrelay.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cmath>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// Loopback address with the given port.
+static sockaddr_in loopback_address(std::uint16_t port)
+{
+	sockaddr_in retval;
+	std::memset(&retval, 0, sizeof(retval));
+	retval.sin_family      = AF_INET;
+	retval.sin_port        = htons(port);
+	retval.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return retval;
+}
+
+
+// Constructor.
+TimeSyncRelay::TimeSyncRelay(std::uint16_t server_port, double mean_delay, std::int64_t offset, double drift) :
+	_client_fd(-1), _server_fd(-1), _stop_fd(-1), _port(0), _created_at(time_sync_now()), _offset(offset), _drift(drift),
+	_random(std::random_device()()), _delay(mean_delay>0.0 ? 1.0/mean_delay : 1e9)
+{
+	sockaddr_in relay_address  = loopback_address(0);
+	sockaddr_in server_address = loopback_address(server_port);
+	_client_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	_server_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	_stop_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(_client_fd<0 || _server_fd<0 || _stop_fd<0 ||
+		bind   (_client_fd, reinterpret_cast<sockaddr *>(&relay_address ), sizeof(relay_address ))!=0 ||
+		connect(_server_fd, reinterpret_cast<sockaddr *>(&server_address), sizeof(server_address))!=0)
+	{
+		for(int fd : {_client_fd, _server_fd, _stop_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw std::runtime_error("Unable to create the time-base relay sockets.");
+	}
+	socklen_t length = sizeof(relay_address);
+	getsockname(_client_fd, reinterpret_cast<sockaddr *>(&relay_address), &length);
+	_port = ntohs(relay_address.sin_port);
+
+	_thread = std::thread(&TimeSyncRelay::run, this);
+}
+
+
+// Destructor.
+TimeSyncRelay::~TimeSyncRelay()
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_stop_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+	for(int fd : {_client_fd, _server_fd, _stop_fd}) {
+		close(fd);
+	}
+}
+
+
+// Simulated clock minus local clock.
+std::int64_t TimeSyncRelay::offset_at(std::int64_t local) const
+{
+	return _offset + static_cast<std::int64_t>(std::llround(_drift * 1e-6 * (local - _created_at)));
+}
+
+
+// Event loop of the relay thread.
+void TimeSyncRelay::run()
+{
+	while(true) {
+		std::int64_t now = time_sync_now();
+		release(now);
+		int timeout = _held.empty() ? -1 : static_cast<int>((_held.begin()->first - now + 999)/1000);
+
+		pollfd fds[3] = { {_stop_fd, POLLIN, 0}, {_client_fd, POLLIN, 0}, {_server_fd, POLLIN, 0} };
+		if(poll(fds, 3, timeout)<0) {
+			continue;
+		}
+		if(fds[0].revents!=0) {
+			return;
+		}
+		if(fds[1].revents!=0) {
+			receive(_client_fd, true);
+		}
+		if(fds[2].revents!=0) {
+			receive(_server_fd, false);
+		}
+	}
+}
+
+
+// Hold the datagrams received on the given socket.
+void TimeSyncRelay::receive(int fd, bool to_server)
+{
+	while(true) {
+		char        buffer[TIME_SYNC_PACKET_SIZE + 1];
+		sockaddr_in from;
+		socklen_t   length = sizeof(from);
+		ssize_t received = recvfrom(fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from), &length);
+		if(received<0) {
+			return;
+		}
+		Datagram datagram;
+		datagram.to_server = to_server;
+		datagram.data.assign(buffer, received);
+		if(to_server) {
+			_client.assign(reinterpret_cast<const char *>(&from), sizeof(from));
+		}
+
+		// The responses are stamped on the simulated clock (the malformed datagrams are forwarded as they are).
+		TimeSyncPacket packet;
+		if(!to_server && decode_time_sync_packet(buffer, received, packet)) {
+			packet.receive  += offset_at(packet.receive );
+			packet.transmit += offset_at(packet.transmit);
+			datagram.data = encode_time_sync_packet(packet);
+		}
+		std::int64_t delay = static_cast<std::int64_t>(_delay(_random));
+		_held.insert(std::make_pair(time_sync_now() + delay, datagram));
+	}
+}
+
+
+// Forward the datagrams whose delay has elapsed.
+void TimeSyncRelay::release(std::int64_t now)
+{
+	while(!_held.empty() && _held.begin()->first<=now) {
+		const Datagram &datagram(_held.begin()->second);
+		if(datagram.to_server) {
+			send(_server_fd, datagram.data.data(), datagram.data.size(), MSG_DONTWAIT);
+		}
+		else if(!_client.empty()) {
+			sendto(_client_fd, datagram.data.data(), datagram.data.size(), MSG_DONTWAIT,
+				reinterpret_cast<const sockaddr *>(_client.data()), _client.size());
+		}
+		_held.erase(_held.begin());
+	}
+}
+
+#else
+
+// Sockets are not supported on this platform.
+TimeSyncRelay::TimeSyncRelay(std::uint16_t, double, std::int64_t offset, double drift) :
+	_client_fd(-1), _server_fd(-1), _stop_fd(-1), _port(0), _created_at(0), _offset(offset), _drift(drift)
+{
+	throw std::runtime_error("The time-base relay is not supported on this platform.");
+}
+
+TimeSyncRelay::~TimeSyncRelay() {}
+std::int64_t TimeSyncRelay::offset_at(std::int64_t) const { return _offset; }
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,110 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef TIMESYNCRELAY_H_
+#define TIMESYNCRELAY_H_
+
+#include "timesync.h"
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+
+
+/**
+ * Loopback relay simulating the network path to a remote time-base server and the clock of this server, so that
+ * `TimeSyncClient` can be tested on a single machine (`vcc --time-sync-probe=simulated`).
+ *
+ * The requests received on the port of the relay are forwarded to the server, and the responses back to the client,
+ * each datagram being held for a random delay (exponentially distributed). The instants stamped by the server are
+ * rewritten as if they had been read on a clock with the given offset and drift with respect to the local one.
+ *
+ * Only available on Unix platforms.
+ */
+class TimeSyncRelay
+{
+public:
+
+	/**
+	 * Constructor. Bind the relay socket on the loopback interface, and start the relay thread.
+	 * @param server_port Port of the server (on the loopback interface).
+	 * @param mean_delay Mean of the delay added to each datagram, in each direction (in microseconds).
+	 * @param offset Offset of the simulated clock with respect to the local one, when the relay is created (in microseconds).
+	 * @param drift Drift of the simulated clock with respect to the local one (in ppm).
+	 * @throw std::runtime_error If the sockets cannot be created.
+	 */
+	TimeSyncRelay(std::uint16_t server_port, double mean_delay, std::int64_t offset, double drift);
+
+	/**
+	 * Destructor. Stop the relay thread.
+	 */
+	~TimeSyncRelay();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	TimeSyncRelay(const TimeSyncRelay &op) = delete;
+	TimeSyncRelay &operator=(const TimeSyncRelay &op) = delete;
+	/**@} */
+
+	/**
+	 * Port of the relay, to which the client sends its requests.
+	 */
+	std::uint16_t port() const { return _port; }
+
+	/**
+	 * Simulated clock minus local clock, at the given local instant (us since the Unix epoch, UTC).
+	 */
+	std::int64_t offset_at(std::int64_t local) const;
+
+private:
+
+	// Datagram held by the relay.
+	struct Datagram
+	{
+		bool        to_server;
+		std::string data     ;
+	};
+
+	// Private functions
+	void run();
+	void receive(int fd, bool to_server);
+	void release(std::int64_t now);
+
+	// Private members
+	int                                   _client_fd  ; // Socket bound to the relay port.
+	int                                   _server_fd  ; // Socket connected to the server.
+	int                                   _stop_fd    ;
+	std::uint16_t                         _port       ;
+	std::int64_t                          _created_at ;
+	std::int64_t                          _offset     ;
+	double                                _drift      ;
+	std::string                           _client     ; // Address of the client (`sockaddr_in`), once it has sent a request.
+	std::multimap<std::int64_t, Datagram> _held       ; // Datagrams, by instant at which they are released.
+	std::mt19937                          _random     ;
+	std::exponential_distribution<double> _delay      ;
+	std::thread                           _thread     ;
+};
+
+#endif /* TIMESYNCRELAY_H_ */
@@ -0,0 +1,151 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#include "timesyncserver.h"
+#include <stdexcept>
+
+#ifdef OS_IS_UNIX
+
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+// Constructor.
+TimeSyncServer::TimeSyncServer(const std::string &address, std::uint16_t port) : _udp_fd(-1), _stop_fd(-1), _port(port), _requests(0)
+{
+	sockaddr_in bind_address;
+	std::memset(&bind_address, 0, sizeof(bind_address));
+	bind_address.sin_family = AF_INET;
+	bind_address.sin_port   = htons(port);
+	if(inet_pton(AF_INET, address.c_str(), &bind_address.sin_addr)!=1) {
+		throw std::runtime_error("Invalid time-base server address: " + address);
+	}
+
+	int enable = 1;
+	_udp_fd  = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(_udp_fd<0 || _stop_fd<0 || bind(_udp_fd, reinterpret_cast<sockaddr *>(&bind_address), sizeof(bind_address))!=0) {
+		for(int fd : {_udp_fd, _stop_fd}) {
+			if(fd>=0) {
+				close(fd);
+			}
+		}
+		throw std::runtime_error("Unable to create the time-base server socket.");
+	}
+	setsockopt(_udp_fd, SOL_SOCKET, SO_TIMESTAMP, &enable, sizeof(enable)); // <- Optional: reception instants stamped by the kernel.
+	socklen_t length = sizeof(bind_address);
+	getsockname(_udp_fd, reinterpret_cast<sockaddr *>(&bind_address), &length);
+	_port = ntohs(bind_address.sin_port);
+
+	_thread = std::thread(&TimeSyncServer::run, this);
+}
+
+
+// Destructor.
+TimeSyncServer::~TimeSyncServer()
+{
+	std::uint64_t one = 1;
+	ssize_t ignored = write(_stop_fd, &one, sizeof(one));
+	(void)ignored;
+	_thread.join();
+	close(_udp_fd);
+	close(_stop_fd);
+}
+
+
+// Event loop of the server thread.
+void TimeSyncServer::run()
+{
+	while(true) {
+		pollfd fds[2] = { {_stop_fd, POLLIN, 0}, {_udp_fd, POLLIN, 0} };
+		if(poll(fds, 2, -1)<0) {
+			continue;
+		}
+		if(fds[0].revents!=0) {
+			return;
+		}
+		answer();
+	}
+}
+
+
+// Answer the pending requests.
+void TimeSyncServer::answer()
+{
+	while(true) {
+		char        buffer[TIME_SYNC_PACKET_SIZE + 1];
+		char        control[CMSG_SPACE(sizeof(timeval))];
+		sockaddr_in from;
+		iovec       iov{buffer, sizeof(buffer)};
+		msghdr      message;
+		std::memset(&message, 0, sizeof(message));
+		message.msg_name       = &from;
+		message.msg_namelen    = sizeof(from);
+		message.msg_iov        = &iov;
+		message.msg_iovlen     = 1;
+		message.msg_control    = control;
+		message.msg_controllen = sizeof(control);
+		ssize_t received = recvmsg(_udp_fd, &message, 0);
+		if(received<0) {
+			return;
+		}
+
+		// Reception instant
+		std::int64_t stamp = time_sync_now();
+		for(cmsghdr *it=CMSG_FIRSTHDR(&message); it!=nullptr; it=CMSG_NXTHDR(&message, it)) {
+			if(it->cmsg_level==SOL_SOCKET && it->cmsg_type==SCM_TIMESTAMP) {
+				timeval tv;
+				std::memcpy(&tv, CMSG_DATA(it), sizeof(tv));
+				stamp = static_cast<std::int64_t>(tv.tv_sec)*1000000 + tv.tv_usec;
+			}
+		}
+
+		TimeSyncPacket packet;
+		if(!decode_time_sync_packet(buffer, received, packet) || packet.type!=TimeSyncPacketType::REQUEST) {
+			continue;
+		}
+		packet.type     = TimeSyncPacketType::RESPONSE;
+		packet.receive  = stamp;
+		packet.transmit = time_sync_now();
+		std::string response = encode_time_sync_packet(packet);
+		sendto(_udp_fd, response.data(), response.size(), 0, reinterpret_cast<sockaddr *>(&from), sizeof(from));
+		++_requests;
+	}
+}
+
+#else
+
+// Sockets are not supported on this platform.
+TimeSyncServer::TimeSyncServer(const std::string &, std::uint16_t port) : _udp_fd(-1), _stop_fd(-1), _port(port), _requests(0)
+{
+	throw std::runtime_error("The time-base server is not supported on this platform.");
+}
+
+TimeSyncServer::~TimeSyncServer() {}
+
+#endif /* OS_IS_UNIX */
@@ -0,0 +1,89 @@
+/******************************************************************************
+ *                                                                            *
+ *    This file is part of Virtual Chess Clock, a chess clock software        *
+ *                                                                            *
+ *    Copyright (C) 2010-2014 Yoann Le Montagner <yo35(at)melix(dot)net>      *
+ *                                                                            *
+ *    This program is free software: you can redistribute it and/or modify    *
+ *    it under the terms of the GNU General Public License as published by    *
+ *    the Free Software Foundation, either version 3 of the License, or       *
+ *    (at your option) any later version.                                     *
+ *                                                                            *
+ *    This program is distributed in the hope that it will be useful,         *
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *    GNU General Public License for more details.                            *
+ *                                                                            *
+ *    You should have received a copy of the GNU General Public License       *
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
+ *                                                                            *
+ ******************************************************************************/
+
+
+#ifndef TIMESYNCSERVER_H_
+#define TIMESYNCSERVER_H_
+
+#include "timesync.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+
+/**
+ * Reference clock of a hall: answers the time-base requests of the `TimeSyncClient` objects
+ * (see `timesync.h` for the protocol).
+ *
+ * The requests are answered by a dedicated thread, with the reception instant stamped by the kernel
+ * when available, so that the scheduling latency of the thread does not add noise to the samples.
+ *
+ * Only available on Unix platforms.
+ */
+class TimeSyncServer
+{
+public:
+
+	/**
+	 * Constructor. Bind the UDP socket on the given IPv4 address and port, and start the server thread.
+	 * @throw std::runtime_error If the socket cannot be created.
+	 */
+	TimeSyncServer(const std::string &address, std::uint16_t port=TIME_SYNC_DEFAULT_PORT);
+
+	/**
+	 * Destructor. Stop the server thread.
+	 */
+	~TimeSyncServer();
+
+	/**
+	 * @name Copy is not allowed.
+	 * @{
+	 */
+	TimeSyncServer(const TimeSyncServer &op) = delete;
+	TimeSyncServer &operator=(const TimeSyncServer &op) = delete;
+	/**@} */
+
+	/**
+	 * Port actually used by the socket (useful if the server has been created with port 0).
+	 */
+	std::uint16_t port() const { return _port; }
+
+	/**
+	 * Number of requests answered so far.
+	 */
+	std::uint64_t requests() const { return _requests; }
+
+private:
+
+	// Private functions
+	void run();
+	void answer();
+
+	// Private members
+	int                        _udp_fd  ;
+	int                        _stop_fd ;
+	std::uint16_t              _port    ;
+	std::atomic<std::uint64_t> _requests;
+	std::thread                _thread  ;
+};
+
+#endif /* TIMESYNCSERVER_H_ */